@@ -0,0 +1,381 @@
+// ped-sim: pedigree simulation tool
+//
+// This program is distributed under the terms of the GNU General Public License
+
+#include <random>
+#include <algorithm>
+#include <math.h>
+#include <limits.h>
+#include <assert.h>
+#include "backward.h"
+#include "simulate.h"
+#include "fixedcos.h"
+#include "phasetimer.h"
+#include "packedhaps.h"
+
+extern uniform_real_distribution<double> unif_prob;
+
+// For --engine backward: simulates the replicate <rep> of pedigree <ped> (whose
+// Person objects, with their sexes, fixed crossover indexes, and founder
+// haplotypes, are in <repSamples>) by tracing the ancestry of the printed
+// samples' haplotypes back through the pedigree. Starting from the last
+// generation, each non-founder passes the stretches of its haplotypes that
+// a printed descendant inherits (or, for printed individuals, the whole
+// chromosome) up to its parents, sampling only the parts of the meiosis that
+// fall within these stretches. A parent in a deep pedigree typically transmits
+// only a small part of its genome to the printed samples, and the rest of it
+// is never simulated. Then, from the first generation down, the founder
+// haplotype of each traced stretch is resolved, and the haplotypes and
+// <hapCarriers> records of the printed non-founders are filled in as
+// simulate() does for the forward engine. The results have the same
+// distribution as those of the forward engine, but the random draws differ.
+void traceAncestry(SimDetails &pedDetails, int ped, int rep,
+		   Person ***repSamples, GeneticMap &map, bool sexSpecificMaps,
+		   vector<COInterfere> &coIntf,
+		   vector< vector< vector<InheritRecord> > > &hapCarriers) {
+  int numGen = pedDetails.numGen;
+  int **numSampsToPrint = pedDetails.numSampsToPrint;
+  int *numBranches = pedDetails.numBranches;
+  Parent **branchParents = pedDetails.branchParents;
+  int **branchNumSpouses = pedDetails.branchNumSpouses;
+  unsigned int numChrs = map.size();
+
+  // Number the individuals in the replicate: <branchFirst> is the number of
+  // the first individual in each branch, and <branchFounders> and
+  // <branchPersons> the numbers of founders and of all individuals in it
+  vector< vector<int> > branchFirst(numGen), branchFounders(numGen),
+			branchPersons(numGen);
+  int numInRep = 0;
+  for(int gen = 0; gen < numGen; gen++) {
+    for(int branch = 0; branch < numBranches[gen]; branch++) {
+      int numFounders, numNonFounders;
+      getPersonCounts(gen, numGen, branch, numSampsToPrint, branchParents,
+		      branchNumSpouses, numFounders, numNonFounders);
+      branchFirst[gen].push_back(numInRep);
+      branchFounders[gen].push_back(numFounders);
+      branchPersons[gen].push_back(numFounders + numNonFounders);
+      numInRep += numFounders + numNonFounders;
+    }
+  }
+
+  // For each haplotype of each individual and chromosome (indexed by
+  // tracedIdx()), the stretches its descendants want, and those traced to a
+  // haplotype of its parent (later resolved to founder haplotypes). These are
+  // empty between calls, and we keep their space for the next replicate.
+  static thread_local vector< vector< pair<int,int> > > wanted;
+  static thread_local vector< vector<TracedSeg> > traced;
+  if (wanted.size() < (size_t) numInRep * 2 * numChrs) {
+    wanted.resize(numInRep * 2 * numChrs);
+    traced.resize(numInRep * 2 * numChrs);
+  }
+
+  // printed non-founders want all of both their haplotypes
+  for(int gen = 1; gen < numGen; gen++) {
+    for(int branch = 0; branch < numBranches[gen]; branch++) {
+      if (numSampsToPrint[gen][branch] == 0)
+	continue;
+      int numPersons = branchPersons[gen][branch];
+      for(int ind = branchFounders[gen][branch]; ind < numPersons; ind++) {
+	int person = branchFirst[gen][branch] + ind;
+	for(int h = 0; h < 2; h++) {
+	  for(unsigned int chrIdx = 0; chrIdx < numChrs; chrIdx++) {
+	    if (map.isX(chrIdx) && h == 0 &&
+		repSamples[gen][branch][ind].sex == 0)
+	      continue; // only one haplotype (maternal) for males on X
+	    wanted[ tracedIdx(person, h, chrIdx, numChrs) ].emplace_back(
+		      map.chromStartPhys(chrIdx), map.chromEndPhys(chrIdx));
+	  }
+	}
+      }
+    }
+  }
+
+  // Trace from the last generation back: the descendants of every individual
+  // are in later generations, so by the time we reach it, all the stretches
+  // they want are in <wanted>
+  for(int gen = numGen - 1; gen > 0; gen--) {
+    for(int branch = numBranches[gen] - 1; branch >= 0; branch--) {
+      int numFounders = branchFounders[gen][branch];
+      int numPersons = branchPersons[gen][branch];
+      if (numPersons == numFounders)
+	continue; // no parents in this branch
+
+      Parent pars[2];
+      int parIdx[2];
+      getBranchParents(pedDetails, gen, branch, pars, parIdx);
+
+      for(int ind = numFounders; ind < numPersons; ind++) {
+	Person &thePerson = repSamples[gen][branch][ind];
+	int person = branchFirst[gen][branch] + ind;
+	for(int p = 0; p < 2; p++) {
+	  Person &theParent = repSamples[ pars[p].gen ][ pars[p].branch ]
+								  [ parIdx[p] ];
+	  int parent = branchFirst[ pars[p].gen ][ pars[p].branch ] + parIdx[p];
+	  int hapIdx = (sexSpecificMaps) ? theParent.sex : p;
+	  for(unsigned int chrIdx = 0; chrIdx < numChrs; chrIdx++) {
+	    int idx = tracedIdx(person, hapIdx, chrIdx, numChrs);
+	    if (wanted[idx].empty())
+	      continue;
+
+	    mergeStretches(wanted[idx]);
+	    traceMeiosis(wanted[idx], theParent.sex, thePerson.fixedCOidxs,
+			 map, coIntf, chrIdx, traced[idx]);
+	    wanted[idx].clear();
+
+	    // the parent's haplotypes must supply these stretches
+	    for(auto it = traced[idx].begin(); it != traced[idx].end(); it++)
+	      wanted[ tracedIdx(parent, it->src, chrIdx, numChrs) ].emplace_back(
+							  it->start, it->end);
+	  }
+	}
+      }
+    }
+  }
+
+  // Now resolve the founder haplotypes from the first generation down: the
+  // stretches of every parent are resolved before those of its children
+  vector<TracedSeg> resolved;
+  for(int gen = 1; gen < numGen; gen++) {
+    for(int branch = 0; branch < numBranches[gen]; branch++) {
+      int numFounders = branchFounders[gen][branch];
+      int numPersons = branchPersons[gen][branch];
+      if (numPersons == numFounders)
+	continue;
+
+      Parent pars[2];
+      int parIdx[2];
+      getBranchParents(pedDetails, gen, branch, pars, parIdx);
+      bool print = numSampsToPrint[gen][branch] > 0;
+
+      for(int ind = numFounders; ind < numPersons; ind++) {
+	Person &thePerson = repSamples[gen][branch][ind];
+	int person = branchFirst[gen][branch] + ind;
+	for(int p = 0; p < 2; p++) {
+	  Person &theParent = repSamples[ pars[p].gen ][ pars[p].branch ]
+								  [ parIdx[p] ];
+	  int parent = branchFirst[ pars[p].gen ][ pars[p].branch ] + parIdx[p];
+	  bool parentIsFounder = pars[p].gen == 0 ||
+		      parIdx[p] < branchFounders[ pars[p].gen ][ pars[p].branch ];
+	  int hapIdx = (sexSpecificMaps) ? theParent.sex : p;
+	  for(unsigned int chrIdx = 0; chrIdx < numChrs; chrIdx++) {
+	    vector<TracedSeg> &segs =
+			      traced[ tracedIdx(person, hapIdx, chrIdx, numChrs) ];
+	    if (segs.empty())
+	      continue;
+
+	    if (parentIsFounder) {
+	      // founders have the same haplotypes across the chromosome, and
+	      // their haplotype numbers are consecutive; haps[1] is defined on
+	      // all chromosomes
+	      int hap1Num = theParent.haps[1].front().front().foundHapNum;
+	      for(auto it = segs.begin(); it != segs.end(); it++)
+		it->src = hap1Num - 1 + it->src;
+	    }
+	    else {
+	      resolved.clear();
+	      for(auto it = segs.begin(); it != segs.end(); it++)
+		copyResolved(traced[ tracedIdx(parent, it->src, chrIdx,
+						numChrs) ],
+			     it->start, it->end, resolved);
+	      segs.swap(resolved);
+	    }
+	  }
+	}
+
+	if (!print)
+	  continue;
+
+	// fill in the haplotypes of <thePerson> in chromosome order
+	for(int h = 0; h < 2; h++) {
+	  for(unsigned int chrIdx = 0; chrIdx < numChrs; chrIdx++) {
+	    if (map.isX(chrIdx) && h == 0 && thePerson.sex == 0)
+	      continue; // only one haplotype (maternal) for males on X
+	    vector<TracedSeg> &segs =
+				traced[ tracedIdx(person, h, chrIdx, numChrs) ];
+	    Haplotype &hap = addHap(thePerson, h);
+	    hap.reserve(segs.size());
+	    for(auto it = segs.begin(); it != segs.end(); it++) {
+	      hap.emplace_back(it->src, it->end);
+	      hapCarriers[ it->src ][ chrIdx ].emplace_back(
+		  ped, rep, gen, branch, ind, it->start, it->end);
+	    }
+	    PhaseTimer::count(SEGMENTS, hap.size());
+	  }
+	}
+      }
+    }
+  }
+
+  // ready for the next replicate (the founders' stretches in <wanted> are never
+  // traced)
+  for(int i = 0; i < numInRep * 2 * (int) numChrs; i++) {
+    wanted[i].clear();
+    traced[i].clear();
+  }
+}
+
+// Sorts the stretches in <stretches> and merges any that overlap or abut
+void mergeStretches(vector< pair<int,int> > &stretches) {
+  sort(stretches.begin(), stretches.end());
+  unsigned int last = 0;
+  for(unsigned int i = 1; i < stretches.size(); i++) {
+    if (stretches[i].first <= stretches[last].second + 1)
+      stretches[last].second = max(stretches[last].second,
+				   stretches[i].second);
+    else
+      stretches[++last] = stretches[i];
+  }
+  stretches.resize(last + 1);
+}
+
+// Samples the meiosis in a parent of sex <parSex> that transmits chromosome
+// <chrIdx>, only over the (sorted and disjoint) stretches in <wanted>, and
+// adds these stretches to <traced> along with the index of the parent's
+// haplotype each is copied from. Without crossover interference or fixed
+// crossovers, the crossovers are sampled lazily: an odd number of crossovers
+// in the gap between two wanted stretches, which has probability
+// (1 - e^{-2d}) / 2 for a gap of d Morgans, switches the haplotype, and only
+// the crossovers within the stretches are placed.
+void traceMeiosis(vector< pair<int,int> > &wanted, int parSex,
+		  unsigned int fixedCOidxs[2], GeneticMap &map,
+		  vector<COInterfere> &coIntf, unsigned int chrIdx,
+		  vector<TracedSeg> &traced) {
+  // Pick haplotype for the beginning of the transmitted one:
+  int curHap = coinFlip(randomGen);
+
+  if (map.isX(chrIdx) && parSex == 0)
+    // only one haplotype on X (the maternal) if the parent is male
+    curHap = 1;
+
+  double firstcMPos = map.chromStartGenet(chrIdx, parSex);
+  double chrLength = map.chromGenetLength(chrIdx, parSex);
+
+  vector<int> switches; // when sampling all crossovers
+#ifndef NOFIXEDCO
+  if (fixedCOidxs[0] != UINT_MAX) {
+    vector<int> &theCOs = FixedCOs::getCOs(parSex, fixedCOidxs[parSex],
+					   chrIdx);
+    PhaseTimer::count(CROSSOVERS, theCOs.size());
+    traceSwitches(wanted, theCOs, curHap, traced);
+    return;
+  }
+#endif // NOFIXEDCO
+  if (chrLength > 0.0 && coIntf.size() > 0) {
+    vector<double> coLocations; // in Morgans
+    coIntf[chrIdx].simStahl(coLocations, parSex, randomGen);
+    PhaseTimer::count(CROSSOVERS, coLocations.size());
+    for(auto it = coLocations.begin(); it != coLocations.end(); it++) {
+      int switchPos = crossoverSwitchPos(map, chrIdx, parSex,
+					 firstcMPos + (*it * 100));
+      if (switchPos < 0)
+	break;
+      switches.push_back(switchPos);
+    }
+  }
+  if (chrLength <= 0.0 || coIntf.size() > 0) {
+    traceSwitches(wanted, switches, curHap, traced);
+    return;
+  }
+
+  int numCOs = 0;
+  double prevEndcM = firstcMPos; // end of the last stretch sampled
+  for(auto it = wanted.begin(); it != wanted.end(); it++) {
+    double startcM = physToGenet(map, chrIdx, parSex, it->first);
+    double endcM = physToGenet(map, chrIdx, parSex, it->second);
+    double gap = (startcM - prevEndcM) / 100; // in Morgans
+    if (gap > 0.0 && unif_prob(randomGen) < (1 - exp(-2 * gap)) / 2)
+      curHap ^= 1;
+
+    int start = it->first;
+    double cMPos = startcM;
+    while (true) {
+      cMPos += crossoverDist(randomGen) * 100;
+      if (cMPos >= endcM)
+	break;
+      int switchPos = crossoverSwitchPos(map, chrIdx, parSex, cMPos);
+      if (switchPos < 0)
+	break;
+      numCOs++;
+      if (start <= switchPos) {
+	addTraced(traced, start, switchPos, curHap);
+	start = switchPos + 1;
+      }
+      curHap ^= 1;
+    }
+    if (start <= it->second)
+      addTraced(traced, start, it->second, curHap);
+    prevEndcM = endcM;
+  }
+  PhaseTimer::count(CROSSOVERS, numCOs);
+}
+
+// Adds the stretches in <wanted> to <traced>, switching from <curHap> to the
+// other haplotype just after each of the positions in <switches> (sorted)
+void traceSwitches(vector< pair<int,int> > &wanted, vector<int> &switches,
+		   int curHap, vector<TracedSeg> &traced) {
+  unsigned int s = 0;
+  for(auto it = wanted.begin(); it != wanted.end(); it++) {
+    for( ; s < switches.size() && switches[s] < it->first; s++)
+      curHap ^= 1;
+    int start = it->first;
+    for( ; s < switches.size() && switches[s] < it->second; s++) {
+      if (start <= switches[s]) {
+	addTraced(traced, start, switches[s], curHap);
+	start = switches[s] + 1;
+      }
+      curHap ^= 1;
+    }
+    addTraced(traced, start, it->second, curHap);
+  }
+}
+
+// Adds the stretch <start> through <end> of <src> to <traced>, extending the
+// last stretch if it abuts and has the same source (as for two crossovers at
+// the same position)
+void addTraced(vector<TracedSeg> &traced, int start, int end, int src) {
+  if (!traced.empty() && traced.back().end + 1 == start &&
+      traced.back().src == src)
+    traced.back().end = end;
+  else
+    traced.push_back({ start, end, src });
+}
+
+// Adds to <resolved> the stretches of the resolved list <from> (sorted and
+// covering <start> through <end>) between <start> and <end>, clipped to these
+// positions
+void copyResolved(vector<TracedSeg> &from, int start, int end,
+		  vector<TracedSeg> &resolved) {
+  // first stretch that ends at or after <start>
+  auto it = lower_bound(from.begin(), from.end(), start,
+			[](const TracedSeg &seg, int pos) {
+			  return seg.end < pos;
+			});
+  for( ; it != from.end() && it->start <= end; it++) {
+    resolved.push_back({ max(it->start, start), min(it->end, end), it->src });
+    assert(resolved.back().start <= resolved.back().end);
+  }
+  assert(resolved.back().end == end);
+}
+
+// Returns the genetic position (in centiMorgans) of physical position <pos> on
+// chromosome <chrIdx> in the map for <sex>, using linear interpolation
+double physToGenet(GeneticMap &map, unsigned int chrIdx, int sex, int pos) {
+  int left = 0, right = map.chromNumPos(chrIdx) - 1;
+  // stretches often span the whole chromosome
+  if (pos <= map.chromPhysPos(chrIdx, left))
+    return map.chromGenetPos(chrIdx, sex, left);
+  if (pos >= map.chromPhysPos(chrIdx, right))
+    return map.chromGenetPos(chrIdx, sex, right);
+  while (right - left > 1) {
+    int mid = (left + right) / 2;
+    if (map.chromPhysPos(chrIdx, mid) <= pos)
+      left = mid;
+    else
+      right = mid;
+  }
+  double frac = (double) (pos - map.chromPhysPos(chrIdx, left)) /
+		(map.chromPhysPos(chrIdx, right) - map.chromPhysPos(chrIdx, left));
+  return map.chromGenetPos(chrIdx, sex, left) +
+	 frac * (map.chromGenetPos(chrIdx, sex, right) -
+					    map.chromGenetPos(chrIdx, sex, left));
+}
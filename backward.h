@@ -0,0 +1,45 @@
+// ped-sim: pedigree simulation tool
+//
+// This program is distributed under the terms of the GNU General Public License
+
+#include <vector>
+#include "datastructs.h"
+#include "geneticmap.h"
+#include "cointerfere.h"
+
+#ifndef BACKWARD_H
+#define BACKWARD_H
+
+using namespace std;
+
+// A stretch <start> through <end> of a haplotype traced by traceAncestry():
+// <src> is the index of the parent's haplotype it's copied from until it is
+// resolved, and the founder haplotype number after
+struct TracedSeg {
+  int start, end;
+  int src;
+};
+
+// Index of haplotype <hap> of individual <person> on chromosome <chrIdx>
+inline int tracedIdx(int person, int hap, unsigned int chrIdx,
+		     unsigned int numChrs) {
+  return (2 * person + hap) * numChrs + chrIdx;
+}
+
+void traceAncestry(SimDetails &pedDetails, int ped, int rep,
+		   Person ***repSamples, GeneticMap &map, bool sexSpecificMaps,
+		   vector<COInterfere> &coIntf,
+		   vector< vector< vector<InheritRecord> > > &hapCarriers);
+void mergeStretches(vector< pair<int,int> > &stretches);
+void traceMeiosis(vector< pair<int,int> > &wanted, int parSex,
+		  unsigned int fixedCOidxs[2], GeneticMap &map,
+		  vector<COInterfere> &coIntf, unsigned int chrIdx,
+		  vector<TracedSeg> &traced);
+void traceSwitches(vector< pair<int,int> > &wanted, vector<int> &switches,
+		   int curHap, vector<TracedSeg> &traced);
+void addTraced(vector<TracedSeg> &traced, int start, int end, int src);
+void copyResolved(vector<TracedSeg> &from, int start, int end,
+		  vector<TracedSeg> &resolved);
+double physToGenet(GeneticMap &map, unsigned int chrIdx, int sex, int pos);
+
+#endif // BACKWARD_H
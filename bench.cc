@@ -0,0 +1,490 @@
+// ped-sim: pedigree simulation tool
+//
+// This program is distributed under the terms of the GNU General Public License
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <unistd.h>
+#include <getopt.h>
+#include <vector>
+#include <string>
+#include <random>
+#include <chrono>
+#include <algorithm>
+#include <functional>
+#include "cmdlineopts.h"
+#include "datastructs.h"
+#include "geneticmap.h"
+#include "cointerfere.h"
+#include "simulate.h"
+#include "ibdseg.h"
+#include "fileorgz.h"
+#include "pedsim.h"
+#include "readdef.h"
+
+using namespace std;
+
+////////////////////////////////////////////////////////////////////////////////
+// Microbenchmarks of the core kernels, built and run by `make bench`. The
+// inputs (genetic map, pedigrees, and input VCF) are generated here, so the
+// results only depend on the code and the machine. Each kernel runs <numReps>
+// times; the time per operation of each run gives the median and percentiles,
+// printed as tab-separated values (times in nanoseconds) for comparing
+// builds.
+
+// synthetic inputs
+static const int NUM_CHRS = 4;
+static const int MAP_POSITIONS = 2000;     // per chromosome
+static const int CHR_PHYS_LENGTH = 100000000;
+static const double CHR_GENET_LENGTH = 120.0; // in cM
+static const int VCF_SITES = 2000;         // across all chromosomes
+static const char *BENCH_DEF =
+  "def cousins 50 4\n"
+  "1 1\n"
+  "2 0 2\n"
+  "3 0 2\n"
+  "4 1 2\n"
+  "def avuncular 50 3\n"
+  "2 1 2  1n\n"
+  "3 1 1\n";
+
+static char tmpDir[] = "/tmp/ped-sim-bench.XXXXXX";
+static const char *kernelFilter = NULL;
+
+// Returns <tmpDir>/<name>
+string tmpFile(const char *name) {
+  return string(tmpDir) + "/" + name;
+}
+
+// Runs <body> <numReps> times, each performing <opsPerRep> operations, and
+// prints the distribution of the time per operation. <prepare> (if given) runs
+// before each repetition and isn't timed.
+void runKernel(const char *name, const char *unit, int numReps,
+	       long opsPerRep, function<void()> body,
+	       function<void()> prepare = nullptr) {
+  if (kernelFilter && strstr(name, kernelFilter) == NULL)
+    return;
+
+  vector<double> nsPerOp;
+  for(int rep = 0; rep < numReps; rep++) {
+    if (prepare)
+      prepare();
+    auto start = chrono::steady_clock::now();
+    body();
+    auto end = chrono::steady_clock::now();
+    double ns = chrono::duration<double, nano>(end - start).count();
+    nsPerOp.push_back(ns / opsPerRep);
+  }
+  sort(nsPerOp.begin(), nsPerOp.end());
+
+  // nearest-rank percentiles
+  auto pct = [&](double p) {
+    int idx = (int) (p / 100 * nsPerOp.size() + 0.5) - 1;
+    return nsPerOp[ max(0, min(idx, (int) nsPerOp.size() - 1)) ];
+  };
+  printf("%s\t%s\t%d\t%ld\t%.2lf\t%.2lf\t%.2lf\t%.2lf\t%.2lf\n", name, unit,
+	 numReps, opsPerRep, pct(50), pct(10), pct(90), pct(99), nsPerOp[0]);
+  fflush(stdout);
+}
+
+// Writes a sex-averaged genetic map with <MAP_POSITIONS> evenly spaced
+// positions per chromosome and recombination rates that vary along it
+void writeMap(const char *fileName) {
+  FILE *out = fopen(fileName, "w");
+  if (!out) {
+    fprintf(stderr, "ERROR: could not open %s!\n", fileName);
+    perror("open");
+    exit(1);
+  }
+  mt19937 gen(1);
+  uniform_real_distribution<double> rate(0.2, 1.8);
+  for(int chr = 1; chr <= NUM_CHRS; chr++) {
+    vector<double> steps(MAP_POSITIONS - 1);
+    double total = 0.0;
+    for(auto it = steps.begin(); it != steps.end(); it++)
+      total += (*it = rate(gen));
+    double cM = 0.0;
+    for(int i = 0; i < MAP_POSITIONS; i++) {
+      int pos = 1 + (long) i * (CHR_PHYS_LENGTH - 1) / (MAP_POSITIONS - 1);
+      fprintf(out, "%d %d %.6lf\n", chr, pos, cM);
+      if (i < MAP_POSITIONS - 1)
+	cM += steps[i] / total * CHR_GENET_LENGTH;
+    }
+  }
+  fclose(out);
+}
+
+// Writes a phased VCF with <numSamples> samples and <VCF_SITES> sites spread
+// across the chromosomes of the map
+void writeVCF(const char *fileName, int numSamples) {
+  FileOrGZ<FILE *> out;
+  if (!out.open(fileName, "w")) {
+    fprintf(stderr, "ERROR: could not open %s!\n", fileName);
+    perror("open");
+    exit(1);
+  }
+  mt19937 gen(2);
+  uniform_int_distribution<int> allele(0, 1);
+  out.printf("##fileformat=VCFv4.2\n");
+  out.printf("#CHROM\tPOS\tID\tREF\tALT\tQUAL\tFILTER\tINFO\tFORMAT");
+  for(int s = 0; s < numSamples; s++)
+    out.printf("\tS%d", s);
+  out.printf("\n");
+  int sitesPerChr = VCF_SITES / NUM_CHRS;
+  for(int chr = 1; chr <= NUM_CHRS; chr++) {
+    for(int i = 0; i < sitesPerChr; i++) {
+      int pos = 1 + (long) (i + 1) * (CHR_PHYS_LENGTH - 2) / (sitesPerChr + 1);
+      out.printf("%d\t%d\t.\tA\tG\t.\tPASS\t.\tGT", chr, pos);
+      for(int s = 0; s < numSamples; s++)
+	out.printf("\t%d|%d", allele(gen), allele(gen));
+      out.printf("\n");
+    }
+  }
+  out.close();
+}
+
+// Gives <parent> haplotypes on every chromosome made of <numSegs> segments
+// from different founder haplotypes, as in a sample many generations removed
+// from its founders
+void makeParent(Person &parent, GeneticMap &map, int numSegs) {
+  for(int h = 0; h < 2; h++) {
+    parent.haps[h].clear();
+    for(unsigned int c = 0; c < map.size(); c++) {
+      parent.haps[h].emplace_back();
+      int start = map.chromStartPhys(c), end = map.chromEndPhys(c);
+      for(int s = 1; s <= numSegs; s++) {
+	int endPos = (s == numSegs) ? end :
+				start + (long) s * (end - start) / numSegs;
+	parent.haps[h][c].emplace_back(h * numSegs + s - 1, endPos);
+      }
+    }
+  }
+}
+
+void printUsage(FILE *out, char *programName) {
+  fprintf(out, "Usage: %s [-r <reps>] [-k <kernel substring>]\n", programName);
+  fprintf(out, "  -r <reps>\trepetitions of each kernel (default 25)\n");
+  fprintf(out, "  -k <string>\tonly run kernels whose names contain <string>\n");
+}
+
+int main(int argc, char **argv) {
+  int numReps = 25;
+  int c;
+  while ((c = getopt(argc, argv, "r:k:")) != -1) {
+    switch (c) {
+      case 'r':
+	numReps = atoi(optarg);
+	if (numReps < 1) {
+	  fprintf(stderr, "ERROR: -r value must be 1 or greater\n");
+	  exit(5);
+	}
+	break;
+      case 'k':
+	kernelFilter = optarg;
+	break;
+      default:
+	printUsage(stderr, argv[0]);
+	exit(1);
+    }
+  }
+
+  if (mkdtemp(tmpDir) == NULL) {
+    fprintf(stderr, "ERROR: could not make temporary directory\n");
+    perror("mkdtemp");
+    exit(1);
+  }
+  CmdLineOpts::chrX = (char *) "X";
+
+  string mapFile = tmpFile("map.txt");
+  writeMap(mapFile.c_str());
+  bool sexSpecificMaps;
+  GeneticMap map((char *) mapFile.c_str(), sexSpecificMaps);
+
+  // interference parameters as estimated for humans
+  vector<COInterfere> coIntf;
+  for(unsigned int chr = 0; chr < map.size(); chr++) {
+    double nu[2] = { 8.9, 6.4 }, p[2] = { 0.06, 0.07 }, len[2];
+    for(int s = 0; s < 2; s++)
+      len[s] = map.chromGenetLength(chr, s) / 100;
+    coIntf.emplace_back(nu, p, len);
+  }
+  vector<COInterfere> noIntf; // Poisson model
+
+  printf("kernel\tunit\treps\tops_per_rep\tmedian_ns\tp10_ns\tp90_ns\tp99_ns\tmin_ns\n");
+
+  randomGen.seed(3);
+
+  //////////////////////////////////////////////////////////////////////////
+  // meiosis: generateHaplotype() and copySegs()
+  const int HAPS_PER_REP = 2000;
+  Person parent;
+  makeParent(parent, map, /*numSegs=*/ 20);
+  unsigned int noFixedCOs[2] = { UINT_MAX, UINT_MAX };
+  vector< vector< vector<InheritRecord> > > hapCarriers;
+  Haplotype toGen;
+  auto meioses = [&](vector<COInterfere> &intf, int ped) {
+    for(int i = 0; i < HAPS_PER_REP; i++) {
+      toGen.clear();
+      generateHaplotype(toGen, parent, map, intf, i % map.size(), hapCarriers,
+			ped, /*rep=*/ 0, /*curGen=*/ 1, /*branch=*/ 0,
+			/*ind=*/ i, noFixedCOs);
+    }
+  };
+  runKernel("generateHaplotype_poisson", "haplotype", numReps, HAPS_PER_REP,
+	    [&]() { meioses(noIntf, -1); });
+  runKernel("generateHaplotype_intf", "haplotype", numReps, HAPS_PER_REP,
+	    [&]() { meioses(coIntf, -1); });
+  // with the records of which samples carry each founder haplotype
+  runKernel("generateHaplotype_carriers", "haplotype", numReps, HAPS_PER_REP,
+	    [&]() { meioses(coIntf, 0); },
+	    [&]() {
+	      hapCarriers.assign(40, vector< vector<InheritRecord> >(map.size()));
+	    });
+
+  //////////////////////////////////////////////////////////////////////////
+  // crossover locations under the interference model
+  const int DRAWS_PER_REP = 10000;
+  vector<double> locations;
+  runKernel("simStahl", "draw", numReps, DRAWS_PER_REP, [&]() {
+    for(int i = 0; i < DRAWS_PER_REP; i++) {
+      locations.clear();
+      coIntf[i % map.size()].simStahl(locations, i & 1, randomGen);
+    }
+  });
+
+  //////////////////////////////////////////////////////////////////////////
+  // genetic to physical position lookups, as generateHaplotype() does for
+  // each crossover
+  const int LOOKUPS_PER_REP = 100000;
+  uniform_real_distribution<double> cMDist(0.0, CHR_GENET_LENGTH);
+  vector<double> lookups(LOOKUPS_PER_REP);
+  long physSum = 0; // keeps the compiler from dropping the lookups
+  runKernel("map_lookup", "lookup", numReps, LOOKUPS_PER_REP, [&]() {
+    for(int i = 0; i < LOOKUPS_PER_REP; i++) {
+      unsigned int chrIdx = i % map.size();
+      double cMPos = lookups[i];
+      int left = 0, right = map.chromNumPos(chrIdx) - 1;
+      while (right - left > 1) {
+	int mid = (left + right) / 2;
+	if (map.chromGenetPos(chrIdx, 0, mid) <= cMPos)
+	  left = mid;
+	else
+	  right = mid;
+      }
+      double frac = (cMPos - map.chromGenetPos(chrIdx, 0, left)) /
+		    (map.chromGenetPos(chrIdx, 0, right) -
+					map.chromGenetPos(chrIdx, 0, left));
+      physSum += map.chromPhysPos(chrIdx, left) +
+		 frac * (map.chromPhysPos(chrIdx, right) -
+					       map.chromPhysPos(chrIdx, left));
+    }
+  }, [&]() {
+    for(auto it = lookups.begin(); it != lookups.end(); it++)
+      *it = cMDist(randomGen);
+  });
+
+  //////////////////////////////////////////////////////////////////////////
+  // locatePrintIBD() pieces: sorting carrier records and merging segments
+  const int RECORDS_PER_REP = 20000;
+  uniform_int_distribution<int> posDist(1, CHR_PHYS_LENGTH - 1);
+  uniform_int_distribution<int> sampDist(0, 7);
+  vector<InheritRecord> carriers, carriersCopy;
+  for(int i = 0; i < RECORDS_PER_REP; i++) {
+    int start = posDist(randomGen);
+    carriers.emplace_back(/*ped=*/ 0, /*rep=*/ i % 50, sampDist(randomGen),
+			  sampDist(randomGen), sampDist(randomGen), start,
+			  min(start + 5000000, CHR_PHYS_LENGTH));
+  }
+  runKernel("sort_carriers_by_start", "record", numReps, RECORDS_PER_REP,
+	    [&]() { sort(carriersCopy.begin(), carriersCopy.end(),
+			 compInheritRecStart); },
+	    [&]() { carriersCopy = carriers; });
+  runKernel("sort_carriers_by_sample", "record", numReps, RECORDS_PER_REP,
+	    [&]() { sort(carriersCopy.begin(), carriersCopy.end(),
+			 compInheritRecSamp); },
+	    [&]() { carriersCopy = carriers; });
+
+  // segments between one pair of samples, as printIBD() merges them: half
+  // adjoin the previous one (and get merged)
+  vector<IBDRecord> segs, segsCopy;
+  uniform_int_distribution<int> lenDist(1000, 20000);
+  for(int i = 0, chrIdx = -1, pos = 0; i < RECORDS_PER_REP; i++) {
+    if (i % (RECORDS_PER_REP / NUM_CHRS) == 0) {
+      chrIdx++;
+      pos = 1;
+    }
+    int len = lenDist(randomGen);
+    segs.emplace_back(/*otherGen=*/ 2, /*otherBranch=*/ 0, /*otherInd=*/ 0,
+		      chrIdx, pos, pos + len - 1, sampDist(randomGen));
+    pos += len + coinFlip(randomGen) * lenDist(randomGen);
+  }
+  runKernel("mergeSegments", "segment", numReps, RECORDS_PER_REP,
+	    [&]() { mergeSegments(segsCopy, /*retainFoundHap=*/ false); },
+	    [&]() {
+	      segsCopy = segs;
+	      sort(segsCopy.begin(), segsCopy.end(), compIBDRecord);
+	    });
+
+  //////////////////////////////////////////////////////////////////////////
+  // readDef() on a large generated def file: pairs of branches have children
+  // together, then each pair has children with the next, so that the sex
+  // constraints join into one large set
+  const int DEF_PAIRS = 2000;
+  string bigDef = "def chain 1 3\n1 1\n";
+  bigDef += "2 0 " + to_string(2 * DEF_PAIRS) + "\n";
+  bigDef += "3 1 " + to_string(2 * DEF_PAIRS - 1);
+  for(int i = 0; i < DEF_PAIRS; i++)
+    bigDef += " " + to_string(i + 1) + ":" + to_string(2*i + 1) + "_" +
+							      to_string(2*i + 2);
+  for(int i = 1; i < DEF_PAIRS; i++)
+    bigDef += " " + to_string(DEF_PAIRS + i) + ":" + to_string(2*i + 1) + "_" +
+								to_string(2*i);
+  bigDef += "\n";
+  vector<SimDetails> bigDefDetails;
+  runKernel("readDef_couples", "couple", numReps, 2 * DEF_PAIRS - 1, [&]() {
+    FILE *in = fmemopen((void *) bigDef.c_str(), bigDef.size(), "r");
+    readDef(bigDefDetails, in);
+    fclose(in);
+  }, [&]() { deleteSimDetails(bigDefDetails); });
+  deleteSimDetails(bigDefDetails);
+
+  //////////////////////////////////////////////////////////////////////////
+  // all of locatePrintIBD(), including printIBD()'s IBD1/IBD2/HBD
+  // classification, on simulated pedigrees
+  PedSim sim(map, sexSpecificMaps, coIntf);
+  sim.readDefText(BENCH_DEF);
+  sim.setSeed(4);
+  sim.simulate();
+  int numSimReps = 100; // replicates in BENCH_DEF
+  long numSegs = 0;
+  runKernel("locatePrintIBD", "replicate", numReps, numSimReps,
+	    [&]() { sim.getIBDSegments([&](const IBDSegInfo &) { numSegs++; }); },
+	    [&]() { sim.simulate(); });
+
+  //////////////////////////////////////////////////////////////////////////
+  // simulate() with each --engine on eighth cousins, who inherit little of
+  // their distant ancestors' genomes
+  const char *DEEP_DEF = "def cousins8 20 10\n"
+			 "2 0 2\n"
+			 "10 1 2\n";
+  const char *engineNames[2] = { "simulate_deep_cousins_forward",
+				 "simulate_deep_cousins_backward" };
+  for(int engine = ENGINE_FORWARD; engine <= ENGINE_BACKWARD; engine++) {
+    PedSim deepSim(map, sexSpecificMaps, coIntf);
+    deepSim.opts.engine = engine;
+    deepSim.readDefText(DEEP_DEF);
+    deepSim.setSeed(5);
+    runKernel(engineNames[engine], "replicate", numReps, /*numReps=*/ 20,
+	      [&]() { deepSim.simulate(); });
+  }
+
+  //////////////////////////////////////////////////////////////////////////
+  // FileOrGZ writes and reads
+  const int LINES_PER_REP = 100000;
+  const char *line = "cousins1_g4-b1-i1\tcousins1_g4-b2-i1\t1\t1234567\t"
+		     "7654321\tIBD1\t5.123\t6.234\t7.345\n";
+  for(int gz = 0; gz < 2; gz++) {
+    string fileName = tmpFile(gz ? "lines.txt.gz" : "lines.txt");
+    auto write = [&]() {
+      if (gz) {
+	FileOrGZ<gzFile> out;
+	out.open(fileName.c_str(), "w");
+	for(int i = 0; i < LINES_PER_REP; i++)
+	  out.printf("%s", line);
+	out.close();
+      }
+      else {
+	FileOrGZ<FILE *> out;
+	out.open(fileName.c_str(), "w");
+	for(int i = 0; i < LINES_PER_REP; i++)
+	  out.printf("%s", line);
+	out.close();
+      }
+    };
+    auto read = [&]() {
+      long numLines = 0;
+      if (gz) {
+	FileOrGZ<gzFile> in;
+	in.open(fileName.c_str(), "r");
+	while (in.getline() >= 0)
+	  numLines++;
+	in.close();
+      }
+      else {
+	FileOrGZ<FILE *> in;
+	in.open(fileName.c_str(), "r");
+	while (in.getline() >= 0)
+	  numLines++;
+	in.close();
+      }
+      if (numLines != LINES_PER_REP) {
+	fprintf(stderr, "ERROR: read %ld lines from %s, expected %d\n",
+		numLines, fileName.c_str(), LINES_PER_REP);
+	exit(5);
+      }
+    };
+    runKernel(gz ? "FileOrGZ_write_gz" : "FileOrGZ_write", "line", numReps,
+	      LINES_PER_REP, write);
+    if (!kernelFilter || strstr(gz ? "FileOrGZ_read_gz" : "FileOrGZ_read",
+				kernelFilter))
+      write(); // the input for reading
+    runKernel(gz ? "FileOrGZ_read_gz" : "FileOrGZ_read", "line", numReps,
+	      LINES_PER_REP, read);
+  }
+
+  //////////////////////////////////////////////////////////////////////////
+  // VCF records: tokenizing input lines, and generating the output rows for
+  // the simulated samples (PedSim::getGenotypes() runs the same code as -i)
+  int numVCFsamples = sim.numFounderHaps() / 2 + 10;
+  string vcfFile = tmpFile("panel.vcf");
+  writeVCF(vcfFile.c_str(), numVCFsamples);
+
+  vector<string> vcfLines;
+  {
+    FileOrGZ<FILE *> in;
+    in.open(vcfFile.c_str(), "r");
+    while (in.getline() >= 0 && vcfLines.size() < 200)
+      if (in.buf[0] != '#')
+	vcfLines.push_back(in.buf);
+    in.close();
+  }
+  vector<char *> lineCopies;
+  for(auto it = vcfLines.begin(); it != vcfLines.end(); it++)
+    lineCopies.push_back(new char[it->size() + 1]);
+  long numFields = 0;
+  runKernel("vcf_tokenize", "record", numReps, vcfLines.size(), [&]() {
+    for(unsigned int i = 0; i < vcfLines.size(); i++) {
+      char *saveptr, *tok;
+      tok = strtok_r(lineCopies[i], "\t\n", &saveptr);
+      while (tok) {
+	numFields++;
+	tok = strtok_r(NULL, "\t\n", &saveptr);
+      }
+    }
+  }, [&]() {
+    for(unsigned int i = 0; i < vcfLines.size(); i++)
+      strcpy(lineCopies[i], vcfLines[i].c_str());
+  });
+
+  long numAlleles = 0;
+  sim.simulate();
+  runKernel("vcf_render", "record", numReps, VCF_SITES, [&]() {
+    sim.getGenotypes(vcfFile.c_str(), [&](const char *, int,
+					  const vector<const char *> &alleles) {
+      numAlleles += alleles.size();
+    });
+  });
+
+  // report totals to stderr so that the work above isn't optimized away
+  fprintf(stderr, "checksums: %ld %ld %ld %ld\n", physSum, numSegs, numFields,
+	  numAlleles);
+
+  // clean up
+  string cmd = string("rm -rf ") + tmpDir;
+  if (system(cmd.c_str()) != 0)
+    fprintf(stderr, "WARNING: could not remove %s\n", tmpDir);
+
+  return 0;
+}
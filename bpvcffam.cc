@@ -4,16 +4,37 @@
 
 #include <random>
 #include <algorithm>
+#include <memory>
+#include <sstream>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <limits.h>
 #include <assert.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/stat.h>
 #include "bpvcffam.h"
+#include "checkpoint.h"
 #include "cmdlineopts.h"
 #include "datastructs.h"
 #include "fileorgz.h"
+#include "membudget.h"
+#include "phasetimer.h"
+#include "pedcosts.h"
+#include "packedhaps.h"
+#include "progress.h"
+#include "readdef.h"
 #include "simulate.h"
+#include "trace.h"
+#include "runerror.h"
+
+// Number of records in each --trace event for generating VCF(s)
+static const long VCF_TRACE_CHUNK = 1000;
+
+// With --progress, the position in the input VCF is updated once per this
+// many records
+static const long VCF_PROGRESS_CHUNK = 1024;
 
 // Reads the file input with the `--sexes` option that specifies the sex of
 // individuals in the input VCF
@@ -23,14 +44,14 @@ void readSexes(unordered_map<const char*,uint8_t,HashString,EqString> &sexes,
   if (!in) {
     fprintf(stderr, "ERROR: could not open sexes file %s!\n", sexesFile);
     perror("open");
-    exit(1);
+    fatalExit(1);
   }
 
   size_t bytesRead = 1024;
   char *buffer = (char *) malloc(bytesRead + 1);
   if (buffer == NULL) {
     fprintf(stderr, "ERROR: out of memory");
-    exit(5);
+    fatalExit(5);
   }
   const char *delim = " \t\n";
 
@@ -49,18 +70,18 @@ void readSexes(unordered_map<const char*,uint8_t,HashString,EqString> &sexes,
       fprintf(stderr, "ERROR: line %d in sexes file: expect two fields per line:\n",
 	      line);
       fprintf(stderr, "       [id] [M/F]\n");
-      exit(6);
+      fatalExit(6);
     }
     if (sex[1] != '\0' || (sex[0] != 'M' && sex[0] != 'F')) {
       fprintf(stderr, "ERROR: line %d has a sex of %s but only 'M' or 'F' are valid\n",
 	      line, sex);
-      exit(6);
+      fatalExit(6);
     }
 
     char *storeId = new char[ strlen(id) + 1 ]; // +1 for '\0'
     if (storeId == NULL) {
       fprintf(stderr, "ERROR: out of memory");
-      exit(5);
+      fatalExit(5);
     }
     strcpy(storeId, id);
 
@@ -76,32 +97,30 @@ void readSexes(unordered_map<const char*,uint8_t,HashString,EqString> &sexes,
 // Prints the sample id of the given sample to <out>.
 // Returns true if the sample is a founder, false otherwise.
 template<class IO_TYPE>
-bool printSampleId(FILE *out, SimDetails &pedDetails, int rep, int gen,
-		   int branch, int ind, bool printAllGens,
-		   FileOrGZ<IO_TYPE> *gzOut) {
+bool printSampleId(FileOrGZ<IO_TYPE> *out, SimDetails &pedDetails, int rep,
+		   int gen, int branch, int ind, bool printAllGens) {
   int thisBranchNumSpouses = getBranchNumSpouses(pedDetails, gen, branch);
   bool shouldPrint = pedDetails.numSampsToPrint[gen][branch] >0 || printAllGens;
 
+  if (pedDetails.sampleIds) {
+    // from a fam file: one person per branch, founders in the first generation
+    if (shouldPrint)
+      out->printf("%s%d_%s", pedDetails.name, pedDetails.firstRep + rep+1,
+		  pedDetails.sampleIds[gen][branch]);
+    return gen == 0;
+  }
+
   if (ind < thisBranchNumSpouses) {
-    if (shouldPrint) {
-      if (!gzOut)
-	fprintf(out, "%s%d_g%d-b%d-s%d", pedDetails.name, rep+1, gen+1,
-		branch+1, ind+1);
-      else
-	gzOut->printf("%s%d_g%d-b%d-s%d", pedDetails.name, rep+1, gen+1,
-		      branch+1, ind+1);
-    }
+    if (shouldPrint)
+      out->printf("%s%d_g%d-b%d-s%d", pedDetails.name,
+		  pedDetails.firstRep + rep+1, gen+1, branch+1, ind+1);
     return true; // is a founder
   }
   else {
-    if (shouldPrint) {
-      if (!gzOut)
-	fprintf(out, "%s%d_g%d-b%d-i%d", pedDetails.name, rep+1, gen+1,
-		branch+1, ind - thisBranchNumSpouses + 1);
-      else
-	gzOut->printf("%s%d_g%d-b%d-i%d", pedDetails.name, rep+1, gen+1,
-		      branch+1, ind - thisBranchNumSpouses + 1);
-    }
+    if (shouldPrint)
+      out->printf("%s%d_g%d-b%d-i%d", pedDetails.name,
+		  pedDetails.firstRep + rep+1, gen+1, branch+1,
+		  ind - thisBranchNumSpouses + 1);
     if (gen == 0 || pedDetails.branchParents[gen][branch*2].branch < 0) {
       assert(ind - thisBranchNumSpouses == 0);
       return true; // is a founder
@@ -110,17 +129,18 @@ bool printSampleId(FILE *out, SimDetails &pedDetails, int rep, int gen,
   }
 }
 
-// Print the break points to <outFile>
+// Print the break points to <outFile> (adding to the end of it if <append>)
 void printBPs(vector<SimDetails> &simDetails, Person *****theSamples,
-	      GeneticMap &map, char *bpFile) {
+	      GeneticMap &map, char *bpFile, bool append) {
 
   assert(!CmdLineOpts::dryRun);
 
-  FILE *out = fopen(bpFile, "w");
-  if (!out) {
+  FileOrGZ<FILE *> out;
+  bool success = out.open(bpFile, append ? "a" : "w");
+  if (!success) {
     fprintf(stderr, "ERROR: could not open output file %s!\n", bpFile);
     perror("open");
-    exit(1);
+    fatalExit(1);
   }
 
   for(unsigned int ped = 0; ped < simDetails.size(); ped++) {
@@ -130,6 +150,8 @@ void printBPs(vector<SimDetails> &simDetails, Person *****theSamples,
     int *numBranches = simDetails[ped].numBranches;
     Parent **branchParents = simDetails[ped].branchParents;
     int **branchNumSpouses = simDetails[ped].branchNumSpouses;
+    int hapNumShift = simDetails[ped].hapNumShift;
+    long pedStartBytes = out.printed();
 
     for(int rep = 0; rep < numReps; rep++) {
       for(int gen = 0; gen < numGen; gen++) {
@@ -144,8 +166,8 @@ void printBPs(vector<SimDetails> &simDetails, Person *****theSamples,
 	    for(int ind = 0; ind < numPersons; ind++) {
 	      for(int h = 0; h < 2; h++) {
 		int sex = theSamples[ped][rep][gen][branch][ind].sex;
-		printSampleId(out, simDetails[ped], rep, gen, branch, ind);
-		fprintf(out, " s%d h%d", sex, h);
+		printSampleId(&out, simDetails[ped], rep, gen, branch, ind);
+		out.printf(" s%d h%d", sex, h);
 
 		for(unsigned int chr = 0; chr < map.size(); chr++) {
 		  if (map.isX(chr) &&
@@ -154,74 +176,364 @@ void printBPs(vector<SimDetails> &simDetails, Person *****theSamples,
 		    continue; // no paternal X chromosome in males
 
 		  // print chrom name and starting position
-		  fprintf(out, " %s|%d", map.chromName(chr),
+		  out.printf(" %s|%d", map.chromName(chr),
 			  map.chromStartPhys(chr));
-		  Haplotype &curHap = theSamples[ped][rep][gen][branch][ind].
-								   haps[h][chr];
-		  for(unsigned int s = 0; s < curHap.size(); s++) {
-		    Segment &seg = curHap[s];
-		    fprintf(out, " %d:%d", seg.foundHapNum, seg.endPos);
+		  HapCursor seg(theSamples[ped][rep][gen][branch][ind], h, chr);
+		  if (seg.atSegment()) {
+		    do {
+		      out.printf(" %d:%d", seg.foundHapNum + hapNumShift,
+				 seg.endPos);
+		    } while (seg.advance());
 		  }
 		}
-		fprintf(out, "\n");
+		out.printf("\n");
 	      }
 	    }
 	  }
 	}
       }
     }
+    PedCosts::add(ped, PED_OUT_BYTES, out.printed() - pedStartBytes);
+  }
+
+  out.close();
+}
+
+VCFSettingsParser::VCFSettingsParser(bool &haveSeed, unsigned int &seed,
+				     double &genoErrRate, double &homErrRate,
+				     double &missRate, double &pseudoHapRate) :
+	haveSeed(haveSeed), seed(seed), genoErrRate(genoErrRate),
+	homErrRate(homErrRate), missRate(missRate),
+	pseudoHapRate(pseudoHapRate) {
+  setMissRate = false;
+}
+
+bool VCFSettingsParser::isSetting(const char *key) {
+  return strcmp(key, "seed") == 0 || strcmp(key, "err_rate") == 0 ||
+	 strcmp(key, "err_hom_rate") == 0 || strcmp(key, "miss_rate") == 0 ||
+	 strcmp(key, "pseudo_hap") == 0;
+}
+
+int VCFSettingsParser::parse(const char *key, const char *value,
+			     string &err) {
+  assert(isSetting(key));
+
+  errno = 0; // initially
+  char *endptr;
+  double rate = 0.0;
+  if (strcmp(key, "seed") == 0) {
+    haveSeed = true;
+    seed = strtol(value, &endptr, 10);
+  }
+  else
+    rate = strtod(value, &endptr);
+  if (errno != 0 || *endptr != '\0' || value[0] == '\0') {
+    err = string("unable to parse ") + key + " value " + value;
+    return 2;
+  }
+  if (rate < 0 || rate > 1) {
+    err = string(key) + " value must be between 0 and 1";
+    return 5;
   }
 
-  fclose(out);
+  if (strcmp(key, "err_rate") == 0)
+    genoErrRate = rate;
+  else if (strcmp(key, "err_hom_rate") == 0)
+    homErrRate = rate;
+  else if (strcmp(key, "miss_rate") == 0) {
+    missRate = rate;
+    setMissRate = true;
+  }
+  else if (strcmp(key, "pseudo_hap") == 0) {
+    pseudoHapRate = rate;
+    if (!setMissRate)
+      missRate = 0.0;
+  }
+  return 0;
+}
+
+int VCFSettingsParser::finish(string &err) {
+  if (missRate > 0 && pseudoHapRate > 0) {
+    err = "can only use miss_rate or pseudo_hap for missingness, not both";
+    return 6;
+  }
+  return 0;
+}
+
+// Reads the file input with the `--renders` option. Each line gives a name for
+// the output VCF followed by any number of <key>=<value> settings that override
+// the corresponding command line values for that output:
+//   seed, err_rate, err_hom_rate, miss_rate, pseudo_hap
+void readRenders(vector<RenderSpec> &renders, const char *rendersFile) {
+  FILE *in = fopen(rendersFile, "r");
+  if (!in) {
+    fprintf(stderr, "ERROR: could not open renders file %s!\n", rendersFile);
+    perror("open");
+    fatalExit(1);
+  }
+
+  size_t bytesRead = 1024;
+  char *buffer = (char *) malloc(bytesRead + 1);
+  if (buffer == NULL) {
+    fprintf(stderr, "ERROR: out of memory");
+    fatalExit(5);
+  }
+  const char *delim = " \t\n";
+
+  int line = 0;
+  while (getline(&buffer, &bytesRead, in) >= 0) {
+    line++;
+
+    char *name, *saveptr;
+    name = strtok_r(buffer, delim, &saveptr);
+    if (name == NULL || name[0] == '#')
+      // blank line or comment
+      continue;
+
+    for(auto it = renders.begin(); it != renders.end(); it++) {
+      if (strcmp(it->name, name) == 0) {
+	fprintf(stderr, "ERROR: line %d in renders file: name %s is same as previous render\n",
+		line, name);
+	fatalExit(5);
+      }
+    }
+
+    renders.emplace_back();
+    RenderSpec &render = renders.back();
+    render.name = new char[ strlen(name) + 1 ];
+    if (render.name == NULL) {
+      fprintf(stderr, "ERROR: out of memory");
+      fatalExit(5);
+    }
+    strcpy(render.name, name);
+    render.haveSeed = false;
+    render.seed = 0;
+    render.genoErrRate = CmdLineOpts::genoErrRate;
+    render.homErrRate = CmdLineOpts::homErrRate;
+    render.missRate = CmdLineOpts::missRate;
+    render.pseudoHapRate = CmdLineOpts::pseudoHapRate;
+    render.genoFunc = NULL;
+
+    VCFSettingsParser settings(render.haveSeed, render.seed,
+			       render.genoErrRate, render.homErrRate,
+			       render.missRate, render.pseudoHapRate);
+    string err;
+    char *setting;
+    while ((setting = strtok_r(NULL, delim, &saveptr))) {
+      char *value = strchr(setting, '=');
+      if (value == NULL) {
+	fprintf(stderr, "ERROR: line %d in renders file: expected <key>=<value> but got %s\n",
+		line, setting);
+	fatalExit(6);
+      }
+      *value = '\0';
+      value++;
+
+      if (!VCFSettingsParser::isSetting(setting)) {
+	fprintf(stderr, "ERROR: line %d in renders file: unknown setting %s\n",
+		line, setting);
+	fprintf(stderr, "       valid settings are seed, err_rate, err_hom_rate, miss_rate, and pseudo_hap\n");
+	fatalExit(6);
+      }
+      int status = settings.parse(setting, value, err);
+      if (status != 0) {
+	fprintf(stderr, "ERROR: line %d in renders file: %s\n", line,
+		err.c_str());
+	fatalExit(status);
+      }
+    }
+
+    int status = settings.finish(err);
+    if (status != 0) {
+      fprintf(stderr, "ERROR: line %d in renders file: %s\n", line,
+	      err.c_str());
+      fatalExit(status);
+    }
+  }
+
+  if (renders.size() == 0) {
+    fprintf(stderr, "ERROR: renders file %s does not list any outputs\n",
+	    rendersFile);
+    fatalExit(3);
+  }
+
+  free(buffer);
+  fclose(in);
 }
 
 // Given an input VCF filename, determines whether the output should be gzipped
 // or not and calls makeVCF()
 int printVCF(vector<SimDetails> &simDetails, Person *****theSamples,
-	     int totalFounderHaps, const char *inVCFfile, char *outFile,
-	     GeneticMap &map, FILE *outs[2], vector<int> hapNumsBySex[2],
+	     int totalFounderHaps, const char *inVCFfile,
+	     vector<RenderSpec> &renders, GeneticMap &map, FILE *outs[2],
+	     vector<int> hapNumsBySex[2],
 	     unordered_map<const char*,uint8_t,HashString,EqString> &sexes) {
 
   assert(!CmdLineOpts::dryRun);
 
   // decide whether to use gz I/O or standard, and call makeVCF() accordingly
   int inVCFlen = strlen(inVCFfile);
-  if (strcmp(&CmdLineOpts::inVCFfile[ inVCFlen - 3 ], ".gz") == 0) {
+  if (strcmp(&inVCFfile[ inVCFlen - 3 ], ".gz") == 0) {
     if (CmdLineOpts::nogz) {
-      sprintf(outFile, "%s.vcf", CmdLineOpts::outPrefix);
       return makeVCF<gzFile, FILE *>(simDetails, theSamples, totalFounderHaps,
-				     CmdLineOpts::inVCFfile,
-				     /*outVCFfile=*/ outFile, map, outs,
+				     inVCFfile, renders,
+				     /*outExt=*/ "vcf", map, outs,
 				     hapNumsBySex, sexes);
     }
     else {
-      sprintf(outFile, "%s.vcf.gz", CmdLineOpts::outPrefix);
       return makeVCF<gzFile, gzFile>(simDetails, theSamples, totalFounderHaps,
-				     CmdLineOpts::inVCFfile,
-				     /*outVCFfile=*/ outFile, map, outs,
+				     inVCFfile, renders,
+				     /*outExt=*/ "vcf.gz", map, outs,
 				     hapNumsBySex, sexes);
     }
   }
   else {
-    sprintf(outFile, "%s.vcf", CmdLineOpts::outPrefix);
     return makeVCF<FILE *, FILE *>(simDetails, theSamples, totalFounderHaps,
-				   CmdLineOpts::inVCFfile,
-				   /*outVCFfile=*/ outFile, map, outs,
+				   inVCFfile, renders,
+				   /*outExt=*/ "vcf", map, outs,
 				   hapNumsBySex, sexes);
   }
 }
 
+// Returns a newly allocated output filename for <render> with extension <ext>:
+// [out_prefix].[ext] for the standard output or [out_prefix]-[name].[ext]
+char *renderFileName(const RenderSpec &render, const char *ext) {
+  int len = strlen(CmdLineOpts::outPrefix) + 1 + strlen(ext) + 1; // +1 for '\0'
+  if (render.name)
+    len += strlen(render.name) + 1;
+  char *fileName = new char[len];
+  if (fileName == NULL) {
+    fprintf(stderr, "ERROR: out of memory");
+    fatalExit(5);
+  }
+  if (render.name)
+    sprintf(fileName, "%s-%s.%s", CmdLineOpts::outPrefix, render.name, ext);
+  else
+    sprintf(fileName, "%s.%s", CmdLineOpts::outPrefix, ext);
+  return fileName;
+}
+
+// FNV-1a hash of the contents of the file named <fileName>, or 0 if it can't
+// be read
+static uint64_t hashFile(const char *fileName) {
+  uint64_t hash = 14695981039346656037ULL;
+  FILE *in = fopen(fileName, "r");
+  if (!in)
+    return 0;
+  int c;
+  while ((c = getc(in)) != EOF)
+    hash = (hash ^ (uint8_t) c) * 1099511628211ULL;
+  fclose(in);
+  return hash;
+}
+
+// Returns a one-line description of the inputs and settings that determine
+// the output VCFs, which --resume compares to that of the checkpoint.
+// <numPrinted> is the number of samples printed for the pedigrees.
+static string runFingerprint(vector<SimDetails> &simDetails,
+			     int totalFounderHaps, int numPrinted,
+			     const char *inVCFfile,
+			     vector<RenderSpec> &renders) {
+  ostringstream run;
+  run.precision(17);
+
+  // the pedigrees: the text of the def or fam file (if any) and the
+  // structure of each entry (which also covers def text given by a job)
+  const char *pedFile = (CmdLineOpts::defFile) ? CmdLineOpts::defFile :
+						 CmdLineOpts::inFamFile;
+  if (pedFile)
+    run << "peds " << hashFile(pedFile);
+  else
+    run << "pop " << CmdLineOpts::popSize << " " << CmdLineOpts::popGens
+	<< " " << CmdLineOpts::popSample << " " << CmdLineOpts::popMonogamy
+	<< " " << CmdLineOpts::popVar;
+  uint64_t structHash = 14695981039346656037ULL;
+  for(unsigned int ped = 0; ped < simDetails.size(); ped++) {
+    SimDetails &cur = simDetails[ped];
+    uint64_t values[2] = { (uint64_t) cur.numReps,
+			   hashStructure(cur, getSetBase(cur)) };
+    for(int v = 0; v < 2; v++)
+      structHash = (structHash ^ values[v]) * 1099511628211ULL;
+  }
+  run << " " << structHash;
+
+  const char *files[2] = { CmdLineOpts::mapFile, inVCFfile };
+  for(int f = 0; f < 2; f++) {
+    struct stat st;
+    long size = (stat(files[f], &st) == 0) ? st.st_size : -1;
+    run << " file " << files[f] << " " << size;
+  }
+
+  run << " founders " << totalFounderHaps / 2 << " samples " << numPrinted
+      << " cursors " << 2 * numPrinted << " keep_phase "
+      << CmdLineOpts::keepPhase << " retain " << CmdLineOpts::retainExtra;
+
+  run << " renders " << renders.size();
+  for(auto it = renders.begin(); it != renders.end(); it++) {
+    run << " " << ((it->name) ? it->name : "-") << " ";
+    if (it->haveSeed)
+      run << it->seed;
+    else
+      run << "-";
+    run << " " << it->genoErrRate << " " << it->homErrRate << " "
+	<< it->missRate << " " << it->pseudoHapRate;
+  }
+
+  return run.str();
+}
+
+// State for generating one output VCF; see RenderSpec
+template<typename O_TYPE>
+struct VCFRender {
+  RenderSpec *spec;
+  mt19937 randomGen;
+  FileOrGZ<O_TYPE> out;
+  bernoulli_distribution genoErr;
+  bernoulli_distribution homErr;
+  bernoulli_distribution setMissing;
+  bernoulli_distribution isPseudoHap;
+  // For each founder haplotype number, the index of the input haplotype (in
+  // <hapAlleles> in makeVCF()) assigned to it
+  int *founderHapSrc;
+  // map from haplotype index / 2 to sample_index
+  int *founderSamples;
+  vector<int> extraSamples; // Sample indexes to print for --retain_extra
+  // alleles for the current record when passing them to <spec->genoFunc>
+  vector<const char *> siteAlleles;
+
+  // Outputs the genotype of one sample: <numHaps> alleles, each preceded by
+  // the corresponding <betweenAlleles> character when printing
+  void putGeno(const char *alleles[2], int numHaps,
+	       const char betweenAlleles[2]) {
+    if (spec->genoFunc) {
+      siteAlleles.push_back(alleles[0]);
+      siteAlleles.push_back(alleles[numHaps - 1]);
+    }
+    else {
+      for(int h = 0; h < numHaps; h++)
+	out.printf("%c%s", betweenAlleles[h], alleles[h]);
+    }
+  }
+};
+
 // Given the simulated break points for individuals in each pedigree/family
 // stored in <theSamples> and other necessary information, reads input VCF
 // format data from the file named <inVCFfile> and prints the simulated
-// haplotypes for each sample to <outVCFfile> in VCF format.
+// haplotypes for each sample to one output VCF per entry in <renders>.
+// All outputs are generated in one pass over the input.
 template<typename I_TYPE, typename O_TYPE>
 int makeVCF(vector<SimDetails> &simDetails, Person *****theSamples,
-	    int totalFounderHaps, const char *inVCFfile, char *outFileBuf,
-	    GeneticMap &map, FILE *outs[2], vector<int> hapNumsBySex[2],
+	    int totalFounderHaps, const char *inVCFfile,
+	    vector<RenderSpec> &renders, const char *outExt, GeneticMap &map,
+	    FILE *outs[2], vector<int> hapNumsBySex[2],
 	    unordered_map<const char*,uint8_t,HashString,EqString> &sexes) {
 
   assert(!CmdLineOpts::dryRun);
+
+  PhaseTimer timer("VCF header");
+  // for --trace: an event for the header and each chunk of VCF_TRACE_CHUNK
+  // records
+  uint64_t traceStart = Trace::now();
   
   // open input VCF file:
   FileOrGZ<I_TYPE> in;
@@ -229,23 +541,9 @@ int makeVCF(vector<SimDetails> &simDetails, Person *****theSamples,
   if (!success) {
     fprintf(stderr, "\nERROR: could not open input VCF file %s!\n", inVCFfile);
     perror("open");
-    exit(1);
+    fatalExit(1);
   }
 
-  // open output VCF file:
-  FileOrGZ<O_TYPE> out;
-  success = out.open(outFileBuf, "w");
-  if (!success) {
-    fprintf(stderr, "\nERROR: could not open output VCF file %s!\n",
-	    outFileBuf);
-    perror("open");
-    exit(1);
-  }
-
-  bernoulli_distribution genoErr( CmdLineOpts::genoErrRate );
-  bernoulli_distribution homErr( CmdLineOpts::homErrRate );
-  bernoulli_distribution setMissing( CmdLineOpts::missRate );
-  bernoulli_distribution isPseudoHap( CmdLineOpts::pseudoHapRate );
   // below, if a male is heterozygous on the X chromosome, we choose a random
   // allele. If this code is run with different values for the distributions
   // above, that can affect the outcome of the heterozygous male allele choice
@@ -256,6 +554,113 @@ int makeVCF(vector<SimDetails> &simDetails, Person *****theSamples,
   // any further random numbers are generated
   mt19937 hetMaleXRandGen( randomGen );
 
+  // --checkpoint and --resume: only for output files (not <genoFunc>s)
+  int numRenders = renders.size();
+  bool allFiles = true;
+  for(int r = 0; r < numRenders; r++)
+    allFiles = allFiles && !renders[r].genoFunc;
+  char *ckptFile = NULL;
+  VCFCheckpoint resumeFrom;
+  bool resuming = false;
+  if (allFiles && (CmdLineOpts::checkpointInterval > 0 || CmdLineOpts::resume))
+    ckptFile = VCFCheckpoint::fileName();
+  // number of samples printed for the pedigrees, each with two <segCursors>
+  int numPrinted = 0;
+  for(unsigned int ped = 0; ckptFile && ped < simDetails.size(); ped++) {
+    int numGen = simDetails[ped].numGen;
+    int **numSampsToPrint = simDetails[ped].numSampsToPrint;
+    for(int gen = 0; gen < numGen; gen++)
+      for(int branch = 0; branch < simDetails[ped].numBranches[gen]; branch++)
+	if (numSampsToPrint[gen][branch] > 0) {
+	  int numNonFounders, numFounders;
+	  getPersonCounts(gen, numGen, branch, numSampsToPrint,
+			  simDetails[ped].branchParents,
+			  simDetails[ped].branchNumSpouses, numFounders,
+			  numNonFounders);
+	  numPrinted += simDetails[ped].numReps *
+						(numNonFounders + numFounders);
+	}
+  }
+  string runInfo;
+  if (ckptFile)
+    runInfo = runFingerprint(simDetails, totalFounderHaps, numPrinted,
+			     inVCFfile, renders);
+  if (ckptFile && CmdLineOpts::resume) {
+    resuming = resumeFrom.read(ckptFile);
+    if (resuming && (resumeFrom.run != runInfo ||
+		     (int) resumeFrom.outOffsets.size() != numRenders ||
+		     resumeFrom.randSeed != CmdLineOpts::randSeed ||
+		     resumeFrom.segCursors.size() != 2 * (size_t) numPrinted)) {
+      fprintf(stderr, "\nERROR: checkpoint %s is from a run with different inputs or settings:\n",
+	      ckptFile);
+      fprintf(stderr, "       checkpoint: seed %u %s\n", resumeFrom.randSeed,
+	      resumeFrom.run.c_str());
+      fprintf(stderr, "       this run:   seed %u %s\n", CmdLineOpts::randSeed,
+	      runInfo.c_str());
+      fatalExit(5);
+    }
+  }
+  long numRecords = 0; // printed so far
+  long firstRecord = 0; // number printed before this run (with --resume)
+
+  // open output VCF files and set up the state for each (held by a unique_ptr
+  // so that an error closes the files; see fatalExit()):
+  unique_ptr< VCFRender<O_TYPE>[] > vcfRenders(
+					    new VCFRender<O_TYPE>[numRenders]);
+  if (vcfRenders == NULL) {
+    fprintf(stderr, "ERROR: out of memory");
+    fatalExit(5);
+  }
+  bool anyErrors = false; // any render with a non-zero genotyping error rate?
+  for(int r = 0; r < numRenders; r++) {
+    VCFRender<O_TYPE> &render = vcfRenders[r];
+    render.spec = &renders[r];
+
+    if (!renders[r].genoFunc) {
+      char *outFile = renderFileName(renders[r], outExt);
+      if (resuming) {
+	// drop anything printed after the checkpoint and append from there
+	success = truncate(outFile, resumeFrom.outOffsets[r]) == 0 &&
+		  render.out.open(outFile, "a");
+      }
+      else
+	success = render.out.open(outFile, "w");
+      if (!success) {
+	fprintf(stderr, "\nERROR: could not open output VCF file %s!\n",
+		outFile);
+	perror("open");
+	fatalExit(1);
+      }
+      delete [] outFile;
+    }
+
+    if (renders[r].haveSeed)
+      render.randomGen.seed(renders[r].seed);
+    else
+      render.randomGen = randomGen;
+
+    render.genoErr = bernoulli_distribution( renders[r].genoErrRate );
+    render.homErr = bernoulli_distribution( renders[r].homErrRate );
+    render.setMissing = bernoulli_distribution( renders[r].missRate );
+    render.isPseudoHap = bernoulli_distribution( renders[r].pseudoHapRate );
+    anyErrors = anyErrors || renders[r].genoErrRate > 0.0;
+
+    render.founderHapSrc = new int[totalFounderHaps];
+    render.founderSamples = new int[totalFounderHaps / 2];
+    if (render.founderHapSrc == NULL || render.founderSamples == NULL) {
+      fprintf(stderr, "ERROR: out of memory");
+      fatalExit(5);
+    }
+  }
+  // bytes printed to the output VCFs (for PedCosts)
+  auto printedBytes = [&]() {
+    long bytes = 0;
+    for(int r = 0; r < numRenders; r++)
+      if (!renders[r].genoFunc)
+	bytes += vcfRenders[r].out.printed();
+    return bytes;
+  };
+
   // technically tab and newline; we want the latter so that the last sample id
   // on the header line doesn't include the newline character in it
   const char *tab = "\t\n";
@@ -271,11 +676,6 @@ int makeVCF(vector<SimDetails> &simDetails, Person *****theSamples,
   bool alleleCountWarnPrinted = false;
 
   char **hapAlleles = NULL; // stores all alleles from input sample
-  char **founderHaps = new char*[totalFounderHaps]; // alleles for founder haps
-  if (founderHaps == NULL) {
-    fprintf(stderr, "ERROR: out of memory");
-    exit(5);
-  }
 
   // iterate over chromosomes in the genetic map
   unsigned int chrIdx = 0; // index of current chromosome number;
@@ -285,25 +685,39 @@ int makeVCF(vector<SimDetails> &simDetails, Person *****theSamples,
 
   bool gotSomeData = false;
 
+  // Index of the current segment in each printed sample's haplotypes on the
+  // current chromosome; [2 * i + h] is haplotype h of the ith printed sample.
+  // Advancing these (rather than removing passed segments) leaves
+  // <theSamples> unchanged so the other output stages can read it concurrently
+  vector<uint32_t> segCursors;
+  // Decoders of the packed haplotypes at these segments; not yet positioned
+  // at the start of each chromosome (and after resuming)
+  vector<HapCursor> hapCursors;
+
   int numInputSamples = 0;
   vector<uint8_t> sampleSexes; // to check X genotypes in males
   bool warnedHetMaleX = false;
-  std::vector<std::vector<int>> shuffHaps; // For randomizing the assigned haplotypes
-  vector<int> extraSamples; // Sample indexes to print for --retain_extra
-  // map from haplotype index / 2 to sample_index
-  int *founderSamples = new int[totalFounderHaps / 2];
-  if (founderSamples == NULL) {
-    fprintf(stderr, "ERROR: out of memory");
-    exit(5);
-  }
   // number of elements of <extraSamples> to print (see below)
   unsigned int numToRetain = 0;
   bool readMeta = false;
 
-  while (in.getline() >= 0) { // lines of input VCF
+  if (Progress::enabled()) {
+    struct stat st;
+    Progress::begin(PROG_VCF, (stat(inVCFfile, &st) == 0) ? st.st_size : 0);
+    Progress::vcfChrom(chrName);
+  }
+
+  int lineLen;
+  while ((lineLen = in.getline()) >= 0) { // lines of input VCF
+    if (MemBudget::exceeded())
+      // main() reports the overrun; keep the checkpoint (if any) to resume
+      return 0;
+    Progress::vcfLineIn(lineLen);
     if (in.buf[0] == '#' && in.buf[1] == '#') {
-      // header line: print to output
-      out.printf("%s", in.buf);
+      // header line: print to output (already there when <resuming>)
+      for(int r = 0; r < numRenders; r++)
+	if (!renders[r].genoFunc && !resuming)
+	  vcfRenders[r].out.printf("%s", in.buf);
       continue;
     }
 
@@ -314,7 +728,7 @@ int makeVCF(vector<SimDetails> &simDetails, Person *****theSamples,
 	fprintf(stderr, "\n");
 	fprintf(stderr, "ERROR: multiple copies of line giving sample ids: please remove all headers\n");
 	fprintf(stderr, "       not at the beginning of the input VCF\n");
-	exit(2);
+	fatalExit(2);
       }
       readMeta = true;
 
@@ -325,20 +739,22 @@ int makeVCF(vector<SimDetails> &simDetails, Person *****theSamples,
       for(int i = 1; i < 9; i++)
 	strtok_r(NULL, tab, &saveptr);
 
-      // now parse / store the sample ids and get randomized haplotypes in a way
-      // that respects the sex of the input samples when necessary
+      // now parse / store the sample ids, grouping the haplotypes to assign
+      // to them in a way that respects the sex of the input samples when
+      // necessary
       vector<char*> sampleIds;
-      getSampleIdsShuffHaps(sampleIds, sampleSexes, shuffHaps, outs,
-			    hapNumsBySex, sexes, saveptr, totalFounderHaps,tab);
+      vector<int> sexSpecHapIdxs[3];
+      getSampleIds(sampleIds, sampleSexes, sexSpecHapIdxs, outs, hapNumsBySex,
+		   sexes, saveptr, totalFounderHaps, tab);
 
       numInputSamples = sampleIds.size();
       hapAlleles = new char*[numInputSamples * 2]; // 2 for diploid samples
       if (hapAlleles == NULL) {
 	fprintf(stderr, "ERROR: out of memory");
-	exit(5);
+	fatalExit(5);
       }
 
-      // Do math and store sample ids for --retain_extra:
+      // Do math for --retain_extra:
       unsigned int numExtraSamples = numInputSamples - totalFounderHaps / 2;
       bool cantRetainEnough = false;
       if (CmdLineOpts::retainExtra < 0) {
@@ -352,46 +768,6 @@ int makeVCF(vector<SimDetails> &simDetails, Person *****theSamples,
 	}
       }
 
-      // Store ids for all extra samples -- those whose shuffled haplotype
-      // assignment is after all that will be used:
-      for(int i = 0; i < numInputSamples; i++) {
-
-        vector<int> founderIndices = shuffHaps[i];
-
-        for(int founderIndex : founderIndices){
-        
-	// if (shuffHaps[i][0] < totalFounderHaps) // TODO
-    if (founderIndex < totalFounderHaps)
-    // founderSamples[5] = 10 means that the 6th VCF sample corresponds to the 10th founder
-	  // founderSamples[ shuffHaps[i][0] / 2 ] = i; // TODO
-      founderSamples[ founderIndex / 2] = i;
-	else
-	  extraSamples.push_back(i);
-      }
-      }
-      // assert(extraSamples.size() == numExtraSamples);
-
-      // want to randomize which samples get included, though this is only
-      // relevant if we have more samples than are requested to be retained:
-      if (numToRetain < numExtraSamples) {
-	// will print the first <numToRetain> from this list (random subset)
-
-	shuffle(extraSamples.begin(), extraSamples.end(), randomGen);
-      }
-
-      // open output ids file (if needed):
-      FILE *idOut = NULL;
-      if (CmdLineOpts::printFounderIds) {
-	sprintf(outFileBuf, "%s.ids", CmdLineOpts::outPrefix);
-	idOut = fopen(outFileBuf, "w");
-	if (!idOut) {
-	  fprintf(stderr, "ERROR: could not open found ids file %s!\n",
-		  outFileBuf);
-	  perror("open");
-	  exit(1);
-	}
-      }
-
       for(int o = 0; o < 2; o++) {
 	fprintf(outs[o], "done.\n"); // initial scan of VCF file (see main())
 	fprintf(outs[o], "  Input contains %d samples, using %d as founders, and retaining %d\n",
@@ -400,78 +776,176 @@ int makeVCF(vector<SimDetails> &simDetails, Person *****theSamples,
 	  fprintf(outs[o], "  Note: cannot retain all requested %d samples\n",
 		  CmdLineOpts::retainExtra);
 	}
-	if (idOut) {
-	  fprintf(outs[o], "Generating founder ids file... ");
-	  fflush(outs[o]);
-	}
       }
 
+      for(int r = 0; r < numRenders; r++) {
+	VCFRender<O_TYPE> &render = vcfRenders[r];
 
-      // Now print the header line indicating fields and sample ids for the
-      // output VCF
-      out.printf("#CHROM\tPOS\tID\tREF\tALT\tQUAL\tFILTER\tINFO\tFORMAT");
-
-      // print sample ids:
-      for(unsigned int ped = 0; ped < simDetails.size(); ped++) {
-	int numReps = simDetails[ped].numReps;
-	int numGen = simDetails[ped].numGen;
-	int **numSampsToPrint = simDetails[ped].numSampsToPrint;
-	int *numBranches = simDetails[ped].numBranches;
-	Parent **branchParents = simDetails[ped].branchParents;
-	int **branchNumSpouses = simDetails[ped].branchNumSpouses;
-
-	for(int rep = 0; rep < numReps; rep++)
-	  for(int gen = 0; gen < numGen; gen++)
-	    for(int branch = 0; branch < numBranches[gen]; branch++)
-	      if (numSampsToPrint[gen][branch] > 0 || idOut) { // need to print?
-		int numNonFounders, numFounders;
-		getPersonCounts(gen, numGen, branch, numSampsToPrint,
-				branchParents, branchNumSpouses, numFounders,
-				numNonFounders);
-		int numPersons = numNonFounders + numFounders;
-    // fprintf(stderr, "fam %d gen %d branch %d\n", fam, gen, branch); // Delete
-		for(int ind = 0; ind < numPersons; ind++) {
-		  if (numSampsToPrint[gen][branch] > 0)
-		    out.printf("\t");
-		  bool curIsFounder = printSampleId(NULL, simDetails[ped],
-						    rep, gen, branch, ind,
-						    /*printAllGens=*/ false,
-						    /*gzOut=*/ &out);
-		  if (idOut && curIsFounder) {
-		    // print Ped-sim id to founder id file:
-		    printSampleId(idOut, simDetails[ped], rep, gen, branch,ind, true);
-
-		    // since males on the X chromosome only have a defined
-		    // haplotype for haps index 1, we use that index
-		    int hapNum = theSamples[ped][rep][gen][branch][ind].
-				      haps[1][/*chrIdx=*/0].front().foundHapNum;
-		    hapNum--; // hap index 1 is an odd number, so we decrement
-		    assert(hapNum % 2 == 0);
-		    int founderIdx = founderSamples[ hapNum / 2 ];
-		    fprintf(idOut, "\t%s\n", sampleIds[ founderIdx ]);
-		  }
+	// randomized haplotypes for this output; shuffleHaps() permutes its
+	// argument, so each render starts from the original order
+	std::vector<std::vector<int>> shuffHaps;
+	vector<int> renderHapIdxs[3];
+	for(int sexIdx = 0; sexIdx < 3; sexIdx++)
+	  renderHapIdxs[sexIdx] = sexSpecHapIdxs[sexIdx];
+	shuffleHaps(shuffHaps, sampleSexes, renderHapIdxs, totalFounderHaps,
+		    render.randomGen);
+
+	// Store ids for all extra samples -- those whose shuffled haplotype
+	// assignment is after all that will be used:
+	for(int i = 0; i < numInputSamples; i++) {
+
+	  vector<int> founderIndices = shuffHaps[i];
 
+	  for(int founderIndex : founderIndices){
+
+	    if (founderIndex < totalFounderHaps) {
+	      // founderSamples[5] = 10 means that the 6th VCF sample corresponds
+	      // to the 10th founder
+	      render.founderSamples[ founderIndex / 2] = i;
+	      for(int h = 0; h < 2; h++)
+		render.founderHapSrc[founderIndex + h] = 2 * i + h;
+	    }
+	    else
+	      render.extraSamples.push_back(i);
+	  }
+	}
+
+	// want to randomize which samples get included, though this is only
+	// relevant if we have more samples than are requested to be retained:
+	if (numToRetain < numExtraSamples) {
+	  // will print the first <numToRetain> from this list (random subset)
+
+	  shuffle(render.extraSamples.begin(), render.extraSamples.end(),
+		  render.randomGen);
+	}
+
+	if (render.spec->genoFunc || resuming)
+	  continue; // no ids file or header line (or printed before)
+
+	// open output ids file (if needed):
+	FileOrGZ<FILE *> idOut;
+	if (CmdLineOpts::printFounderIds) {
+	  char *idFile = renderFileName(*render.spec, "ids");
+	  success = idOut.open(idFile, "w");
+	  if (!success) {
+	    fprintf(stderr, "ERROR: could not open found ids file %s!\n",
+		    idFile);
+	    perror("open");
+	    fatalExit(1);
+	  }
+	  delete [] idFile;
+
+	  for(int o = 0; o < 2; o++) {
+	    if (render.spec->name)
+	      fprintf(outs[o], "Generating founder ids file for %s... ",
+		      render.spec->name);
+	    else
+	      fprintf(outs[o], "Generating founder ids file... ");
+	    fflush(outs[o]);
+	  }
+	}
+
+	FileOrGZ<O_TYPE> &out = render.out;
+
+	// Now print the header line indicating fields and sample ids for the
+	// output VCF
+	out.printf("#CHROM\tPOS\tID\tREF\tALT\tQUAL\tFILTER\tINFO\tFORMAT");
+
+	// print sample ids:
+	for(unsigned int ped = 0; ped < simDetails.size(); ped++) {
+	  int numReps = simDetails[ped].numReps;
+	  int numGen = simDetails[ped].numGen;
+	  int **numSampsToPrint = simDetails[ped].numSampsToPrint;
+	  int *numBranches = simDetails[ped].numBranches;
+	  Parent **branchParents = simDetails[ped].branchParents;
+	  int **branchNumSpouses = simDetails[ped].branchNumSpouses;
+
+	  for(int rep = 0; rep < numReps; rep++)
+	    for(int gen = 0; gen < numGen; gen++)
+	      for(int branch = 0; branch < numBranches[gen]; branch++)
+		if (numSampsToPrint[gen][branch] > 0 ||
+					CmdLineOpts::printFounderIds) { // need to print?
+		  int numNonFounders, numFounders;
+		  getPersonCounts(gen, numGen, branch, numSampsToPrint,
+				  branchParents, branchNumSpouses, numFounders,
+				  numNonFounders);
+		  int numPersons = numNonFounders + numFounders;
+		  for(int ind = 0; ind < numPersons; ind++) {
+		    if (numSampsToPrint[gen][branch] > 0)
+		      out.printf("\t");
+		    bool curIsFounder = printSampleId(&out, simDetails[ped],
+						      rep, gen, branch, ind);
+		    if (CmdLineOpts::printFounderIds && curIsFounder) {
+		      // print Ped-sim id to founder id file:
+		      printSampleId(&idOut, simDetails[ped], rep, gen, branch,
+				    ind, true);
+
+		      // since males on the X chromosome only have a defined
+		      // haplotype for haps index 1, we use that index
+		      int hapNum = HapCursor(theSamples[ped][rep][gen][branch][ind],
+					     /*h=*/ 1, /*chrIdx=*/ 0).foundHapNum;
+		      hapNum--; // hap index 1 is an odd number, so we decrement
+		      assert(hapNum % 2 == 0);
+		      int founderIdx = render.founderSamples[ hapNum / 2 ];
+		      idOut.printf("\t%s\n", sampleIds[ founderIdx ]);
+		    }
+		  }
 		}
-	      }
-      }
+	}
 
-      // print the ids for the --retain_extra samples:
-      for(unsigned int i = 0; i < numToRetain; i++) {
-	int sampIdx = extraSamples[i];
-	out.printf("\t%s", sampleIds[ sampIdx ]);
+	// print the ids for the --retain_extra samples:
+	for(unsigned int i = 0; i < numToRetain; i++) {
+	  int sampIdx = render.extraSamples[i];
+	  out.printf("\t%s", sampleIds[ sampIdx ]);
+	}
+
+	out.printf("\n");
+
+	if (CmdLineOpts::printFounderIds) {
+	  idOut.close();
+	  for(int o = 0; o < 2; o++)
+	    fprintf(outs[o], "done.\n");
+	}
       }
 
-      out.printf("\n");
       for(int o = 0; o < 2; o++) {
-	if (idOut)
-	  fprintf(outs[o], "done.\n");
-	fprintf(outs[o], "Generating VCF file... ");
+	if (numRenders > 1)
+	  fprintf(outs[o], "Generating %d VCF files... ", numRenders);
+	else
+	  fprintf(outs[o], "Generating VCF file... ");
 	fflush(outs[o]);
       }
 
-      if (idOut)
-	fclose(idOut);
+      if (resuming) {
+	// skip the records the outputs already contain
+	if (!in.seek(resumeFrom.inOffset)) {
+	  fprintf(stderr, "\nERROR: could not seek to offset %ld in input VCF %s\n",
+		  resumeFrom.inOffset, inVCFfile);
+	  fatalExit(5);
+	}
+	numRecords = resumeFrom.numRecords;
+	chrIdx = resumeFrom.chrIdx;
+	chrName = map.chromName(chrIdx);
+	chrBegin = map.chromStartPhys(chrIdx);
+	chrEnd = map.chromEndPhys(chrIdx);
+	gotSomeData = resumeFrom.gotSomeData;
+	warnedHetMaleX = resumeFrom.warnedHetMaleX;
+	alleleCountWarnPrinted = resumeFrom.alleleCountWarnPrinted;
+	// checked against the printed samples above
+	assert(resumeFrom.segCursors.size() == 2 * (size_t) numPrinted);
+	segCursors = resumeFrom.segCursors;
+	for(int r = 0; r < numRenders; r++)
+	  vcfRenders[r].randomGen = resumeFrom.renderGens[r];
+	for(int o = 0; o < 2; o++) {
+	  fprintf(outs[o], "resuming after %ld records... ", numRecords);
+	  fflush(outs[o]);
+	}
+	firstRecord = numRecords;
+      }
 
+      timer.next("VCF records");
+      Trace::record("VCF header", traceStart);
+      traceStart = Trace::now();
       continue;
     }
 
@@ -490,12 +964,17 @@ int makeVCF(vector<SimDetails> &simDetails, Person *****theSamples,
 	fprintf(stderr, "\nERROR: chromosome %s in VCF file either out of order or not present\n",
 		chrom);
 	fprintf(stderr, "       in genetic map\n");
-	exit(5);
+	fatalExit(5);
       }
 
       // update beginning / end positions for this chromosome
       chrBegin = map.chromStartPhys(chrIdx);
       chrEnd = map.chromEndPhys(chrIdx);
+      Progress::vcfChrom(chrName);
+
+      // back to the first segment of the new chromosome
+      segCursors.assign(segCursors.size(), 0);
+      hapCursors.assign(hapCursors.size(), HapCursor());
     }
 
     if (sexes.size() == 0 && map.isX(chrIdx))
@@ -525,7 +1004,7 @@ int makeVCF(vector<SimDetails> &simDetails, Person *****theSamples,
     if (formatCurField == NULL) {
       fprintf(stderr, "ERROR: in VCF: no GT field at CHROM %s, POS %s\n",
 	      chrom, posStr);
-      exit(6);
+      fatalExit(6);
     }
 
     // count the number of alleles present at this variant; generally this is
@@ -537,8 +1016,7 @@ int makeVCF(vector<SimDetails> &simDetails, Person *****theSamples,
       if (altField[i] == ',')
 	numAlleles++;
     }
-    if (numAlleles > 2 && CmdLineOpts::genoErrRate > 0.0 &&
-						      !alleleCountWarnPrinted) {
+    if (numAlleles > 2 && anyErrors && !alleleCountWarnPrinted) {
       alleleCountWarnPrinted = true;
       for(int o = 0; o < 2; o++) {
 	fprintf(outs[o], "\nWARNING: genotyping error only implemented for markers with 2 alleles\n");
@@ -564,7 +1042,9 @@ int makeVCF(vector<SimDetails> &simDetails, Person *****theSamples,
 	  fprintf(stderr, "       Prematurely truncating output VCF.\n");
 	  fprintf(stderr, "       See variant on chromosome/contig %s, position %d\n",
 		  chrom, pos);
-	  out.close();
+	  for(int r = 0; r < numRenders; r++)
+	    if (!renders[r].genoFunc)
+	      vcfRenders[r].out.close();
 	  in.close();
 	  return 1;
 	}
@@ -603,11 +1083,11 @@ int makeVCF(vector<SimDetails> &simDetails, Person *****theSamples,
 	fprintf(stderr, "ERROR: VCF contains genotype %s, which is not phased or contains one haplotype\n",
 		theGT);
 	fprintf(stderr, "       this is only allowed for males (input with --sexes) on the X chromosome\n");
-	exit(5);
+	fatalExit(5);
       }
       if (strtok_r(NULL, bar, &saveptrAlleles) != NULL) {
 	fprintf(stderr, "ERROR: multiple '|' characters in data field\n");
-	exit(5);
+	fatalExit(5);
       }
 
       for(int h = 0; h < 2; h++) {
@@ -615,29 +1095,13 @@ int makeVCF(vector<SimDetails> &simDetails, Person *****theSamples,
 	  fprintf(stderr, "\nERROR: simulator currently requires all positions to be non-missing\n");
 	  fprintf(stderr, "         see variant on chromosome/contig %s, position %d\n",
 		  chrom, pos);
-	  exit(5);
+	  fatalExit(5);
 	}
+	// the founder haplotypes are assigned alleles via the <founderHapSrc>
+	// index of each render
 	hapAlleles[numStored++] = alleles[h];
       }
-      // inputIndex: 0, 1, 2, ...
-      // int founderIndex = shuffHaps[ inputIndex ];
-      std::vector<int> founderIndices = shuffHaps[ inputIndex ];
-      // fprintf(stderr, "founderIndex: %d\n", founderIndex); // Delete
-
       inputIndex++;
-    for(int founderIndex : founderIndices){
-      if (founderIndex < totalFounderHaps) {
-	for(int h = 0; h < 2; h++)
-    // founderHaps contains 2xNumOfFounders and populates with the genotype
-    // founderHaps[0] is the first haplotype of the first founder
-    // founderHaps[1] is the second haplotype of the first founder
-	  founderHaps[founderIndex + h] = alleles[h];
-    // founderHaps[8] = alleles[0]; // Delete
-    // founderHaps[9] = alleles[1]; // Delete
-          // fprintf(stderr, "founderIndex: %d, %d, %d\n", founderIndex, numStored, inputIndex); // Delete
-
-      }
-      }
     }
 
     bool fewer = numStored < numInputSamples * 2;
@@ -645,15 +1109,24 @@ int makeVCF(vector<SimDetails> &simDetails, Person *****theSamples,
     if (fewer || more) {
       fprintf(stderr, "ERROR: line in VCF file has data for %s than the indicated %d samples\n",
 	      (more) ? "more" : "fewer", numInputSamples);
-      exit(6);
+      fatalExit(6);
     }
 
-    // Print this line to the output file
-    out.printf("%s\t%s", chrom, posStr);
-    for(int i = 0; i < 6; i++)
-      out.printf("\t%s", otherFields[i]);
-    out.printf("\tGT");
+    // Print this line to the output files
+    for(int r = 0; r < numRenders; r++) {
+      if (renders[r].genoFunc)
+	continue;
+      FileOrGZ<O_TYPE> &out = vcfRenders[r].out;
+      out.printf("%s\t%s", chrom, posStr);
+      for(int i = 0; i < 6; i++)
+	out.printf("\t%s", otherFields[i]);
+      out.printf("\tGT");
+    }
 
+    uint32_t curPrinted = 0; // index of sample (for <segCursors>)
+    // with --timing, sample the time and output of each pedigree's genotypes
+    bool sampleCosts = PedCosts::active() &&
+					  numRecords % PED_COST_SAMPLE == 0;
     for(unsigned int ped = 0; ped < simDetails.size(); ped++) {
       int numReps = simDetails[ped].numReps;
       int numGen = simDetails[ped].numGen;
@@ -661,6 +1134,12 @@ int makeVCF(vector<SimDetails> &simDetails, Person *****theSamples,
       int *numBranches = simDetails[ped].numBranches;
       Parent **branchParents = simDetails[ped].branchParents;
       int **branchNumSpouses = simDetails[ped].branchNumSpouses;
+      uint64_t pedStart = 0;
+      long pedBytes = 0;
+      if (sampleCosts) {
+	pedStart = PedCosts::now();
+	pedBytes = printedBytes();
+      }
 
       for(int rep = 0; rep < numReps; rep++)
 	for(int gen = 0; gen < numGen; gen++)
@@ -682,16 +1161,17 @@ int makeVCF(vector<SimDetails> &simDetails, Person *****theSamples,
 		  numHaps = 1;
 		}
 
-		// set to missing (according to the rate set by the user)?
-		if (setMissing( randomGen )) {
-		  for(int h = 0; h < numHaps; h++)
-		    out.printf("%c.", betweenAlleles[h]);
-		  continue; // done printing genotype data for this sample
-		}
-
-		// non-missing genotype: print, possibly with a genotyping error
+		// get founder haps for the current sample; these are the same
+		// for all renders
+		if (segCursors.size() < 2 * (curPrinted + 1))
+		  // first line of input: add this sample's cursors
+		  segCursors.resize(2 * (curPrinted + 1), 0);
+		if (hapCursors.size() < 2 * (curPrinted + 1))
+		  hapCursors.resize(2 * (curPrinted + 1));
+		uint32_t *curSegIdx = &segCursors[2 * curPrinted];
+		HapCursor *curSeg = &hapCursors[2 * curPrinted];
+		curPrinted++;
 
-		// get founder haps for the current sample
 		uint32_t curFounderHaps[2];
 		for(int h = 0; h < 2; h++) {
 		  if (maleX && h == 0) {
@@ -700,119 +1180,209 @@ int makeVCF(vector<SimDetails> &simDetails, Person *****theSamples,
 		    continue;
 		  }
 
-
-		  Haplotype &curHap = theSamples[ped][rep][gen][branch][ind].
-								haps[h][chrIdx];
-      // fprintf(stderr, "pos %d %d%d%d%d%d chr %d %d\n", pos, ped, fam, gen, branch, ind, chrIdx, curHap.front().endPos); // Delete
-		  while (curHap.front().endPos < pos) {
-		    pop_front(curHap);
+		  if (!curSeg[h].positioned()) {
+		    curSeg[h] = HapCursor(theSamples[ped][rep][gen][branch][ind],
+					  h, chrIdx);
+		    for(uint32_t s = 0; s < curSegIdx[h]; s++)
+		      curSeg[h].advance();
+		  }
+		  while (curSeg[h].endPos < pos && curSeg[h].advance()) {
+		    curSegIdx[h]++;
 		  }
-		  assert(curHap.front().endPos >= pos);
-      // Basically, for each simulated person, gives us the haplotype of the founder
-		  curFounderHaps[h] = curHap.front().foundHapNum;
-      // fprintf(stderr, "hap %d founderHap %d\n", h, curFounderHaps[h]); // Delete
+		  assert(curSeg[h].endPos >= pos);
+		  // Basically, for each simulated person, gives us the haplotype
+		  // of the founder
+		  curFounderHaps[h] = curSeg[h].foundHapNum;
 		}
 		if (maleX)
 		  curFounderHaps[0] = curFounderHaps[1];
 
-		// make this a pseudo haploid genotype?
-		if (CmdLineOpts::pseudoHapRate > 0) {
-		  if (isPseudoHap( randomGen )) {
-		    // pseudo-haploid; pick one haplotype to print
-		    int printHap = coinFlip(randomGen);
-		    for(int h = 0; h < numHaps; h++)
-		      out.printf("%c%s", betweenAlleles[h],
-				 founderHaps[ curFounderHaps[printHap] ]);
-		  }
-		  else { // not pseudo-haploid => both alleles missing:
-		    for(int h = 0; h < numHaps; h++)
-		      out.printf("%c.", betweenAlleles[h]);
-		  }
-		  continue;
-		}
-
+		for(int r = 0; r < numRenders; r++) {
+		  VCFRender<O_TYPE> &render = vcfRenders[r];
+		  const char *geno[2];
 
-		// genotyping error?
-		if (genoErr( randomGen ) && numAlleles == 2) {
-		  int alleles[2]; // integer allele values
-		  for(int h = 0; h < numHaps; h++)
-		    // can get character 0 from founderHaps strings: with only
-		    // two alleles possible, these strings must have length 1.
-		    // converting to an integer is simple: subtract '0'
-        
-		    alleles[h] = founderHaps[ curFounderHaps[h] ][0] - '0';
+		  // set to missing (according to the rate set by the user)?
+		  if (render.setMissing( render.randomGen )) {
+		    geno[0] = geno[1] = ".";
+		    render.putGeno(geno, numHaps, betweenAlleles);
+		    continue; // done printing genotype data for this sample
+		  }
 
+		  // non-missing genotype: print, possibly with a genotyping
+		  // error
 
-		  if (alleles[0] != alleles[1]) {
-        		    // heterozygous: choose an allele to alter
-		    int alleleToFlip = coinFlip(randomGen);
-		    alleles[ alleleToFlip ] ^= 1;
+		  // make this a pseudo haploid genotype?
+		  if (render.spec->pseudoHapRate > 0) {
+		    if (render.isPseudoHap( render.randomGen )) {
+		      // pseudo-haploid; pick one haplotype to print
+		      int printHap = coinFlip(render.randomGen);
+		      geno[0] = geno[1] =
+			hapAlleles[ render.founderHapSrc[ curFounderHaps[printHap] ] ];
+		    }
+		    else { // not pseudo-haploid => both alleles missing:
+		      geno[0] = geno[1] = ".";
+		    }
+		    render.putGeno(geno, numHaps, betweenAlleles);
+		    continue;
 		  }
-		  else {
-		    // homozygous: determine whether to change to the opposite
-		    // homozygote or to a heterozygote
-		    if (homErr(randomGen)) {
-		      alleles[0] ^= 1;
-		      alleles[1] ^= 1;
+
+		  // genotyping error?
+		  if (render.genoErr( render.randomGen ) && numAlleles == 2) {
+		    int alleles[2]; // integer allele values
+		    // set both (even for males on the X, where the two are the
+		    // same) so the homozygosity check below is well-defined
+		    for(int h = 0; h < 2; h++)
+		      // can get character 0 from the allele strings: with only
+		      // two alleles possible, these strings must have length 1.
+		      // converting to an integer is simple: subtract '0'
+		      alleles[h] = hapAlleles[ render.founderHapSrc[
+						  curFounderHaps[h] ] ][0] - '0';
+
+		    if (alleles[0] != alleles[1]) {
+		      // heterozygous: choose an allele to alter
+		      int alleleToFlip = coinFlip(render.randomGen);
+		      alleles[ alleleToFlip ] ^= 1;
 		    }
 		    else {
-		      // will flip only one allele so that the sample becomes
-		      // heterozygous; randomly choose which
-		      int alleleToFlip = coinFlip(randomGen);
-		      alleles[ alleleToFlip ] ^= 1;
-		      if (maleX) // ensure male homozygous on X
-			alleles[ 1^alleleToFlip ] ^= 1;
+		      // homozygous: determine whether to change to the opposite
+		      // homozygote or to a heterozygote
+		      if (render.homErr(render.randomGen)) {
+			alleles[0] ^= 1;
+			alleles[1] ^= 1;
+		      }
+		      else {
+			// will flip only one allele so that the sample becomes
+			// heterozygous; randomly choose which
+			int alleleToFlip = coinFlip(render.randomGen);
+			alleles[ alleleToFlip ] ^= 1;
+			if (maleX) // ensure male homozygous on X
+			  alleles[ 1^alleleToFlip ] ^= 1;
+		      }
+		    }
+
+		    const char *alleleStrs[2] = { "0", "1" };
+		    for(int h = 0; h < numHaps; h++) {
+		      assert(alleles[h] == 0 || alleles[h] == 1);
+		      geno[h] = alleleStrs[ alleles[h] ];
 		    }
+		    render.putGeno(geno, numHaps, betweenAlleles);
+		  }
+		  else { // no error: print alleles from original haplotypes
+		    for(int h = 0; h < numHaps; h++)
+		      geno[h] =
+			hapAlleles[ render.founderHapSrc[ curFounderHaps[h] ] ];
+		    render.putGeno(geno, numHaps, betweenAlleles);
 		  }
-      
-		  for(int h = 0; h < numHaps; h++)
-		    out.printf("%c%d", betweenAlleles[h],alleles[h]);
-		}
-		else { // no error: print alleles from original haplotypes
-    // Error is here
-    // fprintf(stderr, "hereeee %d %d \n", curFounderHaps[0], curFounderHaps[1]); // Delete
-		  for(int h = 0; h < numHaps; h++)
-		    out.printf("%c%s", betweenAlleles[h],
-			       founderHaps[ curFounderHaps[h] ]);
 		}
-      // fprintf(stderr, "hereeee1 %s\n", founderHaps[curFounderHaps[0]]); // Delete
 	      }
 	    }
+
+      if (sampleCosts) {
+	PedCosts::add(ped, PED_VCF_NS,
+		      (PedCosts::now() - pedStart) * PED_COST_SAMPLE);
+	PedCosts::add(ped, PED_OUT_BYTES,
+		      (printedBytes() - pedBytes) * PED_COST_SAMPLE);
+      }
     }
-    // print data for the --retain_extra samples:
 
-    for(unsigned int i = 0; i < numToRetain; i++) {
+    for(int r = 0; r < numRenders; r++) {
+      VCFRender<O_TYPE> &render = vcfRenders[r];
 
-      int sampIdx = extraSamples[i];
-      int numHaps = 2;
-      if (map.isX(chrIdx) && sampleSexes[sampIdx] == 0)
-	// male X: haploid output per VCF spec
-	numHaps = 1;
-      for(int h = 0; h < numHaps; h++)
-	out.printf("%c%s", betweenAlleles[h], hapAlleles[ 2*sampIdx + h ]);
+      // print data for the --retain_extra samples:
+      for(unsigned int i = 0; i < numToRetain; i++) {
+	int sampIdx = render.extraSamples[i];
+	int numHaps = 2;
+	if (map.isX(chrIdx) && sampleSexes[sampIdx] == 0)
+	  // male X: haploid output per VCF spec
+	  numHaps = 1;
+	const char *geno[2] = { hapAlleles[ 2*sampIdx ],
+				hapAlleles[ 2*sampIdx + 1 ] };
+	render.putGeno(geno, numHaps, betweenAlleles);
+      }
+
+      if (render.spec->genoFunc) {
+	(*render.spec->genoFunc)(chrom, pos, render.siteAlleles);
+	render.siteAlleles.clear();
+      }
+      else
+	render.out.printf("\n");
     }
 
-    out.printf("\n");
-    // exit(5); 
+    numRecords++;
+    Progress::vcfRecordOut();
+    if (Progress::enabled() && numRecords % VCF_PROGRESS_CHUNK == 0)
+      Progress::set(PROG_VCF, in.rawOffset());
+    if (Trace::enabled() && numRecords % VCF_TRACE_CHUNK == 0) {
+      Trace::record("VCF records", traceStart, "end record", numRecords);
+      traceStart = Trace::now();
+    }
+    if (ckptFile && CmdLineOpts::checkpointInterval > 0 &&
+	numRecords % CmdLineOpts::checkpointInterval == 0) {
+      VCFCheckpoint ckpt;
+      ckpt.run = runInfo;
+      ckpt.randSeed = CmdLineOpts::randSeed;
+      ckpt.numRecords = numRecords;
+      ckpt.inOffset = in.tell();
+      ckpt.chrIdx = chrIdx;
+      ckpt.gotSomeData = gotSomeData;
+      ckpt.warnedHetMaleX = warnedHetMaleX;
+      ckpt.alleleCountWarnPrinted = alleleCountWarnPrinted;
+      ckpt.segCursors = segCursors;
+      for(int r = 0; r < numRenders; r++) {
+	long offset = vcfRenders[r].out.sync();
+	if (offset < 0) {
+	  fprintf(stderr, "\nERROR: could not write to output VCF\n");
+	  perror("write");
+	  fatalExit(10);
+	}
+	ckpt.outOffsets.push_back(offset);
+	ckpt.renderGens.push_back(vcfRenders[r].randomGen);
+      }
+      ckpt.write(ckptFile);
+    }
   }
 
-  out.close();
+  if (numRecords % VCF_TRACE_CHUNK != 0)
+    Trace::record("VCF records", traceStart, "end record", numRecords);
+
+  for(int r = 0; r < numRenders; r++)
+    if (!renders[r].genoFunc)
+      vcfRenders[r].out.close();
   in.close();
+  Progress::end(PROG_VCF);
+
+  if (timer.active()) {
+    uint64_t numSites = numRecords - firstRecord;
+    // each render prints all simulated and retained samples at every site
+    uint64_t numSamples = segCursors.size() / 2 + numToRetain;
+    PhaseTimer::count(SITES, numSites);
+    PhaseTimer::count(GENOTYPES, numSites * numSamples * numRenders);
+  }
 
-  
+  if (ckptFile) {
+    // complete: a later --resume should start over
+    unlink(ckptFile);
+    delete [] ckptFile;
+  }
+
+  for(int r = 0; r < numRenders; r++) {
+    delete [] vcfRenders[r].founderHapSrc;
+    delete [] vcfRenders[r].founderSamples;
+  }
+  delete [] hapAlleles;
 
   return 0;
 }
 
 // Reads the sample ids from the VCF, stores them for printing the .ids file
 // and any --retain_extra samples. Also maps them to sexes if --sexes was
-// supplied and randomizes the assignment of these samples to founders, keeping
-// sexes the same when --sexes is supplied
-void getSampleIdsShuffHaps(vector<char*> &sampleIds,
-		vector<uint8_t> &sampleSexes, std::vector<std::vector<int>>& shuffHaps,
-		FILE *outs[2], vector<int> hapNumsBySex[2],
-		unordered_map<const char*,uint8_t,HashString,EqString> &sexes,
-		char *&saveptr, int totalFounderHaps, const char *tab) {
+// supplied and groups the haplotype numbers to be assigned to them by sex in
+// <sexSpecHapIdxs> (see shuffleHaps())
+void getSampleIds(vector<char*> &sampleIds, vector<uint8_t> &sampleSexes,
+		  vector<int> sexSpecHapIdxs[3], FILE *outs[2],
+		  vector<int> hapNumsBySex[2],
+		  unordered_map<const char*,uint8_t,HashString,EqString> &sexes,
+		  char *&saveptr, int totalFounderHaps, const char *tab) {
   // Need to randomly assign these samples to founder haplotypes.
   // <hapNumsBySex> contains all the haplotype numbers distinguished by the sex
   // of the founder. If the sexes of the VCF samples is known (in <sexes>), we
@@ -826,7 +1396,6 @@ void getSampleIdsShuffHaps(vector<char*> &sampleIds,
   // - Index [2] contains the number of input samples without sex assignments
   //   Note: if the --sexes option was not used, *all* haplotype numbers end up
   //   in this index
-  vector<int> sexSpecHapIdxs[3];
 
   // Should we assign haplotypes according to the sexes of the samples? Only
   // if we have sexes (via --sexes)
@@ -893,7 +1462,7 @@ void getSampleIdsShuffHaps(vector<char*> &sampleIds,
 	      sexCounts[1], sexCounts[0]);
       fprintf(stderr, "       Note: it is always possible to run without an input VCF or to get\n");
       fprintf(stderr, "       autosomal genotypes by running without the --sexes option\n");
-      exit(5);
+      fatalExit(5);
     }
   }
   // else { // DELETE
@@ -904,7 +1473,15 @@ void getSampleIdsShuffHaps(vector<char*> &sampleIds,
   //     exit(5);
   //   }
   // }
+}
 
+// Randomizes the assignment of the input samples to founders, keeping sexes the
+// same when --sexes is supplied, or reads the assignment from the
+// --founder_order file. <sexSpecHapIdxs> is as produced by getSampleIds() and
+// is shuffled in place by this function.
+void shuffleHaps(std::vector<std::vector<int>>& shuffHaps,
+		 vector<uint8_t> &sampleSexes, vector<int> sexSpecHapIdxs[3],
+		 int totalFounderHaps, mt19937 &rng) {
   if (CmdLineOpts::founderOrderFile != NULL) { 
     // Read founder order from file
     FILE *founderOrderIn = fopen(CmdLineOpts::founderOrderFile, "r");
@@ -912,7 +1489,7 @@ void getSampleIdsShuffHaps(vector<char*> &sampleIds,
         fprintf(stderr, "ERROR: could not open founder order file %s!\n",
                 CmdLineOpts::founderOrderFile);
         perror("open");
-        exit(1);
+        fatalExit(1);
     }
 
     // Clear and reinitialize shuffHaps as a vector of vectors
@@ -948,19 +1525,9 @@ void getSampleIdsShuffHaps(vector<char*> &sampleIds,
     if (totalFounders < (size_t)totalFounderHaps / 2) {
         fprintf(stderr, "ERROR: Total number of founders in the file (%zu) does not match the requirement (%d).\n",
                 totalFounders, totalFounderHaps / 2);
-        exit(1);
+        fatalExit(1);
     }
 
-    // Print debug information
-    // fprintf(stderr, "DEBUG: shuffHaps vector of vectors:\n");
-    // for (size_t i = 0; i < newShuffHaps.size(); i++) {
-    //     fprintf(stderr, "Row %zu: ", i);
-    //     for (size_t j = 0; j < newShuffHaps[i].size(); j++) {
-    //         fprintf(stderr, "%d ", newShuffHaps[i][j]);
-    //     }
-    //     fprintf(stderr, "\n");
-    // }
-
     // Assign the new structure to shuffHaps
     shuffHaps = move(newShuffHaps);
 
@@ -980,7 +1547,7 @@ void getSampleIdsShuffHaps(vector<char*> &sampleIds,
   // --retain_extra is in place
   for(int sexIdx = 0; sexIdx < 3; sexIdx++)
     shuffle(sexSpecHapIdxs[sexIdx].begin(), sexSpecHapIdxs[sexIdx].end(),
-	    randomGen);
+	    rng);
 
   int curSSHapIdx[3] = { 0, 0, 0 };
   for(uint32_t i = 0; i < sampleSexes.size(); i++) {
@@ -991,31 +1558,20 @@ void getSampleIdsShuffHaps(vector<char*> &sampleIds,
     shuffHaps.push_back(randomIndices);
     curSSHapIdx[curSex]++;
   }
-
-  // fprintf(stderr, "DEBUG: shuffHaps vector of vectors:\n"); // More descriptive output
-  // for (size_t i = 0; i < shuffHaps.size(); i++) {
-  //   fprintf(stderr, "Row %zu: ", i); // Indicate row number
-
-  //   for (size_t j = 0; j < shuffHaps[i].size(); j++) {
-  //     fprintf(stderr, "%d ", shuffHaps[i][j]); 
-  //   }
-
-  //   fprintf(stderr, "\n"); // Newline after each row
-  // }
-
 }
 
 
 // print fam format file with the pedigree structure of all individuals included
-// in the simulation
+// in the simulation (adding to the end of it if <append>)
 void printFam(vector<SimDetails> &simDetails, Person *****theSamples,
-	      const char *famFile) {
+	      const char *famFile, bool append) {
   // open output fam file:
-  FILE *out = fopen(famFile, "w");
-  if (!out) {
+  FileOrGZ<FILE *> out;
+  bool success = out.open(famFile, append ? "a" : "w");
+  if (!success) {
     fprintf(stderr, "ERROR: could not open output fam file %s!\n", famFile);
     perror("open");
-    exit(1);
+    fatalExit(1);
   }
 
   for(unsigned int ped = 0; ped < simDetails.size(); ped++) {
@@ -1026,6 +1582,8 @@ void printFam(vector<SimDetails> &simDetails, Person *****theSamples,
     Parent **branchParents = simDetails[ped].branchParents;
     int **branchNumSpouses = simDetails[ped].branchNumSpouses;
     char *pedName = simDetails[ped].name;
+    int firstRep = simDetails[ped].firstRep;
+    long pedStartBytes = out.printed();
 
     if (CmdLineOpts::dryRun)
       // for --dry_run, only generated one replicate per pedigree
@@ -1043,16 +1601,16 @@ void printFam(vector<SimDetails> &simDetails, Person *****theSamples,
 	  for(int ind = 0; ind < numPersons; ind++) {
 
 	    // print family id (PLINK-specific) and sample id
-	    fprintf(out, "%s%d ", pedName, rep+1); // family id first
-	    printSampleId(out, simDetails[ped], rep, gen, branch, ind,
+	    out.printf("%s%d ", pedName, firstRep + rep+1); // family id first
+	    printSampleId(&out, simDetails[ped], rep, gen, branch, ind,
 			  /*printAllGens=*/ true);
-	    fprintf(out, " ");
+	    out.printf(" ");
 
 	    // print parents
 	    if (gen == 0 || ind < numFounders) {
 	      // first generation or ind >= numNonFounders are founders, so
 	      // they have no parents.
-	      fprintf(out, "0 0 ");
+	      out.printf("0 0 ");
 	    }
 	    else {
 	      Parent pars[2]; // which branch are the two parents in
@@ -1084,12 +1642,16 @@ void printFam(vector<SimDetails> &simDetails, Person *****theSamples,
 		// the following will switch and print parent 1 first
 		int printPar = p ^ par0sex;
 		// TODO: use printSampleId()
-		if (!isSpouse[ printPar ])
+		if (simDetails[ped].sampleIds)
+		  out.printf("%s%d_%s ", pedName, firstRep + rep+1,
+			     simDetails[ped].sampleIds[ pars[ printPar ].gen ]
+						      [ pars[ printPar ].branch ]);
+		else if (!isSpouse[ printPar ])
 		  // must be the primary person, so i1:
-		  fprintf(out, "%s%d_g%d-b%d-i1 ", pedName, rep+1,
+		  out.printf("%s%d_g%d-b%d-i1 ", pedName, firstRep + rep+1,
 			  pars[ printPar ].gen+1, pars[ printPar ].branch+1);
 		else
-		  fprintf(out, "%s%d_g%d-b%d-s%d ", pedName, rep+1,
+		  out.printf("%s%d_g%d-b%d-s%d ", pedName, firstRep + rep+1,
 			  pars[ printPar ].gen+1, pars[ printPar ].branch+1,
 			  parIdx[ printPar ]+1);
 	      }
@@ -1099,21 +1661,13 @@ void printFam(vector<SimDetails> &simDetails, Person *****theSamples,
 	    // gets printed:
 	    int sex = theSamples[ped][rep][gen][branch][ind].sex;
 	    int pheno = (numSampsToPrint[gen][branch] > 0) ? 1 : -9;
-	    fprintf(out, "%d %d\n", sex+1, pheno);
+	    out.printf("%d %d\n", sex+1, pheno);
 	  }
 	}
       }
     }
+    PedCosts::add(ped, PED_OUT_BYTES, out.printed() - pedStartBytes);
   }
 
-  fclose(out);
-}
-
-// removes the first element from <vec>. This has time that is linear in the
-// number of elements. We could use a list<> instead of a vector<> to avoid this
-// linear time, but having random access ability on the vectors is very
-// convenient, so we'll live with this.
-template<typename T>
-void pop_front(vector<T> &vec) {
-  vec.erase(vec.begin());
+  out.close();
 }
@@ -3,7 +3,10 @@
 // This program is distributed under the terms of the GNU General Public License
 
 #include <vector>
+#include <string>
 #include <unordered_map>
+#include <random>
+#include <functional>
 #include "datastructs.h"
 #include "geneticmap.h"
 #include "fileorgz.h"
@@ -13,31 +16,90 @@
 
 using namespace std;
 
+////////////////////////////////////////////////////////////////////////////////
+// Receives the genotypes of one VCF record in place of printing them (see
+// RenderSpec): <alleles> has two entries for each output sample in the order
+// of the VCF columns. Entries are the allele strings from the input VCF (or
+// "." for missing data), and males have the same allele twice on the X
+typedef function<void(const char *chrom, int pos,
+		      const vector<const char *> &alleles)> GenoFunc;
+
+////////////////////////////////////////////////////////////////////////////////
+// Settings for generating one output VCF. Using --renders, Ped-sim generates
+// several VCFs -- each with its own assignment of input samples to founders
+// and its own error/missingness rates -- in a single pass over the input VCF
+struct RenderSpec {
+  // suffix for the output file names; NULL for the standard output VCF
+  char *name;
+  // if false, this render continues from the state of the main random number
+  // generator (giving the same result as a standard run)
+  bool haveSeed;
+  unsigned int seed;
+  double genoErrRate;
+  double homErrRate;
+  double missRate;
+  double pseudoHapRate;
+  // if non-NULL, the genotypes are passed to this function rather than
+  // printed to a file (for library users; see pedsim.h)
+  GenoFunc *genoFunc;
+};
+
+////////////////////////////////////////////////////////////////////////////////
+// Parses the settings for an output VCF that both --renders lines and --batch
+// or --server jobs can give -- seed, err_rate, err_hom_rate, miss_rate, and
+// pseudo_hap -- into the referenced variables
+class VCFSettingsParser {
+  public:
+    VCFSettingsParser(bool &haveSeed, unsigned int &seed, double &genoErrRate,
+		      double &homErrRate, double &missRate,
+		      double &pseudoHapRate);
+
+    static bool isSetting(const char *key);
+    // Parses <value> into the setting <key>, for which isSetting() must be
+    // true. Returns 0 on success; on error, sets <err> and returns the status
+    // Ped-sim exits with
+    int parse(const char *key, const char *value, string &err);
+    // Checks the settings once all are parsed; returns as parse()
+    int finish(string &err);
+
+  private:
+    bool &haveSeed;
+    unsigned int &seed;
+    double &genoErrRate, &homErrRate, &missRate, &pseudoHapRate;
+    // as with --pseudo_hap, pseudo_hap means no missing data unless miss_rate
+    // is also given
+    bool setMissRate;
+};
+
 void readSexes(unordered_map<const char*,uint8_t,HashString,EqString> &sexes,
 	       uint32_t sexCount[2], const char *sexesFile);
-template<typename O_TYPE = FILE *>
-bool printSampleId(FILE *out, SimDetails &pedDetails, int rep, int gen,
-		   int branch, int ind, bool printAllGens = false,
-		   FileOrGZ<O_TYPE> *gzOut = NULL);
+template<typename O_TYPE>
+bool printSampleId(FileOrGZ<O_TYPE> *out, SimDetails &pedDetails, int rep,
+		   int gen, int branch, int ind, bool printAllGens = false);
+void readRenders(vector<RenderSpec> &renders, const char *rendersFile);
 void printBPs(vector<SimDetails> &simDetails, Person *****theSamples,
-	      GeneticMap &map, char *bpFile);
+	      GeneticMap &map, char *bpFile, bool append = false);
 int printVCF(vector<SimDetails> &simDetails, Person *****theSamples,
-	     int totalFounderHaps, const char *inVCFfile, char *outFile,
-	     GeneticMap &map, FILE *outs[2], vector<int> hapNumsBySex[2],
+	     int totalFounderHaps, const char *inVCFfile,
+	     vector<RenderSpec> &renders, GeneticMap &map, FILE *outs[2],
+	     vector<int> hapNumsBySex[2],
 	     unordered_map<const char*,uint8_t,HashString,EqString> &sexes);
 template<typename I_TYPE, typename O_TYPE>
 int makeVCF(vector<SimDetails> &simDetails, Person *****theSamples,
-	    int totalFounderHaps, const char *inVCFfile, char *outFileBuf,
-	    GeneticMap &map, FILE *outs[2], vector<int> hapNumsBySex[2],
+	    int totalFounderHaps, const char *inVCFfile,
+	    vector<RenderSpec> &renders, const char *outExt, GeneticMap &map,
+	    FILE *outs[2], vector<int> hapNumsBySex[2],
 	    unordered_map<const char*,uint8_t,HashString,EqString> &sexes);
-void getSampleIdsShuffHaps(vector<char*> &sampleIds,
-		vector<uint8_t> &sampleSexes, std::vector<std::vector<int>>& shuffHaps,
-		FILE *outs[2], vector<int> hapNumsBySex[2],
-		unordered_map<const char*,uint8_t,HashString,EqString> &sexes,
-		char *&saveptr, int totalFounderHaps, const char *tab);
+char *renderFileName(const RenderSpec &render, const char *ext);
+void getSampleIds(vector<char*> &sampleIds, vector<uint8_t> &sampleSexes,
+		  vector<int> sexSpecHapIdxs[3], FILE *outs[2],
+		  vector<int> hapNumsBySex[2],
+		  unordered_map<const char*,uint8_t,HashString,EqString> &sexes,
+		  char *&saveptr, int totalFounderHaps, const char *tab);
+void shuffleHaps(std::vector<std::vector<int>>& shuffHaps,
+		 vector<uint8_t> &sampleSexes, vector<int> sexSpecHapIdxs[3],
+		 int totalFounderHaps, mt19937 &rng);
 void printFam(vector<SimDetails> &simDetails, Person *****theSamples,
-	      const char *famFile);
-template<typename T>
-void pop_front(vector<T> &vec);
+	      const char *famFile, bool append = false);
 
 #endif // BPVCFFAM_H
@@ -0,0 +1,134 @@
+// ped-sim: pedigree simulation tool
+//
+// This program is distributed under the terms of the GNU General Public License
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sstream>
+#include "checkpoint.h"
+#include "cmdlineopts.h"
+#include "runerror.h"
+
+// first line of the file
+static const char *CKPT_HEADER = "ped-sim VCF checkpoint v2\n";
+
+bool VCFCheckpoint::read(const char *fileName) {
+  FILE *in = fopen(fileName, "r");
+  if (!in) {
+    if (errno == ENOENT)
+      return false;
+    fprintf(stderr, "ERROR: could not open checkpoint file %s!\n", fileName);
+    perror("open");
+    fatalExit(1);
+  }
+
+  char *buffer = NULL;
+  size_t bytesRead = 0;
+  bool good = getline(&buffer, &bytesRead, in) >= 0 &&
+	      strcmp(buffer, CKPT_HEADER) == 0;
+  // fingerprint of the run: the rest of the second line
+  good = good && getline(&buffer, &bytesRead, in) >= 4 &&
+	 strncmp(buffer, "run ", 4) == 0;
+  if (good) {
+    run = buffer + 4;
+    if (run.size() > 0 && run.back() == '\n')
+      run.pop_back();
+  }
+
+  int numTokens = 0, gotData = 0, warnedHet = 0, warnedCount = 0;
+  unsigned long numCursors = 0;
+  int numRenders = 0;
+  if (good)
+    numTokens = fscanf(in, "seed %u\nrecords %ld\ninput %ld\nchrom %u %d\n"
+			   "warnings %d %d\ncursors %lu",
+		       &randSeed, &numRecords, &inOffset, &chrIdx, &gotData,
+		       &warnedHet, &warnedCount, &numCursors);
+  good = good && numTokens == 8;
+  gotSomeData = gotData;
+  warnedHetMaleX = warnedHet;
+  alleleCountWarnPrinted = warnedCount;
+
+  segCursors.resize(numCursors);
+  for(unsigned long i = 0; good && i < numCursors; i++)
+    good = fscanf(in, " %u", &segCursors[i]) == 1;
+
+  good = good && fscanf(in, "\nrenders %d\n", &numRenders) == 1;
+  outOffsets.resize(numRenders);
+  renderGens.resize(numRenders);
+  for(int r = 0; good && r < numRenders; r++) {
+    // output offset then the generator state on one line
+    good = fscanf(in, "%ld ", &outOffsets[r]) == 1 &&
+	   getline(&buffer, &bytesRead, in) >= 0;
+    if (good) {
+      istringstream genState(buffer);
+      genState >> renderGens[r];
+      good = !genState.fail();
+    }
+  }
+
+  if (!good) {
+    fprintf(stderr, "ERROR: checkpoint file %s is improperly formatted\n",
+	    fileName);
+    fatalExit(5);
+  }
+
+  free(buffer);
+  fclose(in);
+  return true;
+}
+
+void VCFCheckpoint::write(const char *fileName) {
+  int tmpLen = strlen(fileName) + 4 + 1; // + 4 for .tmp, + 1 for '\0'
+  char *tmpFile = new char[tmpLen];
+  if (tmpFile == NULL) {
+    printf("ERROR: out of memory");
+    fatalExit(5);
+  }
+  sprintf(tmpFile, "%s.tmp", fileName);
+
+  FILE *out = fopen(tmpFile, "w");
+  if (!out) {
+    fprintf(stderr, "ERROR: could not open checkpoint file %s!\n", tmpFile);
+    perror("open");
+    fatalExit(1);
+  }
+
+  fprintf(out, "%s", CKPT_HEADER);
+  fprintf(out, "run %s\n", run.c_str());
+  fprintf(out, "seed %u\n", randSeed);
+  fprintf(out, "records %ld\n", numRecords);
+  fprintf(out, "input %ld\n", inOffset);
+  fprintf(out, "chrom %u %d\n", chrIdx, gotSomeData);
+  fprintf(out, "warnings %d %d\n", warnedHetMaleX, alleleCountWarnPrinted);
+  fprintf(out, "cursors %lu", segCursors.size());
+  for(auto it = segCursors.begin(); it != segCursors.end(); it++)
+    fprintf(out, " %u", *it);
+  fprintf(out, "\nrenders %lu\n", outOffsets.size());
+  for(unsigned int r = 0; r < outOffsets.size(); r++) {
+    ostringstream genState;
+    genState << renderGens[r];
+    fprintf(out, "%ld %s\n", outOffsets[r], genState.str().c_str());
+  }
+
+  if (fflush(out) != 0 || fsync(fileno(out)) != 0 || fclose(out) != 0 ||
+      rename(tmpFile, fileName) != 0) {
+    fprintf(stderr, "ERROR: could not write checkpoint file %s\n", fileName);
+    perror("write");
+    fatalExit(10);
+  }
+  delete [] tmpFile;
+}
+
+char *VCFCheckpoint::fileName() {
+  // + 5 for .ckpt, + 1 for '\0'
+  char *fileName = new char[ strlen(CmdLineOpts::outPrefix) + 5 + 1 ];
+  if (fileName == NULL) {
+    printf("ERROR: out of memory");
+    fatalExit(5);
+  }
+  sprintf(fileName, "%s.ckpt", CmdLineOpts::outPrefix);
+  return fileName;
+}
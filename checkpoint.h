@@ -0,0 +1,48 @@
+// ped-sim: pedigree simulation tool
+//
+// This program is distributed under the terms of the GNU General Public License
+
+#include <stdint.h>
+#include <vector>
+#include <random>
+#include <string>
+
+#ifndef CHECKPOINT_H
+#define CHECKPOINT_H
+
+using namespace std;
+
+////////////////////////////////////////////////////////////////////////////////
+// The state of VCF generation (in makeVCF()), saved to <prefix>.ckpt every
+// --checkpoint records so that --resume can continue an interrupted run with
+// output identical to an uninterrupted one. The simulated haplotypes aren't
+// saved: simulate() quickly regenerates them from the seed, which the
+// checkpoint stores.
+struct VCFCheckpoint {
+  // Fingerprint of the inputs and settings of the run (see runFingerprint()
+  // in bpvcffam.cc); --resume refuses a checkpoint with a different one
+  string run;
+  unsigned int randSeed;
+  long numRecords;   // records printed to the output VCFs
+  long inOffset;     // offset in the (uncompressed) input of the next line
+  unsigned int chrIdx;
+  bool gotSomeData;
+  bool warnedHetMaleX;
+  bool alleleCountWarnPrinted;
+  vector<uint32_t> segCursors;
+  // for each render (output VCF): size of the output file and state of the
+  // random number generator
+  vector<long> outOffsets;
+  vector<mt19937> renderGens;
+
+  // Returns false if <fileName> doesn't exist; exits on other errors
+  bool read(const char *fileName);
+  // Writes to a temporary file and renames it so that an interruption leaves
+  // the previous checkpoint in place
+  void write(const char *fileName);
+
+  // Newly allocated name of the checkpoint file: <prefix>.ckpt
+  static char *fileName();
+};
+
+#endif // CHECKPOINT_H
@@ -9,32 +9,30 @@
 #include <string.h>
 #include <errno.h>
 #include "cmdlineopts.h"
+#include "membudget.h"
 
 ////////////////////////////////////////////////////////////////////////////////
 // define/initialize static members
-char  *CmdLineOpts::defFile = NULL;
-char  *CmdLineOpts::mapFile = NULL;
-char  *CmdLineOpts::interfereFile = NULL;
-char  *CmdLineOpts::inVCFfile = NULL;
-char  *CmdLineOpts::outPrefix = NULL;
-char  *CmdLineOpts::founderOrderFile = NULL;
-bool   CmdLineOpts::autoSeed = true;
-int    CmdLineOpts::dryRun = 0;
-unsigned int CmdLineOpts::randSeed;
-int    CmdLineOpts::printFam = 0;
-int    CmdLineOpts::printBP = 0;
-int    CmdLineOpts::printMRCA = 0;
-int    CmdLineOpts::nogz = 0;
-double CmdLineOpts::genoErrRate = 1e-3;
-double CmdLineOpts::homErrRate = 0;
-double CmdLineOpts::missRate = 1e-3;
-double CmdLineOpts::pseudoHapRate = 0.0;
-int    CmdLineOpts::keepPhase = 0;
-int    CmdLineOpts::retainExtra = 0;
-int    CmdLineOpts::printFounderIds = 0;
-char  *CmdLineOpts::fixedCOfile = NULL;
-char  *CmdLineOpts::chrX = NULL;
-char  *CmdLineOpts::vcfSexesFile = NULL;
+#define CMDLINEOPTS_DEFINE(type, name, init)				\
+  thread_local type CmdLineOpts::name = init;
+CMDLINEOPTS_FIELDS(CMDLINEOPTS_DEFINE)
+#undef CMDLINEOPTS_DEFINE
+
+// Returns a copy of the calling thread's settings
+CmdLineOpts::Settings CmdLineOpts::get() {
+  Settings settings;
+#define CMDLINEOPTS_GET(type, name, init) settings.name = name;
+  CMDLINEOPTS_FIELDS(CMDLINEOPTS_GET)
+#undef CMDLINEOPTS_GET
+  return settings;
+}
+
+// Makes <settings> the calling thread's settings
+void CmdLineOpts::set(const Settings &settings) {
+#define CMDLINEOPTS_SET(type, name, init) name = settings.name;
+  CMDLINEOPTS_FIELDS(CMDLINEOPTS_SET)
+#undef CMDLINEOPTS_SET
+}
 
 // Parses the command line options for the program.
 bool CmdLineOpts::parseCmdLineOptions(int argc, char **argv) {
@@ -50,6 +48,25 @@ bool CmdLineOpts::parseCmdLineOptions(int argc, char **argv) {
     FIXED_CO,
     SEXES,
     FOUNDER_ORDER,
+    RENDERS,
+    THREADS,
+    SERVER,
+    BATCH,
+    SHARD,
+    CHECKPOINT,
+    TIMING_JSON,
+    TRACE,
+    PERF,
+    MAX_MEM,
+    PROGRESS,
+    PROGRESS_JSON,
+    IN_FAM,
+    POP,
+    POP_GENS,
+    POP_SAMPLE,
+    POP_MONOGAMY,
+    POP_VAR,
+    ENGINE,
   };
 
   // This is a local variable because whenever <interfereFile> is NULL, the
@@ -57,16 +74,26 @@ bool CmdLineOpts::parseCmdLineOptions(int argc, char **argv) {
   // is selected (and ensure that simulation is not done using both models).
   int poisson = 0;
 
-  static struct option const longopts[] =
+  // not static: the addresses of the (thread-local) flags differ by thread
+  struct option const longopts[] =
 {
+  {"in_fam", required_argument, NULL, IN_FAM},
+  {"pop", required_argument, NULL, POP},
+  {"pop_gens", required_argument, NULL, POP_GENS},
+  {"pop_sample", required_argument, NULL, POP_SAMPLE},
+  {"pop_monogamy", required_argument, NULL, POP_MONOGAMY},
+  {"pop_var", required_argument, NULL, POP_VAR},
   {"intf", required_argument, NULL, INTERFERENCE},
   {"pois", no_argument, &poisson, 1},
   {"seed", required_argument, NULL, RAND_SEED},
   {"sexes", required_argument, NULL, SEXES},
   {"dry_run", no_argument, &CmdLineOpts::dryRun, 1},
+  {"plan", no_argument, &CmdLineOpts::plan, 1},
   {"fam", no_argument, &CmdLineOpts::printFam, 1},
   {"bp", no_argument, &CmdLineOpts::printBP, 1},
   {"mrca", no_argument, &CmdLineOpts::printMRCA, 1},
+  {"edges", no_argument, &CmdLineOpts::printEdges, 1},
+  {"engine", required_argument, NULL, ENGINE},
   {"nogz", no_argument, &CmdLineOpts::nogz, 1},
   {"keep_phase", no_argument, &CmdLineOpts::keepPhase, 1},
   {"founder_ids", no_argument, &CmdLineOpts::printFounderIds, 1},
@@ -76,6 +103,20 @@ bool CmdLineOpts::parseCmdLineOptions(int argc, char **argv) {
   {"miss_rate", required_argument, NULL, MISS_RATE},
   {"pseudo_hap", required_argument, NULL, PSEUDO_HAP_RATE},
   {"founder_order", required_argument, NULL, FOUNDER_ORDER}, 
+  {"renders", required_argument, NULL, RENDERS},
+  {"threads", required_argument, NULL, THREADS},
+  {"server", required_argument, NULL, SERVER},
+  {"batch", required_argument, NULL, BATCH},
+  {"shard", required_argument, NULL, SHARD},
+  {"checkpoint", required_argument, NULL, CHECKPOINT},
+  {"resume", no_argument, &CmdLineOpts::resume, 1},
+  {"timing", no_argument, &CmdLineOpts::printTiming, 1},
+  {"timing_json", required_argument, NULL, TIMING_JSON},
+  {"trace", required_argument, NULL, TRACE},
+  {"perf", no_argument, NULL, PERF},
+  {"max_mem", required_argument, NULL, MAX_MEM},
+  {"progress", required_argument, NULL, PROGRESS},
+  {"progress_json", required_argument, NULL, PROGRESS_JSON},
 #ifndef NOFIXEDCO
   {"fixed_co", required_argument, NULL, FIXED_CO},
 #endif // NOFIXEDCO
@@ -88,6 +129,7 @@ bool CmdLineOpts::parseCmdLineOptions(int argc, char **argv) {
 
   bool haveGoodArgs = true;
   bool setMissRate = false;
+  bool setPopOpt = false; // any of --pop_gens, --pop_sample, etc.?
 
   char optstring[80] = "d:m:i:o:X:";
   while ((c = getopt_long(argc, argv, optstring, longopts, &optionIndex))
@@ -108,6 +150,85 @@ bool CmdLineOpts::parseCmdLineOptions(int argc, char **argv) {
 	}
 	defFile = optarg;
 	break;
+      case IN_FAM:
+	if (inFamFile != NULL) {
+	  if (haveGoodArgs)
+	    fprintf(stderr, "\n");
+	  fprintf(stderr, "ERROR: multiple definitions of --in_fam filename\n");
+	  haveGoodArgs = false;
+	}
+	inFamFile = optarg;
+	break;
+      case POP:
+	popSize = strtol(optarg, &endptr, 10);
+	if (errno != 0 || *endptr != '\0') {
+	  fprintf(stderr, "ERROR: unable to parse --pop argument as integer\n");
+	  if (errno != 0)
+	    perror("strtol");
+	  exit(2);
+	}
+	if (popSize < 2) {
+	  fprintf(stderr, "ERROR: --pop value must be 2 or greater\n");
+	  exit(5);
+	}
+	break;
+      case POP_GENS:
+	setPopOpt = true;
+	popGens = strtol(optarg, &endptr, 10);
+	if (errno != 0 || *endptr != '\0') {
+	  fprintf(stderr, "ERROR: unable to parse --pop_gens argument as integer\n");
+	  if (errno != 0)
+	    perror("strtol");
+	  exit(2);
+	}
+	if (popGens < 2) {
+	  fprintf(stderr, "ERROR: --pop_gens value must be 2 or greater\n");
+	  exit(5);
+	}
+	break;
+      case POP_SAMPLE:
+	setPopOpt = true;
+	popSample = strtol(optarg, &endptr, 10);
+	if (errno != 0 || *endptr != '\0') {
+	  fprintf(stderr, "ERROR: unable to parse --pop_sample argument as integer\n");
+	  if (errno != 0)
+	    perror("strtol");
+	  exit(2);
+	}
+	if (popSample < 0) {
+	  fprintf(stderr, "ERROR: --pop_sample value must be 0 or greater\n");
+	  exit(5);
+	}
+	break;
+      case POP_MONOGAMY:
+	setPopOpt = true;
+	popMonogamy = strtod(optarg, &endptr);
+	if (errno != 0 || *endptr != '\0') {
+	  fprintf(stderr, "ERROR: unable to parse --pop_monogamy argument as floating point value\n");
+	  if (errno != 0)
+	    perror("strtod");
+	  exit(2);
+	}
+	if (popMonogamy < 0 || popMonogamy > 1) {
+	  fprintf(stderr, "ERROR: --pop_monogamy value must be between 0 and 1\n");
+	  exit(5);
+	}
+	break;
+      case POP_VAR:
+	setPopOpt = true;
+	popVar = strtod(optarg, &endptr);
+	if (errno != 0 || *endptr != '\0') {
+	  fprintf(stderr, "ERROR: unable to parse --pop_var argument as floating point value\n");
+	  if (errno != 0)
+	    perror("strtod");
+	  exit(2);
+	}
+	if (popVar < 2) {
+	  // with equal weights, the number of offspring is Poisson with mean 2
+	  fprintf(stderr, "ERROR: --pop_var value must be 2 or greater\n");
+	  exit(5);
+	}
+	break;
       case 'm':
 	if (mapFile != NULL) {
 	  if (haveGoodArgs)
@@ -185,6 +306,107 @@ bool CmdLineOpts::parseCmdLineOptions(int argc, char **argv) {
         }
         founderOrderFile = optarg;
         break;
+      case RENDERS:
+	if (renderFile != NULL) {
+	  if (haveGoodArgs)
+	    fprintf(stderr, "\n");
+	  fprintf(stderr, "ERROR: multiple definitions of renders file\n");
+	  haveGoodArgs = false;
+	}
+	renderFile = optarg;
+	break;
+      case THREADS:
+	numThreads = strtol(optarg, &endptr, 10);
+	if (errno != 0 || *endptr != '\0') {
+	  fprintf(stderr, "ERROR: unable to parse --threads argument as integer\n");
+	  if (errno != 0)
+	    perror("strtol");
+	  exit(2);
+	}
+	if (numThreads < 0) {
+	  fprintf(stderr, "ERROR: --threads value must be 0 or greater\n");
+	  exit(5);
+	}
+	break;
+      case ENGINE:
+	if (strcmp(optarg, "forward") == 0)
+	  engine = ENGINE_FORWARD;
+	else if (strcmp(optarg, "backward") == 0)
+	  engine = ENGINE_BACKWARD;
+	else {
+	  if (haveGoodArgs)
+	    fprintf(stderr, "\n");
+	  fprintf(stderr, "ERROR: --engine must be forward or backward\n");
+	  haveGoodArgs = false;
+	}
+	break;
+      case SERVER:
+	serverPath = optarg;
+	break;
+      case BATCH:
+	batchFile = optarg;
+	break;
+      case CHECKPOINT:
+	checkpointInterval = strtol(optarg, &endptr, 10);
+	if (errno != 0 || *endptr != '\0') {
+	  fprintf(stderr, "ERROR: unable to parse --checkpoint argument as integer\n");
+	  if (errno != 0)
+	    perror("strtol");
+	  exit(2);
+	}
+	if (checkpointInterval < 0) {
+	  fprintf(stderr, "ERROR: --checkpoint value must be 0 or greater\n");
+	  exit(5);
+	}
+	break;
+      case TIMING_JSON:
+	timingJSONfile = optarg;
+	printTiming = 1;
+	break;
+      case PERF:
+	perfCounters = 1;
+	printTiming = 1;
+	break;
+      case TRACE:
+	traceFile = optarg;
+	break;
+      case PROGRESS:
+	progressInterval = strtod(optarg, &endptr);
+	if (errno != 0 || *endptr != '\0') {
+	  fprintf(stderr, "ERROR: unable to parse --progress argument as floating point value\n");
+	  if (errno != 0)
+	    perror("strtod");
+	  exit(2);
+	}
+	if (progressInterval <= 0) {
+	  fprintf(stderr, "ERROR: --progress value must be greater than 0\n");
+	  exit(5);
+	}
+	break;
+      case PROGRESS_JSON:
+	progressJSONfile = optarg;
+	break;
+      case MAX_MEM:
+	maxMem = MemBudget::parseSize(optarg);
+	if (maxMem <= 0) {
+	  fprintf(stderr, "ERROR: unable to parse --max_mem argument as a size such as 500M or 8G\n");
+	  exit(2);
+	}
+	break;
+      case SHARD:
+	{
+	  int numChars = 0;
+	  if (sscanf(optarg, "%d/%d%n", &shardIdx, &numShards, &numChars) != 2 ||
+	      optarg[numChars] != '\0') {
+	    fprintf(stderr, "ERROR: unable to parse --shard argument as <i>/<N>\n");
+	    exit(2);
+	  }
+	  if (numShards < 1 || shardIdx < 1 || shardIdx > numShards) {
+	    fprintf(stderr, "ERROR: --shard <i>/<N> requires 1 <= i <= N\n");
+	    exit(5);
+	  }
+	}
+	break;
       case MISS_RATE:
 	missRate = strtod(optarg, &endptr);
 	setMissRate = true;
@@ -256,10 +478,119 @@ bool CmdLineOpts::parseCmdLineOptions(int argc, char **argv) {
   /////////////////////////////////////////////////////////////////////////////
   // Check for errors in command line options
 
-  if (defFile == NULL || mapFile == NULL || outPrefix == NULL) {
+  if (serverPath || batchFile) {
+    // jobs give the def file and output prefix
+    const char *mode = (serverPath) ? "--server" : "--batch";
+    if (mapFile == NULL) {
+      if (haveGoodArgs)
+	fprintf(stderr, "\n");
+      fprintf(stderr, "ERROR: map file required\n");
+      haveGoodArgs = false;
+    }
+    if (defFile || inFamFile || popSize > 0 || outPrefix || renderFile ||
+	printEdges || dryRun || plan) {
+      if (haveGoodArgs)
+	fprintf(stderr, "\n");
+      fprintf(stderr, "ERROR: cannot use -d, --in_fam, --pop, -o, --renders, --edges, --dry_run, or\n");
+      fprintf(stderr, "       --plan with %s\n", mode);
+      haveGoodArgs = false;
+    }
+    if (maxMem > 0 || progressInterval > 0 || progressJSONfile) {
+      // these are for one run: jobs share the process's memory and report
+      // only when they complete
+      if (haveGoodArgs)
+	fprintf(stderr, "\n");
+      fprintf(stderr, "ERROR: cannot use --max_mem, --progress, or --progress_json with %s\n",
+	      mode);
+      haveGoodArgs = false;
+    }
+    if (printTiming || timingJSONfile || perfCounters) {
+      // the phase times are for the whole process, not a job, and jobs may
+      // run concurrently
+      if (haveGoodArgs)
+	fprintf(stderr, "\n");
+      fprintf(stderr, "ERROR: cannot use --timing, --timing_json, or --perf with %s\n",
+	      mode);
+      haveGoodArgs = false;
+    }
+    if (serverPath && traceFile) {
+      // the server runs until killed: never prints the trace
+      if (haveGoodArgs)
+	fprintf(stderr, "\n");
+      fprintf(stderr, "ERROR: cannot use --trace with --server\n");
+      haveGoodArgs = false;
+    }
+    if (serverPath && batchFile) {
+      if (haveGoodArgs)
+	fprintf(stderr, "\n");
+      fprintf(stderr, "ERROR: can only use one of --server and --batch\n");
+      haveGoodArgs = false;
+    }
+  }
+  else if ((defFile == NULL && inFamFile == NULL && popSize == 0) ||
+	   mapFile == NULL || outPrefix == NULL) {
     if (haveGoodArgs)
       fprintf(stderr, "\n");
-    fprintf(stderr, "ERROR: def, map, and output prefix names required\n");
+    fprintf(stderr, "ERROR: def (or --in_fam or --pop), map, and output prefix names required\n");
+    haveGoodArgs = false;
+  }
+  else if ((defFile != NULL) + (inFamFile != NULL) + (popSize > 0) > 1) {
+    if (haveGoodArgs)
+      fprintf(stderr, "\n");
+    fprintf(stderr, "ERROR: can only use one of -d, --in_fam, and --pop\n");
+    haveGoodArgs = false;
+  }
+  if (setPopOpt && popSize == 0) {
+    if (haveGoodArgs)
+      fprintf(stderr, "\n");
+    fprintf(stderr, "ERROR: --pop_gens, --pop_sample, --pop_monogamy, and --pop_var apply to\n");
+    fprintf(stderr, "       --pop\n");
+    haveGoodArgs = false;
+  }
+  if ((checkpointInterval > 0 || resume) &&
+      (inVCFfile == NULL || dryRun || plan)) {
+    if (haveGoodArgs)
+      fprintf(stderr, "\n");
+    fprintf(stderr, "ERROR: --checkpoint and --resume apply to generating VCFs: need -i and no\n");
+    fprintf(stderr, "       --dry_run or --plan\n");
+    haveGoodArgs = false;
+  }
+  if (numShards > 0 && (inVCFfile || renderFile || dryRun || plan ||
+			serverPath || batchFile)) {
+    // input samples are assigned to the founders of the whole run, so a
+    // shard can't generate its part of the VCF on its own
+    if (haveGoodArgs)
+      fprintf(stderr, "\n");
+    fprintf(stderr, "ERROR: cannot use -i, --renders, --dry_run, --plan, --server, or --batch\n");
+    fprintf(stderr, "       with --shard\n");
+    haveGoodArgs = false;
+  }
+  if (numShards > 0 && printEdges) {
+    // node ids are numbered from the start of the run
+    if (haveGoodArgs)
+      fprintf(stderr, "\n");
+    fprintf(stderr, "ERROR: cannot use --shard with --edges\n");
+    haveGoodArgs = false;
+  }
+  if (engine == ENGINE_BACKWARD && printEdges) {
+    // the backward engine only simulates the parts of the meioses that reach
+    // the printed samples
+    if (haveGoodArgs)
+      fprintf(stderr, "\n");
+    fprintf(stderr, "ERROR: cannot use --engine backward with --edges\n");
+    haveGoodArgs = false;
+  }
+  if (numShards > 0 && popSize > 0) {
+    // the population is one replicate
+    if (haveGoodArgs)
+      fprintf(stderr, "\n");
+    fprintf(stderr, "ERROR: cannot use --shard with --pop\n");
+    haveGoodArgs = false;
+  }
+  if (dryRun && plan) {
+    if (haveGoodArgs)
+      fprintf(stderr, "\n");
+    fprintf(stderr, "ERROR: can only use one of --dry_run and --plan\n");
     haveGoodArgs = false;
   }
   if (!poisson && !interfereFile && !fixedCOfile) {
@@ -291,6 +622,13 @@ bool CmdLineOpts::parseCmdLineOptions(int argc, char **argv) {
     haveGoodArgs = false;
   }
 
+  if (renderFile && inVCFfile == NULL) {
+    if (haveGoodArgs)
+      fprintf(stderr, "\n");
+    fprintf(stderr, "ERROR: --renders requires an input VCF (-i)\n");
+    haveGoodArgs = false;
+  }
+
   if (chrX == NULL && haveGoodArgs) {
     chrX = new char[2];
     if (chrX == NULL) {
@@ -305,6 +643,9 @@ bool CmdLineOpts::parseCmdLineOptions(int argc, char **argv) {
     printFam = 1;
   }
 
+  if (progressJSONfile && progressInterval == 0)
+    progressInterval = 10; // seconds
+
   if (!haveGoodArgs) {
     printUsage(stderr, argv[0]);
   }
@@ -322,6 +663,10 @@ void CmdLineOpts::printUsage(FILE *out, char *programName) {
   fprintf(out, "\n");
   fprintf(out, "REQUIRED ARGUMENTS:\n");
   fprintf(out, "  -d <filename>\t\tdef file describing pedigree structures to simulate\n");
+  fprintf(out, "   (or --in_fam <filename>  PLINK fam file of pedigrees to simulate, one\n");
+  fprintf(out, "\t\t\t  replicate per family; see README.md)\n");
+  fprintf(out, "   (or --pop <#>\t  random population pedigree with <#> individuals per\n");
+  fprintf(out, "\t\t\t  generation; options below)\n");
   fprintf(out, "  -m <filename>\t\tgenetic map file containing either a sex averaged map\n");
   fprintf(out, "\t\t\t  or both male and female maps (format in README.md)\n");
   fprintf(out, "  -o <prefix>\t\toutput prefix (creates <prefix>.vcf, <prefix>.bp, etc.)\n");
@@ -347,10 +692,46 @@ void CmdLineOpts::printUsage(FILE *out, char *programName) {
   fprintf(out, "  --fam\t\t\tprint PLINK fam file (see README.md before use)\n");
   fprintf(out, "  --bp\t\t\tprint BP file (complete haplotype transmission info)\n");
   fprintf(out, "  --mcra\t\tprint MRCA file (founder each IBD segment coalesces in)\n");
+  fprintf(out, "  --edges\t\tprint node and edge tables of the transmissions in tskit's\n");
+  fprintf(out, "\t\t\t  text format (see README.md)\n");
   fprintf(out, "  --nogz\t\talways print uncompressed VCF files\n");
   fprintf(out, "\n");
   fprintf(out, "  --dry_run\t\toutput only a fam file with one replicate per pedigree:\n");
+  fprintf(out, "  --plan\t\testimate the work, memory, output size, and time of the\n");
+  fprintf(out, "\t\t\t  run (from a few replicates) and exit\n");
+  fprintf(out, "  --max_mem <size>\tkeep memory use under <size> (e.g., 8G), lowering it\n");
+  fprintf(out, "\t\t\t  as needed or stopping with an error (see README.md)\n");
   fprintf(out, "  --seed <#>\t\tspecify random seed\n");
+  fprintf(out, "  --engine <name>\tforward (default) or backward: simulate only what the\n");
+  fprintf(out, "\t\t\t  printed samples inherit (faster for deep pedigrees)\n");
+  fprintf(out, "  --threads <#>\t\tnumber of threads used to print output files\n");
+  fprintf(out, "\t\t\t  (default 0: print all output files concurrently)\n");
+  fprintf(out, "  --server <path>\tread the map, etc. once, then run jobs received on the\n");
+  fprintf(out, "\t\t\t  Unix socket <path> (or stdin for -) on --threads threads\n");
+  fprintf(out, "\t\t\t  (protocol in README.md; -d and -o not used)\n");
+  fprintf(out, "  --batch <filename>\trun the jobs listed in <filename> (def file, seed, and\n");
+  fprintf(out, "\t\t\t  output prefix per line) on --threads threads\n");
+  fprintf(out, "\t\t\t  (format in README.md; -d and -o not used)\n");
+  fprintf(out, "  --shard <i>/<N>\tsimulate only part <i> of <N> of the replicates, for\n");
+  fprintf(out, "\t\t\t  merging with merge-shards.py (see README.md)\n");
+  fprintf(out, "  --timing\t\tprint the time and peak memory of each phase to the log\n");
+  fprintf(out, "  --timing_json <filename>  also print these to <filename> as JSON\n");
+  fprintf(out, "  --perf\t\twith --timing, also count cycles, instructions, and cache\n");
+  fprintf(out, "\t\t\t  and branch misses in each phase (Linux only)\n");
+  fprintf(out, "  --trace <filename>\tprint a timeline of the work on each thread to\n");
+  fprintf(out, "\t\t\t  <filename> in Chrome trace event format\n");
+  fprintf(out, "  --progress <#>\tprint progress, rates, and time remaining to stderr\n");
+  fprintf(out, "\t\t\t  and the log every <#> seconds\n");
+  fprintf(out, "  --progress_json <filename>  also keep the latest progress in <filename>\n");
+  fprintf(out, "\t\t\t  as JSON (default interval 10 seconds)\n");
+  fprintf(out, "\n");
+  fprintf(out, " USED WITH --pop:\n");
+  fprintf(out, "  --pop_gens <#>\tnumber of generations (default 10)\n");
+  fprintf(out, "  --pop_sample <#>\tnumber of individuals in the last generation to print\n");
+  fprintf(out, "\t\t\t  (default 0: all)\n");
+  fprintf(out, "  --pop_monogamy <#>\tfraction of individuals whose parents are a couple\n");
+  fprintf(out, "\t\t\t  (default 1)\n");
+  fprintf(out, "  --pop_var <#>\t\tvariance in the number of offspring (default 2: Poisson)\n");
   fprintf(out, "\n");
   fprintf(out, " USED WITH -i:\n");
   fprintf(out, "  --err_rate <#>\tgenotyping error rate (default 1e-3; 0 disables)\n");
@@ -363,6 +744,15 @@ void CmdLineOpts::printUsage(FILE *out, char *programName) {
   fprintf(out, "\n");
   fprintf(out, "  --founder_ids\t\tprint ids of founders to output file <prefix>.ids\n");
   fprintf(out, "\n");
+  fprintf(out, "  --renders <filename>\tgenerate several output VCFs in one pass over the input\n");
+  fprintf(out, "\t\t\t  each line names an output <prefix>-<name>.vcf and can set\n");
+  fprintf(out, "\t\t\t  seed, err_rate, err_hom_rate, miss_rate, or pseudo_hap\n");
+  fprintf(out, "\t\t\t  (format in README.md)\n");
+  fprintf(out, "\n");
+  fprintf(out, "  --checkpoint <#>\tsave the state of VCF generation to <prefix>.ckpt every\n");
+  fprintf(out, "\t\t\t  <#> records (default 0: never)\n");
+  fprintf(out, "  --resume\t\tcontinue an interrupted run from <prefix>.ckpt\n");
+  fprintf(out, "\n");
   fprintf(out, "  --retain_extra <#>\toutput samples not used as founders to VCF file\n");
   fprintf(out, "\t\t\t  numeric argument indicates number to retain\n");
   fprintf(out, "\t\t\t  a negative argument will retain all unused samples\n");
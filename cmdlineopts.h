@@ -10,6 +10,125 @@
 #define VERSION_NUMBER	"1.4"
 #define RELEASE_DATE	"20 Jan 2022"
 
+// Values of CmdLineOpts::engine
+enum SimEngine { ENGINE_FORWARD, ENGINE_BACKWARD };
+
+// The options, each as FIELD(type, name, default value). The thread-local
+// fields of CmdLineOpts, their definitions, the members of Settings, and get()
+// and set() are all generated from this list, so that a new option need only
+// be added here
+#define CMDLINEOPTS_FIELDS(FIELD)                                            \
+  /* Def file */                                                             \
+  FIELD(char *, defFile, NULL)                                               \
+  /* PLINK fam file with pedigrees to simulate in place of a def file */     \
+  FIELD(char *, inFamFile, NULL)                                             \
+  /* Generate a random population pedigree in place of a def file, with      \
+     <popSize> individuals in each of <popGens> generations, printing        \
+     <popSample> from the last one (0 for all); <popMonogamy> is the fraction \
+     of individuals whose parents are a couple and <popVar> the variance in  \
+     offspring number (see genPopulation() in population.cc). <popSize> is 0 \
+     if not in use. */                                                       \
+  FIELD(int, popSize, 0)                                                     \
+  FIELD(int, popGens, 10)                                                    \
+  FIELD(int, popSample, 0)                                                   \
+  FIELD(double, popMonogamy, 1.0)                                            \
+  FIELD(double, popVar, 2.0)                                                 \
+  /* Genetic map file */                                                     \
+  FIELD(char *, mapFile, NULL)                                               \
+  /* Interference parameters file */                                         \
+  FIELD(char *, interfereFile, NULL)                                         \
+  /* Input VCF file */                                                       \
+  FIELD(char *, inVCFfile, NULL)                                             \
+  /* Output filename prefix */                                               \
+  FIELD(char *, outPrefix, NULL)                                             \
+  /* Founder order file */                                                   \
+  FIELD(char *, founderOrderFile, NULL)                                      \
+  /* Number of threads to use to print the output files; 0 means one per     \
+     output stage */                                                         \
+  FIELD(int, numThreads, 0)                                                  \
+  /* File listing the output VCFs to generate in one pass over the input     \
+     (see RenderSpec in bpvcffam.h) */                                       \
+  FIELD(char *, renderFile, NULL)                                            \
+  /* Run as a server (see server.cc) reading jobs from this Unix domain      \
+     socket path, or stdin if "-" */                                         \
+  FIELD(char *, serverPath, NULL)                                            \
+  /* Manifest of jobs to run in one process (see runBatch() in jobs.cc) */   \
+  FIELD(char *, batchFile, NULL)                                             \
+  /* With --shard <i>/<N>, simulate only shard <shardIdx> (1-based) of       \
+     <numShards>; <numShards> is 0 for a standard run (see simulate()) */    \
+  FIELD(int, shardIdx, 0)                                                    \
+  FIELD(int, numShards, 0)                                                   \
+  /* Save the state of VCF generation every <checkpointInterval> records (0  \
+     disables); with <resume>, continue from the last checkpoint (see        \
+     VCFCheckpoint in checkpoint.h) */                                       \
+  FIELD(long, checkpointInterval, 0)                                         \
+  FIELD(int, resume, 0)                                                      \
+  /* Print the time, memory, and work counts of each phase to the log? With  \
+     <timingJSONfile>, also print them to that file (see PhaseTimer in       \
+     phasetimer.h) */                                                        \
+  FIELD(int, printTiming, 0)                                                 \
+  FIELD(char *, timingJSONfile, NULL)                                        \
+  /* Count hardware events (cycles, cache misses, etc.) in each phase too? */ \
+  FIELD(int, perfCounters, 0)                                                \
+  /* Print a timeline of events on each thread to this file (see trace.h) */ \
+  FIELD(char *, traceFile, NULL)                                             \
+  /* Report progress every <progressInterval> seconds (0 disables)? With     \
+     <progressJSONfile>, also rewrite that file each time (see Progress in   \
+     progress.h) */                                                          \
+  FIELD(double, progressInterval, 0)                                         \
+  FIELD(char *, progressJSONfile, NULL)                                      \
+  /* Should we seed the random number generator using std::random_device()?  \
+     If false, will use user-supplied value below */                         \
+  FIELD(bool, autoSeed, true)                                                \
+  /* User-supplied random seed OR set to the automatically generated seed    \
+     later */                                                                \
+  FIELD(unsigned int, randSeed, 0)                                           \
+  /* Dry run? Only prints a fam file with one replicate per pedigee and      \
+     outputs the number of founders needed to simulate genetic data */       \
+  FIELD(int, dryRun, 0)                                                      \
+  /* Estimate the work, peak memory, output size, and time of the run        \
+     without running it? (see printPlan() in plan.h) */                      \
+  FIELD(int, plan, 0)                                                        \
+  /* Memory budget in bytes for --max_mem (0 for none; see MemBudget in      \
+     membudget.h) */                                                         \
+  FIELD(long, maxMem, 0)                                                     \
+  /* Print the fam file? */                                                  \
+  FIELD(int, printFam, 0)                                                    \
+  /* Print the bp file? */                                                   \
+  FIELD(int, printBP, 0)                                                     \
+  /* Print the MRCA of segments? */                                          \
+  FIELD(int, printMRCA, 0)                                                   \
+  /* Print the transmissions as node and edge tables (see EdgeTable)? */     \
+  FIELD(int, printEdges, 0)                                                  \
+  /* How to simulate the non-founders: forward through the pedigree          \
+     (ENGINE_FORWARD), or by tracing only what the printed samples inherit   \
+     back through it (ENGINE_BACKWARD; see traceAncestry() in backward.h) */ \
+  FIELD(int, engine, ENGINE_FORWARD)                                         \
+  /* Always output uncompressed VCFs? */                                     \
+  FIELD(int, nogz, 0)                                                        \
+  /* Rate of genotyping error */                                             \
+  FIELD(double, genoErrRate, 1e-3)                                           \
+  /* Rate of opposite homozygous genotyping errors */                        \
+  FIELD(double, homErrRate, 0)                                               \
+  /* Rate of missingness. Mutually exclusive with pseudoHapRate */           \
+  FIELD(double, missRate, 1e-3)                                              \
+  /* Rate of pseudo-haploid-ity. Mutually exclusive with missRate */         \
+  FIELD(double, pseudoHapRate, 0.0)                                          \
+  /* Keep phase information in output VCF? */                                \
+  FIELD(int, keepPhase, 0)                                                   \
+  /* Retain input samples not used to simulate? If -1, will retain all       \
+     samples not used for simulations. Otherwise, will retain the indicated  \
+     number of samples */                                                    \
+  FIELD(int, retainExtra, 0)                                                 \
+  /* Print the original ids of the founders? */                              \
+  FIELD(int, printFounderIds, 0)                                             \
+  /* Fixed COs input file */                                                 \
+  FIELD(char *, fixedCOfile, NULL)                                           \
+  /* Name of the X chromosome */                                             \
+  FIELD(char *, chrX, NULL)                                                  \
+  /* File with sexes of input VCF samples */                                 \
+  FIELD(char *, vcfSexesFile, NULL)
+
 class CmdLineOpts {
   public:
     //////////////////////////////////////////////////////////////////
@@ -19,83 +138,29 @@ class CmdLineOpts {
     static bool parseCmdLineOptions(int argc, char **argv);
     static void printUsage(FILE *out, char *programName);
 
+    // The fields below are thread-local so that library users (see pedsim.h)
+    // can run simulations with different settings on different threads.
+    // Settings holds a copy of all of them, and get() and set() copy the
+    // calling thread's values out of or into one.
+    struct Settings;
+    static Settings get();
+    static void set(const Settings &settings);
+
     //////////////////////////////////////////////////////////////////
-    // public static fields : variables set by command-line options
+    // public static fields : variables set by command-line options (see
+    // CMDLINEOPTS_FIELDS above for their descriptions)
     //////////////////////////////////////////////////////////////////
 
-    // Def file
-    static char *defFile;
-
-    // Genetic map file
-    static char *mapFile;
-
-    // Interference parameters file
-    static char *interfereFile;
-
-    // Input VCF file
-    static char *inVCFfile;
-
-    // Output filename prefix
-    static char *outPrefix;
-
-    // Founder order file
-    static char *founderOrderFile;
-
-    // Should we seed the random number generator using std::random_device()?
-    // If false, will use user-supplied value below
-    static bool autoSeed;
-
-    // User-supplied random seed OR set to the automatically generated seed
-    // later
-    static unsigned int randSeed;
-
-    // Dry run? Only prints a fam file with one replicate per pedigee and
-    // outputs the number of founders needed to simulate genetic data
-    static int dryRun;
-
-    // Print the fam file?
-    static int printFam;
-
-    // Print the bp file?
-    static int printBP; 
-
-    // Print the MRCA of segments?
-    static int printMRCA;
-
-    // Always output uncompressed VCFs?
-    static int nogz;
-
-    // Rate of genotyping error
-    static double genoErrRate;
-
-    // Rate of opposite homozygous genotyping errors
-    static double homErrRate;
-
-    // Rate of missingness. Mutually exclusive with pseudoHapRate
-    static double missRate;
-
-    // Rate of pseudo-haploid-ity. Mutually exclusive with missRate
-    static double pseudoHapRate;
-    
-    // Keep phase information in output VCF?
-    static int keepPhase;
-
-    // Retain input samples not used to simulate? If -1, will retain all
-    // samples not used for simulations. Otherwise, will retain the indicated
-    // number of samples
-    static int retainExtra;
-
-    // Print the original ids of the founders?
-    static int printFounderIds;
-
-    // Fixed COs input file
-    static char *fixedCOfile;
-
-    // Name of the X chromosome
-    static char *chrX;
+#define CMDLINEOPTS_DECLARE(type, name, init) static thread_local type name;
+    CMDLINEOPTS_FIELDS(CMDLINEOPTS_DECLARE)
+#undef CMDLINEOPTS_DECLARE
+};
 
-    // File with sexes of input VCF samples
-    static char *vcfSexesFile;
+// Copy of the (thread-local) fields of CmdLineOpts; see above
+struct CmdLineOpts::Settings {
+#define CMDLINEOPTS_MEMBER(type, name, init) type name;
+  CMDLINEOPTS_FIELDS(CMDLINEOPTS_MEMBER)
+#undef CMDLINEOPTS_MEMBER
 };
 
 #endif // CMDOPTIONS_H
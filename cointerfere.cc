@@ -10,6 +10,7 @@
 #include <random>
 #include <algorithm>
 #include "cointerfere.h"
+#include "runerror.h"
 
 // Note: we don't use GSL version of gamma cdf to reduce library dependencies,
 // but it is almost 2x faster than boost
@@ -61,21 +62,21 @@ void COInterfere::read(vector<COInterfere> &coIntf, char *interfereFile,
 		       GeneticMap &map, bool &sexSpecificMaps) {
   if (!sexSpecificMaps) {
     fprintf(stderr, "ERROR: Must use sex specific genetic maps in order to simulate with interference\n");
-    exit(6);
+    fatalExit(6);
   }
 
   size_t bytesRead = 1024;
   char *buffer = (char *) malloc(bytesRead + 1);
   if (buffer == NULL) {
     printf("ERROR: out of memory");
-    exit(5);
+    fatalExit(5);
   }
   const char *delim = " \t\n";
 
   FILE *in = fopen(interfereFile, "r");
   if (!in) {
     printf("ERROR: could not open interference file %s!\n", interfereFile);
-    exit(1);
+    fatalExit(1);
   }
 
   // Which chromosome index (into <map>) are we on? This allows us to ensure
@@ -97,7 +98,7 @@ void COInterfere::read(vector<COInterfere> &coIntf, char *interfereFile,
       fprintf(stderr, "ERROR: read chrom %s from interference file, but last genetic map chromosome\n",
 	      chrom);
       fprintf(stderr, "       is %s\n", map.chromName(chrIdx - 1));
-      exit(5);
+      fatalExit(5);
     }
 
     // read remaining tokens:
@@ -112,7 +113,7 @@ void COInterfere::read(vector<COInterfere> &coIntf, char *interfereFile,
 		chrom, (i == 0) ? "male" : "female");
 	if (errno != 0)
 	  perror("strtod");
-	exit(5);
+	fatalExit(5);
       }
       p[i] = strtod(pStr[i], &endptr);
       if (errno != 0 || *endptr != '\0') {
@@ -120,7 +121,7 @@ void COInterfere::read(vector<COInterfere> &coIntf, char *interfereFile,
 		chrom, (i == 0) ? "male" : "female");
 	if (errno != 0)
 	  perror("strtod");
-	exit(5);
+	fatalExit(5);
       }
     }
 
@@ -128,14 +129,14 @@ void COInterfere::read(vector<COInterfere> &coIntf, char *interfereFile,
     if ((tok = strtok_r(NULL, delim, &saveptr)) != NULL) {
       fprintf(stderr, "ERROR: read extra token %s in interference file (chrom %s)\n",
 	      tok, chrom);
-      exit(5);
+      fatalExit(5);
     }
 
     if (strcmp(chrom, map.chromName(chrIdx)) != 0) {
       fprintf(stderr, "ERROR: order of interference chromosomes different from genetic map:\n");
       fprintf(stderr, "       expected chromosome %s in interference file, read %s\n",
 	      map.chromName(chrIdx), chrom);
-      exit(10);
+      fatalExit(10);
     }
 
     // Get the genetic lengths of the male and female maps for this chromosome
@@ -149,7 +150,7 @@ void COInterfere::read(vector<COInterfere> &coIntf, char *interfereFile,
   if (chrIdx != map.size()) {
     fprintf(stderr, "ERROR: read %u chromosomes from interference file, but genetic map has %lu\n",
 	    chrIdx, map.size());
-    exit(5);
+    fatalExit(5);
   }
 
   free(buffer);
@@ -9,6 +9,7 @@
 #include <limits.h>
 #include <assert.h>
 #include <stdint.h>
+#include "runerror.h"
 
 #ifndef DATASTRUCTS_H
 #define DATASTRUCTS_H
@@ -40,6 +41,8 @@ struct SexConstraint {
   // The constraints are always assigned in pairs, with the first index (even
   // number) being of one sex, and the next index (odd number) being the
   // being the opposite sex.
+  // (While readDef() reads a pedigree, this is instead a node index; see
+  // SpouseDependencies in readdef.h.)
   int set;
   // if any member of a constraint set is assigned a sex, all members must
   // have that sex assigned, and the linked constraint set will have the
@@ -67,9 +70,14 @@ struct SimDetails {
     name = new char[ strlen(theName) + 1 ];
     if (name == NULL) {
       printf("ERROR: out of memory");
-      exit(5);
+      fatalExit(5);
     }
     strcpy(name, theName);
+    firstRep = 0;
+    hapNumShift = 0;
+    sampleIds = NULL;
+    sharesWith = -1;
+    setShift = 0;
   }
   SimDetails(const SimDetails &other) {
     numReps = other.numReps;
@@ -83,13 +91,18 @@ struct SimDetails {
     name = new char[ strlen(other.name) + 1 ];
     if (name == NULL) {
       printf("ERROR: out of memory");
-      exit(5);
+      fatalExit(5);
     }
     strcpy(name, other.name);
 
     founderOffset = other.founderOffset;
     numFounders = other.numFounders;
     founderIdSuffix = other.founderIdSuffix;
+    firstRep = other.firstRep;
+    hapNumShift = other.hapNumShift;
+    sampleIds = other.sampleIds;
+    sharesWith = other.sharesWith;
+    setShift = other.setShift;
   }
   ~SimDetails() {
     delete [] name;
@@ -112,6 +125,26 @@ struct SimDetails {
   int founderOffset;
   int numFounders;
   vector<char *> founderIdSuffix;
+
+  // With --shard, only replicates <firstRep> through <firstRep> + <numReps>
+  // - 1 are simulated. Sample ids number the replicates from <firstRep> + 1,
+  // and the .bp file adds <hapNumShift> to the founder haplotype numbers so
+  // that both match an unsharded run. Both are 0 otherwise.
+  int firstRep;
+  int hapNumShift;
+
+  // For pedigrees read from a fam file (see readFam()), the id of the one
+  // person in each generation and branch, which replaces the g-b-i suffix of
+  // sample ids; NULL for def file pedigrees
+  char ***sampleIds;
+
+  // Def file entries with the same structure share the arrays above, along
+  // with <founderIdSuffix> (see shareStructures() in readdef.cc).
+  // <sharesWith> is the index of the earlier entry that owns them (-1 if this
+  // one does), and <setShift> is added to the constraint set indexes in
+  // <sexConstraints> to give this entry's (see SexConstraint).
+  int sharesWith;
+  int setShift;
 };
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -134,9 +167,18 @@ struct Person {
     sex = 0;
     // by default assume not using fixed COs
     fixedCOidxs[0] = fixedCOidxs[1] = UINT_MAX;
+    packed = NULL;
+    packedLen = 0;
   }
   int sex;
-  vector<Haplotype> haps[2]; // haplotype pair for <this>
+  // haplotype pair for <this>; once its replicate is simulated, simulate()
+  // packs these into <packed> and empties them (see packedhaps.h)
+  vector<Haplotype> haps[2];
+  // <packedLen> bytes in a block that holds the packed haplotypes of the
+  // whole replicate; the replicate's first Person (generation 0, branch 0,
+  // index 0) points to its start and deleteTheSamples() frees it from there
+  uint8_t *packed;
+  uint32_t packedLen;
   unsigned int fixedCOidxs[2];
 };
 
@@ -0,0 +1,140 @@
+// ped-sim: pedigree simulation tool
+//
+// This program is distributed under the terms of the GNU General Public License
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <assert.h>
+#include "edgetable.h"
+#include "bpvcffam.h"
+#include "fileorgz.h"
+#include "simulate.h"
+#include "pedcosts.h"
+#include "runerror.h"
+
+thread_local EdgeTable *EdgeTable::cur = NULL;
+
+// Nodes are numbered in the order the fam file lists individuals (by pedigree,
+// replicate, generation, branch, and individual), with the node of haplotype h
+// of individual number i being 2*i + h. Times are in generations before the
+// last generation of the pedigree, and the nodes of the individuals in printed
+// branches are samples. The edges give the inherited stretches as half-open
+// intervals [left, right) of physical positions, with a column for the
+// chromosome name that tskit ignores.
+void EdgeTable::print(vector<SimDetails> &simDetails, Person *****theSamples,
+		      GeneticMap &map, const char *nodesFile,
+		      const char *edgesFile, bool append) {
+  FileOrGZ<FILE *> nodesOut, edgesOut;
+  const char *files[2] = { nodesFile, edgesFile };
+  FileOrGZ<FILE *> *outs[2] = { &nodesOut, &edgesOut };
+  for(int f = 0; f < 2; f++) {
+    bool success = outs[f]->open(files[f], append ? "a" : "w");
+    if (!success) {
+      fprintf(stderr, "ERROR: could not open output file %s!\n", files[f]);
+      perror("open");
+      fatalExit(1);
+    }
+  }
+  if (!append) {
+    nodesOut.printf("id\tis_sample\ttime\tname\thap\n");
+    edgesOut.printf("left\tright\tparent\tchild\tchrom\n");
+  }
+
+  // For each pedigree, the number of the first individual in its first
+  // replicate, the number in each replicate, and the index within a replicate
+  // of the first individual in each branch
+  vector<long> pedFirst(simDetails.size());
+  vector<int> repPersons(simDetails.size());
+  vector< vector< vector<int> > > branchFirst(simDetails.size());
+
+  long curPerson = nextNode / 2;
+  for(unsigned int ped = 0; ped < simDetails.size(); ped++) {
+    int numReps = simDetails[ped].numReps;
+    int numGen = simDetails[ped].numGen;
+    int **numSampsToPrint = simDetails[ped].numSampsToPrint;
+    int *numBranches = simDetails[ped].numBranches;
+    Parent **branchParents = simDetails[ped].branchParents;
+    int **branchNumSpouses = simDetails[ped].branchNumSpouses;
+    long pedStartBytes = nodesOut.printed();
+
+    pedFirst[ped] = curPerson;
+    branchFirst[ped].resize(numGen);
+    int numInRep = 0;
+    for(int gen = 0; gen < numGen; gen++) {
+      for(int branch = 0; branch < numBranches[gen]; branch++) {
+	int numNonFounders, numFounders;
+	getPersonCounts(gen, numGen, branch, numSampsToPrint, branchParents,
+			branchNumSpouses, numFounders, numNonFounders);
+	branchFirst[ped][gen].push_back(numInRep);
+	numInRep += numFounders + numNonFounders;
+      }
+    }
+    repPersons[ped] = numInRep;
+
+    for(int rep = 0; rep < numReps; rep++) {
+      for(int gen = 0; gen < numGen; gen++) {
+	for(int branch = 0; branch < numBranches[gen]; branch++) {
+	  int numNonFounders, numFounders;
+	  getPersonCounts(gen, numGen, branch, numSampsToPrint, branchParents,
+			  branchNumSpouses, numFounders, numNonFounders);
+	  int numPersons = numNonFounders + numFounders;
+	  int isSample = numSampsToPrint[gen][branch] > 0;
+
+	  for(int ind = 0; ind < numPersons; ind++) {
+	    for(int h = 0; h < 2; h++) {
+	      nodesOut.printf("%ld\t%d\t%d\t", 2 * curPerson + h, isSample,
+			      numGen - 1 - gen);
+	      printSampleId(&nodesOut, simDetails[ped], rep, gen, branch, ind,
+			    /*printAllGens=*/ true);
+	      nodesOut.printf("\t%d\n", h);
+	    }
+	    curPerson++;
+	  }
+	}
+      }
+    }
+    PedCosts::add(ped, PED_OUT_BYTES, nodesOut.printed() - pedStartBytes);
+  }
+  nextNode = 2 * curPerson;
+
+  for(unsigned int t = 0; t < transmissions.size(); t++) {
+    Transmission &trans = transmissions[t];
+    long repFirst = pedFirst[trans.ped] +
+				  (long) trans.rep * repPersons[trans.ped];
+    long child = 2 * (repFirst + branchFirst[trans.ped][trans.gen][trans.branch]
+			+ trans.ind) + trans.hap;
+    long parent = 2 * (repFirst +
+		       branchFirst[trans.ped][trans.parGen][trans.parBranch] +
+		       trans.parInd);
+    unsigned int lastEdge = (t + 1 < transmissions.size()) ?
+			      transmissions[t + 1].firstEdge : edges.size();
+    long startBytes = edgesOut.printed();
+    for(unsigned int e = trans.firstEdge; e < lastEdge; e++)
+      edgesOut.printf("%d\t%d\t%ld\t%ld\t%s\n", edges[e].left,
+		      edges[e].right + 1, parent + edges[e].parentHap, child,
+		      map.chromName(trans.chrIdx));
+    PedCosts::add(trans.ped, PED_OUT_BYTES, edgesOut.printed() - startBytes);
+  }
+
+  nodesOut.close();
+  edgesOut.close();
+
+  // done with these
+  MemBudget::release(MEM_EDGES,
+		     transmissions.capacity() * sizeof(Transmission) +
+		     edges.capacity() * sizeof(Edge));
+  vector<Transmission>().swap(transmissions);
+  vector<Edge>().swap(edges);
+}
+
+void EdgeTable::usage(vector<double> &pedEdges,
+		      vector<double> &pedBytes) const {
+  for(unsigned int t = 0; t < transmissions.size(); t++) {
+    unsigned int ped = transmissions[t].ped;
+    unsigned int lastEdge = (t + 1 < transmissions.size()) ?
+			      transmissions[t + 1].firstEdge : edges.size();
+    double numEdges = lastEdge - transmissions[t].firstEdge;
+    pedEdges[ped] += numEdges;
+    pedBytes[ped] += sizeof(Transmission) + numEdges * sizeof(Edge);
+  }
+}
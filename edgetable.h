@@ -0,0 +1,123 @@
+// ped-sim: pedigree simulation tool
+//
+// This program is distributed under the terms of the GNU General Public License
+
+#include <stdint.h>
+#include <vector>
+#include "datastructs.h"
+#include "geneticmap.h"
+#include "membudget.h"
+
+#ifndef EDGETABLE_H
+#define EDGETABLE_H
+
+using namespace std;
+
+////////////////////////////////////////////////////////////////////////////////
+// For --edges: records each haplotype transmission that simulate() makes as
+// edges -- the stretches of the child's haplotype copied from one of the
+// parent's two haplotypes -- and prints these along with a table of nodes (one
+// per haplotype of every simulated individual) in the text formats that
+// tskit.load_text() reads. Unlike the bp file, which lists the founder
+// haplotype segments of every printed individual, these store only where the
+// crossovers in each meiosis are, so their size doesn't grow with the depth of
+// the pedigree. Unless record() has been called on this thread, beginHap() and
+// add() are a test of one pointer.
+class EdgeTable {
+  public:
+    EdgeTable() : nextNode(0) { }
+
+    // Records the transmissions simulate() makes on this thread in <table>
+    // from now on (or stops recording if <table> is NULL)
+    static void record(EdgeTable *table) { cur = table; }
+    static bool active() { return cur != NULL; }
+    // Numbers the nodes printed next from <node>
+    void setNextNode(long node) { nextNode = node; }
+
+    // Starts a transmitted haplotype: <hap> of the given individual on
+    // chromosome <chrIdx>, inherited from the individual at index <parIdx> in
+    // branch <parent> of the same replicate
+    static void beginHap(unsigned int ped, int rep, int gen, int branch,
+			 int ind, int hap, Parent parent, int parIdx,
+			 unsigned int chrIdx) {
+      if (cur) {
+	size_t oldCap = cur->transmissions.capacity();
+	cur->transmissions.emplace_back();
+	if (cur->transmissions.capacity() != oldCap)
+	  MemBudget::add(MEM_EDGES, (cur->transmissions.capacity() - oldCap) *
+						      sizeof(Transmission));
+	Transmission &trans = cur->transmissions.back();
+	trans.ped = ped;
+	trans.rep = rep;
+	trans.gen = gen;
+	trans.branch = branch;
+	trans.ind = ind;
+	trans.hap = hap;
+	trans.parGen = parent.gen;
+	trans.parBranch = parent.branch;
+	trans.parInd = parIdx;
+	trans.chrIdx = chrIdx;
+	trans.firstEdge = cur->edges.size();
+      }
+    }
+
+    // Adds the positions <left> through <right> (inclusive) of the current
+    // haplotype, copied from the parent's haplotype <parentHap>
+    static void add(int left, int right, int parentHap) {
+      if (cur)
+	cur->addEdge(left, right, parentHap);
+    }
+
+    // Prints the nodes and edges of the transmissions recorded since the last
+    // call to <nodesFile> and <edgesFile> (adding to the end of them if
+    // <append>), then frees them. Node ids continue from those printed in
+    // earlier calls.
+    void print(vector<SimDetails> &simDetails, Person *****theSamples,
+	       GeneticMap &map, const char *nodesFile, const char *edgesFile,
+	       bool append);
+
+    // For --plan: adds the number of edges recorded for each pedigree to
+    // <pedEdges> and the bytes of those edges and their transmissions to
+    // <pedBytes> (both indexed by pedigree)
+    void usage(vector<double> &pedEdges, vector<double> &pedBytes) const;
+
+  private:
+    struct Transmission {
+      unsigned int ped;
+      int rep;
+      int gen, branch, ind;
+      int8_t hap;
+      int parGen, parBranch, parInd;
+      unsigned int chrIdx;
+      // index of its first Edge; its last is just before that of the next
+      // Transmission
+      unsigned int firstEdge;
+    };
+    struct Edge {
+      int left, right; // inclusive
+      int8_t parentHap;
+    };
+
+    void addEdge(int left, int right, int parentHap) {
+      if (edges.size() > transmissions.back().firstEdge) {
+	Edge &last = edges.back();
+	if (last.right + 1 == left && last.parentHap == parentHap) {
+	  // two crossovers at the same position: continues the last edge
+	  last.right = right;
+	  return;
+	}
+      }
+      size_t oldCap = edges.capacity();
+      edges.push_back({ left, right, (int8_t) parentHap });
+      if (edges.capacity() != oldCap)
+	MemBudget::add(MEM_EDGES, (edges.capacity() - oldCap) * sizeof(Edge));
+    }
+
+    static thread_local EdgeTable *cur;
+
+    vector<Transmission> transmissions;
+    vector<Edge> edges;
+    long nextNode; // id of the next node to print
+};
+
+#endif // EDGETABLE_H
@@ -5,44 +5,111 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdarg.h>
+#include <string.h>
 #include <assert.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <type_traits>
 #include "fileorgz.h"
+#include "trace.h"
+#include "membudget.h"
+#include "progress.h"
+#include "runerror.h"
 
 template<typename IO_TYPE>
-void FileOrGZ<IO_TYPE>::alloc_buf() {
-  buf = (char *) malloc(INIT_SIZE);
+void FileOrGZ<IO_TYPE>::alloc_buf(size_t size) {
+  buf = (char *) malloc(size);
   if (buf == NULL) {
     fprintf(stderr, "ERROR: out of memory\n");
-    exit(1);
+    fatalExit(1);
   }
-  buf_size = INIT_SIZE;
+  buf_size = size;
   buf_len = 0;
+  if (writing)
+    MemBudget::add(MEM_OUT_BUFS, size);
+}
+
+// Objects still open (e.g., on an early return or an error) are closed; for
+// writing, this finishes the writes so that the writer thread can be joined.
+// Unlike close(), doesn't report write errors
+template<typename IO_TYPE>
+FileOrGZ<IO_TYPE>::~FileOrGZ() {
+  if (writing)
+    finish_writes();
+  free(buf);
+  if (fp)
+    close_fp();
+}
+
+// Frees the buffer allocated by a failed open()
+template<typename IO_TYPE>
+bool FileOrGZ<IO_TYPE>::open_failed() {
+  free(buf);
+  if (writing)
+    MemBudget::release(MEM_OUT_BUFS, buf_size);
+  buf = NULL;
+  buf_size = buf_len = 0;
+  writing = false;
+  return false;
 }
 
 // open <filename> using standard FILE *
 template<>
 bool FileOrGZ<FILE *>::open(const char *filename, const char *mode) {
+  writing = mode[0] == 'w' || mode[0] == 'a';
+  finished = false;
+  write_errno = 0;
+  handed_len = 0;
+
   // First allocate a buffer for I/O:
-  alloc_buf();
+  alloc_buf((writing) ? OUT_BUF_SIZE : INIT_SIZE);
 
   fp = fopen(filename, mode);
   if (!fp)
-    return false;
-  else
-    return true;
+    return open_failed();
+
+  if (writing) {
+    fd = fileno(fp);
+    num_out_bufs = 1;
+    writer = std::thread(&FileOrGZ<FILE *>::write_loop, this);
+  }
+  return true;
 }
 
 // open <filename> as a gzipped file
 template<>
 bool FileOrGZ<gzFile>::open(const char *filename, const char *mode) {
+  writing = mode[0] == 'w' || mode[0] == 'a';
+  finished = false;
+  write_errno = 0;
+  handed_len = 0;
+
   // First allocate a buffer for I/O:
-  alloc_buf();
+  alloc_buf((writing) ? OUT_BUF_SIZE : INIT_SIZE);
 
-  fp = gzopen(filename, mode);
-  if (!fp)
-    return false;
+  if (writing) {
+    // open the descriptor ourselves to be able to fsync() it in sync()
+    int flags = O_WRONLY | O_CREAT | ((mode[0] == 'a') ? O_APPEND : O_TRUNC);
+    fd = ::open(filename, flags, 0666);
+    if (fd < 0)
+      return open_failed();
+    fp = gzdopen(fd, mode);
+    if (!fp) {
+      ::close(fd);
+      return open_failed();
+    }
+  }
   else
-    return true;
+    fp = gzopen(filename, mode);
+  if (!fp)
+    return open_failed();
+
+  if (writing) {
+    num_out_bufs = 1;
+    writer = std::thread(&FileOrGZ<gzFile>::write_loop, this);
+  }
+  return true;
 }
 
 template<>
@@ -63,7 +130,7 @@ int FileOrGZ<gzFile>::getline() {
       char *tmp_buf = (char *) realloc(buf, buf_size + GROW);
       if (tmp_buf == NULL) {
 	fprintf(stderr, "ERROR: out of memory!\n");
-	exit(1);
+	fatalExit(1);
       }
       buf_size += GROW;
       buf = tmp_buf;
@@ -82,20 +149,10 @@ int FileOrGZ<gzFile>::getline() {
   return n_read;
 }
 
-template<>
-int FileOrGZ<FILE *>::printf(const char *format, ...) {
-  va_list args;
-  int ret;
-  va_start(args, format);
-
-  ret = vfprintf(fp, format, args);
-
-  va_end(args);
-  return ret;
-}
+template<typename IO_TYPE>
+int FileOrGZ<IO_TYPE>::printf(const char *format, ...) {
+  assert(writing);
 
-template<>
-int FileOrGZ<gzFile>::printf(const char *format, ...) {
   va_list args;
   va_list copy_args;
   int ret;
@@ -112,27 +169,25 @@ int FileOrGZ<gzFile>::printf(const char *format, ...) {
 //  ret = gzvprintf(fp, format, args);
   ret = vsnprintf(buf + buf_len, buf_size - buf_len, format, args);
   if (ret < 0) {
-    printf("ERROR: could not print\n");
+    ::printf("ERROR: could not print\n");
     perror("printf");
-    exit(10);
+    fatalExit(10);
   }
 
   if (buf_len + ret > buf_size - 1) {
     // didn't fit the text in buf
-    // first print what was in buf before the vsnprintf() call:
-    gzwrite(fp, buf, buf_len);
-    buf_len = 0;
+    // first queue what was in buf before the vsnprintf() call:
+    if (buf_len > 0)
+      hand_off(/*getEmpty=*/ true);
     // now ensure that redoing vsnprintf() will fit in buf:
     if ((size_t) ret > buf_size - 1) {
+      size_t new_size = buf_size;
       do { // find the buffer size that fits the last vsnprintf() call
-	buf_size += INIT_SIZE;
-      } while ((size_t) ret > buf_size - 1);
+	new_size += INIT_SIZE;
+      } while ((size_t) ret > new_size - 1);
       free(buf);
-      buf = (char *) malloc(buf_size);
-      if (buf == NULL) {
-	printf("ERROR: out of memory");
-	exit(5);
-      }
+      MemBudget::release(MEM_OUT_BUFS, buf_size);
+      alloc_buf(new_size);
     }
     // redo:
     ret = vsnprintf(buf + buf_len, buf_size - buf_len, format, copy_args);
@@ -141,8 +196,7 @@ int FileOrGZ<gzFile>::printf(const char *format, ...) {
   buf_len += ret;
   if (buf_len >= buf_size - 1024) { // within a tolerance of MAX_BUF?
     // flush:
-    gzwrite(fp, buf, buf_len);
-    buf_len = 0;
+    hand_off(/*getEmpty=*/ true);
   }
 
   va_end(args);
@@ -150,17 +204,214 @@ int FileOrGZ<gzFile>::printf(const char *format, ...) {
   return ret;
 }
 
+// Queues <buf> to be written by the background thread and, if <getEmpty>,
+// replaces it with an empty buffer, waiting for one to be written if
+// <maxOutBufs> are already in use
+template<typename IO_TYPE>
+void FileOrGZ<IO_TYPE>::hand_off(bool getEmpty) {
+  Progress::bytesOut(buf_len);
+  handed_len += buf_len;
+  std::unique_lock<std::mutex> lk(lock);
+  full.push_back({ buf, buf_size, buf_len });
+  cond.notify_all();
+
+  buf = NULL;
+  buf_size = buf_len = 0;
+  if (!getEmpty)
+    return;
+
+  if (write_errno != 0) {
+    lk.unlock();
+    write_failed();
+  }
+
+  if (empty.size() == 0 && num_out_bufs < maxOutBufs) {
+    num_out_bufs++;
+    lk.unlock();
+    alloc_buf(OUT_BUF_SIZE);
+    return;
+  }
+
+  if (empty.size() == 0) {
+    TraceScope event("wait for writer");
+    cond.wait(lk, [this]{ return empty.size() > 0; });
+  }
+  OutBuf next = empty.back();
+  empty.pop_back();
+  buf = next.data;
+  buf_size = next.size;
+  buf_len = 0;
+}
+
+// Background thread: writes the queued buffers in order until close()
+template<typename IO_TYPE>
+void FileOrGZ<IO_TYPE>::write_loop() {
+  Trace::nameThread("file writer");
+  std::unique_lock<std::mutex> lk(lock);
+  while (true) {
+    cond.wait(lk, [this]{ return full.size() > 0 || finished; });
+    if (full.size() == 0)
+      break; // finished and nothing left to write
+
+    OutBuf cur = full.front();
+    full.pop_front();
+    lk.unlock();
+
+    // after an error, skip the rest: the thread that owns the file reports it
+    int err = 0;
+    if (write_errno == 0) {
+      // gzFile compresses the block as it writes
+      TraceScope event(std::is_same<IO_TYPE, gzFile>::value ? "compress block"
+							    : "write block",
+		       "bytes", cur.len);
+      errno = 0;
+      if (!write_buf(cur.data, cur.len))
+	err = (errno != 0) ? errno : EIO;
+    }
+
+    lk.lock();
+    if (err != 0)
+      write_errno = err;
+    empty.push_back(cur);
+    cond.notify_all();
+  }
+}
+
+template<>
+bool FileOrGZ<FILE *>::write_buf(const char *data, size_t len) {
+  return fwrite(data, 1, len, fp) == len;
+}
+
 template<>
-int FileOrGZ<FILE *>::close() {
-  assert(buf_len == 0);
-  // should free buf, but I know the program is about to end, so won't
-  return fclose(fp);
+bool FileOrGZ<gzFile>::write_buf(const char *data, size_t len) {
+  return len == 0 || gzwrite(fp, data, len) == (int) len;
 }
 
 template<>
-int FileOrGZ<gzFile>::close() {
+long FileOrGZ<FILE *>::tell() {
+  return ftello(fp);
+}
+
+template<>
+long FileOrGZ<gzFile>::tell() {
+  return gztell(fp);
+}
+
+template<>
+bool FileOrGZ<FILE *>::seek(long offset) {
+  return fseeko(fp, offset, SEEK_SET) == 0;
+}
+
+template<>
+long FileOrGZ<FILE *>::rawOffset() {
+  return ftello(fp);
+}
+
+template<>
+long FileOrGZ<gzFile>::rawOffset() {
+  return gzoffset(fp);
+}
+
+// Note: zlib seeks forward by decompressing up to <offset>
+template<>
+bool FileOrGZ<gzFile>::seek(long offset) {
+  return gzseek(fp, offset, SEEK_SET) == offset;
+}
+
+// Queues the current buffer and waits until the writer thread has written all
+// the queued text
+template<typename IO_TYPE>
+void FileOrGZ<IO_TYPE>::wait_writes() {
   if (buf_len > 0)
-    gzwrite(fp, buf, buf_len);
-  // should free buf, but I know the program is about to end, so won't
-  return gzclose(fp);
+    hand_off(/*getEmpty=*/ true);
+  std::unique_lock<std::mutex> lk(lock);
+  TraceScope event("wait for writer");
+  // all buffers other than <buf> are back in <empty> once written
+  cond.wait(lk, [this]{ return (int) empty.size() == num_out_bufs - 1; });
+  if (write_errno != 0) {
+    lk.unlock();
+    write_failed();
+  }
 }
+
+template<>
+long FileOrGZ<FILE *>::sync() {
+  assert(writing);
+  wait_writes();
+  if (fflush(fp) != 0 || fsync(fd) != 0)
+    return -1;
+  return ftello(fp);
+}
+
+template<>
+long FileOrGZ<gzFile>::sync() {
+  assert(writing);
+  wait_writes();
+  if (gzflush(fp, Z_FINISH) != Z_OK || fsync(fd) != 0)
+    return -1;
+  return lseek(fd, 0, SEEK_CUR);
+}
+
+// Prints an error for a failed write and ends the run (see fatalExit())
+template<typename IO_TYPE>
+void FileOrGZ<IO_TYPE>::write_failed() {
+  fprintf(stderr, "\nERROR: could not write to output file: %s\n",
+	  strerror(write_errno));
+  fatalExit(10);
+}
+
+// Queues any remaining text, waits for the writer thread to write everything,
+// and frees the output buffers. Returns false if a write failed
+template<typename IO_TYPE>
+bool FileOrGZ<IO_TYPE>::finish_writes() {
+  hand_off(/*getEmpty=*/ false);
+  {
+    std::lock_guard<std::mutex> lk(lock);
+    finished = true;
+    cond.notify_all();
+  }
+  writer.join();
+
+  for(auto it = empty.begin(); it != empty.end(); it++) {
+    free(it->data);
+    MemBudget::release(MEM_OUT_BUFS, it->size);
+  }
+  empty.clear();
+  num_out_bufs = 0;
+  writing = false;
+  return write_errno == 0;
+}
+
+template<typename IO_TYPE>
+int FileOrGZ<IO_TYPE>::close() {
+  bool success = true;
+  if (writing)
+    success = finish_writes();
+  // input buffer (library users may read many files)
+  free(buf);
+  buf = NULL;
+  int ret = close_fp();
+  if (!success)
+    write_failed();
+  return ret;
+}
+
+template<>
+int FileOrGZ<FILE *>::close_fp() {
+  int ret = fclose(fp);
+  fp = NULL;
+  return ret;
+}
+
+template<>
+int FileOrGZ<gzFile>::close_fp() {
+  int ret = gzclose(fp);
+  fp = NULL;
+  return ret;
+}
+
+template<typename IO_TYPE>
+int FileOrGZ<IO_TYPE>::maxOutBufs = NUM_OUT_BUFS;
+
+template class FileOrGZ<FILE *>;
+template class FileOrGZ<gzFile>;
@@ -3,6 +3,12 @@
 // This program is distributed under the terms of the GNU General Public License
 
 #include <zlib.h>
+#include <stdio.h>
+#include <deque>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
 
 #ifndef FILEORGZ_H
 #define FILEORGZ_H
@@ -10,15 +16,47 @@
 template<typename IO_TYPE>
 class FileOrGZ {
   public:
+    FileOrGZ() : fp(NULL), fd(-1), buf(NULL), buf_size(0), buf_len(0),
+		 writing(false), handed_len(0), num_out_bufs(0),
+		 finished(false), write_errno(0) { }
+    ~FileOrGZ();
+
     bool open(const char *filename, const char *mode);
     int getline();
     int printf(const char *format, ...);
     int close();
 
+    // For checkpoints (see checkpoint.h). When reading: the (uncompressed)
+    // offset of the next line and moving to such an offset. When writing:
+    // writes all text printed so far to disk and returns the file's size; for
+    // gzFile, this ends the current gzip member, so the file is complete up
+    // to this point and later text goes in a new member
+    long tell();
+    bool seek(long offset);
+    long sync();
+
+    // When reading: the offset in the file as stored (for gzFile, in the
+    // compressed data) that reading has reached
+    long rawOffset();
+
+    // When writing: the number of bytes printed since open()
+    long printed() { return handed_len + buf_len; }
+
     static const int INIT_SIZE = 1024 * 50;
 
+    // Files opened for writing print to buffers of this size. Full buffers
+    // are handed to a background thread that writes (and, for gzFile,
+    // compresses) them, so the calling thread only waits on I/O when all
+    // NUM_OUT_BUFS buffers are queued
+    static const int OUT_BUF_SIZE = 1024 * 1024;
+    static const int NUM_OUT_BUFS = 4;
+    // Buffers each file may use: NUM_OUT_BUFS unless --max_mem lowers it
+    // (see chooseMemStrategy() in plan.h)
+    static int maxOutBufs;
+
     // IO_TYPE is either FILE* or gzFile;
     IO_TYPE fp;
+    int fd; // underlying file descriptor when writing (for sync())
 
     // for I/O:
     char *buf;
@@ -26,7 +64,33 @@ class FileOrGZ {
     size_t buf_len;
 
   private:
-    void alloc_buf();
+    struct OutBuf {
+      char *data;
+      size_t size;
+      size_t len;
+    };
+
+    void alloc_buf(size_t size);
+    bool open_failed();
+    void hand_off(bool getEmpty);
+    void write_loop();
+    void wait_writes();
+    bool write_buf(const char *data, size_t len);
+    bool finish_writes();
+    void write_failed();
+    int close_fp();
+
+    // for the background writer thread:
+    bool writing;
+    long handed_len;           // bytes in the buffers handed to the writer
+    std::thread writer;
+    std::mutex lock;
+    std::condition_variable cond;
+    std::deque<OutBuf> full;   // buffers waiting to be written, in order
+    std::vector<OutBuf> empty; // written buffers available for reuse
+    int num_out_bufs;          // number of buffers allocated
+    bool finished;             // set by close(): writer exits once done
+    int write_errno;           // set by the writer if a write fails
 };
 
 #endif // FILEORGZ_H
@@ -10,6 +10,7 @@
 #include <errno.h>
 #include <assert.h>
 #include "fixedcos.h"
+#include "runerror.h"
 
 #ifndef NOFIXEDCO // allow disabling of fixed CO functionality at compile time
 vector< vector< vector<int> > > FixedCOs::theCOs[2];
@@ -22,14 +23,14 @@ void FixedCOs::read(const char *fixedCOfile, GeneticMap &map) {
   char *bufferOther = (char *) malloc(bytesRead + 1);
   if (buffer == NULL || bufferOther == NULL) {
     printf("ERROR: out of memory");
-    exit(5);
+    fatalExit(5);
   }
   const char *delim = " \t\n";
 
   FILE *in = fopen(fixedCOfile, "r");
   if (!in) {
     fprintf(stderr, "ERROR: could not open fixed crossover file %s!\n", fixedCOfile);
-    exit(1);
+    fatalExit(1);
   }
 
   char *lastId = NULL;
@@ -79,7 +80,7 @@ void FixedCOs::read(const char *fixedCOfile, GeneticMap &map) {
     if (errno != 0 || *endptr != '\0') {
       fprintf(stderr, "ERROR: column three of %s contains %s, which cannot be converted to an integer\n",
 	  fixedCOfile, posStr);
-      exit(2);
+      fatalExit(2);
     }
 
     if (pos >= map.chromStartPhys(chrIdx) && pos <= map.chromEndPhys(chrIdx))
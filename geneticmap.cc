@@ -8,6 +8,7 @@
 #include <errno.h>
 #include <vector>
 #include "geneticmap.h"
+#include "runerror.h"
 
 // Read in genetic map from <mapFile>. Also determines whether there are male
 // and female maps present and sets <sexSpecificMaps> to true if so. If only
@@ -18,7 +19,7 @@ GeneticMap::GeneticMap(char *mapFile, bool &sexSpecificMaps) {
   char *buffer = (char *) malloc(bytesRead + 1);
   if (buffer == NULL) {
     printf("ERROR: out of memory");
-    exit(5);
+    fatalExit(5);
   }
   const char *delim = " \t\n";
 
@@ -26,7 +27,7 @@ GeneticMap::GeneticMap(char *mapFile, bool &sexSpecificMaps) {
   if (!in) {
     printf("ERROR: could not open map file %s!\n", mapFile);
     perror("open");
-    exit(1);
+    fatalExit(1);
   }
 
   char *curChr = NULL, *endptr;
@@ -55,13 +56,13 @@ GeneticMap::GeneticMap(char *mapFile, bool &sexSpecificMaps) {
       curChr = new char[ strlen(chrom) + 1 ];
       if (curChr == NULL) {
 	printf("ERROR: out of memory");
-	exit(5);
+	fatalExit(5);
       }
       strcpy(curChr, chrom);
       curMap = new vector<PhysGeneticPos>;
       if (curMap == NULL) {
 	printf("ERROR: out of memory");
-	exit(5);
+	fatalExit(5);
       }
       map.emplace_back(curChr, curMap);
       prevPhysPos = -1;
@@ -75,18 +76,18 @@ GeneticMap::GeneticMap(char *mapFile, bool &sexSpecificMaps) {
       fprintf(stderr, "ERROR: could not parse column 2 of map file as integer\n");
       if (errno != 0)
 	perror("strtol");
-      exit(2);
+      fatalExit(2);
     }
     if (physPos <= prevPhysPos) {
       fprintf(stderr, "ERROR: column 2 of map file is not sorted\n");
-      exit(2);
+      fatalExit(2);
     }
     mapPos1 = strtod(mapPos1Str, &endptr);
     if (errno != 0 || *endptr != '\0') {
       fprintf(stderr, "ERROR: could not parse column 3 of map file as floating point\n");
       if (errno != 0)
 	perror("strtod");
-      exit(2);
+      fatalExit(2);
     }
     if (sexSpecificMaps) {
       mapPos2 = strtod(mapPos2Str, &endptr);
@@ -94,12 +95,12 @@ GeneticMap::GeneticMap(char *mapFile, bool &sexSpecificMaps) {
 	fprintf(stderr, "ERROR: could not parse column 4 of map file as floating point\n");
 	if (errno != 0)
 	  perror("strtod");
-	exit(2);
+	fatalExit(2);
       }
     }
     else if (mapPos2Str != NULL) {
       fprintf(stderr, "ERROR: expected three columns on all lines in map file but more seen\n");
-      exit(2);
+      fatalExit(2);
     }
 
     curMap->emplace_back(physPos, mapPos1, mapPos2);
@@ -14,6 +14,12 @@
 #include "datastructs.h"
 #include "simulate.h"
 #include "bpvcffam.h"
+#include "phasetimer.h"
+#include "trace.h"
+#include "membudget.h"
+#include "progress.h"
+#include "pedcosts.h"
+#include "runerror.h"
 
 bool compInheritRecSamp(const InheritRecord &a, const InheritRecord &b) {
   return (a.ped < b.ped) ||
@@ -43,31 +49,35 @@ bool compIBDRecord(const IBDRecord &a, const IBDRecord &b) {
 	 a.startPos < b.startPos);
 }
 
-// Locates and prints IBD segments using <hapCarriers>
-// if <ibdSegs> is non-NULL, stores the information that the WASM ped-sim code
-// on HAPI-DNA.org displays
+// Locates and prints IBD segments using <hapCarriers> (adding to the end of
+// the files if <append>)
+// if <ibdFunc> is non-NULL, passes each segment to it (the WASM ped-sim code
+// on HAPI-DNA.org and library users, see pedsim.h, get the segments this way)
 void locatePrintIBD(vector<SimDetails> &simDetails,
 		    vector< vector< vector<InheritRecord> > > &hapCarriers,
 		    GeneticMap &map, bool sexSpecificMaps, char *ibdFile,
-		    vector< tuple<uint8_t,int,int,uint8_t,float> > *ibdSegs,
-		    char *mrcaFile) {
-  FILE *out = NULL;
+		    IBDSegFunc *ibdFunc,
+		    char *mrcaFile, bool append) {
+  // the files are closed when these go out of scope, including on an error
+  // (see fatalExit()); <out> and <mrcaOut> point to them if in use
+  FileOrGZ<FILE *> ibdOutFile, mrcaOutFile;
+  FileOrGZ<FILE *> *out = NULL;
   if (ibdFile != NULL) {
-    out = fopen(ibdFile, "w");
-    if (!out) {
+    out = &ibdOutFile;
+    if (!out->open(ibdFile, append ? "a" : "w")) {
       printf("ERROR: could not open output file %s!\n", ibdFile);
       perror("open");
-      exit(1);
+      fatalExit(1);
     }
   }
 
-  FILE *mrcaOut = NULL;
+  FileOrGZ<FILE *> *mrcaOut = NULL;
   if (mrcaFile != NULL) {
-    mrcaOut = fopen(mrcaFile, "w");
-    if (!mrcaOut) {
+    mrcaOut = &mrcaOutFile;
+    if (!mrcaOut->open(mrcaFile, append ? "a" : "w")) {
       printf("ERROR: could not open output file %s!\n", mrcaFile);
       perror("open");
-      exit(1);
+      fatalExit(1);
     }
   }
 
@@ -83,7 +93,7 @@ void locatePrintIBD(vector<SimDetails> &simDetails,
 			  new vector< vector< vector<IBDRecord> > >[maxNumGens];
   if (theSegs == NULL) {
     printf("ERROR: out of memory");
-    exit(5);
+    fatalExit(5);
   }
   int curPed = -1;
   int curRep = -1;
@@ -95,6 +105,7 @@ void locatePrintIBD(vector<SimDetails> &simDetails,
   // Go through this one founder haplotype and one chromosome at a time to
   // find the overlapping IBD and also HBD segments
   for (int foundHapNum = 0; foundHapNum < totalFounderHaps; foundHapNum++) {
+    TraceScope hapEvent("find HBD", "founder hap", foundHapNum);
     for(unsigned int chrIdx = 0; chrIdx < numChrs; chrIdx++) {
       // First find all HBD regions
       // Do this first because multiple InheritRecords for the same sample that
@@ -147,9 +158,21 @@ void locatePrintIBD(vector<SimDetails> &simDetails,
     }
   }
 
+  if (Progress::enabled()) {
+    uint64_t numRecs = 0;
+    for(auto it1 = hapCarriers.begin(); it1 != hapCarriers.end(); it1++)
+      for(auto it2 = it1->begin(); it2 != it1->end(); it2++)
+	numRecs += it2->size();
+    Progress::begin(PROG_IBD, numRecs);
+  }
+
   // Now find and store all IBD (and HBD) segments
   for (int foundHapNum = 0; foundHapNum < totalFounderHaps; foundHapNum++) {
+    if (MemBudget::exceeded())
+      break; // main() reports the overrun once the output stages finish
+    TraceScope hapEvent("locate IBD", "founder hap", foundHapNum);
     for(unsigned int chrIdx = 0; chrIdx < numChrs; chrIdx++) {
+      Progress::add(PROG_IBD, hapCarriers[foundHapNum][chrIdx].size());
       // here we sort by segment start to find IBD segments
       sort(hapCarriers[foundHapNum][chrIdx].begin(),
 	   hapCarriers[foundHapNum][chrIdx].end(), compInheritRecStart);
@@ -165,8 +188,8 @@ void locatePrintIBD(vector<SimDetails> &simDetails,
 	if ((int) it1->ped != curPed || (int) it1->rep != curRep) {
 	  // print stored segments, locating any IBD2
 	  if (curPed >= 0)
-	    printIBD(out, simDetails[curPed], curRep, theSegs, map,
-		     sexSpecificMaps, ibdSegs, mrcaOut);
+	    printIBD(out, simDetails[curPed], curPed, curRep, theSegs, map,
+		     sexSpecificMaps, ibdFunc, mrcaOut);
 	  // update:
 	  curPed = it1->ped;
 	  curRep = it1->rep;
@@ -254,23 +277,36 @@ void locatePrintIBD(vector<SimDetails> &simDetails,
   } // foundHapNum loop
 
   if (curPed >= 0)
-    printIBD(out, simDetails[curPed], curRep, theSegs, map, sexSpecificMaps,
-	     ibdSegs, mrcaOut);
+    printIBD(out, simDetails[curPed], curPed, curRep, theSegs, map,
+	     sexSpecificMaps, ibdFunc, mrcaOut);
 
-  if (out)
-    fclose(out);
+  if (out) {
+    out->close();
+  }
+  if (mrcaOut) {
+    mrcaOut->close();
+  }
 
   delete [] theSegs;
+  MemBudget::set(MEM_IBD_SEGS, 0);
+  Progress::end(PROG_IBD);
 }
 
 // print stored segments, locating any IBD2 regions
-// if <ibdSegs> is non-NULL, stores the information that the WASM ped-sim code
-// on HAPI-DNA.org displays
-void printIBD(FILE *out, SimDetails &pedDetails, int rep,
+// if <ibdFunc> is non-NULL, passes each segment to it (the WASM ped-sim code
+// on HAPI-DNA.org and library users, see pedsim.h, get the segments this way)
+void printIBD(FileOrGZ<FILE *> *out, SimDetails &pedDetails, int ped,
+	      int rep,
 	      vector< vector< vector<IBDRecord> > > *theSegs,
 	      GeneticMap &map, bool sexSpecificMaps,
-	      vector< tuple<uint8_t,int,int,uint8_t,float> > *ibdSegs,
-	      FILE *mrcaOut) {
+	      IBDSegFunc *ibdFunc,
+	      FileOrGZ<FILE *> *mrcaOut) {
+  TraceScope event("print IBD", "ped", ped, "rep", pedDetails.firstRep + rep);
+  long startBytes = 0;
+  if (PedCosts::active())
+    startBytes = ((out) ? out->printed() : 0) +
+		 ((mrcaOut) ? mrcaOut->printed() : 0);
+
   // Go through <theSegs> and print segments for samples that were listed as
   // printed in the def file
   for(int gen = 0; gen < pedDetails.numGen; gen++) {
@@ -330,11 +366,11 @@ void printIBD(FILE *out, SimDetails &pedDetails, int rep,
 
 	      // any preceding IBD1 segment?
 	      if (segs[i].startPos < segs[i + nextI].startPos) {
-		printOneIBDSegment(out, pedDetails, rep, gen, branch, ind,
+		printOneIBDSegment(out, pedDetails, ped, rep, gen, branch, ind,
 				   segs[i], /*realStart=*/ segs[i].startPos,
 				   /*realEnd=*/ segs[i + nextI].startPos - 1,
 				   /*type=IBD1=*/ 1, map, sexSpecificMaps,
-				   ibdSegs);
+				   ibdFunc);
 		if (mrcaOut)
 		  printSegFounderId(mrcaOut, segs[i].foundHapNum, pedDetails,
 				    rep);
@@ -342,12 +378,12 @@ void printIBD(FILE *out, SimDetails &pedDetails, int rep,
 
 	      // now the IBD2 segment:
 	      int ibd2End = min(segs[i].endPos, segs[i + nextI].endPos);
-	      printOneIBDSegment(out, pedDetails, rep, gen, branch, ind,
+	      printOneIBDSegment(out, pedDetails, ped, rep, gen, branch, ind,
 				 segs[i],
 				 /*realStart=*/ segs[i + nextI].startPos,
 				 /*realEnd=*/ ibd2End,
 				 /*type=IBD2=*/ 2, map, sexSpecificMaps,
-				 ibdSegs);
+				 ibdFunc);
 	      if (mrcaOut)
 		printSegFounderId(mrcaOut, segs[i].foundHapNum, pedDetails,
 				  rep);
@@ -407,24 +443,24 @@ void printIBD(FILE *out, SimDetails &pedDetails, int rep,
 	      if (gen == segs[i].otherGen && branch == segs[i].otherBranch &&
 		  ind == segs[i].otherInd) {
 		// HBD
-		printOneIBDSegment(out, pedDetails, rep, gen, branch, ind,
+		printOneIBDSegment(out, pedDetails, ped, rep, gen, branch, ind,
 				   segs[i],
 				   /*realStart=standard=*/ segs[i].startPos,
 				   /*realEnd=standard=*/ segs[i].endPos,
 				   /*type=HBD=*/ 0, map, sexSpecificMaps,
-				   ibdSegs);
+				   ibdFunc);
 		if (mrcaOut)
 		  printSegFounderId(mrcaOut, segs[i].foundHapNum, pedDetails,
 				    rep);
 	      }
 	      else {
 		// IBD1
-		printOneIBDSegment(out, pedDetails, rep, gen, branch, ind,
+		printOneIBDSegment(out, pedDetails, ped, rep, gen, branch, ind,
 				   segs[i],
 				   /*realStart=standard=*/ segs[i].startPos,
 				   /*realEnd=standard=*/ segs[i].endPos,
 				   /*type=IBD1=*/ 1, map, sexSpecificMaps,
-				   ibdSegs);
+				   ibdFunc);
 		if (mrcaOut)
 		  printSegFounderId(mrcaOut, segs[i].foundHapNum, pedDetails,
 				    rep);
@@ -437,6 +473,10 @@ void printIBD(FILE *out, SimDetails &pedDetails, int rep,
       }
     }
   }
+
+  if (PedCosts::active())
+    PedCosts::add(ped, PED_OUT_BYTES, ((out) ? out->printed() : 0) +
+			    ((mrcaOut) ? mrcaOut->printed() : 0) - startBytes);
 }
 
 // Helper for printIBD(): merges adjacent IBD segments
@@ -511,23 +551,26 @@ void mergeSegments(vector<IBDRecord> &segs, bool retainFoundHap) {
 }
 
 // Prints the IBD segment described by the parameters to <out>
-// if <ibdSegs> is non-NULL, stores the information that the WASM ped-sim code
-// on HAPI-DNA.org displays
-void printOneIBDSegment(FILE *out, SimDetails &pedDetails, int rep,
-			int gen, int branch, int ind, IBDRecord &seg,
+// if <ibdFunc> is non-NULL, passes each segment to it (the WASM ped-sim code
+// on HAPI-DNA.org and library users, see pedsim.h, get the segments this way)
+void printOneIBDSegment(FileOrGZ<FILE *> *out, SimDetails &pedDetails,
+			int ped, int rep, int gen, int branch, int ind, IBDRecord &seg,
 			int realStart, int realEnd, uint8_t ibdType,
 			GeneticMap &map, bool sexSpecificMaps,
-			vector<tuple<uint8_t,int,int,uint8_t,float> > *ibdSegs){
+			IBDSegFunc *ibdFunc){
   const char *ibdTypeStr[3] = { "HBD", "IBD1", "IBD2" };
 
-  if (out) { // want to print the segment (if not, <ibdSegs> will be non-NULL)
+  PhaseTimer::count(IBD_RECS);
+  PedCosts::add(ped, PED_IBD_RECS, 1);
+
+  if (out) { // want to print the segment (if not, <ibdFunc> will be non-NULL)
     printSampleId(out, pedDetails, rep, gen, branch, ind);
-    fprintf(out, "\t");
+    out->printf("\t");
     printSampleId(out, pedDetails, rep, seg.otherGen, seg.otherBranch,
 		  seg.otherInd);
-    fprintf(out, "\t");
+    out->printf("\t");
 
-    fprintf(out, "%s\t%d\t%d\t%s", map.chromName(seg.chrIdx), realStart,
+    out->printf("%s\t%d\t%d\t%s", map.chromName(seg.chrIdx), realStart,
 	    realEnd, ibdTypeStr[ ibdType ]);
   }
 
@@ -595,28 +638,44 @@ void printOneIBDSegment(FILE *out, SimDetails &pedDetails, int rep,
   }
 
   if (out)
-    fprintf(out, "\t%lf\t%lf\t%lf\n", ibdGenet[0], ibdGenet[1],
+    out->printf("\t%lf\t%lf\t%lf\n", ibdGenet[0], ibdGenet[1],
 	    ibdGenet[1] - ibdGenet[0]);
 
-  if (ibdSegs)
-    ibdSegs->emplace_back(seg.chrIdx, realStart, realEnd, ibdType,
-			  ibdGenet[1] - ibdGenet[0]);
+  if (ibdFunc) {
+    IBDSegInfo info;
+    info.ped = ped;
+    info.rep = rep;
+    info.gen[0] = gen;
+    info.branch[0] = branch;
+    info.ind[0] = ind;
+    info.gen[1] = seg.otherGen;
+    info.branch[1] = seg.otherBranch;
+    info.ind[1] = seg.otherInd;
+    info.chrIdx = seg.chrIdx;
+    info.startPos = realStart;
+    info.endPos = realEnd;
+    info.type = ibdType;
+    info.genetStart = ibdGenet[0];
+    info.genetEnd = ibdGenet[1];
+    (*ibdFunc)(info);
+  }
 }
 
 // For printing the founder id that segments coalesce in to the .mrca
 // file
-void printSegFounderId(FILE *mrcaOut, int foundHapNum, SimDetails &pedDetails,
-		       int rep) {
+void printSegFounderId(FileOrGZ<FILE *> *mrcaOut, int foundHapNum,
+		       SimDetails &pedDetails, int rep) {
   int founderIdx = (foundHapNum - pedDetails.founderOffset) %
 							pedDetails.numFounders;
-  fprintf(mrcaOut, "%s%d_%s\n", pedDetails.name, rep+1,
-	  pedDetails.founderIdSuffix[founderIdx]);
+  mrcaOut->printf("%s%d_%s\n", pedDetails.name,
+	  pedDetails.firstRep + rep+1, pedDetails.founderIdSuffix[founderIdx]);
 }
 
 // Helper for locatePrintIBD() to clear information in <theSegs>
 void clearTheSegs(SimDetails &pedDetails, 
 		  vector< vector< vector<IBDRecord> > > *theSegs) {
   int numGen = pedDetails.numGen;
+  long segBytes = 0;
   for(int gen = 0; gen < numGen; gen++) {
     int numBranches = pedDetails.numBranches[gen];
     if ((int) theSegs[gen].size() < numBranches)
@@ -631,8 +690,11 @@ void clearTheSegs(SimDetails &pedDetails,
       if ((int) theSegs[gen][branch].size() < numPersons)
 	theSegs[gen][branch].resize(numPersons);
       for(int ind = 0; ind < numPersons; ind++) {
+	segBytes += theSegs[gen][branch][ind].capacity() * sizeof(IBDRecord);
 	theSegs[gen][branch][ind].clear();
       }
     }
   }
+  // clear() keeps the space, so this is what the next replicate starts with
+  MemBudget::set(MEM_IBD_SEGS, segBytes);
 }
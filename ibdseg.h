@@ -3,36 +3,52 @@
 // This program is distributed under the terms of the GNU General Public License
 
 #include <vector>
-#include <tuple>
+#include <functional>
 #include "datastructs.h"
 #include "geneticmap.h"
+#include "fileorgz.h"
 
 #ifndef IBDSEG_H
 #define IBDSEG_H
 
 using namespace std;
 
+// Details of one IBD segment, passed to an IBDSegFunc by locatePrintIBD()
+struct IBDSegInfo {
+  // pedigree index (in def file order) and replicate number, both 0-based
+  int ped, rep;
+  // generation, branch, and individual numbers of the two samples (0-based,
+  // with individual numbers as in Person indexes); identical for HBD segments
+  int gen[2], branch[2], ind[2];
+  unsigned int chrIdx;
+  int startPos, endPos; // physical positions
+  uint8_t type; // 0: HBD, 1: IBD1, 2: IBD2
+  double genetStart, genetEnd; // in cM
+};
+typedef function<void(const IBDSegInfo &)> IBDSegFunc;
+
 bool compInheritRecSamp(const InheritRecord &a, const InheritRecord &b);
 bool compInheritRecStart(const InheritRecord &a, const InheritRecord &b);
 bool compIBDRecord(const IBDRecord &a, const IBDRecord &b);
 void locatePrintIBD(vector<SimDetails> &simDetails,
 		    vector< vector< vector<InheritRecord> > > &hapCarriers,
 		    GeneticMap &map, bool sexSpecificMaps, char *ibdFile,
-		    vector< tuple<uint8_t,int,int,uint8_t,float> > *ibdSegs,
-		    char *mrcaFile);
-void printIBD(FILE *out, SimDetails &pedDetails, int rep,
+		    IBDSegFunc *ibdFunc,
+		    char *mrcaFile, bool append = false);
+void printIBD(FileOrGZ<FILE *> *out, SimDetails &pedDetails, int ped,
+	      int rep,
 	      vector< vector< vector<IBDRecord> > > *theSegs,
 	      GeneticMap &map, bool sexSpecificMaps,
-	      vector< tuple<uint8_t,int,int,uint8_t,float> > *ibdSegs,
-	      FILE *mrcaOut);
+	      IBDSegFunc *ibdFunc,
+	      FileOrGZ<FILE *> *mrcaOut);
 void mergeSegments(vector<IBDRecord> &segs, bool retainFoundHap);
-void printOneIBDSegment(FILE *out, SimDetails &pedDetails, int rep,
-			int gen, int branch, int ind, IBDRecord &seg,
+void printOneIBDSegment(FileOrGZ<FILE *> *out, SimDetails &pedDetails,
+			int ped, int rep, int gen, int branch, int ind, IBDRecord &seg,
 			int realStart, int realEnd, uint8_t ibdType,
 			GeneticMap &map, bool sexSpecificMaps,
-			vector<tuple<uint8_t,int,int,uint8_t,float> > *ibdSegs);
-void printSegFounderId(FILE *mrcaOut, int foundHapNum, SimDetails &pedDetails,
-		       int rep);
+			IBDSegFunc *ibdFunc);
+void printSegFounderId(FileOrGZ<FILE *> *mrcaOut, int foundHapNum,
+		       SimDetails &pedDetails, int rep);
 void clearTheSegs(SimDetails &pedDetails, 
 		  vector< vector< vector<IBDRecord> > > *theSegs);
 
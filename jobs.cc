@@ -0,0 +1,482 @@
+// ped-sim: pedigree simulation tool
+//
+// This program is distributed under the terms of the GNU General Public License
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <random>
+#include "jobs.h"
+#include "pedsim.h"
+#include "bpvcffam.h"
+#include "fixedcos.h"
+#include "fileorgz.h"
+#include "runerror.h"
+
+// Returns the number of samples in the header of <inVCFfile>
+static int countVCFSamples(const char *inVCFfile) {
+  FileOrGZ<gzFile> in; // also reads uncompressed files
+  if (!in.open(inVCFfile, "r")) {
+    fprintf(stderr, "\nERROR: could not open input VCF file %s!\n", inVCFfile);
+    perror("open");
+    fatalExit(1);
+  }
+
+  int numSamples = 0;
+  while (in.getline() >= 0 && in.buf[0] == '#') {
+    if (in.buf[1] != '#') {
+      // header line: 9 fixed columns then the samples
+      int numCols = 1;
+      for(int i = 0; in.buf[i] != '\0'; i++)
+	if (in.buf[i] == '\t')
+	  numCols++;
+      numSamples = max(numCols - 9, 0);
+      break;
+    }
+  }
+  in.close();
+  return numSamples;
+}
+
+JobRunner::JobRunner(int numThreads, FILE *status) {
+  defaults = CmdLineOpts::get();
+
+  fprintf(status, "Reading genetic map %s... ", CmdLineOpts::mapFile);
+  fflush(status);
+  map = new GeneticMap(CmdLineOpts::mapFile, sexSpecificMaps);
+  if (map == NULL) {
+    printf("ERROR: out of memory");
+    fatalExit(5);
+  }
+  fprintf(status, "done.\n");
+
+  if (CmdLineOpts::interfereFile) {
+    fprintf(status, "Reading interference file %s... ",
+	    CmdLineOpts::interfereFile);
+    fflush(status);
+    COInterfere::read(coIntf, CmdLineOpts::interfereFile, *map,
+		      sexSpecificMaps);
+    fprintf(status, "done.\n");
+  }
+
+#ifndef NOFIXEDCO
+  if (CmdLineOpts::fixedCOfile) {
+    fprintf(status, "Reading fixed CO file %s... ", CmdLineOpts::fixedCOfile);
+    fflush(status);
+    FixedCOs::read(CmdLineOpts::fixedCOfile, *map);
+    fprintf(status, "done.\n");
+  }
+#endif // NOFIXEDCO
+
+  // as in main(), only use the sexes when we have an X map
+  haveSexes = CmdLineOpts::vcfSexesFile && map->haveXmap();
+  sexesCount[0] = sexesCount[1] = 0;
+  if (haveSexes)
+    readSexes(sexes, sexesCount, CmdLineOpts::vcfSexesFile);
+
+  // for check()
+  numInputSamples = 0;
+  if (CmdLineOpts::inVCFfile)
+    numInputSamples = countVCFSamples(CmdLineOpts::inVCFfile);
+
+  if (numThreads <= 0)
+    numThreads = thread::hardware_concurrency();
+  if (numThreads <= 0)
+    numThreads = 1;
+  numPending = 0;
+  stopping = false;
+  for(int t = 0; t < numThreads; t++)
+    workers.emplace_back(&JobRunner::workLoop, this);
+  fprintf(status, "Running jobs on %d thread%s\n", numThreads,
+	  (numThreads == 1) ? "" : "s");
+}
+
+JobRunner::~JobRunner() {
+  {
+    unique_lock<mutex> lk(lock);
+    stopping = true;
+  }
+  haveWork.notify_all();
+  for(auto it = workers.begin(); it != workers.end(); it++)
+    it->join();
+  // note: <map> is not freed because the COInterfere and FixedCOs data refer
+  // to it and this object normally lasts until the program exits
+}
+
+void JobRunner::initJob(JobSpec &job, const char *outPrefix) {
+  job.outPrefix = outPrefix;
+  job.defFile.clear();
+  job.defText.clear();
+  job.haveSeed = !defaults.autoSeed;
+  job.seed = defaults.randSeed;
+  job.opts = defaults;
+}
+
+bool JobRunner::parseSettings(JobSpec &job, char *&saveptr, string &err) {
+  const char *delim = " \t\n";
+  VCFSettingsParser vcfSettings(job.haveSeed, job.seed, job.opts.genoErrRate,
+				job.opts.homErrRate, job.opts.missRate,
+				job.opts.pseudoHapRate);
+
+  char *setting;
+  while ((setting = strtok_r(NULL, delim, &saveptr))) {
+    char *value = strchr(setting, '=');
+    if (value) {
+      *value = '\0';
+      value++;
+    }
+
+    // flags
+    int *flag = NULL;
+    if (strcmp(setting, "bp") == 0)
+      flag = &job.opts.printBP;
+    else if (strcmp(setting, "fam") == 0)
+      flag = &job.opts.printFam;
+    else if (strcmp(setting, "mrca") == 0)
+      flag = &job.opts.printMRCA;
+    else if (strcmp(setting, "nogz") == 0)
+      flag = &job.opts.nogz;
+    else if (strcmp(setting, "keep_phase") == 0)
+      flag = &job.opts.keepPhase;
+    if (flag) {
+      if (value) {
+	err = string(setting) + " does not take a value";
+	return false;
+      }
+      *flag = 1;
+      continue;
+    }
+
+    if (value == NULL || value[0] == '\0') {
+      err = string("expected <key>=<value> but got ") + setting;
+      return false;
+    }
+
+    if (strcmp(setting, "def") == 0) {
+      job.defFile = value;
+      continue;
+    }
+
+    if (strcmp(setting, "retain_extra") == 0) {
+      errno = 0; // initially
+      char *endptr;
+      job.opts.retainExtra = strtol(value, &endptr, 10);
+      if (errno != 0 || *endptr != '\0') {
+	err = string("unable to parse ") + setting + " value " + value;
+	return false;
+      }
+      continue;
+    }
+
+    if (!VCFSettingsParser::isSetting(setting)) {
+      err = string("unknown setting ") + setting;
+      return false;
+    }
+    if (vcfSettings.parse(setting, value, err) != 0)
+      return false;
+  }
+
+  return vcfSettings.finish(err) == 0;
+}
+
+bool JobRunner::check(JobSpec &job, string &err) {
+  if (!job.defFile.empty() && access(job.defFile.c_str(), R_OK) != 0) {
+    err = "could not open def file " + job.defFile;
+    return false;
+  }
+
+  PedSim sim(*map, sexSpecificMaps, coIntf);
+  sim.opts = job.opts;
+  int status;
+  if (job.defFile.empty())
+    status = sim.readDefText(job.defText.c_str());
+  else
+    status = sim.readDef(job.defFile.c_str());
+  if (status != 0) {
+    err = "could not read the pedigree definitions";
+    if (!job.defFile.empty())
+      err += " in " + job.defFile;
+    return false;
+  }
+
+  if (job.opts.inVCFfile) {
+    // with the sexes, only input samples of known sex are used as founders;
+    // run() checks the number of each sex once they've been assigned
+    int numFounders = sim.numFoundersNeeded();
+    int numUsable = (haveSexes) ? sexesCount[0] + sexesCount[1]
+				: numInputSamples;
+    if (numFounders > numUsable) {
+      err = "need " + to_string(numFounders) + " founders, but the " +
+	    ((haveSexes) ? "sexes file gives " : "input VCF contains ") +
+	    to_string(numUsable) + " samples";
+      return false;
+    }
+  }
+  return true;
+}
+
+void JobRunner::submit(JobSpec *job, JobDoneFunc done) {
+  {
+    unique_lock<mutex> lk(lock);
+    queue.emplace_back(job, done);
+    numPending++;
+  }
+  haveWork.notify_one();
+}
+
+void JobRunner::wait() {
+  unique_lock<mutex> lk(lock);
+  allDone.wait(lk, [this]() { return numPending == 0; });
+}
+
+void JobRunner::workLoop() {
+  while (true) {
+    pair<JobSpec *, JobDoneFunc> next;
+    {
+      unique_lock<mutex> lk(lock);
+      haveWork.wait(lk, [this]() { return stopping || !queue.empty(); });
+      if (queue.empty())
+	return; // stopping
+      next = queue.front();
+      queue.pop_front();
+    }
+
+    run(*next.first);
+    next.second(next.first);
+
+    {
+      unique_lock<mutex> lk(lock);
+      numPending--;
+      if (numPending == 0)
+	allDone.notify_all();
+    }
+  }
+}
+
+// Runs one job, printing the same output files (apart from the status
+// messages in the log) as running Ped-sim with the same settings would. The
+// steps that print errors set <job.status> to the status they return
+void JobRunner::run(JobSpec &job) {
+  job.status = 0;
+  job.err.clear();
+
+  PedSim sim(*map, sexSpecificMaps, coIntf);
+  sim.opts = job.opts;
+  sim.opts.outPrefix = (char *) job.outPrefix.c_str();
+  if (haveSexes)
+    sim.vcfSexes = &sexes;
+
+  if (!job.haveSeed) {
+    job.seed = random_device()();
+    job.haveSeed = true;
+  }
+  sim.setSeed(job.seed);
+
+  string outFile = job.outPrefix + ".log";
+  FILE *log = fopen(outFile.c_str(), "w");
+  if (!log) {
+    job.status = 1;
+    job.err = "could not open log file " + outFile + ": " + strerror(errno);
+    return;
+  }
+  sim.log = log;
+  fprintf(log, "Pedigree simulator!  v%s    (Released %s)\n\n",
+	  VERSION_NUMBER, RELEASE_DATE);
+  fprintf(log, "  Def file:\t\t%s\n",
+	  job.defFile.empty() ? "[job text]" : job.defFile.c_str());
+  fprintf(log, "  Map file:\t\t%s\n", job.opts.mapFile);
+  fprintf(log, "  Input VCF:\t\t%s\n",
+	  job.opts.inVCFfile == NULL ? "[none: no genetic data]" :
+				       job.opts.inVCFfile);
+  fprintf(log, "  Output prefix:\t%s\n\n", job.outPrefix.c_str());
+  fprintf(log, "  Random seed:\t\t%u\n\n", job.seed);
+
+  // each step runs only if the ones before it succeeded
+  const char *step = "reading the pedigree definitions";
+  if (job.defFile.empty())
+    job.status = sim.readDefText(job.defText.c_str());
+  else
+    job.status = sim.readDef(job.defFile.c_str());
+  if (job.status == 0) {
+    step = "simulating";
+    job.status = sim.simulate();
+  }
+
+  if (job.status == 0 && job.opts.inVCFfile && haveSexes &&
+      (sim.numFounders(0) > (int) sexesCount[0] ||
+       sim.numFounders(1) > (int) sexesCount[1])) {
+    // as in main(), before printing any output
+    step = "checking the input sexes";
+    job.status = 8;
+    job.err = "need the input VCF to contain at least " +
+	      to_string(sim.numFounders(1)) + " females and " +
+	      to_string(sim.numFounders(0)) + " males, but the sexes file " +
+	      "gives " + to_string(sexesCount[1]) + " females and " +
+	      to_string(sexesCount[0]) + " males";
+    fprintf(log, "\nERROR: %s\n", job.err.c_str());
+  }
+
+  if (job.status == 0 && job.opts.printBP) {
+    step = "printing the .bp file";
+    job.status = sim.printBPs((job.outPrefix + ".bp").c_str());
+  }
+
+  if (job.status == 0) {
+    step = "printing IBD segments";
+    string mrcaFile = job.outPrefix + ".mrca";
+    job.status = sim.printIBD((job.outPrefix + ".seg").c_str(),
+			      job.opts.printMRCA ? mrcaFile.c_str() : NULL);
+  }
+
+  if (job.status == 0 && job.opts.printFam) {
+    step = "printing the fam file";
+    job.status = sim.printFam((job.outPrefix + "-everyone.fam").c_str());
+  }
+
+  if (job.status == 0) {
+    if (job.opts.inVCFfile) {
+      step = "generating genotypes";
+      fprintf(log, "Reading input VCF meta data... ");
+      int ret = sim.printVCF(job.opts.inVCFfile);
+      if (ret == 0)
+	fprintf(log, "done.\n");
+      else if (ret != 1) // 1: unphased input, a truncated VCF as with -i
+	job.status = ret;
+    }
+    else
+      fprintf(log, "\nTo simulate genetic data, must use an input VCF with %d founders.\n",
+	      sim.numFounderHaps() / 2);
+  }
+
+  if (job.status != 0 && job.err.empty())
+    job.err = string("failed while ") + step + " (status " +
+	      to_string(job.status) + ")";
+  fclose(log);
+}
+
+// Runs the jobs listed in <manifestFile> (--batch). Each line gives a def
+// file, a random seed (or - for a random one), an output prefix, and
+// optionally other settings as in JobRunner::parseSettings(). The results are
+// the same as running Ped-sim separately for each line. A line with an error
+// (or a job that fails) doesn't stop the others; the return value is the
+// status of the first failure or 0 if all jobs succeeded.
+int runBatch(const char *manifestFile) {
+  FILE *in = fopen(manifestFile, "r");
+  if (!in) {
+    fprintf(stderr, "ERROR: could not open batch file %s!\n", manifestFile);
+    perror("open");
+    fatalExit(1);
+  }
+
+  JobRunner runner(CmdLineOpts::numThreads, stdout);
+
+  size_t bytesRead = 1024;
+  char *buffer = (char *) malloc(bytesRead + 1);
+  if (buffer == NULL) {
+    fprintf(stderr, "ERROR: out of memory");
+    fatalExit(5);
+  }
+  const char *delim = " \t\n";
+
+  // read and check all jobs before running any so that errors are reported
+  // up front; lines with errors are skipped
+  vector<JobSpec> jobs;
+  vector<int> jobLines; // line of each job in <jobs>
+  int status = 0; // of the first line that has an error (and then job failed)
+  int firstBadLine = 0;
+  int numLines = 0, numFailed = 0;
+  int line = 0;
+  while (getline(&buffer, &bytesRead, in) >= 0) {
+    line++;
+
+    char *saveptr, *endptr;
+    char *defFile = strtok_r(buffer, delim, &saveptr);
+    if (defFile == NULL || defFile[0] == '#')
+      // blank line or comment
+      continue;
+    numLines++;
+    char *seedStr = strtok_r(NULL, delim, &saveptr);
+    char *outPrefix = strtok_r(NULL, delim, &saveptr);
+    if (seedStr == NULL || outPrefix == NULL) {
+      fprintf(stderr, "ERROR: line %d in batch file: expect at least three fields:\n",
+	      line);
+      fprintf(stderr, "       [def file] [seed] [output prefix] <settings>\n");
+      if (status == 0) {
+	status = 5;
+	firstBadLine = line;
+      }
+      numFailed++;
+      continue;
+    }
+
+    jobs.emplace_back();
+    JobSpec &job = jobs.back();
+    runner.initJob(job, outPrefix);
+    job.defFile = defFile;
+    int lineStatus = 0;
+    string err;
+    if (strcmp(seedStr, "-") != 0) {
+      errno = 0; // initially
+      job.haveSeed = true;
+      job.seed = strtol(seedStr, &endptr, 10);
+      if (errno != 0 || *endptr != '\0') {
+	err = string("unable to parse seed ") + seedStr;
+	lineStatus = 2;
+      }
+    }
+    else
+      job.haveSeed = false;
+
+    if (lineStatus == 0 && (!runner.parseSettings(job, saveptr, err) ||
+			    !runner.check(job, err)))
+      lineStatus = 5;
+    if (lineStatus != 0) {
+      fprintf(stderr, "ERROR: line %d in batch file: %s; skipping %s\n", line,
+	      err.c_str(), outPrefix);
+      jobs.pop_back();
+      if (status == 0) {
+	status = lineStatus;
+	firstBadLine = line;
+      }
+      numFailed++;
+    }
+    else
+      jobLines.push_back(line);
+  }
+
+  free(buffer);
+  fclose(in);
+
+  printf("Running %lu jobs... \n", jobs.size());
+  mutex printLock;
+  for(auto it = jobs.begin(); it != jobs.end(); it++) {
+    runner.submit(&(*it), [&](JobSpec *job) {
+      unique_lock<mutex> lk(printLock);
+      if (job->status == 0)
+	printf("  finished %s (seed %u)\n", job->outPrefix.c_str(), job->seed);
+      else {
+	printf("  FAILED %s (seed %u): %s\n", job->outPrefix.c_str(),
+	       job->seed, job->err.c_str());
+	numFailed++;
+      }
+      fflush(stdout);
+    });
+  }
+  runner.wait();
+  // jobs finish in any order: take the first failure in the manifest
+  for(unsigned int j = 0; j < jobs.size(); j++) {
+    if (jobs[j].status != 0) {
+      if (status == 0 || jobLines[j] < firstBadLine)
+	status = jobs[j].status;
+      break;
+    }
+  }
+  if (numFailed == 0)
+    printf("done.\n");
+  else
+    printf("done; %d of %d jobs failed.\n", numFailed, numLines);
+
+  return status;
+}
@@ -0,0 +1,101 @@
+// ped-sim: pedigree simulation tool
+//
+// This program is distributed under the terms of the GNU General Public License
+
+#include <stdio.h>
+#include <string>
+#include <vector>
+#include <deque>
+#include <unordered_map>
+#include <functional>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include "cmdlineopts.h"
+#include "datastructs.h"
+#include "geneticmap.h"
+#include "cointerfere.h"
+
+#ifndef JOBS_H
+#define JOBS_H
+
+using namespace std;
+
+////////////////////////////////////////////////////////////////////////////////
+// One simulation run by a JobRunner: the equivalent of running Ped-sim with
+// the def file (or text), seed, and output prefix given here and the other
+// settings in <opts>
+struct JobSpec {
+  string outPrefix;
+  string defFile; // empty if <defText> gives the definitions
+  string defText;
+  bool haveSeed;
+  unsigned int seed;
+  CmdLineOpts::Settings opts;
+  // set when the job finishes: 0 if it succeeded, otherwise the status
+  // Ped-sim would have exited with and a description of the error
+  int status;
+  string err;
+};
+
+typedef function<void(JobSpec *job)> JobDoneFunc;
+
+////////////////////////////////////////////////////////////////////////////////
+// Runs many simulations in one process. The genetic map, interference
+// parameters, fixed crossovers, and input VCF sexes are read once (according
+// to the settings of the thread that creates the JobRunner) and shared by all
+// jobs. Jobs run concurrently on a pool of threads, each with its own random
+// number generator and output files. An error in a job ends only that job.
+class JobRunner {
+  public:
+    // <numThreads> of 0 uses one thread per CPU
+    JobRunner(int numThreads, FILE *status);
+    ~JobRunner();
+
+    // Initializes <job> with the creating thread's settings
+    void initJob(JobSpec &job, const char *outPrefix);
+    // Applies the settings in the remaining whitespace-separated tokens of
+    // the string strtok_r() is parsing with <saveptr>. Each is either
+    // <key>=<value> or a flag name: def, seed, bp, fam, mrca, nogz,
+    // keep_phase, err_rate, err_hom_rate, miss_rate, pseudo_hap, and
+    // retain_extra. On error, returns false and sets <err>
+    bool parseSettings(JobSpec &job, char *&saveptr, string &err);
+    // Reads the pedigree definitions of <job> and, if there is an input VCF,
+    // checks that it has enough samples for the founders, so that requests
+    // that can't run are rejected before they're queued. On error, returns
+    // false and sets <err>
+    bool check(JobSpec &job, string &err);
+
+    // Queues <job> to run; <done> is called from the thread that ran it
+    void submit(JobSpec *job, JobDoneFunc done);
+    // Waits until all submitted jobs have finished
+    void wait();
+
+    // Runs <job> on the calling thread, setting its <status> and <err>
+    void run(JobSpec &job);
+
+  private:
+    void workLoop();
+
+    CmdLineOpts::Settings defaults;
+
+    GeneticMap *map;
+    bool sexSpecificMaps;
+    vector<COInterfere> coIntf;
+    unordered_map<const char*,uint8_t,HashString,EqString> sexes;
+    bool haveSexes;
+    uint32_t sexesCount[2]; // in the sexes file: males, females
+    int numInputSamples;    // in the input VCF, if any
+
+    vector<thread> workers;
+    mutex lock;
+    condition_variable haveWork;
+    condition_variable allDone;
+    deque< pair<JobSpec *, JobDoneFunc> > queue;
+    int numPending; // queued or running
+    bool stopping;
+};
+
+int runBatch(const char *manifestFile);
+
+#endif // JOBS_H
@@ -8,15 +8,30 @@
 #include <vector>
 #include <unordered_map>
 #include <random>
+#include <thread>
+#include <atomic>
+#include <functional>
 #include <sys/time.h>
 #include "cmdlineopts.h"
 #include "readdef.h"
+#include "readfam.h"
+#include "population.h"
 #include "geneticmap.h"
 #include "cointerfere.h"
 #include "simulate.h"
 #include "bpvcffam.h"
 #include "ibdseg.h"
 #include "fixedcos.h"
+#include "checkpoint.h"
+#include "phasetimer.h"
+#include "server.h"
+#include "plan.h"
+#include "membudget.h"
+#include "progress.h"
+#include "pedcosts.h"
+#include "edgetable.h"
+#include "fileorgz.h"
+#include "trace.h"
 
 using namespace std;
 
@@ -25,6 +40,20 @@ int main(int argc, char **argv) {
   if (!success)
     return -1;
 
+  if (CmdLineOpts::traceFile) {
+    Trace::enable();
+    Trace::nameThread("main");
+  }
+
+  if (CmdLineOpts::serverPath)
+    return runServer(CmdLineOpts::serverPath);
+  if (CmdLineOpts::batchFile) {
+    int ret = runBatch(CmdLineOpts::batchFile);
+    if (CmdLineOpts::traceFile)
+      Trace::dump(CmdLineOpts::traceFile);
+    return ret;
+  }
+
   // +13 for -everyone.fam, + 1 for \0
   int outFileLen = strlen(CmdLineOpts::outPrefix)+ 13 + 1;
   char *outFile = new char[outFileLen];
@@ -42,6 +71,24 @@ int main(int argc, char **argv) {
     exit(1);
   }
 
+  // with --resume, use the seed of the interrupted run
+  long resumeRecords = -1;
+  if (CmdLineOpts::resume) {
+    char *ckptFile = VCFCheckpoint::fileName();
+    VCFCheckpoint ckpt;
+    if (ckpt.read(ckptFile)) {
+      if (!CmdLineOpts::autoSeed && CmdLineOpts::randSeed != ckpt.randSeed) {
+	fprintf(stderr, "ERROR: --seed %u differs from the seed %u in checkpoint %s\n",
+		CmdLineOpts::randSeed, ckpt.randSeed, ckptFile);
+	exit(5);
+      }
+      CmdLineOpts::autoSeed = false;
+      CmdLineOpts::randSeed = ckpt.randSeed;
+      resumeRecords = ckpt.numRecords;
+    }
+    delete [] ckptFile;
+  }
+
   // seed random number generator if needed
   if (CmdLineOpts::autoSeed) {
     CmdLineOpts::randSeed = random_device().entropy();
@@ -57,11 +104,44 @@ int main(int argc, char **argv) {
 
   FILE *outs[2] = { stdout, log };
 
+  // output VCFs to generate: either those listed in the --renders file or
+  // the standard one using the command line settings
+  vector<RenderSpec> renders;
+  if (CmdLineOpts::renderFile) {
+    readRenders(renders, CmdLineOpts::renderFile);
+  }
+  else if (CmdLineOpts::inVCFfile) {
+    renders.emplace_back();
+    RenderSpec &render = renders.back();
+    render.name = NULL;
+    render.haveSeed = false;
+    render.seed = 0;
+    render.genoErrRate = CmdLineOpts::genoErrRate;
+    render.homErrRate = CmdLineOpts::homErrRate;
+    render.missRate = CmdLineOpts::missRate;
+    render.pseudoHapRate = CmdLineOpts::pseudoHapRate;
+    render.genoFunc = NULL;
+  }
+
   for(int o = 0; o < 2; o++) {
     fprintf(outs[o], "Pedigree simulator!  v%s    (Released %s)\n\n",
 	    VERSION_NUMBER, RELEASE_DATE);
 
-    fprintf(outs[o], "  Def file:\t\t%s\n", CmdLineOpts::defFile);
+    if (CmdLineOpts::inFamFile)
+      fprintf(outs[o], "  Fam file:\t\t%s\n", CmdLineOpts::inFamFile);
+    else if (CmdLineOpts::popSize > 0) {
+      fprintf(outs[o], "  Population:\t\t%d per generation, %d generations\n",
+	      CmdLineOpts::popSize, CmdLineOpts::popGens);
+      fprintf(outs[o], "\t\t\tsample ");
+      if (CmdLineOpts::popSample > 0)
+	fprintf(outs[o], "%d", CmdLineOpts::popSample);
+      else
+	fprintf(outs[o], "all");
+      fprintf(outs[o], ", monogamy %.3lg, offspring variance %.3lg\n",
+	      CmdLineOpts::popMonogamy, CmdLineOpts::popVar);
+    }
+    else
+      fprintf(outs[o], "  Def file:\t\t%s\n", CmdLineOpts::defFile);
     fprintf(outs[o], "  Map file:\t\t%s\n", CmdLineOpts::mapFile);
     fprintf(outs[o], "  Input VCF:\t\t%s\n",
 	    CmdLineOpts::inVCFfile == NULL ? "[none: no genetic data]" :
@@ -72,6 +152,18 @@ int main(int argc, char **argv) {
 
     fprintf(outs[o], "  Random seed:\t\t%u\n\n", CmdLineOpts::randSeed);
 
+    if (CmdLineOpts::resume) {
+      if (resumeRecords >= 0)
+	fprintf(outs[o], "  Resuming from checkpoint after %ld VCF records\n\n",
+		resumeRecords);
+      else
+	fprintf(outs[o], "  No checkpoint to resume from: starting from the beginning\n\n");
+    }
+
+    if (CmdLineOpts::numShards > 0)
+      fprintf(outs[o], "  Shard:\t\t%d of %d\n\n", CmdLineOpts::shardIdx,
+	      CmdLineOpts::numShards);
+
     if (CmdLineOpts::fixedCOfile)
       fprintf(outs[o], "  Fixed CO file:\t%s\n\n",
 	      CmdLineOpts::fixedCOfile);
@@ -107,22 +199,47 @@ int main(int argc, char **argv) {
       else {
 	fprintf(outs[o], "  Output VCF will contain unphased data\n\n");
       }
+
+      if (CmdLineOpts::renderFile) {
+	fprintf(outs[o], "  Renders file:\t\t%s\n", CmdLineOpts::renderFile);
+	for(auto it = renders.begin(); it != renders.end(); it++) {
+	  fprintf(outs[o], "    %s:\terr %.1le, hom err %.2lf, miss %.1le, pseudo-hap %.1lg",
+		  it->name, it->genoErrRate, it->homErrRate, it->missRate,
+		  it->pseudoHapRate);
+	  if (it->haveSeed)
+	    fprintf(outs[o], ", seed %u", it->seed);
+	  fprintf(outs[o], "\n");
+	}
+	fprintf(outs[o], "\n");
+      }
     }
   }
 
+  PhaseTimer timer((CmdLineOpts::inFamFile) ? "fam file" :
+		   ((CmdLineOpts::popSize > 0) ? "population" : "def file"));
   vector<SimDetails> simDetails;
-  readDef(simDetails, CmdLineOpts::defFile);
-
+  if (CmdLineOpts::inFamFile)
+    readFam(simDetails, CmdLineOpts::inFamFile);
+  else if (CmdLineOpts::popSize > 0)
+    genPopulation(simDetails, CmdLineOpts::popSize, CmdLineOpts::popGens,
+		  CmdLineOpts::popSample, CmdLineOpts::popMonogamy,
+		  CmdLineOpts::popVar);
+  else
+    readDef(simDetails, CmdLineOpts::defFile);
+
+  timer.next("genetic map");
   bool sexSpecificMaps;
   GeneticMap map(CmdLineOpts::mapFile, sexSpecificMaps); // read the genetic map
 
   vector<COInterfere> coIntf;
   if (CmdLineOpts::interfereFile) {
+    timer.next("interference");
     COInterfere::read(coIntf, CmdLineOpts::interfereFile, map, sexSpecificMaps);
   }
 
 #ifndef NOFIXEDCO
   if (CmdLineOpts::fixedCOfile) {
+    timer.next("fixed COs");
     FixedCOs::read(CmdLineOpts::fixedCOfile, map);
   }
 #endif // NOFIXEDCO
@@ -143,10 +260,53 @@ int main(int argc, char **argv) {
 	fprintf(outs[o], "         output VCF will *not* include X chromosome data\n\n");
       }
     }
-    else if (CmdLineOpts::vcfSexesFile)
+    else if (CmdLineOpts::vcfSexesFile) {
+      timer.next("sexes file");
       readSexes(sexes, sexesCountData, CmdLineOpts::vcfSexesFile);
+    }
   }
 
+  if (CmdLineOpts::plan) {
+    timer.next("plan");
+    printPlan(simDetails, map, sexSpecificMaps, coIntf, renders, outs);
+    if (CmdLineOpts::maxMem > 0) {
+      for(int o = 0; o < 2; o++)
+	fprintf(outs[o], "\n");
+      MemStrategy memStrategy;
+      chooseMemStrategy(simDetails, map, sexSpecificMaps, coIntf, renders,
+			memStrategy, outs);
+    }
+    timer.stop();
+    if (CmdLineOpts::printTiming) {
+      PhaseTimer::print(log);
+      if (CmdLineOpts::timingJSONfile)
+	PhaseTimer::printJSON(CmdLineOpts::timingJSONfile);
+    }
+    if (CmdLineOpts::traceFile)
+      Trace::dump(CmdLineOpts::traceFile);
+    fclose(log);
+    return 0;
+  }
+
+  // With --max_mem, choose settings that keep the run within the budget, then
+  // track memory use against it
+  MemStrategy memStrategy = { 0, false, FileOrGZ<FILE *>::NUM_OUT_BUFS, 1 };
+  if (CmdLineOpts::maxMem > 0) {
+    timer.next("memory budget");
+    chooseMemStrategy(simDetails, map, sexSpecificMaps, coIntf, renders,
+		      memStrategy, outs);
+    if (memStrategy.serialStages)
+      CmdLineOpts::numThreads = 1;
+    FileOrGZ<FILE *>::maxOutBufs = memStrategy.numOutBufs;
+    FileOrGZ<gzFile>::maxOutBufs = memStrategy.numOutBufs;
+    timer.stop();
+    MemBudget::start(CmdLineOpts::maxMem, memStrategy.baseBytes);
+  }
+
+  if (CmdLineOpts::progressInterval > 0)
+    Progress::start(CmdLineOpts::progressInterval, log,
+		    CmdLineOpts::progressJSONfile);
+
   // The first index is the pedigree number corresponding to the description of
   // the pedigree to be simulated in the def file
   // The second index is the family: we replicate the same pedigree structure
@@ -163,99 +323,314 @@ int main(int argc, char **argv) {
   // The third index is the record index
   vector< vector< vector<InheritRecord> > > hapCarriers;
 
-  for(int o = 0; o < 2; o++) {
-    fprintf(outs[o], "Simulating haplotype transmissions... ");
-    fflush(outs[o]);
+  // With --max_mem, the replicates may be simulated and printed in batches.
+  // The batches are shards of the run (see simulate()), printed one after
+  // another to the same files.
+  vector<int> fullReps, fullFirstRep;
+  for(auto it = simDetails.begin(); it != simDetails.end(); it++) {
+    fullReps.push_back(it->numReps);
+    fullFirstRep.push_back(it->firstRep);
+  }
+  bool haveVCFstage = CmdLineOpts::inVCFfile && !CmdLineOpts::dryRun;
+  if (CmdLineOpts::printTiming)
+    PedCosts::start(simDetails.size());
+  if (Progress::enabled()) {
+    // replicates to simulate, in all batches
+    long totalReps = 0;
+    for(auto it = simDetails.begin(); it != simDetails.end(); it++)
+      totalReps += (CmdLineOpts::dryRun) ? 1 : it->numReps;
+    if (CmdLineOpts::numShards > 0) // with --shard (never with batches)
+      totalReps = totalReps * CmdLineOpts::shardIdx / CmdLineOpts::numShards -
+	    totalReps * (CmdLineOpts::shardIdx - 1) / CmdLineOpts::numShards;
+    Progress::begin(PROG_SIMULATION, totalReps);
   }
+  // For --edges: the transmissions simulate() makes in each batch
+  EdgeTable edgeTable;
+  if (CmdLineOpts::printEdges && !CmdLineOpts::dryRun)
+    EdgeTable::record(&edgeTable);
   vector<int> hapNumsBySex[2];
-  int totalFounderHaps = simulate(simDetails, theSamples, map, sexSpecificMaps,
-				  coIntf, hapCarriers, hapNumsBySex);
-  for(int o = 0; o < 2; o++)
-    fprintf(outs[o], "done.\n");
-
-  if (sexesCountData[0] > 0 || sexesCountData[1] > 0) {
-    if (sexesCountData[0] < hapNumsBySex[0].size() ||
-				  sexesCountData[1] < hapNumsBySex[1].size()) {
+  int totalFounderHaps = 0; // in the current batch
+  int runFounderHaps = 0;   // in all batches
+
+  // names of the files the output stages print (the same in every batch)
+  char *bpFile = new char[outFileLen];
+  char *nodesFile = new char[outFileLen];
+  char *edgesFile = new char[outFileLen];
+  char *ibdFile = new char[outFileLen];
+  char *mrcaFile = new char[outFileLen];
+  char *famFile = new char[outFileLen];
+  if (bpFile == NULL || nodesFile == NULL || edgesFile == NULL ||
+      ibdFile == NULL || mrcaFile == NULL || famFile == NULL) {
+    printf("ERROR: out of memory");
+    exit(5);
+  }
+  sprintf(bpFile, "%s.bp", CmdLineOpts::outPrefix);
+  sprintf(nodesFile, "%s.nodes", CmdLineOpts::outPrefix);
+  sprintf(edgesFile, "%s.edges", CmdLineOpts::outPrefix);
+  sprintf(ibdFile, "%s.seg", CmdLineOpts::outPrefix);
+  sprintf(mrcaFile, "%s.mrca", CmdLineOpts::outPrefix);
+  sprintf(famFile, "%s-everyone.fam", CmdLineOpts::outPrefix);
+
+  // Every batch does the same steps, so rather than repeat their status
+  // messages for each (there can be thousands), one message covers the run;
+  // --progress reports how far it has got
+  bool batchStatus = memStrategy.numBatches > 1;
+  if (batchStatus) {
+    for(int o = 0; o < 2; o++) {
+      fprintf(outs[o], "Simulating and printing %d batches... ",
+	      memStrategy.numBatches);
+      fflush(outs[o]);
+    }
+  }
+  for(int batch = 1; batch <= memStrategy.numBatches; batch++) {
+    if (memStrategy.numBatches > 1) {
+      for(unsigned int ped = 0; ped < simDetails.size(); ped++) {
+	simDetails[ped].numReps = fullReps[ped];
+	simDetails[ped].firstRep = fullFirstRep[ped];
+      }
+      CmdLineOpts::shardIdx = batch;
+      CmdLineOpts::numShards = memStrategy.numBatches;
+    }
+
+    if (!batchStatus) {
       for(int o = 0; o < 2; o++) {
-	fprintf(outs[o], "\n");
-	fprintf(outs[o], "ERROR: need the input VCF to contain at least %lu females and %lu males, but\n",
-		hapNumsBySex[1].size(), hapNumsBySex[0].size());
-	fprintf(outs[o], "       the sexes file indicates there are %u females and %u males in the VCF\n",
-		sexesCountData[1], sexesCountData[0]);
-	fprintf(outs[o], "       Note: it is always possible to run without an input VCF or to get\n");
-	fprintf(outs[o], "       autosomal genotypes by running without the --sexes option\n");
-	exit(8);
+	fprintf(outs[o], "Simulating haplotype transmissions... ");
+	fflush(outs[o]);
       }
     }
-  }
+    timer.next("simulation");
+    uint64_t simStart = Trace::now();
+    totalFounderHaps = simulate(simDetails, theSamples, map, sexSpecificMaps,
+				coIntf, hapCarriers, hapNumsBySex);
+    Trace::record("simulate", simStart);
+    if (batch == memStrategy.numBatches)
+      Progress::end(PROG_SIMULATION);
+    if (timer.active()) {
+      for(auto it1 = hapCarriers.begin(); it1 != hapCarriers.end(); it1++)
+	for(auto it2 = it1->begin(); it2 != it1->end(); it2++)
+	  PhaseTimer::count(CARRIER_RECS, it2->size());
+    }
+    timer.stop();
+    if (!batchStatus)
+      for(int o = 0; o < 2; o++)
+	fprintf(outs[o], "done.\n");
 
-  if (CmdLineOpts::printBP && !CmdLineOpts::dryRun) {
-    for(int o = 0; o < 2; o++) {
-      fprintf(outs[o], "Printing break points... ");
-      fflush(outs[o]);
+    if (CmdLineOpts::numShards > 0 && memStrategy.numBatches == 1) {
+      // manifest for merge-shards.py: which replicates this shard simulated
+      sprintf(outFile, "%s.shard", CmdLineOpts::outPrefix);
+      FILE *manifest = fopen(outFile, "w");
+      if (!manifest) {
+	printf("ERROR: could not open shard manifest %s!\n", outFile);
+	perror("open");
+	exit(1);
+      }
+      fprintf(manifest, "shard\t%d/%d\n", CmdLineOpts::shardIdx,
+	      CmdLineOpts::numShards);
+      fprintf(manifest, "seed\t%u\n", CmdLineOpts::randSeed);
+      fprintf(manifest, "def\t%s\n", (CmdLineOpts::inFamFile) ?
+				CmdLineOpts::inFamFile : CmdLineOpts::defFile);
+      fprintf(manifest, "outputs\t.seg%s%s%s\n",
+	      CmdLineOpts::printBP ? " .bp" : "",
+	      CmdLineOpts::printMRCA ? " .mrca" : "",
+	      CmdLineOpts::printFam ? " -everyone.fam" : "");
+      for(auto it = simDetails.begin(); it != simDetails.end(); it++)
+	// first replicate number (as in the sample ids) and count
+	fprintf(manifest, "ped\t%s\t%d\t%d\n", it->name, it->firstRep + 1,
+		it->numReps);
+      fclose(manifest);
     }
-    sprintf(outFile, "%s.bp", CmdLineOpts::outPrefix);
-    printBPs(simDetails, theSamples, map, /*bpFile=*/ outFile);
-    for(int o = 0; o < 2; o++) {
-      fprintf(outs[o], "done.\n");
+
+    if (sexesCountData[0] > 0 || sexesCountData[1] > 0) {
+      if (sexesCountData[0] < hapNumsBySex[0].size() ||
+				    sexesCountData[1] < hapNumsBySex[1].size()) {
+	for(int o = 0; o < 2; o++) {
+	  fprintf(outs[o], "\n");
+	  fprintf(outs[o], "ERROR: need the input VCF to contain at least %lu females and %lu males, but\n",
+		  hapNumsBySex[1].size(), hapNumsBySex[0].size());
+	  fprintf(outs[o], "       the sexes file indicates there are %u females and %u males in the VCF\n",
+		  sexesCountData[1], sexesCountData[0]);
+	  fprintf(outs[o], "       Note: it is always possible to run without an input VCF or to get\n");
+	  fprintf(outs[o], "       autosomal genotypes by running without the --sexes option\n");
+	  exit(8);
+	}
+      }
     }
-  }
 
-  if (!CmdLineOpts::dryRun) {
-    for(int o = 0; o < 2; o++) {
-      fprintf(outs[o], "Printing IBD segments");
-      if (CmdLineOpts::printMRCA)
-	fprintf(outs[o], " and MRCAs... ");
-      else
-	fprintf(outs[o], "... ");
-      fflush(outs[o]);
+    // The output stages below only read the simulation results (locatePrintIBD()
+    // modifies <hapCarriers>, but no other stage uses it) and each writes its own
+    // file(s), so they can run concurrently. The VCF stage runs on this thread
+    // and is the only one that prints status messages while the stages are in
+    // progress.
+    struct OutputStage {
+      const char *desc;    // for status messages
+      const char *note;    // printed after the stage completes (or NULL)
+      function<void()> run;
+    };
+    vector<OutputStage> stages;
+    bool append = batch > 1; // add to the files the earlier batches printed
+
+    if (CmdLineOpts::printBP && !CmdLineOpts::dryRun) {
+      stages.push_back({ "break points", NULL, [&, append]() {
+	printBPs(simDetails, theSamples, map, bpFile, append);
+      }});
     }
-    sprintf(outFile, "%s.seg", CmdLineOpts::outPrefix);
-    char *mrcaFile = NULL;
-    if (CmdLineOpts::printMRCA) {
-      mrcaFile = new char[outFileLen];
-      if (mrcaFile == NULL) {
-	printf("ERROR: out of memory");
-	exit(5);
+
+    if (CmdLineOpts::printEdges && !CmdLineOpts::dryRun) {
+      stages.push_back({ "edge tables", NULL, [&, append]() {
+	edgeTable.print(simDetails, theSamples, map, nodesFile, edgesFile,
+			append);
+      }});
+    }
+
+    if (!CmdLineOpts::dryRun) {
+      stages.push_back({ CmdLineOpts::printMRCA ? "IBD segments and MRCAs" :
+						  "IBD segments",
+			 NULL, [&, append]() {
+	locatePrintIBD(simDetails, hapCarriers, map, sexSpecificMaps, ibdFile,
+		       /*ibdFunc=print them only=*/ NULL,
+		       (CmdLineOpts::printMRCA) ? mrcaFile : NULL, append);
+      }});
+    }
+
+    if (CmdLineOpts::printFam) {
+      stages.push_back({ "fam file", "Do not use with PLINK data: see README.md",
+			 [&, append]() {
+	printFam(simDetails, theSamples, famFile, append);
+      }});
+    }
+
+    // How many threads to run the stages above on in addition to this one?
+    // Without a VCF to generate, this thread runs one of them
+    int numWorkers = stages.size();
+    if (!haveVCFstage)
+      numWorkers--;
+    if (CmdLineOpts::numThreads > 0 && CmdLineOpts::numThreads - 1 < numWorkers)
+      numWorkers = CmdLineOpts::numThreads - 1;
+    bool background = numWorkers > 0;
+    // print the status of each stage as it runs?
+    bool stageStatus = !background && !batchStatus;
+
+    // Runs stages until none remain. When they are run in the <background>, the
+    // status is printed after all have completed.
+    atomic<unsigned int> nextStage(0);
+    auto runStages = [&]() {
+      unsigned int i;
+      while ((i = nextStage++) < stages.size()) {
+	if (stageStatus) {
+	  for(int o = 0; o < 2; o++) {
+	    fprintf(outs[o], "Printing %s... ", stages[i].desc);
+	    fflush(outs[o]);
+	  }
+	}
+	PhaseTimer stageTimer(stages[i].desc);
+	TraceScope stageEvent(stages[i].desc);
+	stages[i].run();
+	stageTimer.stop();
+	if (stageStatus) {
+	  for(int o = 0; o < 2; o++) {
+	    if (stages[i].note)
+	      fprintf(outs[o], "done.  (%s)\n", stages[i].note);
+	    else
+	      fprintf(outs[o], "done.\n");
+	  }
+	}
       }
-      sprintf(mrcaFile, "%s.mrca", CmdLineOpts::outPrefix);
+    };
+
+    vector<thread> workers;
+    // the settings are thread-local: the workers need a copy (that outlives
+    // their start)
+    CmdLineOpts::Settings opts = CmdLineOpts::get();
+    if (background) {
+      for(int o = 0; o < 2 && !batchStatus; o++) {
+	fprintf(outs[o], "Printing ");
+	for(unsigned int i = 0; i < stages.size(); i++) {
+	  if (i > 0 && i + 1 == stages.size())
+	    fprintf(outs[o], (i == 1) ? " and " : ", and ");
+	  else if (i > 0)
+	    fprintf(outs[o], ", ");
+	  fprintf(outs[o], "%s", stages[i].desc);
+	}
+	fprintf(outs[o], " in the background\n");
+      }
+      for(int w = 0; w < numWorkers; w++)
+	workers.emplace_back([&]() {
+	  CmdLineOpts::set(opts);
+	  Trace::nameThread("output stages");
+	  runStages();
+	});
     }
-    locatePrintIBD(simDetails, hapCarriers, map, sexSpecificMaps,
-		   /*ibdFile=*/ outFile, /*ibdSegs=print them only=*/ NULL,
-		   mrcaFile);
-    for(int o = 0; o < 2; o++) {
-      fprintf(outs[o], "done.\n");
+    else {
+      // print these before the VCF: running all on this thread
+      runStages();
     }
-  }
 
-  if (CmdLineOpts::printFam) {
-    for(int o = 0; o < 2; o++)
-      fprintf(outs[o], "Printing fam file... ");
-    fflush(stdout);
-    sprintf(outFile, "%s-everyone.fam", CmdLineOpts::outPrefix);
-    printFam(simDetails, theSamples, /*famFile=*/ outFile);
-    for(int o = 0; o < 2; o++)
-      fprintf(outs[o], "done.  (Do not use with PLINK data: see README.md)\n");
-  }
+    if (haveVCFstage) {
+      for(int o = 0; o < 2; o++) {
+	fprintf(outs[o], "Reading input VCF meta data... ");
+	fflush(outs[o]);
+      }
+      // note: printVCF()'s callee makeVCF() print the status for generating the
+      // VCF file
 
-  if (CmdLineOpts::inVCFfile && !CmdLineOpts::dryRun) {
-    for(int o = 0; o < 2; o++) {
-      fprintf(outs[o], "Reading input VCF meta data... ");
-      fflush(outs[o]);
+      int ret = printVCF(simDetails, theSamples, totalFounderHaps,
+			 CmdLineOpts::inVCFfile, renders, map, outs,
+			 hapNumsBySex, sexes);
+
+      if (ret == 0 && !MemBudget::exceeded())
+	for(int o = 0; o < 2; o++)
+	  fprintf(outs[o], "done.\n");
     }
-    // note: printVCF()'s callee makeVCF() print the status for generating the
-    // VCF file
 
-    int ret = printVCF(simDetails, theSamples, totalFounderHaps,
-		       CmdLineOpts::inVCFfile, outFile, map, outs,
-		       hapNumsBySex, sexes);
+    if (background) {
+      // this thread is done with the VCF (if any): help with remaining stages
+      runStages();
+      for(auto it = workers.begin(); it != workers.end(); it++)
+	it->join();
+
+      for(int o = 0; o < 2 && !batchStatus; o++) {
+	fprintf(outs[o], "Finished printing background output\n");
+	for(auto it = stages.begin(); it != stages.end(); it++)
+	  if (it->note)
+	    fprintf(outs[o], "  Note on %s: %s\n", it->desc, it->note);
+      }
+    }
 
-    if (ret == 0)
-      for(int o = 0; o < 2; o++)
+    // the output stages have finished: end the run if any went over budget
+    MemBudget::enforce();
+
+    runFounderHaps += totalFounderHaps;
+
+    if (batchStatus && batch == memStrategy.numBatches) {
+      for(int o = 0; o < 2; o++) {
 	fprintf(outs[o], "done.\n");
+	for(auto it = stages.begin(); it != stages.end(); it++)
+	  if (it->note)
+	    fprintf(outs[o], "  Note on %s: %s\n", it->desc, it->note);
+      }
+    }
+
+    if (memStrategy.numBatches > 1) {
+      // free this batch's samples for the next one
+      deleteTheSamples(simDetails, theSamples);
+      hapCarriers.clear();
+      hapCarriers.shrink_to_fit();
+      for(int s = 0; s < 2; s++)
+	hapNumsBySex[s].clear();
+      MemBudget::set(MEM_SAMPLES, 0);
+      MemBudget::set(MEM_CARRIERS, 0);
+    }
+  } // <batch>
+  if (memStrategy.numBatches > 1) {
+    for(unsigned int ped = 0; ped < simDetails.size(); ped++) {
+      simDetails[ped].numReps = fullReps[ped];
+      simDetails[ped].firstRep = fullFirstRep[ped];
+    }
+    CmdLineOpts::shardIdx = CmdLineOpts::numShards = 0;
   }
-  else {
-    int numFoundersNeeded = totalFounderHaps / 2;
+
+  if (!haveVCFstage) {
+    int numFoundersNeeded = runFounderHaps / 2;
 
     if (CmdLineOpts::dryRun) {
       // with --dry_run, we only included one replicate per pedigree
@@ -286,6 +661,16 @@ int main(int argc, char **argv) {
 	      numFoundersNeeded);
   }
 
+  if (CmdLineOpts::printTiming) {
+    PhaseTimer::print(log);
+    PedCosts::print(log, simDetails);
+    if (CmdLineOpts::timingJSONfile)
+      PhaseTimer::printJSON(CmdLineOpts::timingJSONfile);
+  }
+  if (CmdLineOpts::traceFile)
+    Trace::dump(CmdLineOpts::traceFile);
+
+  Progress::stop();
   fclose(log);
 
   // NOTE: the memory isn't freed because the OS reclaims it when Ped-sim
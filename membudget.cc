@@ -0,0 +1,121 @@
+// ped-sim: pedigree simulation tool
+//
+// This program is distributed under the terms of the GNU General Public License
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <mutex>
+#include "membudget.h"
+#include "runerror.h"
+
+long MemBudget::limit = 0;
+long MemBudget::base = 0;
+atomic<long> MemBudget::used[NUM_MEM_CATEGORIES];
+atomic<bool> MemBudget::overrun(false);
+long MemBudget::overrunUsed[NUM_MEM_CATEGORIES];
+
+static const char *memCategoryNames[NUM_MEM_CATEGORIES] = {
+  "simulated samples", "carrier records", "IBD segments", "output buffers",
+  "edge tables"
+};
+
+void MemBudget::start(long limit, long baseBytes) {
+  for(int i = 0; i < NUM_MEM_CATEGORIES; i++)
+    used[i] = 0;
+  overrun = false;
+  base = baseBytes;
+  MemBudget::limit = limit;
+}
+
+void MemBudget::check() {
+  long total = base;
+  for(int i = 0; i < NUM_MEM_CATEGORIES; i++)
+    total += used[i];
+  if (total <= limit)
+    return;
+
+  // only the first overrun is recorded
+  static mutex overrunLock;
+  lock_guard<mutex> lk(overrunLock);
+  if (overrun)
+    return;
+  for(int i = 0; i < NUM_MEM_CATEGORIES; i++)
+    overrunUsed[i] = used[i];
+  overrun = true;
+}
+
+void MemBudget::enforce() {
+  if (!overrun)
+    return;
+
+  char buf[32];
+  sizeStr(buf, limit);
+  fprintf(stderr, "\nERROR: exceeded the memory budget of %s (--max_mem):\n", buf);
+  sizeStr(buf, base);
+  fprintf(stderr, "       %s at start", buf);
+  for(int i = 0; i < NUM_MEM_CATEGORIES; i++) {
+    sizeStr(buf, overrunUsed[i]);
+    fprintf(stderr, ", %s %s", buf, memCategoryNames[i]);
+  }
+  fprintf(stderr, "\n");
+  fprintf(stderr, "       Note: --plan estimates the memory a run needs\n");
+  fatalExit(5);
+}
+
+long MemBudget::personBytes(Person &person) {
+  long bytes = sizeof(Person) + person.packedLen;
+  for(int h = 0; h < 2; h++) {
+    bytes += person.haps[h].capacity() * sizeof(Haplotype);
+    for(auto it = person.haps[h].begin(); it != person.haps[h].end(); it++)
+      bytes += it->capacity() * sizeof(Segment);
+  }
+  return bytes;
+}
+
+long MemBudget::carrierBytes(vector< vector<InheritRecord> > &carriers) {
+  long bytes = sizeof(carriers) +
+			    carriers.capacity() * sizeof(vector<InheritRecord>);
+  for(auto it = carriers.begin(); it != carriers.end(); it++)
+    bytes += it->capacity() * sizeof(InheritRecord);
+  return bytes;
+}
+
+long MemBudget::parseSize(const char *str) {
+  char *endptr;
+  errno = 0;
+  double size = strtod(str, &endptr);
+  if (errno != 0 || endptr == str || size <= 0)
+    return -1;
+
+  double unit;
+  switch (*endptr) {
+    case 'k': case 'K': unit = 1024.0; break;
+    case '\0':
+    case 'm': case 'M': unit = 1024.0 * 1024; break;
+    case 'g': case 'G': unit = 1024.0 * 1024 * 1024; break;
+    case 't': case 'T': unit = 1024.0 * 1024 * 1024 * 1024; break;
+    default: return -1;
+  }
+  if (*endptr != '\0') {
+    endptr++;
+    if (*endptr == 'b' || *endptr == 'B')
+      endptr++;
+  }
+  if (*endptr != '\0')
+    return -1;
+  return (long) (size * unit);
+}
+
+void MemBudget::sizeStr(char buf[32], double bytes) {
+  const char *units[] = { "B", "kB", "MB", "GB", "TB", "PB" };
+  int u = 0;
+  while (bytes >= 1024 && u < 5) {
+    bytes /= 1024;
+    u++;
+  }
+  if (u == 0)
+    sprintf(buf, "%.0lf %s", bytes, units[u]);
+  else
+    sprintf(buf, "%.1lf %s", bytes, units[u]);
+}
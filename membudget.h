@@ -0,0 +1,90 @@
+// ped-sim: pedigree simulation tool
+//
+// This program is distributed under the terms of the GNU General Public License
+
+#include <stdio.h>
+#include <atomic>
+#include <vector>
+#include "datastructs.h"
+
+#ifndef MEMBUDGET_H
+#define MEMBUDGET_H
+
+using namespace std;
+
+// Memory tracked against --max_mem (names in membudget.cc)
+enum MemCategory {
+  MEM_SAMPLES,   // simulated Persons and their haplotype segments
+  MEM_CARRIERS,  // <hapCarriers>: who carries each founder haplotype
+  MEM_IBD_SEGS,  // <theSegs>: IBD segments of the replicate being printed
+  MEM_OUT_BUFS,  // buffers of the output files (including VCFs)
+  MEM_EDGES,     // for --edges: the transmissions and edges in the EdgeTable
+  NUM_MEM_CATEGORIES
+};
+
+////////////////////////////////////////////////////////////////////////////////
+// For --max_mem: tracks the bytes allocated for the largest data structures
+// of a run. Once start() is called, a run whose tracked memory (plus what was
+// in use when tracking started) exceeds the budget stops with an error
+// instead of waiting for the OS to kill it. Memory is added from any thread
+// (output stages, file writers), so exceeding the budget only records the
+// overrun: the loops that allocate stop early once exceeded() is true, and
+// the thread that runs the simulation calls enforce() to end the run. Before
+// start(), add() and release() are a test of one value. (chooseMemStrategy()
+// in plan.h selects settings that should keep a run within the budget.)
+class MemBudget {
+  public:
+    // Tracks memory from now on: <baseBytes> are already in use (the genetic
+    // map, etc.) and the run may use up to <limit> bytes in all
+    static void start(long limit, long baseBytes);
+    static bool active() { return limit > 0; }
+    // Whether the tracked memory has exceeded the budget
+    static bool exceeded() { return overrun; }
+    // If the budget was exceeded, prints what was in use at the time and ends
+    // the run (see fatalExit()). Only for the thread that runs the simulation,
+    // once no other thread is printing output
+    static void enforce();
+
+    static void add(MemCategory what, long bytes) {
+      if (limit > 0) {
+	used[what] += bytes;
+	check();
+      }
+    }
+    static void release(MemCategory what, long bytes) {
+      if (limit > 0)
+	used[what] -= bytes;
+    }
+    // For structures whose size is recomputed rather than tracked per
+    // allocation
+    static void set(MemCategory what, long bytes) {
+      if (limit > 0) {
+	used[what] = bytes;
+	check();
+      }
+    }
+
+    // Bytes allocated for <person> and its haplotypes, and for the carrier
+    // records of one founder haplotype
+    static long personBytes(Person &person);
+    static long carrierBytes(vector< vector<InheritRecord> > &carriers);
+
+    // Parses sizes such as 500M or 8G (binary units; no suffix means
+    // megabytes); returns -1 if <str> is not a valid size
+    static long parseSize(const char *str);
+    // Prints <bytes> with units to <buf>
+    static void sizeStr(char buf[32], double bytes);
+
+  private:
+    // Records an overrun if the tracked memory exceeds the budget
+    static void check();
+
+    static long limit;
+    static long base;
+    static atomic<long> used[NUM_MEM_CATEGORIES];
+    static atomic<bool> overrun;
+    // what was in use at the first overrun, for enforce()
+    static long overrunUsed[NUM_MEM_CATEGORIES];
+};
+
+#endif // MEMBUDGET_H
@@ -0,0 +1,86 @@
+#!/usr/bin/env python3
+
+"""
+Merge the output of a Ped-sim run split into shards with --shard <i>/<N>.
+
+Give the output prefix of every shard (in any order) and the prefix to write
+the merged files to. Each shard's <prefix>.shard manifest is checked to ensure
+all N shards of the same run (def file and seed) are present, and then the
+.seg, .bp, .mrca, and -everyone.fam files are concatenated in shard order.
+The results are the same as an unsharded run with the same seed.
+"""
+
+import optparse
+import sys
+
+################################################################################
+# FUNCTIONS
+################################################################################
+
+def parse_args():
+    """Parse command line arguments."""
+    parser = optparse.OptionParser(
+        usage='%prog -o <out_prefix> <shard_prefix> [<shard_prefix> ...]',
+        description='merge sharded Ped-sim output')
+
+    parser.add_option('-o', '--out_prefix', type='string', \
+        help='prefix for merged output files')
+
+    (opts, args) = parser.parse_args()
+
+    if not opts.out_prefix or len(args) == 0:
+        print('output prefix and shard prefixes are required\n')
+        parser.print_help()
+        sys.exit(1)
+
+    return opts, args
+
+def read_manifest(prefix):
+    """Read <prefix>.shard, returning a dictionary of its fields"""
+    manifest = {'ped': []}
+    with open(prefix + '.shard', 'r') as in_file:
+        for line in in_file:
+            fields = line.rstrip('\n').split('\t')
+            if fields[0] == 'ped':
+                manifest['ped'].append(tuple(fields[1:]))
+            else:
+                manifest[fields[0]] = fields[1]
+
+    idx, num = manifest['shard'].split('/')
+    manifest['idx'] = int(idx)
+    manifest['num'] = int(num)
+    return manifest
+
+def main():
+    opts, prefixes = parse_args()
+
+    shards = {}
+    for prefix in prefixes:
+        manifest = read_manifest(prefix)
+        manifest['prefix'] = prefix
+        if manifest['idx'] in shards:
+            sys.exit("ERROR: shard %d given more than once" % manifest['idx'])
+        shards[manifest['idx']] = manifest
+
+    first = shards[min(shards)]
+    for key in ['num', 'seed', 'def', 'outputs']:
+        for manifest in shards.values():
+            if manifest[key] != first[key]:
+                sys.exit("ERROR: shards %s and %s differ in %s" %
+                         (first['prefix'], manifest['prefix'], key))
+
+    missing = [i for i in range(1, first['num'] + 1) if i not in shards]
+    if missing:
+        sys.exit("ERROR: missing shard(s) " + \
+                 ", ".join(str(i) for i in missing))
+
+    for suffix in first['outputs'].split():
+        with open(opts.out_prefix + suffix, 'w') as out_file:
+            for i in range(1, first['num'] + 1):
+                with open(shards[i]['prefix'] + suffix, 'r') as in_file:
+                    for line in in_file:
+                        out_file.write(line)
+        print("wrote", opts.out_prefix + suffix)
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,165 @@
+// ped-sim: pedigree simulation tool
+//
+// This program is distributed under the terms of the GNU General Public License
+
+#include <stdio.h>
+#include <string.h>
+#include <assert.h>
+#include "packedhaps.h"
+#include "runerror.h"
+
+// Packed bytes of the individuals of the replicate being packed, and the
+// offset where each one starts: finishPacking() copies them to the
+// replicate's block
+static thread_local vector<uint8_t> repBytes;
+static thread_local vector< pair<Person *, uint32_t> > repPersons;
+
+// Haplotypes emptied by packHaps() (and lists of them), which addHap() reuses
+// rather than allocating anew for each individual
+static thread_local vector<Haplotype> spareHaps;
+static thread_local vector< vector<Haplotype> > spareHapLists;
+
+HapCursor::HapCursor(const Person &person, int h, unsigned int chrIdx) {
+  assert(person.packed != NULL);
+  const uint8_t *p = person.packed;
+  base = getVarint(p);
+  for(unsigned int b = 0; b < 2 * chrIdx + h; b++) {
+    uint32_t blockLen = getVarint(p);
+    p += blockLen;
+  }
+  uint32_t blockLen = getVarint(p);
+  cur = p;
+  end = p + blockLen;
+  foundHapNum = -1;
+  endPos = 0;
+  advance();
+}
+
+// Appends an empty Haplotype for the next chromosome of haplotype <h> of
+// <person> and returns it
+Haplotype &addHap(Person &person, int h) {
+  vector<Haplotype> &haps = person.haps[h];
+  if (haps.capacity() == 0 && !spareHapLists.empty()) {
+    haps.swap(spareHapLists.back());
+    spareHapLists.pop_back();
+  }
+  if (spareHaps.empty())
+    haps.emplace_back();
+  else {
+    haps.push_back(move(spareHaps.back()));
+    spareHaps.pop_back();
+  }
+  return haps.back();
+}
+
+// Packs the haplotypes of <person>, whose founder haplotypes are numbered from
+// <firstHap> up, and empties them (see HapCursor). <person.packed> is set when
+// finishPacking() is called after all the individuals in the replicate are
+// packed.
+void packHaps(Person &person, int firstHap, GeneticMap &map) {
+  repPersons.emplace_back(&person, repBytes.size());
+  HapCursor::putVarint(repBytes, firstHap);
+
+  // index of the next chromosome in each haplotype (males have no haplotype 0
+  // on X)
+  unsigned int nextChr[2] = { 0, 0 };
+  for(unsigned int chrIdx = 0; chrIdx < map.size(); chrIdx++) {
+    for(int h = 0; h < 2; h++) {
+      bool noHap = map.isX(chrIdx) && h == 0 && person.sex == 0;
+      // with --engine backward, the non-founders that aren't printed have no
+      // haplotypes
+      if (noHap || nextChr[h] >= person.haps[h].size()) {
+	repBytes.push_back(0); // empty block
+	continue;
+      }
+
+      Haplotype &hap = person.haps[h][ nextChr[h]++ ];
+      // write the segments after one byte for the block length, which is
+      // usually enough, then fill that in
+      size_t lenPos = repBytes.size();
+      repBytes.push_back(0);
+      int prevEnd = 0;
+      for(auto it = hap.begin(); it != hap.end(); it++) {
+	assert(it->foundHapNum >= firstHap && it->endPos > prevEnd);
+	HapCursor::putVarint(repBytes, it->foundHapNum - firstHap);
+	HapCursor::putVarint(repBytes, it->endPos - prevEnd);
+	prevEnd = it->endPos;
+      }
+      uint32_t blockLen = repBytes.size() - lenPos - 1;
+      int extraLen = HapCursor::varintLen(blockLen) - 1;
+      if (extraLen > 0)
+	repBytes.insert(repBytes.begin() + lenPos + 1, extraLen, 0);
+      for(int i = 0; i < extraLen; i++, blockLen >>= 7)
+	repBytes[lenPos + i] = (blockLen & 0x7f) | 0x80;
+      repBytes[lenPos + extraLen] = blockLen;
+    }
+  }
+
+  // keep the Segment storage for addHap() to reuse
+  for(int h = 0; h < 2; h++) {
+    for(auto it = person.haps[h].begin(); it != person.haps[h].end(); it++) {
+      it->clear();
+      spareHaps.push_back(move(*it));
+    }
+    person.haps[h].clear();
+    spareHapLists.emplace_back();
+    spareHapLists.back().swap(person.haps[h]);
+  }
+}
+
+// Stores the packed haplotypes of the individuals passed to packHaps() since
+// the last call in one block, which the first of them owns
+void finishPacking() {
+  if (repPersons.empty())
+    return;
+  uint8_t *block = new uint8_t[ repBytes.size() ];
+  if (block == NULL) {
+    printf("ERROR: out of memory");
+    fatalExit(5);
+  }
+  memcpy(block, repBytes.data(), repBytes.size());
+  for(unsigned int i = 0; i < repPersons.size(); i++) {
+    uint32_t start = repPersons[i].second;
+    uint32_t end = (i + 1 < repPersons.size()) ? repPersons[i + 1].second
+					       : repBytes.size();
+    repPersons[i].first->packed = block + start;
+    repPersons[i].first->packedLen = end - start;
+  }
+  repBytes.clear();
+  repPersons.clear();
+}
+
+// Frees the storage kept for addHap() to reuse
+void releaseSpareHaps() {
+  vector<Haplotype>().swap(spareHaps);
+  vector< vector<Haplotype> >().swap(spareHapLists);
+}
+
+// Decodes haplotype <h> of <person> on chromosome <chrIdx> into <hap>
+void unpackHap(const Person &person, int h, unsigned int chrIdx,
+	       Haplotype &hap) {
+  hap.clear();
+  HapCursor cursor(person, h, chrIdx);
+  if (!cursor.atSegment())
+    return;
+  do {
+    hap.emplace_back(cursor.foundHapNum, cursor.endPos);
+  } while (cursor.advance());
+}
+
+// Returns the number of segments in the packed haplotypes of <person>
+long countSegments(const Person &person) {
+  // each segment is two varints, and every varint has one byte without the
+  // continuation bit; the first varint and block lengths are the others
+  long numEnds = 0;
+  const uint8_t *p = person.packed;
+  const uint8_t *end = p + person.packedLen;
+  HapCursor::getVarint(p);
+  while (p < end) {
+    uint32_t blockLen = HapCursor::getVarint(p);
+    for(uint32_t i = 0; i < blockLen; i++)
+      numEnds += (p[i] & 0x80) == 0;
+    p += blockLen;
+  }
+  return numEnds / 2;
+}
@@ -0,0 +1,91 @@
+// ped-sim: pedigree simulation tool
+//
+// This program is distributed under the terms of the GNU General Public License
+
+#include <stdint.h>
+#include <vector>
+#include "datastructs.h"
+#include "geneticmap.h"
+
+#ifndef PACKEDHAPS_H
+#define PACKEDHAPS_H
+
+using namespace std;
+
+////////////////////////////////////////////////////////////////////////////////
+// Compact form of the haplotypes of a simulated Person. As vectors, each
+// Segment takes 8 bytes, and each chromosome's few Segments a vector of their
+// own (24 bytes plus a heap block), which dominates the memory of runs with
+// many samples. Once a replicate is simulated, packHaps() encodes each of its
+// individuals' haplotypes as unsigned LEB128 varints, and finishPacking()
+// stores them all in one block (see Person::packed). For each individual:
+//
+//   <number of the replicate's first founder haplotype>
+//   for each chromosome (in map order) and haplotype h (0, then 1):
+//     <number of bytes in the block>
+//     for each segment: <foundHapNum - first> <endPos - previous endPos>
+//
+// where the first segment's end is relative to 0 and a male's haplotype 0 on
+// X is an empty block. The block lengths are a skip index: a HapCursor steps
+// over the blocks before the one it reads without decoding them, then decodes
+// its segments one at a time as it advances.
+class HapCursor {
+  public:
+    HapCursor() : cur(NULL), end(NULL), base(0), foundHapNum(-1), endPos(0) { }
+    // Positions the cursor at the first segment of haplotype <h> of <person>
+    // on chromosome <chrIdx> (at the end if there are none)
+    HapCursor(const Person &person, int h, unsigned int chrIdx);
+
+    // Was the cursor positioned with the constructor above?
+    bool positioned() const { return cur != NULL; }
+    // Is it at a segment? (false only for an empty haplotype)
+    bool atSegment() const { return foundHapNum >= 0; }
+
+    // Moves to the next segment; returns false (leaving the fields below
+    // unchanged) if there are no more
+    bool advance() {
+      if (cur == end)
+	return false;
+      foundHapNum = base + getVarint(cur);
+      endPos += getVarint(cur);
+      return true;
+    }
+
+    static void putVarint(vector<uint8_t> &out, uint32_t value) {
+      while (value >= 0x80) {
+	out.push_back((value & 0x7f) | 0x80);
+	value >>= 7;
+      }
+      out.push_back(value);
+    }
+    static int varintLen(uint32_t value) {
+      int len = 1;
+      for( ; value >= 0x80; value >>= 7)
+	len++;
+      return len;
+    }
+    static uint32_t getVarint(const uint8_t *&p) {
+      uint32_t value = *p & 0x7f;
+      for(int shift = 7; *p++ & 0x80; shift += 7)
+	value |= (uint32_t) (*p & 0x7f) << shift;
+      return value;
+    }
+
+  private:
+    const uint8_t *cur, *end; // the next segment, and the end of the block
+    int base;
+
+  public:
+    // the current segment
+    int foundHapNum, endPos;
+};
+
+Haplotype &addHap(Person &person, int h);
+void packHaps(Person &person, int firstHap, GeneticMap &map);
+void finishPacking();
+void releaseSpareHaps();
+void unpackHap(const Person &person, int h, unsigned int chrIdx,
+	       Haplotype &hap);
+long countSegments(const Person &person);
+
+#endif // PACKEDHAPS_H
@@ -0,0 +1,77 @@
+// ped-sim: pedigree simulation tool
+//
+// This program is distributed under the terms of the GNU General Public License
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <algorithm>
+#include "pedcosts.h"
+#include "runerror.h"
+
+atomic<uint64_t> *PedCosts::costs = NULL;
+int PedCosts::numPeds = 0;
+
+void PedCosts::start(int numPeds) {
+  costs = new atomic<uint64_t>[numPeds * NUM_PED_COSTS];
+  if (costs == NULL) {
+    printf("ERROR: out of memory");
+    fatalExit(5);
+  }
+  for(int i = 0; i < numPeds * NUM_PED_COSTS; i++)
+    costs[i] = 0;
+  PedCosts::numPeds = numPeds;
+}
+
+uint64_t PedCosts::now() {
+  timespec t;
+  clock_gettime(CLOCK_MONOTONIC, &t);
+  return (uint64_t) t.tv_sec * 1000000000 + t.tv_nsec;
+}
+
+void PedCosts::print(FILE *out, vector<SimDetails> &simDetails) {
+  if (!costs)
+    return;
+
+  uint64_t totals[NUM_PED_COSTS] = { 0 };
+  for(int ped = 0; ped < numPeds; ped++)
+    for(int c = 0; c < NUM_PED_COSTS; c++)
+      totals[c] += costs[ped * NUM_PED_COSTS + c];
+  // share of the time spent on each entry (simulating and printing VCFs)
+  double totalSec = (totals[PED_SIM_NS] + totals[PED_VCF_NS]) * 1e-9;
+
+  // width of the name column
+  int nameWidth = strlen("Entry");
+  for(int ped = 0; ped < numPeds; ped++)
+    nameWidth = max(nameWidth, (int) strlen(simDetails[ped].name));
+
+  fprintf(out, "\nCost by def file entry:\n");
+  fprintf(out, "  %-*s %10s %10s %14s %14s %13s %10s %8s\n", nameWidth,
+	  "Entry", "Replicates", "Sim (s)", "Carrier recs", "IBD segments",
+	  "Printed (MB)", "VCF (s)", "Time %");
+  for(int ped = 0; ped < numPeds; ped++) {
+    atomic<uint64_t> *cur = &costs[ped * NUM_PED_COSTS];
+    double simSec = cur[PED_SIM_NS] * 1e-9;
+    double vcfSec = cur[PED_VCF_NS] * 1e-9;
+    fprintf(out, "  %-*s %10d %10.3lf %14lu %14lu %13.1lf %10.3lf %7.1lf%%\n",
+	    nameWidth, simDetails[ped].name, simDetails[ped].numReps, simSec,
+	    (unsigned long) cur[PED_CARRIER_RECS].load(),
+	    (unsigned long) cur[PED_IBD_RECS].load(),
+	    cur[PED_OUT_BYTES] / (1024.0 * 1024), vcfSec,
+	    (totalSec > 0) ? 100.0 * (simSec + vcfSec) / totalSec : 0.0);
+  }
+  int totalReps = 0;
+  for(int ped = 0; ped < numPeds; ped++)
+    totalReps += simDetails[ped].numReps;
+  fprintf(out, "  %-*s %10d %10.3lf %14lu %14lu %13.1lf %10.3lf\n",
+	  nameWidth, "Total", totalReps, totals[PED_SIM_NS] * 1e-9,
+	  (unsigned long) totals[PED_CARRIER_RECS],
+	  (unsigned long) totals[PED_IBD_RECS],
+	  totals[PED_OUT_BYTES] / (1024.0 * 1024), totals[PED_VCF_NS] * 1e-9);
+  fprintf(out, "  (printed sizes are before any compression");
+  if (totals[PED_VCF_NS] > 0)
+    fprintf(out, "; VCF times and sizes are estimated from every %dth record",
+	    PED_COST_SAMPLE);
+  fprintf(out, ")\n");
+}
@@ -0,0 +1,59 @@
+// ped-sim: pedigree simulation tool
+//
+// This program is distributed under the terms of the GNU General Public License
+
+#include <stdio.h>
+#include <stdint.h>
+#include <atomic>
+#include <vector>
+#include "datastructs.h"
+
+#ifndef PEDCOSTS_H
+#define PEDCOSTS_H
+
+using namespace std;
+
+// Costs tracked for each def file entry
+enum PedCost {
+  PED_SIM_NS,       // nanoseconds simulating its replicates
+  PED_CARRIER_RECS, // haplotype carrier records of its founder haplotypes
+  PED_IBD_RECS,     // IBD segments found
+  PED_OUT_BYTES,    // bytes printed to all output files, before any
+		    // compression (VCFs estimated)
+  PED_VCF_NS,       // nanoseconds printing its genotypes (estimated)
+  NUM_PED_COSTS
+};
+
+// With --timing, makeVCF() times the genotypes of each pedigree at every
+// PED_COST_SAMPLE-th record and scales these up to estimate the totals
+const int PED_COST_SAMPLE = 16;
+
+////////////////////////////////////////////////////////////////////////////////
+// For --timing: the work and output of each def file entry (i.e., each
+// SimDetails), printed to the log as a table so that expensive entries can be
+// rebalanced or run as separate jobs. Totals accumulate across --max_mem
+// batches. Unless start() has been called, add() is a test of one pointer.
+class PedCosts {
+  public:
+    // Tracks the costs of <numPeds> def file entries from now on
+    static void start(int numPeds);
+    static bool active() { return costs != NULL; }
+
+    static void add(int ped, PedCost what, uint64_t num) {
+      if (costs)
+	costs[ped * NUM_PED_COSTS + what].fetch_add(num,
+						    memory_order_relaxed);
+    }
+
+    // Nanoseconds on the monotonic clock
+    static uint64_t now();
+
+    // Prints the table of costs for the entries in <simDetails>
+    static void print(FILE *out, vector<SimDetails> &simDetails);
+
+  private:
+    static atomic<uint64_t> *costs;
+    static int numPeds;
+};
+
+#endif // PEDCOSTS_H
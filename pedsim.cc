@@ -0,0 +1,362 @@
+// ped-sim: pedigree simulation tool
+//
+// This program is distributed under the terms of the GNU General Public License
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <unordered_map>
+#include "pedsim.h"
+#include "readdef.h"
+#include "readfam.h"
+#include "population.h"
+#include "simulate.h"
+#include "packedhaps.h"
+#include "runerror.h"
+
+// Installs the settings and random number generator of a PedSim object on the
+// calling thread (where the rest of the code reads them) while the Scope
+// exists; afterwards saves the generator's state back to the object and
+// restores the thread's own values. Errors within the Scope throw a RunError
+// (see fatalExit())
+class PedSim::Scope {
+  public:
+    Scope(PedSim &s) : sim(s), savedOpts(CmdLineOpts::get()),
+		       savedGen(randomGen) {
+      CmdLineOpts::set(sim.opts);
+      randomGen = sim.rng;
+    }
+    ~Scope() {
+      sim.rng = randomGen;
+      randomGen = savedGen;
+      CmdLineOpts::set(savedOpts);
+    }
+
+  private:
+    PedSim &sim;
+    CmdLineOpts::Settings savedOpts;
+    mt19937 savedGen;
+    ErrorScope errScope;
+};
+
+// Runs <func> within a Scope; returns 0 or the status of the error that ended
+// it
+int PedSim::run(const function<void()> &func) {
+  Scope scope(*this);
+  try {
+    func();
+  }
+  catch (RunError &err) {
+    return err.status;
+  }
+  return 0;
+}
+
+// Runs <func>, which adds pedigrees to <simDetails>; on an error, removes and
+// frees any it added
+int PedSim::readPeds(const function<void()> &func) {
+  clearResults();
+  size_t prevSize = simDetails.size();
+  int status = run(func);
+  if (status != 0) {
+    // entries that were added only share arrays with each other or earlier
+    // ones, so they can be freed on their own
+    vector<SimDetails> added(simDetails.begin() + prevSize, simDetails.end());
+    simDetails.erase(simDetails.begin() + prevSize, simDetails.end());
+    deleteSimDetails(added);
+  }
+  return status;
+}
+
+PedSim::PedSim(const char *mapFile, const char *interfereFile) {
+  opts = CmdLineOpts::get();
+  opts.autoSeed = false;
+  if (opts.chrX == NULL)
+    opts.chrX = (char *) "X";
+  log = NULL;
+  vcfSexes = NULL;
+  theSamples = NULL;
+  totalFounderHaps = 0;
+
+  map = NULL;
+  coIntf = new vector<COInterfere>;
+  ownMap = true;
+  initErr = run([&]() {
+    map = new GeneticMap((char *) mapFile, sexSpecificMaps);
+    if (interfereFile)
+      COInterfere::read(*coIntf, (char *) interfereFile, *map,
+			sexSpecificMaps);
+  });
+}
+
+PedSim::PedSim(GeneticMap &theMap, bool sexSpecific,
+	       vector<COInterfere> &theCoIntf) {
+  opts = CmdLineOpts::get();
+  opts.autoSeed = false;
+  if (opts.chrX == NULL)
+    opts.chrX = (char *) "X";
+  log = NULL;
+  vcfSexes = NULL;
+  theSamples = NULL;
+  totalFounderHaps = 0;
+
+  map = &theMap;
+  sexSpecificMaps = sexSpecific;
+  coIntf = &theCoIntf;
+  ownMap = false;
+  initErr = 0;
+}
+
+PedSim::~PedSim() {
+  clearResults();
+  deleteSimDetails(simDetails);
+  if (ownMap) {
+    delete map;
+    delete coIntf;
+  }
+}
+
+void PedSim::setSeed(unsigned int seed) {
+  opts.randSeed = seed;
+  rng.seed(seed);
+}
+
+int PedSim::readDef(const char *defFile) {
+  return readPeds([&]() { ::readDef(simDetails, (char *) defFile); });
+}
+
+int PedSim::readFam(const char *famFile) {
+  return readPeds([&]() { ::readFam(simDetails, famFile); });
+}
+
+int PedSim::genPopulation(int popSize, int numGen, int numSample,
+			  double monogamyRate, double offspringVar) {
+  return readPeds([&]() {
+    ::genPopulation(simDetails, popSize, numGen, numSample, monogamyRate,
+		    offspringVar);
+  });
+}
+
+int PedSim::readDefText(const char *defText) {
+  return readPeds([&]() {
+    FILE *in = fmemopen((void *) defText, strlen(defText), "r");
+    if (!in) {
+      fprintf(stderr, "ERROR: could not read def text\n");
+      perror("fmemopen");
+      fatalExit(1);
+    }
+    try {
+      ::readDef(simDetails, in);
+    }
+    catch (RunError &err) {
+      fclose(in);
+      throw;
+    }
+    fclose(in);
+  });
+}
+
+int PedSim::simulate() {
+  clearResults();
+  int status = run([&]() {
+    totalFounderHaps = ::simulate(simDetails, theSamples, *map,
+				  sexSpecificMaps, *coIntf, hapCarriers,
+				  hapNumsBySex);
+  });
+  if (status != 0)
+    clearResults(); // frees the partial results
+  return status;
+}
+
+// Frees the results of simulate() (if any)
+void PedSim::clearResults() {
+  if (theSamples) {
+    Scope scope(*this); // deleteTheSamples() reads the --dry_run setting
+    deleteTheSamples(simDetails, theSamples);
+    theSamples = NULL;
+  }
+  hapCarriers.clear();
+  for(int s = 0; s < 2; s++)
+    hapNumsBySex[s].clear();
+  totalFounderHaps = 0;
+}
+
+int PedSim::getBreakPoints(HapFunc func) {
+  assert(theSamples != NULL);
+  return run([&]() {
+    vector<PedSimSample> samples = printedSamples();
+    Haplotype hap; // decoded from the packed form (see packedhaps.h)
+    for(auto it = samples.begin(); it != samples.end(); it++) {
+      Person &person =
+	      theSamples[it->ped][it->rep][it->gen][it->branch][it->ind];
+      for(int h = 0; h < 2; h++) {
+	for(unsigned int chr = 0; chr < map->size(); chr++) {
+	  if (map->isX(chr) && person.sex == 0 && h == 0)
+	    continue; // no paternal X chromosome in males
+	  unpackHap(person, h, chr, hap);
+	  func(*it, person.sex, h, chr, hap);
+	}
+      }
+    }
+  });
+}
+
+int PedSim::getIBDSegments(IBDSegFunc func) {
+  assert(theSamples != NULL);
+  return run([&]() {
+    locatePrintIBD(simDetails, hapCarriers, *map, sexSpecificMaps,
+		   /*ibdFile=*/ NULL, &func, /*mrcaFile=*/ NULL);
+  });
+}
+
+int PedSim::printBPs(const char *bpFile) {
+  assert(theSamples != NULL);
+  return run([&]() {
+    ::printBPs(simDetails, theSamples, *map, (char *) bpFile);
+  });
+}
+
+int PedSim::printIBD(const char *ibdFile, const char *mrcaFile) {
+  assert(theSamples != NULL);
+  return run([&]() {
+    locatePrintIBD(simDetails, hapCarriers, *map, sexSpecificMaps,
+		   (char *) ibdFile, /*ibdFunc=*/ NULL, (char *) mrcaFile);
+  });
+}
+
+int PedSim::printFam(const char *famFile) {
+  assert(theSamples != NULL);
+  return run([&]() {
+    ::printFam(simDetails, theSamples, famFile);
+  });
+}
+
+int PedSim::getGenotypes(const char *inVCFfile, GenoFunc func) {
+  return makeVCF(inVCFfile, &func);
+}
+
+int PedSim::printVCF(const char *inVCFfile) {
+  return makeVCF(inVCFfile, /*genoFunc=*/ NULL);
+}
+
+// Generates genotypes using the settings in <opts>, printing them to the
+// standard output VCF if <genoFunc> is NULL
+int PedSim::makeVCF(const char *inVCFfile, GenoFunc *genoFunc) {
+  assert(theSamples != NULL);
+
+  vector<RenderSpec> renders(1);
+  RenderSpec &render = renders.back();
+  render.name = NULL;
+  render.haveSeed = false;
+  render.seed = 0;
+  render.genoErrRate = opts.genoErrRate;
+  render.homErrRate = opts.homErrRate;
+  render.missRate = opts.missRate;
+  render.pseudoHapRate = opts.pseudoHapRate;
+  render.genoFunc = genoFunc;
+
+  unordered_map<const char*,uint8_t,HashString,EqString> readSexesMap;
+  FILE *devNull = NULL;
+  int ret = 0;
+  int status = run([&]() {
+    unordered_map<const char*,uint8_t,HashString,EqString> *sexes = vcfSexes;
+    if (sexes == NULL) {
+      sexes = &readSexesMap;
+      uint32_t sexesCountData[2] = { 0, 0 };
+      if (opts.vcfSexesFile && map->haveXmap())
+	readSexes(readSexesMap, sexesCountData, opts.vcfSexesFile);
+    }
+
+    // status messages go to <log> or nowhere
+    devNull = fopen("/dev/null", "w");
+    if (!devNull) {
+      fprintf(stderr, "ERROR: could not open /dev/null\n");
+      perror("open");
+      fatalExit(1);
+    }
+    FILE *outs[2] = { (log) ? log : devNull, devNull };
+
+    ret = ::printVCF(simDetails, theSamples, totalFounderHaps, inVCFfile,
+		     renders, *map, outs, hapNumsBySex, *sexes);
+  });
+
+  if (devNull)
+    fclose(devNull);
+  for(auto it = readSexesMap.begin(); it != readSexesMap.end(); it++)
+    delete [] it->first;
+
+  return (status != 0) ? status : ret;
+}
+
+vector<PedSimSample> PedSim::printedSamples() {
+  vector<PedSimSample> samples;
+  if (theSamples == NULL)
+    return samples;
+
+  for(unsigned int ped = 0; ped < simDetails.size(); ped++) {
+    int numReps = simDetails[ped].numReps;
+    int numGen = simDetails[ped].numGen;
+    int **numSampsToPrint = simDetails[ped].numSampsToPrint;
+    int *numBranches = simDetails[ped].numBranches;
+    Parent **branchParents = simDetails[ped].branchParents;
+    int **branchNumSpouses = simDetails[ped].branchNumSpouses;
+
+    for(int rep = 0; rep < numReps; rep++) {
+      for(int gen = 0; gen < numGen; gen++) {
+	for(int branch = 0; branch < numBranches[gen]; branch++) {
+	  if (numSampsToPrint[gen][branch] > 0) {
+	    int numNonFounders, numFounders;
+	    getPersonCounts(gen, numGen, branch, numSampsToPrint,
+			    branchParents, branchNumSpouses, numFounders,
+			    numNonFounders);
+	    int numPersons = numNonFounders + numFounders;
+	    for(int ind = 0; ind < numPersons; ind++)
+	      samples.push_back({ (int) ped, rep, gen, branch, ind });
+	  }
+	}
+      }
+    }
+  }
+
+  return samples;
+}
+
+int PedSim::numFoundersNeeded() {
+  int total = 0;
+  for(unsigned int ped = 0; ped < simDetails.size(); ped++) {
+    int numGen = simDetails[ped].numGen;
+    int perRep = 0;
+    // no founders in the last generation
+    for(int gen = 0; gen < numGen - 1; gen++) {
+      for(int branch = 0; branch < simDetails[ped].numBranches[gen];
+								    branch++) {
+	int numFounders, numNonFounders;
+	getPersonCounts(gen, numGen, branch, simDetails[ped].numSampsToPrint,
+			simDetails[ped].branchParents,
+			simDetails[ped].branchNumSpouses, numFounders,
+			numNonFounders);
+	perRep += numFounders;
+      }
+    }
+    total += simDetails[ped].numReps * perRep;
+  }
+  return total;
+}
+
+string PedSim::sampleId(const PedSimSample &samp) {
+  SimDetails &pedDetails = simDetails[samp.ped];
+  int numSpouses = getBranchNumSpouses(pedDetails, samp.gen, samp.branch);
+  if (pedDetails.sampleIds) // from a fam file
+    return string(pedDetails.name) + to_string(pedDetails.firstRep + samp.rep+1)
+	      + "_" + pedDetails.sampleIds[samp.gen][samp.branch];
+  char suffix[60];
+  // as in printSampleId(): spouses are first, then the i individuals
+  if (samp.ind < numSpouses)
+    sprintf(suffix, "%d_g%d-b%d-s%d", pedDetails.firstRep + samp.rep+1,
+	    samp.gen+1, samp.branch+1, samp.ind+1);
+  else
+    sprintf(suffix, "%d_g%d-b%d-i%d", pedDetails.firstRep + samp.rep+1,
+	    samp.gen+1, samp.branch+1, samp.ind - numSpouses + 1);
+  return string(pedDetails.name) + suffix;
+}
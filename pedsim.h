@@ -0,0 +1,161 @@
+// ped-sim: pedigree simulation tool
+//
+// This program is distributed under the terms of the GNU General Public License
+
+#include <stdio.h>
+#include <vector>
+#include <string>
+#include <random>
+#include <functional>
+#include <unordered_map>
+#include "cmdlineopts.h"
+#include "datastructs.h"
+#include "geneticmap.h"
+#include "cointerfere.h"
+#include "ibdseg.h"
+#include "bpvcffam.h"
+
+#ifndef PEDSIM_H
+#define PEDSIM_H
+
+using namespace std;
+
+////////////////////////////////////////////////////////////////////////////////
+// Identifies a simulated sample; all values are 0-based, with the same
+// meanings as the indexes of <theSamples> (and the ids printed in the output
+// files: ped gives the name, rep + 1 the number after it, etc.)
+struct PedSimSample {
+  int ped, rep, gen, branch, ind;
+};
+
+// Receives haplotype <h> of <samp> on chromosome <chrIdx>: each Segment gives
+// the founder haplotype number and the last position it spans, with the first
+// starting at the map's start position for the chromosome. (The same
+// information as the .bp file; males have no haplotype 0 on the X.)
+typedef function<void(const PedSimSample &samp, int sex, int h,
+		      unsigned int chrIdx, const Haplotype &hap)> HapFunc;
+
+////////////////////////////////////////////////////////////////////////////////
+// Library interface to the simulator (built with `make lib`). A PedSim object
+// holds the genetic map, crossover model, pedigree definitions, settings, and
+// random number state for one simulation and passes the results to callbacks
+// rather than writing files.
+//
+// Separate objects can be used on separate threads at the same time; a single
+// object must only be used by one thread at a time. Errors in the input files
+// or settings print a message as they do for the program (to stderr or
+// stdout) and the methods that return an int then return the status the
+// program would have exited with; these return 0 on success. After an error,
+// the object holds no simulation results, and a failed read adds no pedigrees.
+// Fixed crossovers are process-wide: once FixedCOs::read() is called, all
+// objects use them.
+class PedSim {
+  public:
+    // Reads <mapFile> and, if non-NULL, <interfereFile>; with a NULL
+    // <interfereFile>, simulates using the Poisson model. If either can't be
+    // read, initError() is nonzero and the object must not be used
+    PedSim(const char *mapFile, const char *interfereFile);
+    // Uses a map and interference parameters that have already been read;
+    // these can be shared by many objects and must outlive them. An empty
+    // <coIntf> gives the Poisson model
+    PedSim(GeneticMap &map, bool sexSpecificMaps, vector<COInterfere> &coIntf);
+    ~PedSim();
+
+    int initError() { return initErr; }
+
+    // Settings, as for the corresponding command line options. Initially a
+    // copy of the creating thread's settings (the defaults in a program that
+    // doesn't parse a command line), except autoSeed is false. The input and
+    // output file names are not used, apart from <vcfSexesFile> and the
+    // <outPrefix> for printVCF()
+    CmdLineOpts::Settings opts;
+
+    // Where to print status messages and warnings; NULL discards them
+    FILE *log;
+
+    // If non-NULL, the sexes of the input VCF samples (as from readSexes());
+    // used in place of reading <opts.vcfSexesFile> so that many objects can
+    // share one copy
+    unordered_map<const char*,uint8_t,HashString,EqString> *vcfSexes;
+
+    // As with --seed, each replicate is simulated from a stream seeded by
+    // <seed>, its pedigree, and its number, so simulate() gives the same
+    // results each time it's called with the same seed
+    void setSeed(unsigned int seed);
+
+    // Read pedigree definitions (in def file format) from a file or string,
+    // adding to any previously read and discarding any simulation results
+    int readDef(const char *defFile);
+    int readDefText(const char *defText);
+    // Read pedigrees from a PLINK fam file, one per family (as with --in_fam)
+    int readFam(const char *famFile);
+    // Generate a random population pedigree (as with --pop; see
+    // genPopulation() in population.cc) using this object's random seed
+    int genPopulation(int popSize, int numGen, int numSample = 0,
+		      double monogamyRate = 1.0, double offspringVar = 2.0);
+
+    // Simulates all the pedigrees read, replacing any previous results
+    int simulate();
+
+    // Pass the results of the last simulate() call to a callback. Segments
+    // and haplotypes are only given for printed samples; see printedSamples()
+    int getBreakPoints(HapFunc func);
+    int getIBDSegments(IBDSegFunc func);
+    // Generates genotypes from the phased haplotypes in <inVCFfile> (as with
+    // -i), calling <func> for each record with the alleles of each sample in
+    // the order of printedSamples() (and then any samples retained using
+    // <opts.retainExtra>). Also returns 1 if the input VCF contains unphased
+    // data
+    int getGenotypes(const char *inVCFfile, GenoFunc func);
+
+    // Print the results of the last simulate() call to the standard output
+    // files. printIBD() prints the .mrca file if <mrcaFile> is non-NULL, which
+    // requires <opts.printMRCA> to have been set during simulate().
+    // printVCF() names its output using <opts.outPrefix> and returns as
+    // getGenotypes() does
+    int printBPs(const char *bpFile);
+    int printIBD(const char *ibdFile, const char *mrcaFile);
+    int printFam(const char *famFile);
+    int printVCF(const char *inVCFfile);
+
+    // The printed samples, in the order their genotypes are given
+    vector<PedSimSample> printedSamples();
+    // Id of <samp> as it would appear in the output files
+    string sampleId(const PedSimSample &samp);
+    // Number of founder haplotypes the last simulation used (half this many
+    // input samples are needed to generate genotypes)
+    int numFounderHaps() { return totalFounderHaps; }
+    // Number of founders of each sex (0: male, 1: female) in the last
+    // simulation; generating genotypes with the input sexes known needs
+    // input samples of these sexes
+    int numFounders(int sex) { return hapNumsBySex[sex].size(); }
+    // Number of founders the pedigrees that have been read need, which is
+    // known before simulating them
+    int numFoundersNeeded();
+
+    GeneticMap &getMap() { return *map; }
+
+  private:
+    class Scope;
+
+    int run(const function<void()> &func);
+    int readPeds(const function<void()> &func);
+    void clearResults();
+    int makeVCF(const char *inVCFfile, GenoFunc *genoFunc);
+
+    GeneticMap *map;
+    bool sexSpecificMaps;
+    vector<COInterfere> *coIntf;
+    bool ownMap; // did this object read <map> and <coIntf>?
+    int initErr;
+
+    mt19937 rng;
+
+    vector<SimDetails> simDetails;
+    Person *****theSamples; // NULL until simulate() is called
+    vector< vector< vector<InheritRecord> > > hapCarriers;
+    vector<int> hapNumsBySex[2];
+    int totalFounderHaps;
+};
+
+#endif // PEDSIM_H
@@ -0,0 +1,311 @@
+// ped-sim: pedigree simulation tool
+//
+// This program is distributed under the terms of the GNU General Public License
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#ifdef __linux__
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#endif // __linux__
+#include <vector>
+#include <algorithm>
+#include <mutex>
+#include <atomic>
+#include "phasetimer.h"
+#include "cmdlineopts.h"
+#include "runerror.h"
+
+static const char *countNames[NUM_PHASE_COUNTS] = {
+  "meioses", "crossovers", "segments", "carrier records", "IBD segments",
+  "sites", "genotypes"
+};
+
+static const char *perfNames[NUM_PERF_COUNTS] = {
+  "cycles", "instructions", "cache references", "cache misses", "branches",
+  "branch misses"
+};
+
+// A completed phase, or the totals of all those with the same name (starting
+// when the first did)
+struct PhaseRecord {
+  const char *name;
+  double start;   // seconds on the monotonic clock
+  double wall;
+  double cpu;
+  long peakRSS;   // in kB, over the whole process up to the end of the phase
+  uint64_t counts[NUM_PHASE_COUNTS];
+  int perfMask;   // bit i set if perf[i] was counted (with --perf)
+  uint64_t perf[NUM_PERF_COUNTS];
+};
+
+// phases may complete on any thread
+static mutex recordsLock;
+static vector<PhaseRecord> records;
+
+thread_local PhaseTimer *PhaseTimer::current = NULL;
+
+// If --perf can't count any events, the errno; the reason is printed in the log
+static atomic<int> perfErrno(0);
+
+static double toSeconds(const timespec &t) {
+  return t.tv_sec + t.tv_nsec * 1e-9;
+}
+
+bool comparePhaseStart(const PhaseRecord &a, const PhaseRecord &b) {
+  return a.start < b.start;
+}
+
+PhaseTimer::PhaseTimer(const char *name) {
+  running = false;
+  for(int i = 0; i < NUM_PERF_COUNTS; i++)
+    perfFds[i] = -1;
+  if (CmdLineOpts::printTiming)
+    start(name);
+}
+
+void PhaseTimer::start(const char *name) {
+  this->name = name;
+  running = true;
+  memset(counts, 0, sizeof(counts));
+  outer = current;
+  current = this;
+  if (CmdLineOpts::perfCounters)
+    startPerf();
+  clock_gettime(CLOCK_MONOTONIC, &wallStart);
+  clock_gettime(CLOCK_THREAD_CPUTIME_ID, &cpuStart);
+}
+
+#ifdef __linux__
+// Opens the events as one group on the calling thread so that they're counted
+// over the same time; events the hardware doesn't support are left out
+void PhaseTimer::startPerf() {
+  const uint64_t configs[NUM_PERF_COUNTS] = {
+    PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS,
+    PERF_COUNT_HW_CACHE_REFERENCES, PERF_COUNT_HW_CACHE_MISSES,
+    PERF_COUNT_HW_BRANCH_INSTRUCTIONS, PERF_COUNT_HW_BRANCH_MISSES
+  };
+
+  int leader = -1;
+  for(int i = 0; i < NUM_PERF_COUNTS; i++) {
+    perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = PERF_TYPE_HARDWARE;
+    attr.config = configs[i];
+    attr.disabled = (leader < 0);
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED |
+		       PERF_FORMAT_TOTAL_TIME_RUNNING;
+    perfFds[i] = syscall(__NR_perf_event_open, &attr, /*pid=this thread=*/ 0,
+			 /*cpu=any=*/ -1, leader, 0);
+    if (perfFds[i] < 0) {
+      if (leader < 0)
+	perfErrno = errno;
+      continue;
+    }
+    if (leader < 0)
+      leader = perfFds[i];
+  }
+
+  if (leader >= 0) {
+    ioctl(leader, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+    ioctl(leader, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+  }
+}
+
+int PhaseTimer::stopPerf(uint64_t perf[NUM_PERF_COUNTS]) {
+  int leader = -1;
+  for(int i = 0; i < NUM_PERF_COUNTS && leader < 0; i++)
+    leader = perfFds[i];
+  if (leader < 0)
+    return 0;
+
+  ioctl(leader, PERF_EVENT_IOC_DISABLE, PERF_IOC_FLAG_GROUP);
+  // number of events, time enabled, time running, then the counts in the
+  // order the events were opened
+  uint64_t values[3 + NUM_PERF_COUNTS];
+  ssize_t len = ::read(leader, values, sizeof(values));
+
+  int mask = 0;
+  int v = 3;
+  for(int i = 0; i < NUM_PERF_COUNTS; i++) {
+    if (perfFds[i] < 0)
+      continue;
+    // values[2] is 0 if the group never got onto the hardware (other users
+    // of the counters); scale for the time it was multiplexed out
+    if (len >= (ssize_t) ((v + 1) * sizeof(uint64_t)) && values[2] > 0) {
+      perf[i] = values[v] * ((double) values[1] / values[2]);
+      mask |= 1 << i;
+    }
+    v++;
+    close(perfFds[i]);
+    perfFds[i] = -1;
+  }
+  return mask;
+}
+#else
+void PhaseTimer::startPerf() {
+  perfErrno = ENOSYS; // only supported on Linux
+}
+
+int PhaseTimer::stopPerf(uint64_t perf[NUM_PERF_COUNTS]) {
+  return 0;
+}
+#endif // __linux__
+
+void PhaseTimer::next(const char *name) {
+  if (!CmdLineOpts::printTiming)
+    return;
+  stop();
+  start(name);
+}
+
+void PhaseTimer::stop() {
+  if (!running)
+    return;
+
+  timespec wallEnd, cpuEnd;
+  clock_gettime(CLOCK_MONOTONIC, &wallEnd);
+  clock_gettime(CLOCK_THREAD_CPUTIME_ID, &cpuEnd);
+  rusage usage;
+  getrusage(RUSAGE_SELF, &usage);
+
+  PhaseRecord rec;
+  rec.perfMask = stopPerf(rec.perf);
+  rec.name = name;
+  rec.start = toSeconds(wallStart);
+  rec.wall = toSeconds(wallEnd) - rec.start;
+  rec.cpu = toSeconds(cpuEnd) - toSeconds(cpuStart);
+  rec.peakRSS = usage.ru_maxrss;
+  memcpy(rec.counts, counts, sizeof(counts));
+  {
+    lock_guard<mutex> lock(recordsLock);
+    // a phase that ran before under this name (e.g., in an earlier --max_mem
+    // batch) gets the totals, so that the table has one row per phase
+    auto it = records.begin();
+    while (it != records.end() && strcmp(it->name, name) != 0)
+      it++;
+    if (it == records.end())
+      records.push_back(rec);
+    else {
+      it->wall += rec.wall;
+      it->cpu += rec.cpu;
+      it->peakRSS = max(it->peakRSS, rec.peakRSS);
+      for(int c = 0; c < NUM_PHASE_COUNTS; c++)
+	it->counts[c] += rec.counts[c];
+      for(int p = 0; p < NUM_PERF_COUNTS; p++) {
+	if (!(rec.perfMask & (1 << p)))
+	  continue;
+	if (it->perfMask & (1 << p))
+	  it->perf[p] += rec.perf[p];
+	else
+	  it->perf[p] = rec.perf[p];
+      }
+      it->perfMask |= rec.perfMask;
+    }
+  }
+
+  running = false;
+  current = outer;
+}
+
+// Prints the instructions per cycle and miss rates of <rec> (if counted)
+static void printPerf(FILE *out, PhaseRecord &rec) {
+  int mask = rec.perfMask;
+  if ((mask & (1 << CYCLES)) && (mask & (1 << INSTRUCTIONS)) &&
+      rec.perf[CYCLES] > 0)
+    fprintf(out, "    %-22s %12.2lf\n", "instructions per cycle",
+	    (double) rec.perf[INSTRUCTIONS] / rec.perf[CYCLES]);
+  if ((mask & (1 << CACHE_REFS)) && (mask & (1 << CACHE_MISSES)) &&
+      rec.perf[CACHE_REFS] > 0) {
+    fprintf(out, "    %-22s %11.2lf%%", "cache miss rate",
+	    100.0 * rec.perf[CACHE_MISSES] / rec.perf[CACHE_REFS]);
+    if ((mask & (1 << INSTRUCTIONS)) && rec.perf[INSTRUCTIONS] > 0)
+      fprintf(out, "  (%.2lf per 1000 instructions)",
+	      1000.0 * rec.perf[CACHE_MISSES] / rec.perf[INSTRUCTIONS]);
+    fprintf(out, "\n");
+  }
+  if ((mask & (1 << BRANCHES)) && (mask & (1 << BRANCH_MISSES)) &&
+      rec.perf[BRANCHES] > 0)
+    fprintf(out, "    %-22s %11.2lf%%\n", "branch miss rate",
+	    100.0 * rec.perf[BRANCH_MISSES] / rec.perf[BRANCHES]);
+}
+
+void PhaseTimer::print(FILE *out) {
+  lock_guard<mutex> lock(recordsLock);
+  sort(records.begin(), records.end(), comparePhaseStart);
+
+  fprintf(out, "\nTiming:\n");
+  fprintf(out, "  %-24s %10s %10s %14s\n", "Phase", "Wall (s)", "CPU (s)",
+	  "Peak RSS (MB)");
+  if (CmdLineOpts::perfCounters && perfErrno != 0)
+    fprintf(out, "  (hardware counters unavailable: perf_event_open: %s)\n",
+	    strerror(perfErrno));
+  for(auto it = records.begin(); it != records.end(); it++) {
+    fprintf(out, "  %-24s %10.3lf %10.3lf %14.1lf\n", it->name, it->wall,
+	    it->cpu, it->peakRSS / 1024.0);
+    for(int c = 0; c < NUM_PHASE_COUNTS; c++) {
+      if (it->counts[c] == 0)
+	continue;
+      fprintf(out, "    %-22s %12lu", countNames[c], it->counts[c]);
+      if (it->wall > 0)
+	fprintf(out, "  (%.4lg/s)", it->counts[c] / it->wall);
+      fprintf(out, "\n");
+    }
+    printPerf(out, *it);
+  }
+}
+
+void PhaseTimer::printJSON(const char *fileName) {
+  FILE *out = fopen(fileName, "w");
+  if (!out) {
+    printf("ERROR: could not open timing file %s!\n", fileName);
+    perror("open");
+    fatalExit(1);
+  }
+
+  lock_guard<mutex> lock(recordsLock);
+  sort(records.begin(), records.end(), comparePhaseStart);
+
+  // start times are relative to the first phase
+  double origin = (records.size() > 0) ? records[0].start : 0.0;
+  fprintf(out, "{\n  \"phases\": [");
+  for(auto it = records.begin(); it != records.end(); it++) {
+    fprintf(out, "%s\n    {\"name\": \"%s\", \"start_sec\": %.6lf, "
+		 "\"wall_sec\": %.6lf, \"cpu_sec\": %.6lf, "
+		 "\"peak_rss_kb\": %ld, \"counts\": {",
+	    (it == records.begin()) ? "" : ",", it->name, it->start - origin,
+	    it->wall, it->cpu, it->peakRSS);
+    bool first = true;
+    for(int c = 0; c < NUM_PHASE_COUNTS; c++) {
+      if (it->counts[c] == 0)
+	continue;
+      fprintf(out, "%s\"%s\": %lu", first ? "" : ", ", countNames[c],
+	      it->counts[c]);
+      first = false;
+    }
+    fprintf(out, "}");
+    if (it->perfMask) {
+      fprintf(out, ", \"perf\": {");
+      first = true;
+      for(int p = 0; p < NUM_PERF_COUNTS; p++) {
+	if (!(it->perfMask & (1 << p)))
+	  continue;
+	fprintf(out, "%s\"%s\": %lu", first ? "" : ", ", perfNames[p],
+		it->perf[p]);
+	first = false;
+      }
+      fprintf(out, "}");
+    }
+    fprintf(out, "}");
+  }
+  fprintf(out, "\n  ]\n}\n");
+  fclose(out);
+}
@@ -0,0 +1,86 @@
+// ped-sim: pedigree simulation tool
+//
+// This program is distributed under the terms of the GNU General Public License
+
+#include <stdio.h>
+#include <stdint.h>
+#include <time.h>
+
+#ifndef PHASETIMER_H
+#define PHASETIMER_H
+
+using namespace std;
+
+// Quantities counted during a phase (names in phasetimer.cc)
+enum PhaseCount {
+  MEIOSES,
+  CROSSOVERS,
+  SEGMENTS,      // haplotype segments generated
+  CARRIER_RECS,  // records of which samples carry each founder haplotype
+  IBD_RECS,      // IBD segments found
+  SITES,         // VCF records printed
+  GENOTYPES,     // genotypes printed across all output VCFs
+  NUM_PHASE_COUNTS
+};
+
+// Hardware events counted in each phase with --perf (on Linux, using
+// perf_event_open(); names in phasetimer.cc)
+enum PerfCount {
+  CYCLES,
+  INSTRUCTIONS,
+  CACHE_REFS,
+  CACHE_MISSES,
+  BRANCHES,
+  BRANCH_MISSES,
+  NUM_PERF_COUNTS
+};
+
+////////////////////////////////////////////////////////////////////////////////
+// Measures the wall time, CPU time (of the calling thread), and peak memory of
+// one phase of a run along with the counts of work done in it. The phase runs
+// from construction until stop() (or destruction), and the results for all
+// phases are printed to the log with --timing. Phases with the same name are
+// reported as one, with their times and counts summed. With --perf, also
+// counts the hardware events above on the calling thread; if the counters are
+// unavailable, the log says why and the other values are still printed.
+// Without --timing, a PhaseTimer does nothing and count() is a test of one
+// pointer.
+class PhaseTimer {
+  public:
+    PhaseTimer(const char *name);
+    ~PhaseTimer() { stop(); }
+
+    // Ends the current phase and starts one named <name>
+    void next(const char *name);
+    void stop();
+    bool active() { return running; }
+
+    // Adds <num> to the count of <what> for the innermost phase running on the
+    // calling thread (if any)
+    static void count(PhaseCount what, uint64_t num = 1) {
+      if (current)
+	current->counts[what] += num;
+    }
+
+    // Print the phases that have completed, in the order they started
+    static void print(FILE *out);
+    static void printJSON(const char *fileName);
+
+  private:
+    void start(const char *name);
+    void startPerf();
+    // Stores the event counts in <perf>; returns a bit mask of the ones counted
+    int stopPerf(uint64_t perf[NUM_PERF_COUNTS]);
+
+    const char *name;
+    bool running;
+    timespec wallStart;
+    timespec cpuStart;
+    uint64_t counts[NUM_PHASE_COUNTS];
+    PhaseTimer *outer; // phase that was running when this one started
+    int perfFds[NUM_PERF_COUNTS]; // -1 for events not being counted
+
+    static thread_local PhaseTimer *current;
+};
+
+#endif // PHASETIMER_H
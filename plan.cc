@@ -0,0 +1,864 @@
+// ped-sim: pedigree simulation tool
+//
+// This program is distributed under the terms of the GNU General Public License
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/resource.h>
+#include <zlib.h>
+#include <random>
+#include <algorithm>
+#include "plan.h"
+#include "cmdlineopts.h"
+#include "simulate.h"
+#include "packedhaps.h"
+#include "ibdseg.h"
+#include "fileorgz.h"
+#include "membudget.h"
+#include "edgetable.h"
+#include "progress.h"
+
+// Replicates of each pedigree simulated to measure the work per replicate
+static const int PLAN_PILOT_REPS = 50;
+
+// Uncompressed bytes read from the start of the input VCF to estimate its
+// number of records
+static const long PLAN_VCF_SAMPLE_BYTES = 16 * 1024 * 1024;
+
+// Genotypes printed to measure the cost of generating output VCFs
+static const long PLAN_BENCH_GENOTYPES = 4 * 1000 * 1000;
+
+// Fraction of --max_mem that chooseMemStrategy() plans to use: the estimates
+// don't include the allocator's overhead
+static const double MEM_PLAN_FRACTION = 0.9;
+
+// Work per pedigree: measured on the pilot replicates, then scaled to the
+// full run
+struct PedPlan {
+  int pilotReps;
+  double samples;      // simulated, including those not printed
+  double printed;
+  double founders;
+  double meioses;
+  double crossovers;   // expected
+  double segments;     // generated in meioses (as --timing counts them)
+  double carrierRecs;
+  double ibdSegs;
+  double memBytes;     // Persons, haplotypes, and carrier records
+  double edges;        // for --edges: rows of the .edges file
+  double edgeBytes;    // for --edges: memory for the transmissions and edges
+};
+
+// What the start of the input VCF indicates about the whole file
+struct InputEstimate {
+  int numSamples;
+  double records;
+  double bytes;          // uncompressed
+  double fixedBytes;     // average length of the columns before FORMAT
+  double compressRatio;  // size of the file over <bytes>
+  double nsPerByte;      // to read and split into fields
+};
+
+static double nowSeconds() {
+  timespec t;
+  clock_gettime(CLOCK_MONOTONIC, &t);
+  return t.tv_sec + t.tv_nsec * 1e-9;
+}
+
+static long fileSize(const char *fileName) {
+  struct stat st;
+  if (stat(fileName, &st) != 0)
+    return 0;
+  return st.st_size;
+}
+
+// Reads up to PLAN_VCF_SAMPLE_BYTES of records from <inVCFfile> and
+// extrapolates to the rest of the file using the fraction of it read
+template<typename IO_TYPE>
+void sampleInputVCF(const char *inVCFfile, InputEstimate &est) {
+  FileOrGZ<IO_TYPE> in;
+  bool success = in.open(inVCFfile, "r");
+  if (!success) {
+    fprintf(stderr, "\nERROR: could not open input VCF file %s!\n", inVCFfile);
+    perror("open");
+    exit(1);
+  }
+
+  double start = nowSeconds();
+  long headerBytes = 0, sampleBytes = 0, fixedBytes = 0;
+  long numRecords = 0;
+  long dataStart = 0; // raw offset of the first record
+  bool atEnd = true;
+  est.numSamples = 0;
+  int len;
+  while ((len = in.getline()) >= 0) {
+    if (in.buf[0] == '#') {
+      headerBytes += len;
+      dataStart = in.rawOffset();
+      if (in.buf[1] != '#') {
+	// header line: 9 fixed columns then the samples
+	int numCols = 1;
+	for(int i = 0; i < len; i++)
+	  if (in.buf[i] == '\t')
+	    numCols++;
+	est.numSamples = std::max(numCols - 9, 0);
+      }
+      continue;
+    }
+
+    numRecords++;
+    sampleBytes += len;
+    int numTabs = 0;
+    for(int i = 0; i < len; i++) {
+      if (in.buf[i] == '\t' && ++numTabs == 8) {
+	fixedBytes += i;
+	break;
+      }
+    }
+    // split the fields as makeVCF() does so that the time includes this
+    char *saveptr, *alleleSaveptr;
+    for(char *field = strtok_r(in.buf, "\t\n", &saveptr); field != NULL;
+	field = strtok_r(NULL, "\t\n", &saveptr))
+      strtok_r(field, "|/", &alleleSaveptr);
+    if (sampleBytes >= PLAN_VCF_SAMPLE_BYTES) {
+      atEnd = false;
+      break;
+    }
+  }
+  est.nsPerByte = (headerBytes + sampleBytes > 0) ?
+	    (nowSeconds() - start) * 1e9 / (headerBytes + sampleBytes) : 0.0;
+
+  long totalSize = fileSize(inVCFfile);
+  long sampleSize = in.rawOffset() - dataStart;
+  if (atEnd || sampleSize <= 0)
+    est.records = numRecords;
+  else
+    est.records = (double) numRecords * (totalSize - dataStart) / sampleSize;
+  double bytesPerRecord = (numRecords > 0) ? (double) sampleBytes / numRecords
+					   : 0.0;
+  est.bytes = headerBytes + est.records * bytesPerRecord;
+  est.fixedBytes = (numRecords > 0) ? (double) fixedBytes / numRecords : 0.0;
+  est.compressRatio = (est.bytes > 0) ? totalSize / est.bytes : 1.0;
+  in.close();
+}
+
+// Returns the nanoseconds to print one genotype as VCFRender::putGeno() does
+// (to a temporary file <fileName>)
+template<typename IO_TYPE>
+double benchGenotypes(const char *fileName) {
+  FileOrGZ<IO_TYPE> out;
+  bool success = out.open(fileName, "w");
+  if (!success) {
+    fprintf(stderr, "ERROR: could not open output file %s!\n", fileName);
+    perror("open");
+    exit(1);
+  }
+
+  // random alleles, from a generator of our own
+  mt19937 benchGen(1);
+  const char *alleleStrs[2] = { "0", "1" };
+  double start = nowSeconds();
+  for(long i = 0; i < PLAN_BENCH_GENOTYPES; i++) {
+    uint32_t bits = benchGen();
+    out.printf("%c%s", '\t', alleleStrs[bits & 1]);
+    out.printf("%c%s", '|', alleleStrs[(bits >> 1) & 1]);
+    if (i % 1000 == 999)
+      out.printf("\n");
+  }
+  out.close();
+  double ns = (nowSeconds() - start) * 1e9 / PLAN_BENCH_GENOTYPES;
+  unlink(fileName);
+  return ns;
+}
+
+// Memory for one output file that uses <numOutBufs> buffers, plus one buffer's
+// worth for stdio or zlib
+static double outFileBytes(int numOutBufs) {
+  return (numOutBufs + 1.0) * FileOrGZ<FILE *>::OUT_BUF_SIZE;
+}
+
+// Newly allocated name of <file> in <dir>
+static char *pilotFileName(const char *dir, const char *file) {
+  char *name = new char[strlen(dir) + 1 + strlen(file) + 1];
+  if (name == NULL) {
+    printf("ERROR: out of memory");
+    exit(5);
+  }
+  sprintf(name, "%s/%s", dir, file);
+  return name;
+}
+
+// Simulates the last (up to) PLAN_PILOT_REPS replicates of each pedigree in
+// place of the full run's, filling <peds> with the work done and memory used
+// for them and <simSec> with the time taken. The pilot's replicates stay in
+// <simDetails> until endPilot(), and with --edges, its transmissions stay in
+// <edgeTable>.
+//
+// Taking the last replicates means that the sample ids in the pilot's output
+// have as many digits as most ids in the full run.
+static void simulatePilot(vector<SimDetails> &simDetails, GeneticMap &map,
+			  bool sexSpecificMaps, vector<COInterfere> &coIntf,
+			  vector<PedPlan> &peds, vector<int> &fullReps,
+			  vector<int> &fullFirstRep, Person *****&theSamples,
+			  vector< vector< vector<InheritRecord> > > &hapCarriers,
+			  EdgeTable &edgeTable, double &simSec) {
+  unsigned int numPeds = simDetails.size();
+  fullReps.resize(numPeds);
+  fullFirstRep.resize(numPeds);
+  peds.resize(numPeds);
+  for(unsigned int ped = 0; ped < numPeds; ped++) {
+    fullReps[ped] = simDetails[ped].numReps;
+    fullFirstRep[ped] = simDetails[ped].firstRep;
+    int pilotReps = std::min(fullReps[ped], PLAN_PILOT_REPS);
+    memset(&peds[ped], 0, sizeof(PedPlan));
+    peds[ped].pilotReps = pilotReps;
+    simDetails[ped].numReps = pilotReps;
+    simDetails[ped].firstRep = fullFirstRep[ped] + fullReps[ped] - pilotReps;
+  }
+
+  vector<int> hapNumsBySex[2];
+  if (CmdLineOpts::printEdges)
+    EdgeTable::record(&edgeTable);
+  double start = nowSeconds();
+  int totalFounderHaps = simulate(simDetails, theSamples, map, sexSpecificMaps,
+				  coIntf, hapCarriers, hapNumsBySex);
+  simSec = nowSeconds() - start;
+  EdgeTable::record(NULL);
+
+  // the vectors of the EdgeTable double as they grow, so allow up to twice
+  // the bytes of the recorded rows
+  vector<double> pedEdges(numPeds, 0.0), pedEdgeBytes(numPeds, 0.0);
+  edgeTable.usage(pedEdges, pedEdgeBytes);
+
+  // expected crossovers in the two meioses that produce one non-founder; only
+  // the mother's X chromosome has crossovers
+  double cosPerNonFounder = 0.0;
+  for(unsigned int chr = 0; chr < map.size(); chr++) {
+    int female = sexSpecificMaps ? 1 : 0;
+    if (!map.isX(chr))
+      cosPerNonFounder += map.chromGenetLength(chr, /*sex=*/ 0);
+    cosPerNonFounder += map.chromGenetLength(chr, female);
+  }
+  cosPerNonFounder /= 100; // in Morgans
+
+  for(unsigned int ped = 0; ped < numPeds; ped++) {
+    PedPlan &plan = peds[ped];
+    int numGen = simDetails[ped].numGen;
+    int **numSampsToPrint = simDetails[ped].numSampsToPrint;
+    for(int rep = 0; rep < plan.pilotReps; rep++) {
+      for(int gen = 0; gen < numGen; gen++) {
+	for(int branch = 0; branch < simDetails[ped].numBranches[gen];
+								    branch++) {
+	  int numFounders, numNonFounders;
+	  getPersonCounts(gen, numGen, branch, numSampsToPrint,
+			  simDetails[ped].branchParents,
+			  simDetails[ped].branchNumSpouses, numFounders,
+			  numNonFounders);
+	  int numPersons = numFounders + numNonFounders;
+	  for(int ind = 0; ind < numPersons; ind++) {
+	    Person &person = theSamples[ped][rep][gen][branch][ind];
+	    plan.samples++;
+	    if (numSampsToPrint[gen][branch] > 0)
+	      plan.printed++;
+	    if (gen > 0 && ind >= numFounders) {
+	      plan.meioses += 2;
+	      plan.segments += countSegments(person);
+	    }
+	    plan.memBytes += MemBudget::personBytes(person);
+	  }
+	}
+      }
+    }
+    plan.crossovers = plan.meioses / 2 * cosPerNonFounder;
+    plan.edges = pedEdges[ped];
+    plan.edgeBytes = 2 * pedEdgeBytes[ped];
+
+    // founder haplotypes numbered from <founderOffset> up to the next
+    // pedigree's
+    int endHap = (ped + 1 < numPeds) ? simDetails[ped + 1].founderOffset
+				     : totalFounderHaps;
+    plan.founders = (endHap - simDetails[ped].founderOffset) / 2;
+    for(int hap = simDetails[ped].founderOffset; hap < endHap; hap++) {
+      plan.memBytes += MemBudget::carrierBytes(hapCarriers[hap]);
+      for(auto it = hapCarriers[hap].begin(); it != hapCarriers[hap].end();
+									  it++)
+	plan.carrierRecs += it->size();
+    }
+  }
+}
+
+// Frees the pilot's samples and restores the full run's replicates
+static void endPilot(vector<SimDetails> &simDetails, Person *****theSamples,
+		     vector<int> &fullReps, vector<int> &fullFirstRep) {
+  deleteTheSamples(simDetails, theSamples);
+  for(unsigned int ped = 0; ped < simDetails.size(); ped++) {
+    simDetails[ped].numReps = fullReps[ped];
+    simDetails[ped].firstRep = fullFirstRep[ped];
+  }
+}
+
+void printPlan(vector<SimDetails> &simDetails, GeneticMap &map,
+	       bool sexSpecificMaps, vector<COInterfere> &coIntf,
+	       vector<RenderSpec> &renders, FILE *outs[2]) {
+  for(int o = 0; o < 2; o++) {
+    fprintf(outs[o], "Planning: simulating up to %d replicates of each pedigree... ",
+	    PLAN_PILOT_REPS);
+    fflush(outs[o]);
+  }
+
+  // a run repeats the work done so far (reading the map, etc.) on one thread,
+  // so its CPU time estimates the wall time
+  rusage usage;
+  getrusage(RUSAGE_SELF, &usage);
+  double baseBytes = usage.ru_maxrss * 1024.0;
+  double setupSec = usage.ru_utime.tv_sec + usage.ru_utime.tv_usec * 1e-6 +
+		    usage.ru_stime.tv_sec + usage.ru_stime.tv_usec * 1e-6;
+
+  unsigned int numPeds = simDetails.size();
+  vector<int> fullReps, fullFirstRep;
+  vector<PedPlan> peds;
+  Person *****theSamples;
+  vector< vector< vector<InheritRecord> > > hapCarriers;
+  EdgeTable edgeTable;
+  double simSec;
+  simulatePilot(simDetails, map, sexSpecificMaps, coIntf, peds, fullReps,
+		fullFirstRep, theSamples, hapCarriers, edgeTable, simSec);
+
+  double pilotSegments = 0.0, pilotCarrierRecs = 0.0;
+  for(unsigned int ped = 0; ped < numPeds; ped++) {
+    pilotSegments += peds[ped].segments;
+    pilotCarrierRecs += peds[ped].carrierRecs;
+  }
+
+  // print the pilot's output files to a temporary directory
+  char *tmpDir = new char[strlen(CmdLineOpts::outPrefix) + 13 + 1];
+  if (tmpDir == NULL) {
+    printf("ERROR: out of memory");
+    exit(5);
+  }
+  sprintf(tmpDir, "%s.plan.XXXXXX", CmdLineOpts::outPrefix);
+  if (mkdtemp(tmpDir) == NULL) {
+    fprintf(stderr, "ERROR: could not create directory %s!\n", tmpDir);
+    perror("mkdtemp");
+    exit(1);
+  }
+
+  double start, bpSec = 0.0, edgesSec = 0.0, ibdSec = 0.0, famSec = 0.0;
+  long bpBytes = 0, nodesBytes = 0, edgesBytes = 0, segBytes = 0,
+       mrcaBytes = 0, famBytes = 0;
+  if (CmdLineOpts::printBP) {
+    char *bpFile = pilotFileName(tmpDir, "pilot.bp");
+    start = nowSeconds();
+    printBPs(simDetails, theSamples, map, bpFile);
+    bpSec = nowSeconds() - start;
+    bpBytes = fileSize(bpFile);
+    unlink(bpFile);
+    delete [] bpFile;
+  }
+  if (CmdLineOpts::printEdges) {
+    // number the pilot's nodes from the middle of the full run's, so that
+    // their ids have as many digits as most of the full run's
+    double fullSamples = 0.0, pilotSamples = 0.0;
+    for(unsigned int ped = 0; ped < numPeds; ped++) {
+      fullSamples += peds[ped].samples * fullReps[ped] / peds[ped].pilotReps;
+      pilotSamples += peds[ped].samples;
+    }
+    edgeTable.setNextNode(2 * (long) ((fullSamples - pilotSamples) / 2));
+    char *nodesFile = pilotFileName(tmpDir, "pilot.nodes");
+    char *edgesFile = pilotFileName(tmpDir, "pilot.edges");
+    start = nowSeconds();
+    edgeTable.print(simDetails, theSamples, map, nodesFile, edgesFile,
+		    /*append=*/ false);
+    edgesSec = nowSeconds() - start;
+    nodesBytes = fileSize(nodesFile);
+    edgesBytes = fileSize(edgesFile);
+    unlink(nodesFile);
+    unlink(edgesFile);
+    delete [] nodesFile;
+    delete [] edgesFile;
+  }
+  if (CmdLineOpts::printFam) {
+    char *famFile = pilotFileName(tmpDir, "pilot.fam");
+    start = nowSeconds();
+    printFam(simDetails, theSamples, famFile);
+    famSec = nowSeconds() - start;
+    famBytes = fileSize(famFile);
+    unlink(famFile);
+    delete [] famFile;
+  }
+  {
+    char *ibdFile = pilotFileName(tmpDir, "pilot.seg");
+    char *mrcaFile = NULL;
+    if (CmdLineOpts::printMRCA)
+      mrcaFile = pilotFileName(tmpDir, "pilot.mrca");
+    IBDSegFunc countSegs = [&](const IBDSegInfo &info) {
+      peds[info.ped].ibdSegs++;
+    };
+    start = nowSeconds();
+    locatePrintIBD(simDetails, hapCarriers, map, sexSpecificMaps, ibdFile,
+		   &countSegs, mrcaFile);
+    ibdSec = nowSeconds() - start;
+    segBytes = fileSize(ibdFile);
+    unlink(ibdFile);
+    delete [] ibdFile;
+    if (mrcaFile) {
+      mrcaBytes = fileSize(mrcaFile);
+      unlink(mrcaFile);
+      delete [] mrcaFile;
+    }
+  }
+
+  endPilot(simDetails, theSamples, fullReps, fullFirstRep);
+
+  // scale the pilot to the full run; the sizes of the .bp, fam, and .nodes
+  // files scale with the samples, that of the .edges file with the edges, and
+  // those of the .seg and .mrca files with the IBD segments
+  PedPlan total;
+  memset(&total, 0, sizeof(PedPlan));
+  double pilotPrinted = 0.0, pilotSamples = 0.0, pilotIBDSegs = 0.0,
+	 pilotEdges = 0.0;
+  for(unsigned int ped = 0; ped < numPeds; ped++) {
+    PedPlan &plan = peds[ped];
+    pilotPrinted += plan.printed;
+    pilotSamples += plan.samples;
+    pilotIBDSegs += plan.ibdSegs;
+    pilotEdges += plan.edges;
+
+    double scale = (double) fullReps[ped] / plan.pilotReps;
+    plan.samples *= scale;
+    plan.printed *= scale;
+    plan.founders *= scale;
+    plan.meioses *= scale;
+    plan.crossovers *= scale;
+    plan.segments *= scale;
+    plan.carrierRecs *= scale;
+    plan.ibdSegs *= scale;
+    plan.memBytes *= scale;
+    plan.edges *= scale;
+    plan.edgeBytes *= scale;
+
+    total.samples += plan.samples;
+    total.printed += plan.printed;
+    total.founders += plan.founders;
+    total.meioses += plan.meioses;
+    total.crossovers += plan.crossovers;
+    total.segments += plan.segments;
+    total.carrierRecs += plan.carrierRecs;
+    total.ibdSegs += plan.ibdSegs;
+    total.memBytes += plan.memBytes;
+    total.edges += plan.edges;
+    total.edgeBytes += plan.edgeBytes;
+  }
+  double printedScale = (pilotPrinted > 0) ? total.printed / pilotPrinted : 0;
+  double samplesScale = (pilotSamples > 0) ? total.samples / pilotSamples : 0;
+  double ibdScale = (pilotIBDSegs > 0) ? total.ibdSegs / pilotIBDSegs : 0;
+  double edgesScale = (pilotEdges > 0) ? total.edges / pilotEdges : 0;
+
+  // cost constants from the pilot
+  double nsPerSegment = (pilotSegments > 0) ? simSec * 1e9 / pilotSegments : 0;
+  double nsPerCarrierRec = (pilotCarrierRecs > 0) ?
+				      ibdSec * 1e9 / pilotCarrierRecs : 0;
+  double nsPerByte = (bpBytes + famBytes > 0) ?
+			      (bpSec + famSec) * 1e9 / (bpBytes + famBytes) : 0;
+
+  // output files: name, size, and time to print them
+  struct PlannedFile {
+    char name[32];
+    double bytes;
+    double sec;
+  };
+  vector<PlannedFile> files;
+  double simTotalSec = nsPerSegment * total.segments * 1e-9;
+  files.push_back({ ".seg", segBytes * ibdScale,
+		    nsPerCarrierRec * total.carrierRecs * 1e-9 });
+  if (CmdLineOpts::printMRCA)
+    files.push_back({ ".mrca", mrcaBytes * ibdScale, 0.0 });
+  if (CmdLineOpts::printBP)
+    files.push_back({ ".bp", bpBytes * printedScale,
+		      nsPerByte * bpBytes * printedScale * 1e-9 });
+  if (CmdLineOpts::printEdges) {
+    // one stage prints both files; its time is listed with the .nodes file
+    double fullBytes = nodesBytes * samplesScale + edgesBytes * edgesScale;
+    double pilotBytes = nodesBytes + edgesBytes;
+    files.push_back({ ".nodes", nodesBytes * samplesScale,
+		      (pilotBytes > 0) ? edgesSec * fullBytes / pilotBytes : 0 });
+    files.push_back({ ".edges", edgesBytes * edgesScale, 0.0 });
+  }
+  if (CmdLineOpts::printFam)
+    files.push_back({ "-everyone.fam", famBytes * samplesScale,
+		      nsPerByte * famBytes * samplesScale * 1e-9 });
+
+  InputEstimate input;
+  double nsPerGeno = 0.0;
+  bool gzOut = false;
+  if (CmdLineOpts::inVCFfile) {
+    for(int o = 0; o < 2; o++) {
+      fprintf(outs[o], "reading start of input VCF... ");
+      fflush(outs[o]);
+    }
+    const char *inVCFfile = CmdLineOpts::inVCFfile;
+    int inVCFlen = strlen(inVCFfile);
+    char *benchFile = pilotFileName(tmpDir, "bench.vcf");
+    if (strcmp(&inVCFfile[ inVCFlen - 3 ], ".gz") == 0) {
+      sampleInputVCF<gzFile>(inVCFfile, input);
+      gzOut = !CmdLineOpts::nogz;
+    }
+    else
+      sampleInputVCF<FILE *>(inVCFfile, input);
+    if (gzOut)
+      nsPerGeno = benchGenotypes<gzFile>(benchFile);
+    else
+      nsPerGeno = benchGenotypes<FILE *>(benchFile);
+    delete [] benchFile;
+
+    double outSamples = total.printed;
+    double unused = std::max(input.numSamples - total.founders, 0.0);
+    if (CmdLineOpts::retainExtra < 0)
+      outSamples += unused;
+    else
+      outSamples += std::min((double) CmdLineOpts::retainExtra, unused);
+
+    // columns before FORMAT, then "GT" and 4 characters per genotype
+    double vcfBytes = input.records * (input.fixedBytes + 3 + 4 * outSamples +
+									   1);
+    if (gzOut)
+      vcfBytes *= input.compressRatio;
+    // reading the input is part of the first output VCF's time
+    double readSec = input.nsPerByte * input.bytes * 1e-9;
+    for(unsigned int r = 0; r < renders.size(); r++) {
+      PlannedFile vcf;
+      if (renders[r].name)
+	snprintf(vcf.name, sizeof(vcf.name), "-%s.vcf%s", renders[r].name,
+		 gzOut ? ".gz" : "");
+      else
+	sprintf(vcf.name, ".vcf%s", gzOut ? ".gz" : "");
+      vcf.bytes = vcfBytes;
+      vcf.sec = nsPerGeno * input.records * outSamples * 1e-9;
+      if (r == 0)
+	vcf.sec += readSec;
+      files.push_back(vcf);
+    }
+  }
+
+  rmdir(tmpDir);
+  delete [] tmpDir;
+
+  // Peak memory: what's been allocated so far (the map, etc.), the simulated
+  // haplotypes and carrier records, the edge tables, and the output buffers
+  double peakBytes = baseBytes + total.memBytes + total.edgeBytes +
+	  files.size() * outFileBytes(FileOrGZ<FILE *>::NUM_OUT_BUFS);
+
+  // The output stages run concurrently on --threads threads (by default one
+  // each); the VCFs are printed in one stage
+  double stageSum = 0.0, stageMax = 0.0, vcfSec = 0.0;
+  int numStages = 0;
+  for(auto it = files.begin(); it != files.end(); it++) {
+    if (strcmp(it->name, ".mrca") == 0 || strcmp(it->name, ".edges") == 0)
+      continue; // printed with the .seg and .nodes files
+    if (strstr(it->name, ".vcf"))
+      vcfSec += it->sec;
+    else {
+      stageSum += it->sec;
+      stageMax = std::max(stageMax, it->sec);
+      numStages++;
+    }
+  }
+  if (vcfSec > 0) {
+    stageSum += vcfSec;
+    stageMax = std::max(stageMax, vcfSec);
+    numStages++;
+  }
+  int numWorkers = (CmdLineOpts::numThreads > 0) ?
+		      std::min(CmdLineOpts::numThreads, numStages) : numStages;
+  double outputSec = std::max(stageMax, stageSum / std::max(numWorkers, 1));
+  double totalSec = setupSec + simTotalSec + outputSec;
+
+  ////////////////////////////////////////////////////////////////////////////
+  // print the plan
+  for(int o = 0; o < 2; o++) {
+    FILE *out = outs[o];
+    char buf[32];
+    fprintf(out, "done.\n\n");
+    fprintf(out, "Plan: estimates for the full run from up to %d replicates per pedigree\n\n",
+	    PLAN_PILOT_REPS);
+    fprintf(out, "  %-16s %8s %12s %12s %12s %13s %13s %12s\n", "Pedigree",
+	    "Reps", "Samples", "Meioses", "Crossovers", "Segments",
+	    "Carrier recs", "IBD segments");
+    for(unsigned int ped = 0; ped < numPeds; ped++) {
+      PedPlan &plan = peds[ped];
+      fprintf(out, "  %-16s %8d %12.0lf %12.0lf %12.0lf %13.0lf %13.0lf %12.0lf\n",
+	      simDetails[ped].name, fullReps[ped], plan.samples, plan.meioses,
+	      plan.crossovers, plan.segments, plan.carrierRecs, plan.ibdSegs);
+    }
+    if (numPeds > 1)
+      fprintf(out, "  %-16s %8s %12.0lf %12.0lf %12.0lf %13.0lf %13.0lf %12.0lf\n",
+	      "Total", "", total.samples, total.meioses, total.crossovers,
+	      total.segments, total.carrierRecs, total.ibdSegs);
+
+    fprintf(out, "\n  Founders needed:\t%.0lf\n", total.founders);
+    if (CmdLineOpts::inVCFfile) {
+      fprintf(out, "  Input VCF:\t\t%d samples, about %.0lf records", input.numSamples,
+	      input.records);
+      if (input.numSamples < total.founders)
+	fprintf(out, "  (too few samples!)");
+      fprintf(out, "\n");
+    }
+    if (CmdLineOpts::printEdges) {
+      MemBudget::sizeStr(buf, total.edgeBytes);
+      fprintf(out, "  Edge tables:\t\t%.0lf nodes, %.0lf edges (up to %s in memory)\n",
+	      2 * total.samples, total.edges, buf);
+    }
+
+    fprintf(out, "\n  %-32s %12s %12s\n", "Output file", "Size", "Time");
+    for(auto it = files.begin(); it != files.end(); it++) {
+      char name[1024];
+      snprintf(name, sizeof(name), "%s%s", CmdLineOpts::outPrefix, it->name);
+      fprintf(out, "  %-32s", name);
+      MemBudget::sizeStr(buf, it->bytes);
+      fprintf(out, " %12s", buf);
+      if (it->sec > 0) {
+	Progress::timeStr(buf, it->sec);
+	fprintf(out, " %12s", buf);
+      }
+      fprintf(out, "\n");
+    }
+
+    MemBudget::sizeStr(buf, peakBytes);
+    fprintf(out, "\n  Peak memory:\t\t%s\n", buf);
+    Progress::timeStr(buf, totalSec);
+    fprintf(out, "  Time:\t\t\t%s", buf);
+    Progress::timeStr(buf, setupSec);
+    fprintf(out, "  (setup %s, ", buf);
+    Progress::timeStr(buf, simTotalSec);
+    fprintf(out, "simulation %s, ", buf);
+    Progress::timeStr(buf, outputSec);
+    fprintf(out, "output %s on %d thread%s)\n", buf, std::max(numWorkers, 1),
+	    (numWorkers > 1) ? "s" : "");
+
+    fprintf(out, "\n  Costs measured on this machine:\n");
+    fprintf(out, "    %-24s %10.1lf ns per haplotype segment\n",
+	    "simulation", nsPerSegment);
+    fprintf(out, "    %-24s %10.1lf ns per carrier record\n",
+	    "IBD segments", nsPerCarrierRec);
+    if (nsPerByte > 0)
+      fprintf(out, "    %-24s %10.2lf ns per byte\n",
+	      "break points, fam file", nsPerByte);
+    if (CmdLineOpts::inVCFfile) {
+      fprintf(out, "    %-24s %10.2lf ns per byte\n", "reading input VCF",
+	      input.nsPerByte);
+      fprintf(out, "    %-24s %10.2lf ns per genotype\n", "printing VCF",
+	      nsPerGeno);
+    }
+  }
+}
+
+// Largest memory for the samples and carrier records of one batch when the
+// <runReps> replicates of each pedigree, each taking <repBytes>, are split
+// into <numBatches> batches as --shard splits them
+static double maxBatchBytes(vector<int> &runReps, vector<double> &repBytes,
+			    long numBatches) {
+  long totalReps = 0;
+  for(auto it = runReps.begin(); it != runReps.end(); it++)
+    totalReps += *it;
+
+  double maxBytes = 0.0;
+  for(long batch = 0; batch < numBatches; batch++) {
+    long batchStart = totalReps * batch / numBatches;
+    long batchEnd = totalReps * (batch + 1) / numBatches;
+    double bytes = 0.0;
+    long pedStart = 0;
+    for(unsigned int ped = 0; ped < runReps.size(); ped++) {
+      long pedEnd = pedStart + runReps[ped];
+      long first = std::min(std::max(batchStart, pedStart), pedEnd);
+      long last = std::min(std::max(batchEnd, pedStart), pedEnd);
+      bytes += (last - first) * repBytes[ped];
+      pedStart = pedEnd;
+    }
+    maxBytes = std::max(maxBytes, bytes);
+  }
+  return maxBytes;
+}
+
+void chooseMemStrategy(vector<SimDetails> &simDetails, GeneticMap &map,
+		       bool sexSpecificMaps, vector<COInterfere> &coIntf,
+		       vector<RenderSpec> &renders, MemStrategy &strategy,
+		       FILE *outs[2]) {
+  rusage usage;
+  getrusage(RUSAGE_SELF, &usage);
+  strategy.baseBytes = usage.ru_maxrss * 1024L;
+  strategy.serialStages = false;
+  strategy.numOutBufs = FileOrGZ<FILE *>::NUM_OUT_BUFS;
+  strategy.numBatches = 1;
+  if (CmdLineOpts::dryRun)
+    return; // simulates one replicate per pedigree
+
+  // with --shard, the run simulates only the shard's replicates
+  unsigned int numPeds = simDetails.size();
+  vector<int> runReps(numPeds);
+  for(unsigned int ped = 0; ped < numPeds; ped++)
+    runReps[ped] = simDetails[ped].numReps;
+  int numShards = CmdLineOpts::numShards;
+  if (numShards > 0) {
+    vector<int> firstReps(numPeds), firstHap, firstNonFounder, repNonFounders;
+    for(unsigned int ped = 0; ped < numPeds; ped++)
+      firstReps[ped] = simDetails[ped].firstRep;
+    selectShard(simDetails, firstHap, firstNonFounder, repNonFounders);
+    for(unsigned int ped = 0; ped < numPeds; ped++) {
+      std::swap(runReps[ped], simDetails[ped].numReps);
+      simDetails[ped].firstRep = firstReps[ped];
+    }
+  }
+
+  vector<int> fullReps, fullFirstRep;
+  vector<PedPlan> peds;
+  double simBytes = 0.0, edgeBytes = 0.0;
+  vector<double> repBytes(numPeds);
+  {
+    mt19937 savedGen = randomGen;
+    CmdLineOpts::numShards = 0; // the pilot picks its own replicates
+    Person *****theSamples;
+    vector< vector< vector<InheritRecord> > > hapCarriers;
+    EdgeTable edgeTable;
+    double simSec;
+    simulatePilot(simDetails, map, sexSpecificMaps, coIntf, peds, fullReps,
+		  fullFirstRep, theSamples, hapCarriers, edgeTable, simSec);
+    endPilot(simDetails, theSamples, fullReps, fullFirstRep);
+    CmdLineOpts::numShards = numShards;
+    randomGen = savedGen;
+  }
+  // the edge tables hold the transmissions of a batch until its output
+  // stage prints them, so they count with its samples
+  for(unsigned int ped = 0; ped < numPeds; ped++) {
+    if (peds[ped].pilotReps == 0) {
+      repBytes[ped] = 0.0;
+      continue;
+    }
+    double repEdgeBytes = peds[ped].edgeBytes / peds[ped].pilotReps;
+    repBytes[ped] = peds[ped].memBytes / peds[ped].pilotReps + repEdgeBytes;
+    simBytes += runReps[ped] * repBytes[ped];
+    edgeBytes += runReps[ped] * repEdgeBytes;
+  }
+
+  // files each output stage prints (see main())
+  vector<int> stageFiles;
+  if (CmdLineOpts::printBP)
+    stageFiles.push_back(1);
+  if (CmdLineOpts::printEdges)
+    stageFiles.push_back(2);
+  stageFiles.push_back(CmdLineOpts::printMRCA ? 2 : 1);
+  if (CmdLineOpts::printFam)
+    stageFiles.push_back(1);
+  if (CmdLineOpts::inVCFfile)
+    stageFiles.push_back(renders.size());
+  int allFiles = 0, maxStageFiles = 0;
+  for(auto it = stageFiles.begin(); it != stageFiles.end(); it++) {
+    allFiles += *it;
+    maxStageFiles = std::max(maxStageFiles, *it);
+  }
+  // running on one thread, the stages print their files one at a time
+  bool serial = CmdLineOpts::numThreads == 1 || stageFiles.size() == 1;
+
+  double limit = CmdLineOpts::maxMem;
+  double target = limit * MEM_PLAN_FRACTION;
+  auto need = [&]() {
+    int numFiles = (serial || strategy.serialStages) ? maxStageFiles
+						     : allFiles;
+    return strategy.baseBytes + numFiles * outFileBytes(strategy.numOutBufs) +
+	   maxBatchBytes(runReps, repBytes, strategy.numBatches);
+  };
+
+  char buf[32], buf2[32];
+  MemBudget::sizeStr(buf, limit);
+  double bytes = need();
+  for(int o = 0; o < 2; o++) {
+    fprintf(outs[o], "Memory budget (--max_mem %s), estimated from up to %d replicates per pedigree:\n",
+	    buf, PLAN_PILOT_REPS);
+    MemBudget::sizeStr(buf2, bytes);
+    fprintf(outs[o], "  Run needs about %s", buf2);
+    MemBudget::sizeStr(buf2, simBytes - edgeBytes);
+    fprintf(outs[o], " (simulation %s, ", buf2);
+    if (CmdLineOpts::printEdges) {
+      MemBudget::sizeStr(buf2, edgeBytes);
+      fprintf(outs[o], "edge tables %s, ", buf2);
+    }
+    MemBudget::sizeStr(buf2, bytes - simBytes - strategy.baseBytes);
+    fprintf(outs[o], "output buffers %s, ", buf2);
+    MemBudget::sizeStr(buf2, strategy.baseBytes);
+    fprintf(outs[o], "in use now %s)\n", buf2);
+  }
+
+  if (bytes > target && !serial) {
+    strategy.serialStages = true;
+    bytes = need();
+    MemBudget::sizeStr(buf2, bytes);
+    for(int o = 0; o < 2; o++)
+      fprintf(outs[o], "  Printing the output files one stage at a time: %s\n",
+	      buf2);
+  }
+
+  if (bytes > target) {
+    strategy.numOutBufs = 1;
+    bytes = need();
+    MemBudget::sizeStr(buf2, bytes);
+    for(int o = 0; o < 2; o++)
+      fprintf(outs[o], "  Using one buffer per output file: %s\n", buf2);
+  }
+
+  // Batches simulate the replicates as --shard does, so they can't generate
+  // genetic data (or be combined with --shard)
+  bool canBatch = !CmdLineOpts::inVCFfile && numShards == 0;
+  long totalReps = 0;
+  for(auto it = runReps.begin(); it != runReps.end(); it++)
+    totalReps += *it;
+  if (bytes > target && canBatch && totalReps > 1) {
+    double avail = target - (bytes - simBytes);
+    long numBatches = (avail > 0) ? (long) (simBytes / avail) + 1 : totalReps;
+    numBatches = std::min(numBatches, totalReps);
+    // the replicates differ in size: add batches until the largest fits
+    strategy.numBatches = numBatches;
+    while ((bytes = need()) > target && strategy.numBatches < totalReps) {
+      numBatches = std::min(numBatches + numBatches / 10 + 1, totalReps);
+      strategy.numBatches = numBatches;
+    }
+    MemBudget::sizeStr(buf2, bytes);
+    for(int o = 0; o < 2; o++) {
+      fprintf(outs[o], "  Simulating and printing the replicates in %d batches: %s\n",
+	      strategy.numBatches, buf2);
+      fprintf(outs[o], "    (the results are the same as without batches)\n");
+    }
+  }
+
+  if (bytes > limit) {
+    MemBudget::sizeStr(buf2, bytes);
+    for(int o = 0; o < 2; o++) {
+      fprintf(outs[o], "\nERROR: the run needs about %s, more than the budget of %s\n",
+	      buf2, buf);
+      if (CmdLineOpts::inVCFfile) {
+	fprintf(outs[o], "       generating genetic data requires simulating all replicates at once;\n");
+	fprintf(outs[o], "       split the def file across several runs to use less memory\n");
+      }
+      else if (numShards > 0)
+	fprintf(outs[o], "       use more shards to use less memory\n");
+      else
+	fprintf(outs[o], "       even one replicate at a time does not fit\n");
+    }
+    exit(5);
+  }
+
+  if (strategy.serialStages || strategy.numOutBufs <
+					    FileOrGZ<FILE *>::NUM_OUT_BUFS ||
+      strategy.numBatches > 1) {
+    if (bytes > target)
+      for(int o = 0; o < 2; o++)
+	fprintf(outs[o], "  WARNING: the run is close to the budget\n");
+  }
+  else
+    for(int o = 0; o < 2; o++)
+      fprintf(outs[o], "  Fits in the budget: running as usual\n");
+  for(int o = 0; o < 2; o++)
+    fprintf(outs[o], "\n");
+}
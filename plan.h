@@ -0,0 +1,53 @@
+// ped-sim: pedigree simulation tool
+//
+// This program is distributed under the terms of the GNU General Public License
+
+#include <stdio.h>
+#include <vector>
+#include "datastructs.h"
+#include "geneticmap.h"
+#include "cointerfere.h"
+#include "bpvcffam.h"
+
+#ifndef PLAN_H
+#define PLAN_H
+
+using namespace std;
+
+////////////////////////////////////////////////////////////////////////////////
+// For --plan: estimates what the run described by the command line will cost
+// without running it. Like --dry_run, this simulates only part of the run:
+// up to PLAN_PILOT_REPS replicates of each pedigree, which it prints to
+// temporary files next to the output prefix. The per-replicate counts of
+// meioses, haplotype segments, carrier records, and IBD segments, the memory
+// used, and the output sizes scale to the full number of replicates. The
+// expected number of crossovers comes from the map lengths. Times come from
+// the cost per operation measured on the pilot replicates and, for VCF
+// output, from reading the start of the input VCF and a quick benchmark of
+// printing genotypes. Prints the estimates to <outs>.
+void printPlan(vector<SimDetails> &simDetails, GeneticMap &map,
+	       bool sexSpecificMaps, vector<COInterfere> &coIntf,
+	       vector<RenderSpec> &renders, FILE *outs[2]);
+
+// For --max_mem: settings that keep a run within the memory budget
+struct MemStrategy {
+  long baseBytes;    // in use before simulating (the genetic map, etc.)
+  bool serialStages; // print the output files one stage at a time?
+  int numOutBufs;    // buffers per output file (see FileOrGZ)
+  int numBatches;    // simulate and print the replicates in this many batches
+};
+
+// Estimates the memory the run needs from a pilot like printPlan()'s (using a
+// copy of the random number generator, so the run itself is unchanged) and
+// chooses the settings in <strategy> that fit it in CmdLineOpts::maxMem. Each
+// setting that lowers memory use also costs time or changes the output, so
+// they are taken in turn and only as needed: printing the output files one
+// stage at a time, fewer output buffers, then (when not generating genetic
+// data) batches of replicates. Prints the estimates and the decisions to
+// <outs>, and exits with an error if the run can't fit.
+void chooseMemStrategy(vector<SimDetails> &simDetails, GeneticMap &map,
+		       bool sexSpecificMaps, vector<COInterfere> &coIntf,
+		       vector<RenderSpec> &renders, MemStrategy &strategy,
+		       FILE *outs[2]);
+
+#endif // PLAN_H
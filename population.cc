@@ -0,0 +1,135 @@
+// ped-sim: pedigree simulation tool
+//
+// This program is distributed under the terms of the GNU General Public License
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <random>
+#include <algorithm>
+#include "population.h"
+#include "readfam.h"
+#include "simulate.h"
+#include "runerror.h"
+
+// Builds a random population pedigree and adds it to <simDetails> as an entry
+// named "pop" with one replicate. Each of the <numGen> generations has
+// <popSize> individuals: the first half are male, the rest female, and male i
+// and female i are a couple (the individuals in a generation are
+// exchangeable, so this pairing is random). Each couple (and each unpaired
+// female) has a fertility weight drawn from a gamma distribution with mean 1,
+// and, for each member of the next generation, the mother is drawn in
+// proportion to these weights. With probability <monogamyRate> the father is
+// her partner; otherwise he is drawn in proportion to the weights of the
+// couples. The offspring counts then have mean 2 and variance
+// 2 + 4 / shape, so <offspringVar> (at least 2) sets the shape; with
+// <offspringVar> == 2 the weights are equal, as in the Wright-Fisher model.
+//
+// <numSample> individuals in the last generation (all if 0) are sampled and
+// printed, and only these and their ancestors are kept: the pedigree is built
+// directly in the representation simulate() uses, with each individual in a
+// branch of its own, so memory and time are linear in <popSize> * <numGen>
+// to build it and in the number of ancestors thereafter.
+void genPopulation(vector<SimDetails> &simDetails, int popSize, int numGen,
+		   int numSample, double monogamyRate, double offspringVar) {
+  int numMales = popSize / 2;
+  int numFemales = popSize - numMales;
+
+  // parents of each individual (by index in the previous generation): father,
+  // then mother
+  vector< vector<int> > parents(numGen);
+
+  uniform_real_distribution<double> unif(0.0, 1.0);
+  // weights have mean 1 and variance (<offspringVar> - 2) / 4
+  bool equalWeights = offspringVar == 2;
+  double shape = (equalWeights) ? 1.0 : 4.0 / (offspringVar - 2);
+  gamma_distribution<double> weightDist(shape, 1.0 / shape);
+  uniform_int_distribution<int> anyMother(numMales, popSize - 1);
+  uniform_int_distribution<int> anyCouple(0, numMales - 1);
+  vector<double> weights(numFemales);
+
+  for(int gen = 1; gen < numGen; gen++) {
+    // weights of the previous generation's females (and their couples)
+    discrete_distribution<int> motherDist, coupleDist;
+    if (!equalWeights) {
+      for(int f = 0; f < numFemales; f++)
+	weights[f] = weightDist(randomGen);
+      motherDist = discrete_distribution<int>(weights.begin(), weights.end());
+      coupleDist = discrete_distribution<int>(weights.begin(),
+					      weights.begin() + numMales);
+    }
+
+    parents[gen].resize(2 * popSize);
+    for(int i = 0; i < popSize; i++) {
+      int mother = (equalWeights) ? anyMother(randomGen) :
+				    numMales + motherDist(randomGen);
+      int father;
+      if (mother - numMales < numMales && unif(randomGen) < monogamyRate)
+	father = mother - numMales; // her partner
+      else
+	father = (equalWeights) ? anyCouple(randomGen) : coupleDist(randomGen);
+      parents[gen][2*i] = father;
+      parents[gen][2*i + 1] = mother;
+    }
+  }
+
+  // which individuals to keep: the sample and their ancestors
+  vector< vector<bool> > keep(numGen, vector<bool>(popSize, false));
+  if (numSample == 0 || numSample >= popSize)
+    keep[numGen - 1].assign(popSize, true);
+  else {
+    // partial Fisher-Yates shuffle
+    vector<int> perm(popSize);
+    for(int i = 0; i < popSize; i++)
+      perm[i] = i;
+    for(int s = 0; s < numSample; s++) {
+      uniform_int_distribution<int> pick(s, popSize - 1);
+      swap(perm[s], perm[ pick(randomGen) ]);
+      keep[numGen - 1][ perm[s] ] = true;
+    }
+  }
+  for(int gen = numGen - 1; gen > 0; gen--)
+    for(int i = 0; i < popSize; i++)
+      if (keep[gen][i])
+	for(int p = 0; p < 2; p++)
+	  keep[gen - 1][ parents[gen][2*i + p] ] = true;
+
+  vector<int> genSizes(numGen, 0);
+  for(int gen = 0; gen < numGen; gen++)
+    genSizes[gen] = count(keep[gen].begin(), keep[gen].end(), true);
+  SimDetails &pop = addOnePerBranch(simDetails, "pop", genSizes);
+
+  // branch numbers of the kept individuals in the previous and current
+  // generations
+  vector<int> prevBranch, curBranch(popSize, -1);
+  for(int gen = 0; gen < numGen; gen++) {
+    int num = 0;
+    for(int i = 0; i < popSize; i++)
+      curBranch[i] = (keep[gen][i]) ? num++ : -1;
+
+    for(int i = 0; i < popSize; i++) {
+      int branch = curBranch[i];
+      if (branch < 0)
+	continue;
+
+      pop.numSampsToPrint[gen][branch] = (gen == numGen - 1) ? 1 : 0;
+      for(int p = 0; p < 2; p++) {
+	Parent &parent = pop.branchParents[gen][branch*2 + p];
+	if (gen == 0) {
+	  parent.gen = -1;
+	  parent.branch = -1;
+	}
+	else {
+	  parent.gen = gen - 1;
+	  parent.branch = prevBranch[ parents[gen][2*i + p] ];
+	}
+      }
+      pop.sexConstraints[gen][branch].theSex = (i < numMales) ? 0 : 1;
+    }
+
+    prevBranch.swap(curBranch);
+    curBranch.resize(popSize);
+    // done with these
+    vector<int>().swap(parents[gen]);
+    vector<bool>().swap(keep[gen]);
+  }
+}
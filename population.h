@@ -0,0 +1,16 @@
+// ped-sim: pedigree simulation tool
+//
+// This program is distributed under the terms of the GNU General Public License
+
+#include <vector>
+#include "datastructs.h"
+
+#ifndef POPULATION_H
+#define POPULATION_H
+
+using namespace std;
+
+void genPopulation(vector<SimDetails> &simDetails, int popSize, int numGen,
+		   int numSample, double monogamyRate, double offspringVar);
+
+#endif // POPULATION_H
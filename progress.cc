@@ -0,0 +1,247 @@
+// ped-sim: pedigree simulation tool
+//
+// This program is distributed under the terms of the GNU General Public License
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include "progress.h"
+#include "runerror.h"
+
+bool Progress::on = false;
+atomic<uint64_t> Progress::done[NUM_PROG_STAGES];
+atomic<uint64_t> Progress::total[NUM_PROG_STAGES];
+atomic<uint64_t> Progress::startNs[NUM_PROG_STAGES];
+atomic<uint64_t> Progress::endNs[NUM_PROG_STAGES];
+atomic<int> Progress::state[NUM_PROG_STAGES];
+atomic<uint64_t> Progress::vcfLines, Progress::vcfBytesIn,
+		 Progress::vcfRecords, Progress::outBytes;
+atomic<const char *> Progress::vcfChr;
+atomic<bool> Progress::newLine;
+
+static const char *stageNames[NUM_PROG_STAGES] = {
+  "simulation", "IBD segments", "VCF"
+};
+static const char *stageUnits[NUM_PROG_STAGES] = {
+  "replicates", "carrier records", "input bytes"
+};
+
+static double interval;
+static FILE *logOut;
+static const char *jsonFile;
+static chrono::steady_clock::time_point origin;
+static thread reporter;
+static mutex stopLock;
+static condition_variable stopCond;
+static bool stopping = false;
+
+static uint64_t nowNs() {
+  return chrono::duration_cast<chrono::nanoseconds>(
+			    chrono::steady_clock::now() - origin).count();
+}
+
+void Progress::start(double interval, FILE *log, const char *jsonFile) {
+  ::interval = interval;
+  logOut = log;
+  ::jsonFile = jsonFile;
+  origin = chrono::steady_clock::now();
+  for(int s = 0; s < NUM_PROG_STAGES; s++) {
+    done[s] = total[s] = startNs[s] = endNs[s] = 0;
+    state[s] = 0;
+  }
+  vcfLines = vcfBytesIn = vcfRecords = outBytes = 0;
+  vcfChr = NULL;
+  newLine = false;
+  on = true;
+  reporter = thread(run);
+}
+
+void Progress::stop() {
+  if (!on)
+    return;
+  {
+    lock_guard<mutex> lk(stopLock);
+    stopping = true;
+    stopCond.notify_all();
+  }
+  reporter.join();
+  report(/*final=*/ true);
+  on = false;
+}
+
+void Progress::begin(ProgressStage stage, uint64_t total) {
+  if (!on)
+    return;
+  done[stage] = 0;
+  Progress::total[stage] = total;
+  startNs[stage] = nowNs();
+  if (state[stage] == 0)
+    newLine = true;
+  state[stage] = 1;
+}
+
+void Progress::end(ProgressStage stage) {
+  if (on) {
+    endNs[stage] = nowNs();
+    state[stage] = 2;
+  }
+}
+
+void Progress::run() {
+  unique_lock<mutex> lk(stopLock);
+  auto wait = chrono::duration<double>(interval);
+  while (!stopCond.wait_for(lk, wait, []{ return stopping; })) {
+    lk.unlock();
+    report(/*final=*/ false);
+    lk.lock();
+  }
+}
+
+void Progress::timeStr(char buf[32], double sec) {
+  if (sec < 120)
+    sprintf(buf, "%.1lf s", sec);
+  else if (sec < 2 * 3600)
+    sprintf(buf, "%.1lf min", sec / 60);
+  else
+    sprintf(buf, "%.1lf h", sec / 3600);
+}
+
+// Prints <bytes> in MB to <buf>
+static void mbStr(char buf[32], uint64_t bytes) {
+  sprintf(buf, "%.1lf MB", bytes / (1024.0 * 1024));
+}
+
+// Prints one line to stderr and the log and, with --progress_json, rewrites
+// that file
+void Progress::report(bool final) {
+  double elapsed = nowNs() * 1e-9;
+  char line[1024], buf[32];
+  int len = 0;
+  timeStr(buf, elapsed);
+  len += snprintf(line + len, sizeof(line) - len, "Progress [%s]:", buf);
+
+  // for the JSON file
+  struct StageStatus {
+    int state;
+    uint64_t done, total;
+    double rate, eta; // eta < 0 if unknown
+  } status[NUM_PROG_STAGES];
+
+  bool first = true;
+  for(int s = 0; s < NUM_PROG_STAGES; s++) {
+    StageStatus &cur = status[s];
+    cur.state = state[s];
+    cur.done = done[s].load(memory_order_relaxed);
+    cur.total = total[s];
+    // rate over the time the stage ran
+    double sec = ((cur.state == 2 ? endNs[s].load() : nowNs()) - startNs[s]) *
+									  1e-9;
+    cur.rate = (cur.state > 0 && sec > 0) ? cur.done / sec : 0.0;
+    cur.eta = (cur.total > 0 && cur.rate > 0 && cur.done <= cur.total) ?
+				(cur.total - cur.done) / cur.rate : -1.0;
+    if (cur.state != 1)
+      continue;
+
+    len += snprintf(line + len, sizeof(line) - len, "%s %s ",
+		    first ? "" : " |", stageNames[s]);
+    first = false;
+    if (s == PROG_VCF) {
+      const char *chr = vcfChr.load(memory_order_relaxed);
+      mbStr(buf, vcfBytesIn);
+      len += snprintf(line + len, sizeof(line) - len,
+		      "chr %s, %lu lines in (%s), %lu records out",
+		      chr ? chr : "-", (unsigned long) vcfLines.load(), buf,
+		      (unsigned long) vcfRecords.load());
+      if (cur.total > 0)
+	len += snprintf(line + len, sizeof(line) - len, ", %.1lf%% of input",
+			100.0 * cur.done / cur.total);
+    }
+    else {
+      len += snprintf(line + len, sizeof(line) - len, "%lu",
+		      (unsigned long) cur.done);
+      if (cur.total > 0)
+	len += snprintf(line + len, sizeof(line) - len, " of %lu",
+			(unsigned long) cur.total);
+      len += snprintf(line + len, sizeof(line) - len, " %s", stageUnits[s]);
+      if (cur.total > 0)
+	len += snprintf(line + len, sizeof(line) - len, " (%.1lf%%)",
+			100.0 * cur.done / cur.total);
+      len += snprintf(line + len, sizeof(line) - len, ", %.0lf/s", cur.rate);
+    }
+    if (cur.eta >= 0) {
+      timeStr(buf, cur.eta);
+      len += snprintf(line + len, sizeof(line) - len, ", ETA %s", buf);
+    }
+  }
+  if (first)
+    len += snprintf(line + len, sizeof(line) - len, "%s",
+		    final ? " finished" : " between stages");
+  mbStr(buf, outBytes);
+  snprintf(line + len, sizeof(line) - len, " | %s written\n", buf);
+
+  if (!final) {
+    if (newLine.exchange(false)) {
+      fputs("\n", stderr);
+      fputs("\n", logOut);
+    }
+    fputs(line, stderr);
+    fputs(line, logOut);
+    fflush(logOut);
+  }
+
+  if (!jsonFile)
+    return;
+
+  // write to a temporary file, then rename so readers never see part of one
+  char *tmpFile = new char[strlen(jsonFile) + 4 + 1];
+  if (tmpFile == NULL) {
+    printf("ERROR: out of memory");
+    fatalExit(5);
+  }
+  sprintf(tmpFile, "%s.tmp", jsonFile);
+  FILE *out = fopen(tmpFile, "w");
+  if (!out) {
+    fprintf(stderr, "\nERROR: could not open progress file %s!\n", tmpFile);
+    perror("open");
+    fatalExit(1);
+  }
+  const char *stateNames[3] = { "waiting", "running", "done" };
+  fprintf(out, "{\n  \"elapsed_sec\": %.3lf,\n  \"finished\": %s,\n",
+	  elapsed, final ? "true" : "false");
+  fprintf(out, "  \"bytes_out\": %lu,\n", (unsigned long) outBytes.load());
+  fprintf(out, "  \"stages\": {\n");
+  for(int s = 0; s < NUM_PROG_STAGES; s++) {
+    StageStatus &cur = status[s];
+    fprintf(out, "    \"%s\": { \"state\": \"%s\", \"unit\": \"%s\", \"done\": %lu, \"total\": %lu, \"rate\": %.3lf, ",
+	    stageNames[s], stateNames[cur.state], stageUnits[s],
+	    (unsigned long) cur.done, (unsigned long) cur.total, cur.rate);
+    if (cur.state == 1 && cur.eta >= 0)
+      fprintf(out, "\"eta_sec\": %.3lf }", cur.eta);
+    else
+      fprintf(out, "\"eta_sec\": null }");
+    fprintf(out, "%s\n", (s + 1 < NUM_PROG_STAGES) ? "," : "");
+  }
+  fprintf(out, "  },\n");
+  const char *chr = vcfChr.load(memory_order_relaxed);
+  fprintf(out, "  \"vcf\": { \"chrom\": ");
+  if (chr)
+    fprintf(out, "\"%s\"", chr);
+  else
+    fprintf(out, "null");
+  fprintf(out, ", \"lines_in\": %lu, \"bytes_in\": %lu, \"records_out\": %lu }\n",
+	  (unsigned long) vcfLines.load(), (unsigned long) vcfBytesIn.load(),
+	  (unsigned long) vcfRecords.load());
+  fprintf(out, "}\n");
+  fclose(out);
+  if (rename(tmpFile, jsonFile) != 0) {
+    fprintf(stderr, "\nERROR: could not rename %s to %s!\n", tmpFile,
+	    jsonFile);
+    perror("rename");
+    fatalExit(1);
+  }
+  delete [] tmpFile;
+}
@@ -0,0 +1,100 @@
+// ped-sim: pedigree simulation tool
+//
+// This program is distributed under the terms of the GNU General Public License
+
+#include <stdio.h>
+#include <stdint.h>
+#include <atomic>
+
+#ifndef PROGRESS_H
+#define PROGRESS_H
+
+using namespace std;
+
+// Stages whose progress is reported, each with its own unit of work (names
+// in progress.cc)
+enum ProgressStage {
+  PROG_SIMULATION, // replicates simulated
+  PROG_IBD,        // carrier records searched for IBD segments
+  PROG_VCF,        // bytes of the input VCF (as stored, so possibly
+		   // compressed) read
+  NUM_PROG_STAGES
+};
+
+////////////////////////////////////////////////////////////////////////////////
+// For --progress: a background thread that prints the progress of each stage
+// that is running -- the work done out of the total, the rate, and an
+// estimate of the time remaining -- along with the VCF lines and bytes read,
+// records printed, and the bytes written to all output files. It prints to
+// stderr and the log every <interval> seconds and, with --progress_json,
+// rewrites a JSON file with the same values for job schedulers. The code
+// doing the work only updates counters (relaxed atomic adds); unless start()
+// has been called, each update is a test of one flag.
+class Progress {
+  public:
+    // Starts reporting every <interval> seconds to stderr and <log> and, if
+    // <jsonFile> is non-NULL, to that file
+    static void start(double interval, FILE *log, const char *jsonFile);
+    // Prints a last report and stops the reporting thread
+    static void stop();
+    static bool enabled() { return on; }
+
+    // Marks <stage> as running with <total> units of work to do; for stages
+    // that run more than once (e.g., in --max_mem batches), restarts the
+    // count
+    static void begin(ProgressStage stage, uint64_t total);
+    static void end(ProgressStage stage);
+    static void add(ProgressStage stage, uint64_t num = 1) {
+      if (on)
+	done[stage].fetch_add(num, memory_order_relaxed);
+    }
+    static void set(ProgressStage stage, uint64_t num) {
+      if (on)
+	done[stage].store(num, memory_order_relaxed);
+    }
+
+    // A line of <bytes> read from the input VCF
+    static void vcfLineIn(uint64_t bytes) {
+      if (on) {
+	vcfLines.fetch_add(1, memory_order_relaxed);
+	vcfBytesIn.fetch_add(bytes, memory_order_relaxed);
+      }
+    }
+    // A record printed to the output VCF(s)
+    static void vcfRecordOut() {
+      if (on)
+	vcfRecords.fetch_add(1, memory_order_relaxed);
+    }
+    // Chromosome the VCF has reached (must remain valid: from the map)
+    static void vcfChrom(const char *name) {
+      if (on)
+	vcfChr.store(name, memory_order_relaxed);
+    }
+    // <bytes> of text handed to be written to an output file
+    static void bytesOut(uint64_t bytes) {
+      if (on)
+	outBytes.fetch_add(bytes, memory_order_relaxed);
+    }
+
+    // Prints <sec> with units to <buf>
+    static void timeStr(char buf[32], double sec);
+
+  private:
+    static void run();
+    static void report(bool final);
+
+    static bool on;
+    static atomic<uint64_t> done[NUM_PROG_STAGES];
+    static atomic<uint64_t> total[NUM_PROG_STAGES];
+    static atomic<uint64_t> startNs[NUM_PROG_STAGES];
+    static atomic<uint64_t> endNs[NUM_PROG_STAGES];
+    static atomic<int> state[NUM_PROG_STAGES]; // 0: not run, 1: running,
+					       // 2: ended
+    static atomic<uint64_t> vcfLines, vcfBytesIn, vcfRecords, outBytes;
+    static atomic<const char *> vcfChr;
+    // set when a stage first begins: its status message is likely still open
+    // on its line, so the next report starts a new one
+    static atomic<bool> newLine;
+};
+
+#endif // PROGRESS_H
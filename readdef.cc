@@ -8,7 +8,12 @@
 #include <limits.h>
 #include <errno.h>
 #include <assert.h>
+#include <unordered_map>
+#include <unordered_set>
+#include <string>
+#include <algorithm>
 #include "readdef.h"
+#include "runerror.h"
 
 // TODO: only use sexConstraints array when there are sex-specific maps?
 // TODO: make branchNumSpouses positive
@@ -23,9 +28,23 @@ void readDef(vector<SimDetails> &simDetails, char *defFile) {
   if (!in) {
     printf("ERROR: could not open def file %s!\n", defFile);
     perror("open");
-    exit(1);
+    fatalExit(1);
   }
 
+  // close the file if the definitions have an error (see fatalExit())
+  try {
+    readDef(simDetails, in);
+  }
+  catch (RunError &err) {
+    fclose(in);
+    throw;
+  }
+
+  fclose(in);
+}
+
+// Reads pedigree formats in def file format from <in>; see above
+void readDef(vector<SimDetails> &simDetails, FILE *in) {
   // def file gives the number of samples to print; we store this in a 2d array
   // with the first index being generation number and the second index the
   // branch number
@@ -61,14 +80,17 @@ void readDef(vector<SimDetails> &simDetails, char *defFile) {
   // Tracks whether there has been an explicit assignment of the parents of
   // each branch to avoid double assignments and giving default assignments.
   vector<bool> branchParentsAssigned;
-  // Stores sets of individuals that are required to have the same and/or
-  // opposite sex assignments by virtue of their being spouses.
-  // Also, for each set, stores the sex (either 0 or 1 for male or female) of
-  // the set if this is specified for any member of a set (or their partners)
-  // in the def file
+  // Tracks which branches are required to have the same and/or opposite sex
+  // assignments by virtue of their being spouses, along with the sexes this
+  // implies when the def file specifies the sex of any of them
   // (this value is temporary: its contents get put into <curSexConstraints>
   // during processing)
-  vector< pair<set<Parent,ParentComp>,int8_t>* > spouseDependencies;
+  SpouseDependencies spouseDependencies;
+
+  // names of the pedigrees, which must be unique
+  unordered_set<string> pedNames;
+  for(auto it = simDetails.begin(); it != simDetails.end(); it++)
+    pedNames.insert(it->name);
 
   bool warningGiven = false;
 
@@ -76,8 +98,15 @@ void readDef(vector<SimDetails> &simDetails, char *defFile) {
   char *buffer = (char *) malloc(bytesRead + 1);
   if (buffer == NULL) {
     printf("ERROR: out of memory");
-    exit(5);
+    fatalExit(5);
   }
+  // frees <buffer> on return or when the definitions have an error (see
+  // fatalExit()). The arrays for each pedigree are stored in <simDetails> as
+  // soon as they're allocated, so the caller can free them after an error.
+  struct FreeBuffer {
+    char *&buf;
+    ~FreeBuffer() { free(buf); }
+  } freeBuffer = { buffer };
   const char *delim = " \t\n";
 
   int line = 0;
@@ -93,7 +122,7 @@ void readDef(vector<SimDetails> &simDetails, char *defFile) {
     }
 
     if (strcmp(token, "def") == 0) {
-      if (spouseDependencies.size() > 0) {
+      if (spouseDependencies.nodes.size() > 0) {
 	// do some bookkeeping to finalize the previously read pedigree
 	int lastNumGen = curNumGen;
 	finishLastDef(lastNumGen, curSexConstraints, spouseDependencies);
@@ -112,7 +141,7 @@ void readDef(vector<SimDetails> &simDetails, char *defFile) {
 	fprintf(stderr, "ERROR: line %d in def: expect four or five fields for pedigree definition:\n",
 		line);
 	fprintf(stderr, "       def [name] [numReps] [numGen] <sex of i1>\n");
-	exit(5);
+	fatalExit(5);
       }
       errno = 0; // initially
       int curNumReps = strtol(numRepsStr, &endptr, 10);
@@ -121,7 +150,7 @@ void readDef(vector<SimDetails> &simDetails, char *defFile) {
 		line);
 	if (errno != 0)
 	  perror("strtol");
-	exit(2);
+	fatalExit(2);
       }
       curNumGen = strtol(numGenStr, &endptr, 10);
       if (errno != 0 || *endptr != '\0') {
@@ -130,7 +159,7 @@ void readDef(vector<SimDetails> &simDetails, char *defFile) {
 	fprintf(stderr, "      token\n");
 	if (errno != 0)
 	  perror("strtol");
-	exit(2);
+	fatalExit(2);
       }
 
       if (i1SexStr == NULL)
@@ -146,18 +175,14 @@ void readDef(vector<SimDetails> &simDetails, char *defFile) {
 	  fprintf(stderr, "ERROR: line %d in def: allowed values for sex of i1 field are 'M' and 'F'\n",
 		  line);
 	  fprintf(stderr, "       got %s\n", i1SexStr);
-	  exit(7);
+	  fatalExit(7);
 	}
       }
 
-      // TODO: slow linear search to ensure lack of repetition of the pedigree
-      // names; probably fast enough
-      for(auto it = simDetails.begin(); it != simDetails.end(); it++) {
-	if (strcmp(it->name, name) == 0) {
-	  fprintf(stderr, "ERROR: line %d in def: name of pedigree is same as previous pedigree\n",
-		  line);
-	  exit(5);
-	}
+      if (!pedNames.insert(name).second) {
+	fprintf(stderr, "ERROR: line %d in def: name of pedigree is same as previous pedigree\n",
+		line);
+	fatalExit(5);
       }
 
       curNumSampsToPrint = new int*[curNumGen];
@@ -169,7 +194,7 @@ void readDef(vector<SimDetails> &simDetails, char *defFile) {
 	  curBranchParents == NULL || curSexConstraints == NULL ||
 	  curBranchNumSpouses == NULL) {
 	printf("ERROR: out of memory");
-	exit(5);
+	fatalExit(5);
       }
       if (lastReadGen >= 0)
 	lastReadGen = -1; // reset
@@ -199,7 +224,7 @@ void readDef(vector<SimDetails> &simDetails, char *defFile) {
       fprintf(stderr, "ERROR: line %d in def: expect four or five fields for pedigree definition:\n",
 	      line);
       fprintf(stderr, "       def [name] [numReps] [numGen] <sex of i1>\n");
-      exit(5);
+      fatalExit(5);
     }
 
     char *genNumStr = token;
@@ -213,13 +238,13 @@ void readDef(vector<SimDetails> &simDetails, char *defFile) {
 	  line);
       if (errno != 0)
 	perror("strtol");
-      exit(2);
+      fatalExit(2);
     }
 
     if (numSampsStr == NULL) {
       printf("ERROR: improper line number %d in def file: expected at least two fields\n",
 	      line);
-      exit(5);
+      fatalExit(5);
     }
     int numSamps = strtol(numSampsStr, &endptr, 10);
     if (errno != 0 || *endptr != '\0') {
@@ -227,32 +252,32 @@ void readDef(vector<SimDetails> &simDetails, char *defFile) {
 	  line);
       if (errno != 0)
 	perror("strtol");
-      exit(2);
+      fatalExit(2);
     }
 
     if (generation < 1 || generation > curNumGen) {
       fprintf(stderr, "ERROR: line %d in def: generation %d below 1 or above %d (max number\n",
 	      line, generation, curNumGen);
       fprintf(stderr, "       of generations)\n");
-      exit(1);
+      fatalExit(1);
     }
     if (numSamps < 0) {
       fprintf(stderr, "ERROR: line %d in def: in generation %d, number of samples to print\n",
 	      line, generation);
       fprintf(stderr, "       below 0\n");
-      exit(2);
+      fatalExit(2);
     }
     if (generation == 1 && numSamps > 1) {
       fprintf(stderr, "ERROR: line %d in def: in generation 1, if founders are to be printed must\n",
 	      line);
       fprintf(stderr, "       list 1 as the number to be printed (others invalid)\n");
-      exit(2);
+      fatalExit(2);
     }
 
     if (generation <= lastReadGen) {
       fprintf(stderr, "ERROR: line %d in def: generation numbers must be in increasing order\n",
 	      line);
-      exit(7);
+      fatalExit(7);
     }
 
     // if <curNumBranches> != -1, have prior definition for generation.
@@ -260,7 +285,7 @@ void readDef(vector<SimDetails> &simDetails, char *defFile) {
     if (curNumBranches[generation - 1] != -1) {
       fprintf(stderr, "ERROR: line %d in def: multiple entries for generation %d\n",
 	      line, generation);
-      exit(2);
+      fatalExit(2);
     }
     // Will assign <numSamps> to each branch of this generation below -- first
     // need to know how many branches are in this generation
@@ -287,7 +312,7 @@ void readDef(vector<SimDetails> &simDetails, char *defFile) {
       curNumSampsToPrint[i] = new int[ curNumBranches[i] ];
       if (curNumSampsToPrint[i] == NULL) {
 	printf("ERROR: out of memory");
-	exit(5);
+	fatalExit(5);
       }
       for (int b = 0; b < curNumBranches[i]; b++)
 	curNumSampsToPrint[i][b] = 0;
@@ -302,13 +327,13 @@ void readDef(vector<SimDetails> &simDetails, char *defFile) {
 	fprintf(stderr, "      number of branches\n");
 	if (errno != 0)
 	  perror("strtol");
-	exit(2);
+	fatalExit(2);
       }
 
       if (thisGenNumBranches <= 0) {
 	fprintf(stderr, "ERROR: line %d in def: in generation %d, branch number zero or below\n",
 		line, generation);
-	exit(2);
+	fatalExit(2);
       }
       else {
 	curNumBranches[generation - 1] = thisGenNumBranches;
@@ -328,7 +353,7 @@ void readDef(vector<SimDetails> &simDetails, char *defFile) {
     curNumSampsToPrint[generation - 1] = new int[thisGenNumBranches];
     if (curNumSampsToPrint[generation - 1] == NULL) {
       printf("ERROR: out of memory");
-      exit(5);
+      fatalExit(5);
     }
     for(int b = 0; b < thisGenNumBranches; b++) {
       curNumSampsToPrint[generation - 1][b] = numSamps;
@@ -382,7 +407,7 @@ void readDef(vector<SimDetails> &simDetails, char *defFile) {
 	      it->name, it->numGen);
       fprintf(stderr, "       but no request to print any samples from last generation (number %d)\n",
 	      it->numGen);
-      exit(4);
+      fatalExit(4);
     }
     else if (anyNoPrint) {
       fprintf(stderr, "Warning: no-print branches in last generation of pedigree %s:\n",
@@ -394,44 +419,36 @@ void readDef(vector<SimDetails> &simDetails, char *defFile) {
   if (simDetails.size() == 0) {
     fprintf(stderr, "ERROR: def file does not contain pedigree definitions;\n");
     fprintf(stderr, "       nothing to simulate\n");
-    exit(3);
+    fatalExit(3);
   }
 
-  free(buffer);
-  fclose(in);
-
   if (warningGiven)
     fprintf(stderr, "\n");
+
+  shareStructures(simDetails);
 }
 
 void finishLastDef(int numGen, SexConstraint **&sexConstraints,
-		   vector< pair<set<Parent,ParentComp>,int8_t>* > &spouseDependencies) {
-  // need to assign sex from spouse dependency sets to <sexConstraints>; also
-  // don't need to store the spouse dependency sets anymore:
-  for(unsigned int i = 0; i < spouseDependencies.size(); i++) {
-    if (spouseDependencies[i] != NULL) {
-      int8_t theSex = spouseDependencies[i]->second;
-      if (theSex >= 0) {
-	// assign the sexes of all samples in the spouseDependencies set to
-	// <theSex>
-	set<Parent,ParentComp> &toUpdate = spouseDependencies[i]->first;
-	for(auto it = toUpdate.begin(); it != toUpdate.end(); it++) {
-	  assert(sexConstraints[ it->gen ][ it->branch ].theSex == -1 ||
-		 sexConstraints[ it->gen ][ it->branch ].theSex == theSex);
-	  sexConstraints[ it->gen ][ it->branch ].theSex = theSex;
-	}
-      }
-      delete spouseDependencies[i];
-      spouseDependencies[i] = NULL;
+		   SpouseDependencies &spouseDependencies) {
+  // replace the node indexes stored in <sexConstraints> with the constraint
+  // set indexes of their components and assign the sexes these imply:
+  vector<SpouseNode> &nodes = spouseDependencies.nodes;
+  for(unsigned int i = 0; i < nodes.size(); i++) {
+    int8_t parity;
+    int root = findSpouseRoot(nodes, i, parity);
+    SexConstraint &constraint =
+		    sexConstraints[ nodes[i].branch.gen ][ nodes[i].branch.branch ];
+    constraint.set = nodes[root].setBase + (nodes[root].rootSet ^ parity);
+    if (nodes[root].sex >= 0) {
+      assert(constraint.theSex == -1 ||
+	     constraint.theSex == (nodes[root].sex ^ parity));
+      constraint.theSex = nodes[root].sex ^ parity;
     }
   }
-  // TODO: can speed things by doing this, though note that it means that the
-  // results for a given random seed will differ relative to an earlier version
-  // of Ped-sim; therefore, will not do this, but may combine it with another
-  // feature that has this effect
-  // (Also, if this gets put in place, can remove the assignment of NULL just
-  // above.)
-  //spouseDependencies.clear();
+  nodes.clear();
+  // Note: could reset <spouseDependencies.numSets> here, but that would mean
+  // the results for a given random seed differ relative to earlier versions of
+  // Ped-sim
 }
 
 // Gives the default parent assignment for any branches that have not had
@@ -450,7 +467,7 @@ void assignDefaultBranchParents(int prevGenNumBranches, int thisGenNumBranches,
     *thisGenBranchParents = new Parent[2 * thisGenNumBranches];
     if (*thisGenBranchParents == NULL) {
       printf("ERROR: out of memory");
-      exit(5);
+      fatalExit(5);
     }
   }
 
@@ -503,7 +520,7 @@ bool readBranchSpec(int *numBranches, Parent **thisGenBranchParents,
 		    int *thisGenNumSampsToPrint, int curGen,
 		    SexConstraint **sexConstraints, int **prevGenSpouseNum,
 		    vector<bool> &branchParentsAssigned,
-		    vector< pair<set<Parent,ParentComp>,int8_t>* > &spouseDependencies,
+		    SpouseDependencies &spouseDependencies,
 		    const int i1Sex, const char *delim, char *&saveptr,
 		    char *&endptr, int line) {
   bool warningGiven = false;
@@ -514,7 +531,7 @@ bool readBranchSpec(int *numBranches, Parent **thisGenBranchParents,
     *prevGenSpouseNum = new int[numBranches[prevGen]];
     if (*prevGenSpouseNum == NULL) {
       printf("ERROR: out of memory\n");
-      exit(5);
+      fatalExit(5);
     }
     for(int b = 0; b < numBranches[prevGen]; b++)
       // What number have we assigned through for founder spouses of
@@ -528,7 +545,7 @@ bool readBranchSpec(int *numBranches, Parent **thisGenBranchParents,
     *thisGenBranchParents = new Parent[ 2 * numBranches[curGen] ];
     if (*thisGenBranchParents == NULL) {
       printf("ERROR: out of memory\n");
-      exit(5);
+      fatalExit(5);
     }
 
     if (sexConstraints[prevGen] == NULL) {
@@ -538,7 +555,7 @@ bool readBranchSpec(int *numBranches, Parent **thisGenBranchParents,
       sexConstraints[prevGen] = new SexConstraint[numBranches[prevGen]];
       if (sexConstraints[prevGen] == NULL) {
 	printf("ERROR: out of memory\n");
-	exit(5);
+	fatalExit(5);
       }
       initSexConstraints(sexConstraints[prevGen], numBranches[prevGen]);
     }
@@ -578,14 +595,14 @@ bool readBranchSpec(int *numBranches, Parent **thisGenBranchParents,
       fprintf(stderr, "ERROR: line %d in def: improperly formatted parent assignment, sex assignment\n",
 	      line);
       fprintf(stderr, "       or no-print field %s\n", assignToken);
-      exit(8);
+      fatalExit(8);
     }
     assignToken[i] = '\0';
 
     if (curGen == 0 && parentAssign) {
       fprintf(stderr, "ERROR: line %d in def: first generation cannot have parent specifications\n",
 	      line);
-      exit(8);
+      fatalExit(8);
     }
 
     // should have only one of these options:
@@ -608,7 +625,7 @@ bool readBranchSpec(int *numBranches, Parent **thisGenBranchParents,
 	fprintf(stderr, "ERROR: line %d in def: improperly formatted no-print field \"%s\":\n",
 		line, assignToken);
 	fprintf(stderr, "       no-print character 'n' should be followed by white space\n");
-	exit(8);
+	fatalExit(8);
       }
     }
     else {
@@ -625,7 +642,7 @@ bool readBranchSpec(int *numBranches, Parent **thisGenBranchParents,
 	fprintf(stderr, "ERROR: line %d in def: improperly formatted sex assignment field \"%s\":\n",
 		line, assignToken);
 	fprintf(stderr, "       character 's' should be followed either 'M' or 'F' and then white space\n");
-	exit(10);
+	fatalExit(10);
       }
     }
 
@@ -647,7 +664,7 @@ bool readBranchSpec(int *numBranches, Parent **thisGenBranchParents,
 	if (startBranch != NULL) {
 	  fprintf(stderr, "ERROR: line %d in def: improperly formatted branch range \"%s-%s-\"\n",
 		  line, startBranch, assignBranches);
-	  exit(5);
+	  fatalExit(5);
 	}
 	startBranch = assignBranches;
 	assignBranches = &(assignBranches[i+1]); // go through next loop
@@ -674,7 +691,7 @@ bool readBranchSpec(int *numBranches, Parent **thisGenBranchParents,
 		    (sexToAssign == 0) ? 'M' : 'F');
 	  if (errno != 0)
 	    perror("strtol");
-	  exit(2);
+	  fatalExit(2);
 	}
 
 	if (startBranch) {
@@ -692,7 +709,7 @@ bool readBranchSpec(int *numBranches, Parent **thisGenBranchParents,
 		      (sexToAssign == 0) ? 'M' : 'F');
 	    if (errno != 0)
 	      perror("strtol");
-	    exit(2);
+	    fatalExit(2);
 	  }
 	  startBranch = NULL; // parsed: reset this variable
 
@@ -706,13 +723,13 @@ bool readBranchSpec(int *numBranches, Parent **thisGenBranchParents,
 	    else // sexAssign
 	      fprintf(stderr, "       assign sex %c to\n",
 		      (sexToAssign == 0) ? 'M' : 'F');
-	    exit(8);
+	    fatalExit(8);
 	  }
 	  if (rangeEnd >= numBranches[curGen]) {
 	    fprintf(stderr, "ERROR: line %d in def: request to assign a branch greater than %d, the total\n",
 		    line, numBranches[curGen]);
 	    fprintf(stderr, "       number of branches in generation %d\n", curGen + 1);
-	    exit(11);
+	    fatalExit(11);
 	  }
 
 	  for(int branch = rangeStart; branch <= rangeEnd; branch++) {
@@ -727,7 +744,7 @@ bool readBranchSpec(int *numBranches, Parent **thisGenBranchParents,
 	    fprintf(stderr, "ERROR: line %d in def: request to assign a branch greater than %d, the total\n",
 		    line, numBranches[curGen]);
 	    fprintf(stderr, "       number of branches in generation %d\n", curGen + 1);
-	    exit(11);
+	    fatalExit(11);
 	  }
 
 	  assignBranch(parentAssign, noPrint, sexToAssign, curGen, curBranch,
@@ -749,15 +766,11 @@ bool readBranchSpec(int *numBranches, Parent **thisGenBranchParents,
       else // sexAssign
 	fprintf(stderr, "assign sex %c to\n", (sexToAssign == 0) ? 'M' : 'F');
       fprintf(stderr, "does not terminate\n");
-      exit(8);
+      fatalExit(8);
     }
   }
 
-  // TODO: As a space optimization, could compress the spouseDependencies
-  //       vector more. When combining two sets, the indexes of one of the set
-  //       are no longer used, but the size of the spouseDependencies list
-  //       still accounts for them.
-  assert(spouseDependencies.size() % 2 == 0);
+  assert(spouseDependencies.numSets % 2 == 0);
 
   if (curGen > 0)
     assignDefaultBranchParents(numBranches[prevGen], numBranches[curGen],
@@ -776,7 +789,7 @@ void assignBranch(bool parentAssign, bool noPrint, int sexToAssign, int curGen,
     if (branchParentsAssigned[branch]) {
       fprintf(stderr, "ERROR: line %d in def: parents of branch number %d assigned multiple times\n",
 	      line, branch+1);
-      exit(8);
+      fatalExit(8);
     }
     branchParentsAssigned[branch] = true;
     for(int p = 0; p < 2; p++)
@@ -802,14 +815,14 @@ void assignBranch(bool parentAssign, bool noPrint, int sexToAssign, int curGen,
       sexConstraints[curGen] = new SexConstraint[thisGenNumBranches];
       if (sexConstraints[curGen] == NULL) {
 	printf("ERROR: out of memory\n");
-	exit(5);
+	fatalExit(5);
       }
       initSexConstraints(sexConstraints[curGen], thisGenNumBranches);
     }
     else if (sexConstraints[curGen][branch].theSex != -1) {
       fprintf(stderr, "ERROR: line %d in def: sex of branch number %d assigned multiple times\n",
 	      line, branch+1);
-      exit(8);
+      fatalExit(8);
     }
     sexConstraints[curGen][branch].theSex = sexToAssign;
   }
@@ -818,7 +831,7 @@ void assignBranch(bool parentAssign, bool noPrint, int sexToAssign, int curGen,
 // In the branch specifications, read the parent assignments
 void readParents(int *numBranches, int prevGen, SexConstraint **sexConstraints,
 		 int **prevGenSpouseNum,
-		 vector< pair<set<Parent,ParentComp>,int8_t>* > &spouseDependencies,
+		 SpouseDependencies &spouseDependencies,
 		 char *assignBranches, char *assignPar[2], Parent pars[2],
 		 char *&fullAssignPar, const int i1Sex, char *&endptr,
 		 int line) {
@@ -849,7 +862,7 @@ void readParents(int *numBranches, int prevGen, SexConstraint **sexConstraints,
 	fprintf(stderr, "       number for the first parent, but this is only allowed for the second\n");
 	fprintf(stderr, "       parent; for example, 2:1_3^1 has branch 1 from previous generation\n");
 	fprintf(stderr, "       married to branch 3 from generation 1\n");
-	exit(3);
+	fatalExit(3);
       }
       assignPar[p][i] = '\0';
       genNumStr = &(assignPar[p][i+1]);
@@ -861,21 +874,21 @@ void readParents(int *numBranches, int prevGen, SexConstraint **sexConstraints,
 		genNumStr);
 	if (errno != 0)
 	  perror("strtol");
-	exit(5);
+	fatalExit(5);
       }
       if (pars[p].gen > prevGen) {
 	fprintf(stderr, "ERROR: line %d in def: unable to parse parent assignment for branches %s\n",
 		line, assignBranches);
 	fprintf(stderr, "       generation number %s for second parent is after previous generation\n",
 		genNumStr);
-	exit(-7);
+	fatalExit(-7);
       }
       else if (pars[p].gen < 0) {
 	fprintf(stderr, "ERROR: line %d in def: unable to parse parent assignment for branches %s\n",
 		line, assignBranches);
 	fprintf(stderr, "       generation number %s for second parent is before first generation\n",
 		genNumStr);
-	exit(5);
+	fatalExit(5);
       }
     }
 
@@ -885,19 +898,19 @@ void readParents(int *numBranches, int prevGen, SexConstraint **sexConstraints,
 	      line, assignBranches);
       if (errno != 0)
 	perror("strtol");
-      exit(2);
+      fatalExit(2);
     }
     if (pars[p].branch < 0) {
       fprintf(stderr, "ERROR: line %d in def: parent assignments must be of positive branch numbers\n",
 	      line);
-      exit(8);
+      fatalExit(8);
     }
     else if (pars[p].branch >= numBranches[ pars[p].gen ]) {
       fprintf(stderr, "ERROR: line %d in def: parent branch number %d is more than the number of\n",
 	      line, pars[p].branch+1);
       fprintf(stderr, "       branches (%d) in generation %d\n",
 	      numBranches[ pars[p].gen ], pars[p].gen+1);
-      exit(8);
+      fatalExit(8);
     }
     // so that we can print the parent assignment in case of errors below
     if (genNumStr != NULL)
@@ -920,14 +933,14 @@ void readParents(int *numBranches, int prevGen, SexConstraint **sexConstraints,
     if (pars[0].branch == pars[1].branch && pars[0].gen == pars[1].gen) {
       fprintf(stderr, "ERROR: line %d in def: cannot have both parents be from same branch\n",
 	      line);
-      exit(8);
+      fatalExit(8);
     }
     if (i1Sex >= 0) {
       fprintf(stderr, "ERROR: line %d in def: cannot have fixed sex for i1 samples and marriages\n",
 	      line);
       fprintf(stderr, "       between branches -- i1's will have the same sex and cannot reproduce.\n");
       fprintf(stderr, "       consider assigning sexes to individual branches\n");
-      exit(9);
+      fatalExit(9);
     }
     updateSexConstraints(sexConstraints, pars, numBranches, spouseDependencies,
 			 line);
@@ -942,269 +955,315 @@ void readParents(int *numBranches, int prevGen, SexConstraint **sexConstraints,
 // Given the branch indexes of two parents, adds constraints and error checks
 // to ensure that this couple does not violate the requirement that parents
 // must have opposite sex.
-// Also stores (in <spouseDependencies>) the specified or inferred sexes of the
-// branches; sexes explicitly specified in the def file are currently stored in
-// <sexConstraints>. This function infers the sexes of those branches these
-// individuals have children with, and transitively to the partners of those
-// branches, etc.
+// The branches that have children with other branches are nodes in a
+// union-find structure (<spouseDependencies>) in which each node stores
+// whether it has the same or opposite sex as its parent node. Joining two
+// components and checking a couple against the sexes already implied are
+// nearly constant time, so machine-generated def files with many branches and
+// marriages between them are read in time close to linear in their size.
+// Sexes explicitly specified in the def file are in <sexConstraints> and
+// propagate to every branch in the component.
 void updateSexConstraints(SexConstraint **sexConstraints, Parent pars[2],
 			  int *numBranches,
-			  vector< pair< set<Parent,ParentComp>, int8_t>* >
-							    &spouseDependencies,
-			  int line) {
+			  SpouseDependencies &spouseDependencies, int line) {
   // we check these things in the caller, but just to be sure:
   for(int p = 0; p < 2; p++) {
     assert(pars[p].branch >= 0);
     assert(pars[p].branch < numBranches[ pars[p].gen ]);
   }
 
-  if (sexConstraints[ pars[0].gen ][ pars[0].branch ].set == -1 &&
-      sexConstraints[ pars[1].gen ][ pars[1].branch ].set == -1) {
-    // neither is a member of a spouse set: create and add to
-    // <spouseDependencies>
-    pair<set<Parent,ParentComp>,int8_t> *sets[2];
-    for(int p = 0; p < 2; p++) {
-      sets[p] = new pair<set<Parent,ParentComp>,int8_t>();
-      if (sets[p] == NULL) {
-	printf("ERROR: out of memory");
-	exit(5);
-      }
-      sets[p]->first.insert( pars[p] );
-      // which index in spouseDependencies is the set corresponding to this
-      // parent stored in? As we're about to add it just below this, the
-      // current size will be the index
-      sexConstraints[ pars[p].gen ][ pars[p].branch ].set =
-						      spouseDependencies.size();
-      if (sexConstraints[ pars[p].gen ][ pars[p].branch ].theSex != -1)
-	sets[p]->second = sexConstraints[pars[p].gen][pars[p].branch].theSex;
-      else
-	sets[p]->second = -1;
-      spouseDependencies.push_back( sets[p] );
+  vector<SpouseNode> &nodes = spouseDependencies.nodes;
+
+  // add a node for any parent that hasn't had children with another branch
+  // before
+  for(int p = 0; p < 2; p++) {
+    SexConstraint &constraint = sexConstraints[pars[p].gen][pars[p].branch];
+    if (constraint.set == -1) {
+      SpouseNode node;
+      node.parent = nodes.size();
+      node.parity = 0;
+      node.branch = pars[p];
+      node.size = 1;
+      node.setBase = -1;
+      node.rootSet = 0;
+      node.sex = constraint.theSex;
+      constraint.set = nodes.size();
+      nodes.push_back(node);
     }
+  }
 
-    // any assigned sexes? ensure consistency:
-    if (sets[0]->second >= 0 || sets[1]->second >= 0) {
-      for(int p = 0; p < 2; p++)
-	if (sets[p]->second < 0)
-	  // infer sex that is unassigned: is opposite (^ 1) the assigned one
-	  sets[p]->second = sets[ p^1 ]->second ^ 1;
-      if (sets[0]->second != (sets[1]->second ^ 1)) {
-	fprintf(stderr, "ERROR: line %d in def: assigning branch %d from generation %d and branch %d from\n",
-		line, pars[0].branch+1, pars[0].gen+1, pars[1].branch+1);
-	fprintf(stderr, "       generation %d as parents is impossible: they are assigned the same sex\n",
-		pars[1].gen+1);
-	exit(3);
-      }
+  int roots[2];
+  int8_t parity[2];
+  for(int p = 0; p < 2; p++)
+    roots[p] = findSpouseRoot(nodes,
+			      sexConstraints[pars[p].gen][pars[p].branch].set,
+			      parity[p]);
+
+  if (roots[0] == roots[1]) {
+    if (parity[0] == parity[1]) {
+      fprintf(stderr, "ERROR: line %d in def: assigning branch %d from generation %d and branch %d from\n",
+	      line, pars[0].branch+1, pars[0].gen+1, pars[1].branch+1);
+      fprintf(stderr, "       generation %d as parents is impossible due to other parent assignments:\n",
+	      pars[1].gen+1);
+      fprintf(stderr, "       they necessarily have same sex\n");
+      fatalExit(5);
     }
+    return; // already constrained to have opposite sexes
   }
-  else if (sexConstraints[ pars[0].gen ][ pars[0].branch ].set == -1 ||
-	   sexConstraints[ pars[1].gen ][ pars[1].branch ].set == -1) {
-    // one spouse is a member of a spouse set and the other is not: add the
-    // other parent to the opposite spouse set, error check, and update state
-    int assignedPar = -1;
-    if (sexConstraints[ pars[0].gen ][ pars[0].branch ].set >= 0)
-      assignedPar = 0;
-    else
-      assignedPar = 1;
-
-    int otherPar = assignedPar ^ 1;
-    int assignedSetIdx = sexConstraints[ pars[assignedPar].gen ]
-				       [ pars[assignedPar].branch ].set;
-
-    // since <otherPar> isn't in a spouse set yet, it definitely shouldn't be in
-    // the same spouse set as <assignedPar>
-    assert((unsigned int) assignedSetIdx < spouseDependencies.size());
-    assert(spouseDependencies[ assignedSetIdx ] != NULL);
-    assert(spouseDependencies[ assignedSetIdx ]->first.find( pars[otherPar] ) ==
-			      spouseDependencies[assignedSetIdx]->first.end());
-
-    // NOTE: The following is a trick that relies on the fact that sets are
-    // stored as sequential pairs in <spouseDependencies>. Ex: indexes 0 and 1
-    // are pairs of spouses that are dependent upon each other (those in index
-    // 0 must have the same sex and must be opposite those in index 1). To get
-    // an even number that is 1 minus an odd value or the odd number that is 1
-    // plus an even value, it suffices to flip the lowest order bit:
-    int otherSetIdx = assignedSetIdx ^ 1;
-    // add <pars[otherPar]> to the set containing spouses of <pars[assignedPar]>
-    spouseDependencies[ otherSetIdx ]->first.insert( pars[otherPar] );
-    sexConstraints[ pars[otherPar].gen ][ pars[otherPar].branch ].set
-								  = otherSetIdx;
-    // is the "new" spouse assigned a sex? If not, no change needed: that
-    // person can have sex assigned according to the current constraints, but
-    // if so, error check and, if needed, update
-    if (sexConstraints[pars[otherPar].gen][pars[otherPar].branch].theSex >= 0) {
-      if (spouseDependencies[ otherSetIdx ]->second == -1) {
-	// sex not yet assigned in <spouseDependencies>; ensure that that's
-	// true of both the "linked" dependency sets:
-	assert(spouseDependencies[ assignedSetIdx ]->second == -1);
-
-	// no sexes assigned yet; assign:
-	spouseDependencies[ otherSetIdx ]->second =
-	       sexConstraints[pars[otherPar].gen][pars[otherPar].branch].theSex;
-	spouseDependencies[ assignedSetIdx ]->second =
-				(spouseDependencies[ otherSetIdx ]->second ^ 1);
-      }
-      else if (spouseDependencies[ otherSetIdx ]->second !=
-	     sexConstraints[pars[otherPar].gen][pars[otherPar].branch].theSex) {
-	fprintf(stderr, "ERROR: line %d in def: assigning branch %d from generation %d as a parent with\n",
-		line, pars[otherPar].branch+1, pars[otherPar].gen+1);
-	fprintf(stderr, "       branch %d from generation %d is impossible: due to sex assignments and/or\n",
-		pars[assignedPar].branch+1, pars[assignedPar].gen+1);
-	fprintf(stderr, "       other parent assignments they necessarily have the same sex\n");
-	exit(4);
-      }
-      // else: the current assigned sex for <otherSetIdx> is the same as the
-      // spouse
+
+  // the parents have opposite sexes, so the root of pars[1] has the sex of
+  // the root of pars[0] xor <rel>
+  int8_t rel = parity[0] ^ parity[1] ^ 1;
+  SpouseNode &root0 = nodes[ roots[0] ], &root1 = nodes[ roots[1] ];
+  if (root0.sex >= 0 && root1.sex >= 0 && root1.sex != (root0.sex ^ rel)) {
+    if (root0.size == 1 && root1.size == 1) {
+      fprintf(stderr, "ERROR: line %d in def: assigning branch %d from generation %d and branch %d from\n",
+	      line, pars[0].branch+1, pars[0].gen+1, pars[1].branch+1);
+      fprintf(stderr, "       generation %d as parents is impossible: they are assigned the same sex\n",
+	      pars[1].gen+1);
+      fatalExit(3);
     }
+    // name the parent that is new to the constraints (if any) first
+    int first = (root1.size == 1) ? 1 : 0;
+    fprintf(stderr, "ERROR: line %d in def: assigning branch %d from generation %d as a parent with\n",
+	    line, pars[first].branch+1, pars[first].gen+1);
+    fprintf(stderr, "       branch %d from generation %d is impossible: due to sex assignments and/or\n",
+	    pars[first^1].branch+1, pars[first^1].gen+1);
+    fprintf(stderr, "       other parent assignments they necessarily have the same sex\n");
+    fatalExit((root0.size == 1 || root1.size == 1) ? 4 : 6);
+  }
+
+  // the sex and constraint set of root0 after the merge; the component keeps
+  // the constraint set indexes of pars[0]'s component if it has them so that
+  // these match those in earlier versions of Ped-sim (which determine the
+  // sexes drawn for a given random seed)
+  int8_t sex = (root0.sex >= 0) ? root0.sex :
+				  ((root1.sex >= 0) ? root1.sex ^ rel : -1);
+  int setBase;
+  int8_t rootSet;
+  if (root0.setBase >= 0) {
+    setBase = root0.setBase;
+    rootSet = root0.rootSet;
+  }
+  else if (root1.setBase >= 0) {
+    setBase = root1.setBase;
+    rootSet = root1.rootSet ^ rel;
   }
   else {
-    assert(sexConstraints[ pars[0].gen ][ pars[0].branch ].set >= 0 &&
-	   sexConstraints[ pars[1].gen ][ pars[1].branch ].set >= 0);
-    // both are members of spouse sets
-
-    if (sexConstraints[ pars[0].gen ][ pars[0].branch ].set / 2 ==
-	sexConstraints[ pars[1].gen ][ pars[1].branch ].set / 2) {
-      // spouse sets from the same pair of sets
-      if (sexConstraints[ pars[0].gen ][ pars[0].branch ].set ==
-	  sexConstraints[ pars[1].gen ][ pars[1].branch ].set) {
-	fprintf(stderr, "ERROR: line %d in def: assigning branch %d from generation %d and branch %d from\n",
-		line, pars[0].branch+1, pars[0].gen+1, pars[1].branch+1);
-	fprintf(stderr, "       generation %d as parents is impossible due to other parent assignments:\n",
-		pars[1].gen+1);
-	fprintf(stderr, "       they necessarily have same sex\n");
-	exit(5);
+    // two new branches: new pair of constraint sets
+    setBase = spouseDependencies.numSets;
+    spouseDependencies.numSets += 2;
+    rootSet = 0;
+  }
+
+  // union by size
+  if (root0.size >= root1.size) {
+    root1.parent = roots[0];
+    root1.parity = rel;
+    root0.size += root1.size;
+    root0.setBase = setBase;
+    root0.rootSet = rootSet;
+    root0.sex = sex;
+  }
+  else {
+    root0.parent = roots[1];
+    root0.parity = rel;
+    root1.size += root0.size;
+    root1.setBase = setBase;
+    root1.rootSet = rootSet ^ rel;
+    root1.sex = (sex >= 0) ? sex ^ rel : -1;
+  }
+}
+
+// Returns the root of the component in <nodes> that contains node <n> and
+// sets <parity> to 1 if <n> has the opposite sex of the root or 0 if the same.
+// Points all the nodes on the path directly to the root.
+int findSpouseRoot(vector<SpouseNode> &nodes, int n, int8_t &parity) {
+  int root = n;
+  parity = 0;
+  while (nodes[root].parent != root) {
+    parity ^= nodes[root].parity;
+    root = nodes[root].parent;
+  }
+
+  int8_t curParity = parity; // of <n> relative to <root>
+  while (n != root) {
+    int next = nodes[n].parent;
+    int8_t nextParity = curParity ^ nodes[n].parity;
+    nodes[n].parent = root;
+    nodes[n].parity = curParity;
+    n = next;
+    curParity = nextParity;
+  }
+  return root;
+}
+
+void initSexConstraints(SexConstraint *newSexConstraints, int numBranches) {
+  for(int i = 0; i < numBranches; i++) {
+    newSexConstraints[i].set = -1;
+    newSexConstraints[i].theSex = -1;
+  }
+}
+
+// Def files generated by scripts often contain many entries with the same
+// structure, differing only in their names and numbers of replicates. Makes
+// each such entry share the arrays of the first entry with its structure (see
+// SimDetails::sharesWith), freeing its own, so that the work done for each
+// structure -- e.g., the founder ids for the mrca file -- is done once. The
+// constraint set indexes are numbered across the def file, so they are
+// compared relative to the lowest index in each entry.
+void shareStructures(vector<SimDetails> &simDetails) {
+  // entries that own their arrays, by the hash of their structure
+  unordered_map< uint64_t, vector<int> > owners;
+  vector<int> setBases(simDetails.size());
+
+  for(unsigned int ped = 0; ped < simDetails.size(); ped++) {
+    SimDetails &cur = simDetails[ped];
+    setBases[ped] = getSetBase(cur);
+    if (cur.sharesWith >= 0 || cur.sampleIds)
+      continue; // already shared (by an earlier call) or from a fam file
+
+    vector<int> &candidates = owners[ hashStructure(cur, setBases[ped]) ];
+    for(auto it = candidates.begin(); it != candidates.end(); it++) {
+      SimDetails &owner = simDetails[*it];
+      if (sameStructure(owner, setBases[*it], cur, setBases[ped])) {
+	deleteStructure(cur);
+	cur.numSampsToPrint = owner.numSampsToPrint;
+	cur.numBranches = owner.numBranches;
+	cur.branchParents = owner.branchParents;
+	cur.sexConstraints = owner.sexConstraints;
+	cur.branchNumSpouses = owner.branchNumSpouses;
+	cur.sharesWith = *it;
+	cur.setShift = setBases[ped] - setBases[*it];
+	break;
       }
-      // otherwise done with set assignment
     }
-    else {
-      // two distinct sets of spouse sets: must generate two sets that are the
-      // unions of the appropriate sets -- all the spouses of both must be
-      // constrained to be opposite sex
-      int setIdxes[2][2]; // current set indexes
-      for(int p = 0; p < 2; p++) {
-	setIdxes[p][0] = sexConstraints[ pars[p].gen ]
-				       [ pars[p].branch ].set;
-	// see comment denoted with NOTE a little ways above for why this works:
-	setIdxes[p][1] = setIdxes[p][0] ^ 1;
-      }
+    if (cur.sharesWith < 0)
+      candidates.push_back(ped);
+  }
+}
 
-      for(int i = 0; i < 2; i++)
-	for(int j = 0; j < 2; j++)
-	  assert(spouseDependencies[ setIdxes[i][j] ] != NULL);
-
-      // check/ensure that the sets to be unioned have consistent sexes (if
-      // assigned). We will union into setIdxes[0][*], so loop over the second
-      // index (the merge parent index)
-      for(int mp = 0; mp < 2; mp++) { // loop over merged p index
-	int op = mp ^ 1; // other p
-	if (spouseDependencies[ setIdxes[0][mp] ]->second !=
-	    spouseDependencies[ setIdxes[1][op] ]->second) {
-	  if (spouseDependencies[ setIdxes[0][mp] ]->second == -1)
-	    // set to be unioned into doesn't have a sex assigned; set to the
-	    // same as the other parent:
-	    spouseDependencies[ setIdxes[0][mp] ]->second =
-				  spouseDependencies[ setIdxes[1][op] ]->second;
-	  else if (spouseDependencies[ setIdxes[1][op] ]->second != -1) {
-	    // the sexes of the two sets to be merged are different; error
-	    fprintf(stderr, "ERROR: line %d in def: assigning branch %d from generation %d as a parent with\n",
-		    line, pars[0].branch+1, pars[0].gen+1);
-	    fprintf(stderr, "       branch %d from generation %d is impossible: due to sex assignments and/or\n",
-		    pars[1].branch+1, pars[1].gen+1);
-	    fprintf(stderr, "       other parent assignments they necessarily have the same sex\n");
-	    exit(6);
-	  }
+// Returns the even constraint set index at or below the lowest in
+// <pedDetails> (0 if it has none)
+int getSetBase(SimDetails &pedDetails) {
+  int minSet = INT_MAX;
+  for(int gen = 0; gen < pedDetails.numGen; gen++) {
+    if (pedDetails.sexConstraints[gen] == NULL)
+      continue;
+    for(int branch = 0; branch < pedDetails.numBranches[gen]; branch++)
+      if (pedDetails.sexConstraints[gen][branch].set >= 0)
+	minSet = min(minSet, pedDetails.sexConstraints[gen][branch].set);
+  }
+  return (minSet == INT_MAX) ? 0 : minSet & ~1;
+}
+
+// FNV-1a hash of the structure of <pedDetails>, with its constraint set
+// indexes relative to <setBase>
+uint64_t hashStructure(SimDetails &pedDetails, int setBase) {
+  uint64_t hash = 14695981039346656037ULL;
+  auto add = [&hash](int value) {
+    hash = (hash ^ (uint32_t) value) * 1099511628211ULL;
+  };
+
+  add(pedDetails.numGen);
+  add(pedDetails.i1Sex);
+  for(int gen = 0; gen < pedDetails.numGen; gen++) {
+    int numBranches = pedDetails.numBranches[gen];
+    add(numBranches);
+    for(int branch = 0; branch < numBranches; branch++) {
+      add(pedDetails.numSampsToPrint[gen][branch]);
+      if (pedDetails.branchParents[gen])
+	for(int p = 0; p < 2; p++) {
+	  add(pedDetails.branchParents[gen][branch*2 + p].gen);
+	  add(pedDetails.branchParents[gen][branch*2 + p].branch);
 	}
+      if (pedDetails.sexConstraints[gen]) {
+	int set = pedDetails.sexConstraints[gen][branch].set;
+	add((set >= 0) ? set - setBase : set);
+	add(pedDetails.sexConstraints[gen][branch].theSex);
       }
-      // sanity check that the end result is either opposite sex assignments or
-      // no sex assignments
-      if (spouseDependencies[ setIdxes[0][0] ]->second != -1)
-	assert(spouseDependencies[ setIdxes[0][0] ]->second == 
-			    (spouseDependencies[ setIdxes[0][1] ]->second ^ 1));
-      else {
-	assert(spouseDependencies[ setIdxes[0][1] ]->second == -1);
-	assert(spouseDependencies[ setIdxes[1][0] ]->second == -1);
-	assert(spouseDependencies[ setIdxes[1][1] ]->second == -1);
-      }
+      if (pedDetails.branchNumSpouses[gen])
+	add(pedDetails.branchNumSpouses[gen][branch]);
+    }
+  }
+  return hash;
+}
 
-      // This is legacy code, but I'll keep it anyway:
-      // ensure the values are different pointers (old code used to update
-      // the pointers directly instead of setting one of the two merged sets
-      // to NULL)
-      assert(spouseDependencies[ setIdxes[0][0] ] !=
-					spouseDependencies[ setIdxes[1][1] ]);
-      assert(spouseDependencies[ setIdxes[0][1] ] !=
-					  spouseDependencies[ setIdxes[1][0] ]);
-
-      // take the union such that spouses of each are contained in both
-      spouseDependencies[ setIdxes[0][0] ]->first.insert(
-			    spouseDependencies[ setIdxes[1][1] ]->first.begin(),
-			    spouseDependencies[ setIdxes[1][1] ]->first.end());
-      spouseDependencies[ setIdxes[0][1] ]->first.insert(
-			    spouseDependencies[ setIdxes[1][0] ]->first.begin(),
-			    spouseDependencies[ setIdxes[1][0] ]->first.end());
-
-      // intersection of these should be empty, otherwise there's
-      // inconsistencies and individuals that are meant to be different sexes
-      // simultaneously
-      // seems like this is impossible, so arguably should be an assertion, but
-      // we'll keep the informative error in:
-      if (intersectNonEmpty(spouseDependencies[ setIdxes[0][0] ]->first,
-			    spouseDependencies[ setIdxes[0][1] ]->first)) {
-	fprintf(stderr, "ERROR: line %d in def: assigning branch %d from generation %d and branch %d from\n",
-		line, pars[0].branch+1, pars[0].gen+1, pars[1].branch+1);
-	fprintf(stderr, "       generation %d as parents is impossible due to other parent assignments:\n",
-		pars[1].gen+1);
-	fprintf(stderr, "       they necessarily have same sex\n");
-	exit(7);
+// Returns true if <a> and <b> have the same structure, with their constraint
+// set indexes relative to <aSetBase> and <bSetBase>
+bool sameStructure(SimDetails &a, int aSetBase, SimDetails &b, int bSetBase) {
+  if (a.numGen != b.numGen || a.i1Sex != b.i1Sex)
+    return false;
+  for(int gen = 0; gen < a.numGen; gen++) {
+    int numBranches = a.numBranches[gen];
+    if (b.numBranches[gen] != numBranches ||
+	(a.branchParents[gen] == NULL) != (b.branchParents[gen] == NULL) ||
+	(a.sexConstraints[gen] == NULL) != (b.sexConstraints[gen] == NULL) ||
+	(a.branchNumSpouses[gen] == NULL) != (b.branchNumSpouses[gen] == NULL))
+      return false;
+    for(int branch = 0; branch < numBranches; branch++) {
+      if (a.numSampsToPrint[gen][branch] != b.numSampsToPrint[gen][branch])
+	return false;
+      if (a.branchParents[gen]) {
+	for(int p = 0; p < 2; p++) {
+	  Parent &aPar = a.branchParents[gen][branch*2 + p];
+	  Parent &bPar = b.branchParents[gen][branch*2 + p];
+	  if (aPar.gen != bPar.gen || aPar.branch != bPar.branch)
+	    return false;
+	}
       }
-
-      // replace set values stored in sexConstraints to the newly merged set
-      // indexes
-      for(int p = 0; p < 2; p++) {
-	// update all set indexes for samples in
-	// <spouseDependencies[ setIdxes[1][p] ]> to setIdxes[0][ p^1 ];
-	set<Parent,ParentComp> &toUpdate =
-				    spouseDependencies[ setIdxes[1][p] ]->first;
-	for(auto it = toUpdate.begin(); it != toUpdate.end(); it++)
-	  sexConstraints[ it->gen ][ it->branch ].set = setIdxes[0][p^1];
-
-	delete spouseDependencies[ setIdxes[1][p] ];
-	spouseDependencies[ setIdxes[1][p] ] = NULL;
+      if (a.sexConstraints[gen]) {
+	SexConstraint &aCon = a.sexConstraints[gen][branch];
+	SexConstraint &bCon = b.sexConstraints[gen][branch];
+	if (aCon.theSex != bCon.theSex ||
+	    (aCon.set >= 0) != (bCon.set >= 0) ||
+	    (aCon.set >= 0 && aCon.set - aSetBase != bCon.set - bSetBase))
+	  return false;
       }
+      if (a.branchNumSpouses[gen] &&
+	  a.branchNumSpouses[gen][branch] != b.branchNumSpouses[gen][branch])
+	return false;
     }
   }
+  return true;
+}
 
-  // the sexes of these branches (if assigned) should now be set in
-  // <spouseDependencies>
-  for(int p = 0; p < 2; p++) {
-    int assignedSetIdx = sexConstraints[ pars[p].gen ][ pars[p].branch ].set;
-    assert(sexConstraints[ pars[p].gen ][ pars[p].branch ].theSex == -1 ||
-	   spouseDependencies[ assignedSetIdx ]->second ==
-			sexConstraints[ pars[p].gen ][ pars[p].branch ].theSex);
+// Frees the arrays that describe the structure of <pedDetails>
+void deleteStructure(SimDetails &pedDetails) {
+  for(int gen = 0; gen < pedDetails.numGen; gen++) {
+    delete [] pedDetails.numSampsToPrint[gen];
+    delete [] pedDetails.branchParents[gen];
+    delete [] pedDetails.sexConstraints[gen];
+    delete [] pedDetails.branchNumSpouses[gen];
   }
+  delete [] pedDetails.numSampsToPrint;
+  delete [] pedDetails.numBranches;
+  delete [] pedDetails.branchParents;
+  delete [] pedDetails.sexConstraints;
+  delete [] pedDetails.branchNumSpouses;
 }
 
-// Returns true if the intersection of <a> and <b> is non-empty
-bool intersectNonEmpty(set<Parent,ParentComp> &a, set<Parent,ParentComp> &b) {
-  // Similar to the std::set_intersection code
-  auto a_it = a.begin();
-  auto b_it = b.begin();
-  while(a_it != a.end() && b_it != b.end()) {
-    if (ParentComp()(*a_it, *b_it))
-      a_it++;
-    else if (ParentComp()(*b_it, *a_it))
-      b_it++;
-    else {
-      // have *a_it == *b_it, so intersection is non-empty:
-      return true;
+// Frees the arrays that readDef() allocates (and the founder ids that
+// simulate() stores for printing the mrca file) for each element of
+// <simDetails> and empties it
+void deleteSimDetails(vector<SimDetails> &simDetails) {
+  for(auto it = simDetails.begin(); it != simDetails.end(); it++) {
+    if (it->sharesWith >= 0)
+      continue; // the owner frees the arrays
+
+    deleteStructure(*it);
+    if (it->sampleIds) {
+      for(int gen = 0; gen < it->numGen; gen++) {
+	for(int branch = 0; branch < it->numBranches[gen]; branch++)
+	  delete [] it->sampleIds[gen][branch];
+	delete [] it->sampleIds[gen];
+      }
+      delete [] it->sampleIds;
     }
-  }
-  return false;
-}
 
-void initSexConstraints(SexConstraint *newSexConstraints, int numBranches) {
-  for(int i = 0; i < numBranches; i++) {
-    newSexConstraints[i].set = -1;
-    newSexConstraints[i].theSex = -1;
+    // each suffix is stored twice in a row: once for each haplotype
+    for(unsigned int i = 0; i < it->founderIdSuffix.size(); i += 2)
+      delete [] it->founderIdSuffix[i];
   }
+  simDetails.clear();
 }
@@ -2,9 +2,9 @@
 //
 // This program is distributed under the terms of the GNU General Public License
 
+#include <stdio.h>
+#include <stdint.h>
 #include <vector>
-#include <set>
-#include <utility>
 #include "datastructs.h"
 
 #ifndef READDEF_H
@@ -12,9 +12,44 @@
 
 using namespace std;
 
+////////////////////////////////////////////////////////////////////////////////
+// A branch (i.e., its i1 individual) that has children with another branch.
+// These are nodes in a union-find structure in which all the branches in a
+// component have fixed sexes relative to each other: each node stores whether
+// it has the same or opposite sex as its parent node.
+struct SpouseNode {
+  int parent;     // index of the parent node; the node itself for roots
+  int8_t parity;  // 1 if of opposite sex to <parent>, 0 if the same
+  Parent branch;  // generation and branch number of this node
+  // only meaningful for roots:
+  int size;       // number of nodes in the component
+  int setBase;    // even constraint set index of the component; -1 if none
+  int8_t rootSet; // the root has constraint set <setBase> + <rootSet>
+  int8_t sex;     // sex of the root; -1 if not assigned
+};
+
+// While readDef() reads a pedigree, SexConstraint::set holds the index of
+// each branch's node in <nodes>; finishLastDef() replaces these with the
+// constraint set indexes
+struct SpouseDependencies {
+  SpouseDependencies() : numSets(0) { }
+
+  vector<SpouseNode> nodes; // for the pedigree being read
+  // constraint set indexes assigned so far, in pairs; not reset between
+  // pedigrees
+  int numSets;
+};
+
 void readDef(vector<SimDetails> &simDetails, char *defFile);
+void readDef(vector<SimDetails> &simDetails, FILE *in);
+void deleteSimDetails(vector<SimDetails> &simDetails);
+void shareStructures(vector<SimDetails> &simDetails);
+int getSetBase(SimDetails &pedDetails);
+uint64_t hashStructure(SimDetails &pedDetails, int setBase);
+bool sameStructure(SimDetails &a, int aSetBase, SimDetails &b, int bSetBase);
+void deleteStructure(SimDetails &pedDetails);
 void finishLastDef(int numGen, SexConstraint **&sexConstraints,
-		   vector< pair<set<Parent,ParentComp>,int8_t>* > &spouseDependencies);
+		   SpouseDependencies &spouseDependencies);
 void assignDefaultBranchParents(int prevGenNumBranches, int thisGenNumBranches,
 				Parent **thisGenBranchParents, int prevGen,
 				int *prevGenSpouseNum = NULL,
@@ -23,7 +58,7 @@ bool readBranchSpec(int *numBranches, Parent **thisGenBranchParents,
 		    int *thisGenNumSampsToPrint, int curGen,
 		    SexConstraint **sexConstraints, int **prevGenSpouseNum,
 		    vector<bool> &branchParentsAssigned,
-		    vector< pair<set<Parent,ParentComp>,int8_t>* > &spouseDependencies,
+		    SpouseDependencies &spouseDependencies,
 		    const int i1Sex, const char *delim, char *&saveptr,
 		    char *&endptr, int line);
 void assignBranch(bool parentAssign, bool noPrint, int sexToAssign, int curGen,
@@ -33,15 +68,15 @@ void assignBranch(bool parentAssign, bool noPrint, int sexToAssign, int curGen,
 		  Parent pars[2], int line, bool &warningGiven);
 void readParents(int *numBranches, int prevGen, SexConstraint **sexConstraints,
 		 int **prevGenSpouseNum,
-		 vector< pair<set<Parent,ParentComp>,int8_t>* > &spouseDependencies,
+		 SpouseDependencies &spouseDependencies,
 		 char *assignBranches, char *assignPar[2], Parent pars[2],
 		 char *&fullAssignPar, const int i1Sex, char *&endptr,
 		 int line);
 void updateSexConstraints(SexConstraint **sexConstraints, Parent pars[2],
 			  int *numBranches,
-			  vector< pair<set<Parent,ParentComp>,int8_t>* > &spouseDependencies,
+			  SpouseDependencies &spouseDependencies,
 			  int line);
-bool intersectNonEmpty(set<Parent,ParentComp> &a, set<Parent,ParentComp> &b);
+int findSpouseRoot(vector<SpouseNode> &nodes, int n, int8_t &parity);
 void initSexConstraints(SexConstraint *newSexConstraints, int numBranches);
 
 #endif // READDEF_H
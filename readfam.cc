@@ -0,0 +1,335 @@
+// ped-sim: pedigree simulation tool
+//
+// This program is distributed under the terms of the GNU General Public License
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <unordered_map>
+#include <algorithm>
+#include "readfam.h"
+#include "runerror.h"
+
+// One individual in a fam file family
+struct FamPerson {
+  string id;
+  int parents[2]; // indexes of the father and mother; -1 if a founder
+  int sex;        // 0 for male, 1 for female, -1 if unknown
+  int line;       // in the fam file
+  int gen, branch;
+};
+
+// When only one parent of an individual is given, the other is a founder that
+// isn't printed, with the individual's id plus this suffix
+static const char *implicitSuffix[2] = { "_father", "_mother" };
+
+static void compileFam(vector<SimDetails> &simDetails, const char *famId,
+		       vector<FamPerson> &persons);
+
+// Reads the pedigrees in the PLINK format fam file <famFile> (columns: family
+// id, individual id, father id, mother id, sex, and, optionally, phenotype)
+// and adds one entry to <simDetails> for each family, with one replicate.
+// Unlike def files, which describe regular structures, a fam family can have
+// any number of generations, remarriages, and inbreeding loops: each
+// individual gets a branch of its own in the generation after the later of
+// its parents (founders are all in the first), which gives the order to
+// simulate them in. Reading and compiling the file takes time linear in its
+// size.
+void readFam(vector<SimDetails> &simDetails, const char *famFile) {
+  FILE *in = fopen(famFile, "r");
+  if (!in) {
+    printf("ERROR: could not open fam file %s!\n", famFile);
+    perror("open");
+    fatalExit(1);
+  }
+
+  // the families, in the order they first appear, along with the parent ids
+  // of each person, which are resolved once the whole family is read
+  vector<string> famIds;
+  vector< vector<FamPerson> > famPersons;
+  vector< vector< pair<string,string> > > famParentIds;
+  unordered_map<string,int> famIdx;
+
+  size_t bytesRead = 1024;
+  char *buffer = (char *) malloc(bytesRead + 1);
+  if (buffer == NULL) {
+    printf("ERROR: out of memory");
+    fclose(in);
+    fatalExit(5);
+  }
+  const char *delim = " \t\n";
+
+  int line = 0;
+  while (getline(&buffer, &bytesRead, in) >= 0) {
+    line++;
+
+    char *saveptr;
+    char *fields[5];
+    fields[0] = strtok_r(buffer, delim, &saveptr);
+    if (fields[0] == NULL || fields[0][0] == '#')
+      continue; // blank line or comment -- skip
+    for(int f = 1; f < 5; f++)
+      fields[f] = strtok_r(NULL, delim, &saveptr);
+    if (fields[4] == NULL) {
+      fprintf(stderr, "ERROR: line %d in fam: expected at least five fields:\n",
+	      line);
+      fprintf(stderr, "       [family id] [individual id] [father id] [mother id] [sex]\n");
+      // free these before fatalExit(), which may throw (see runerror.h)
+      free(buffer);
+      fclose(in);
+      fatalExit(5);
+    }
+
+    auto inserted = famIdx.emplace(fields[0], famIds.size());
+    if (inserted.second) {
+      famIds.push_back(fields[0]);
+      famPersons.emplace_back();
+      famParentIds.emplace_back();
+    }
+    int fam = inserted.first->second;
+
+    FamPerson person;
+    person.id = fields[1];
+    person.parents[0] = person.parents[1] = -1;
+    if (strcmp(fields[4], "1") == 0)
+      person.sex = 0;
+    else if (strcmp(fields[4], "2") == 0)
+      person.sex = 1;
+    else
+      person.sex = -1;
+    person.line = line;
+    famPersons[fam].push_back(person);
+    famParentIds[fam].emplace_back(fields[2], fields[3]);
+  }
+  free(buffer);
+  fclose(in);
+
+  if (famIds.size() == 0) {
+    fprintf(stderr, "ERROR: fam file %s contains no individuals\n", famFile);
+    fatalExit(5);
+  }
+
+  for(unsigned int fam = 0; fam < famIds.size(); fam++) {
+    vector<FamPerson> &persons = famPersons[fam];
+    const char *famId = famIds[fam].c_str();
+
+    unordered_map<string,int> personIdx;
+    for(unsigned int i = 0; i < persons.size(); i++) {
+      if (!personIdx.emplace(persons[i].id, i).second) {
+	fprintf(stderr, "ERROR: line %d in fam: individual %s appears twice in family %s\n",
+		persons[i].line, persons[i].id.c_str(), famId);
+	fatalExit(5);
+      }
+    }
+
+    // resolve the parent ids: the numbers of persons can grow below, so
+    // iterate over those read from the file
+    unsigned int numRead = persons.size();
+    for(unsigned int i = 0; i < numRead; i++) {
+      const string *parentIds[2] = { &famParentIds[fam][i].first,
+				     &famParentIds[fam][i].second };
+      bool haveParent[2];
+      for(int p = 0; p < 2; p++)
+	haveParent[p] = *parentIds[p] != "0";
+      if (!haveParent[0] && !haveParent[1])
+	continue; // founder
+
+      for(int p = 0; p < 2; p++) {
+	if (!haveParent[p]) {
+	  // only one parent given: the other is a founder that's not printed
+	  FamPerson implicit;
+	  implicit.id = persons[i].id + implicitSuffix[p];
+	  if (personIdx.count(implicit.id) > 0) {
+	    fprintf(stderr, "ERROR: line %d in fam: id %s for the missing parent of %s is in use\n",
+		    persons[i].line, implicit.id.c_str(), persons[i].id.c_str());
+	    fatalExit(5);
+	  }
+	  implicit.parents[0] = implicit.parents[1] = -1;
+	  implicit.sex = p;
+	  implicit.line = -1;
+	  persons[i].parents[p] = persons.size();
+	  personIdx.emplace(implicit.id, persons.size());
+	  persons.push_back(implicit);
+	  continue;
+	}
+
+	auto it = personIdx.find(*parentIds[p]);
+	if (it == personIdx.end()) {
+	  fprintf(stderr, "ERROR: line %d in fam: %s %s of %s is not in family %s\n",
+		  persons[i].line, (p == 0) ? "father" : "mother",
+		  parentIds[p]->c_str(), persons[i].id.c_str(), famId);
+	  fatalExit(5);
+	}
+	int parIdx = it->second;
+	FamPerson &parent = persons[parIdx];
+	if (parent.sex == 1 - p) {
+	  fprintf(stderr, "ERROR: line %d in fam: %s %s of %s has the opposite sex\n",
+		  persons[i].line, (p == 0) ? "father" : "mother",
+		  parent.id.c_str(), persons[i].id.c_str());
+	  fatalExit(5);
+	}
+	parent.sex = p;
+	persons[i].parents[p] = parIdx;
+      }
+      if (persons[i].parents[0] == persons[i].parents[1]) {
+	fprintf(stderr, "ERROR: line %d in fam: %s has the same father and mother\n",
+		persons[i].line, persons[i].id.c_str());
+	fatalExit(5);
+      }
+    }
+
+    compileFam(simDetails, famId, persons);
+  }
+}
+
+// Adds the family <famId> with individuals <persons> to <simDetails>. Orders
+// the individuals so that parents precede their children (Kahn's algorithm),
+// placing each in the generation after the later of its parents and in its
+// own branch, in the order they appear in the fam file.
+static void compileFam(vector<SimDetails> &simDetails, const char *famId,
+		       vector<FamPerson> &persons) {
+  int numPersons = persons.size();
+
+  // children of each person and the number of parents not yet placed
+  vector<int> childStart(numPersons + 1, 0), children;
+  vector<int> numUnplaced(numPersons, 0);
+  for(int i = 0; i < numPersons; i++)
+    for(int p = 0; p < 2; p++)
+      if (persons[i].parents[p] >= 0) {
+	childStart[ persons[i].parents[p] + 1 ]++;
+	numUnplaced[i]++;
+      }
+  for(int i = 0; i < numPersons; i++)
+    childStart[i + 1] += childStart[i];
+  children.resize(childStart[numPersons]);
+  vector<int> nextChild(childStart.begin(), childStart.end() - 1);
+  for(int i = 0; i < numPersons; i++)
+    for(int p = 0; p < 2; p++)
+      if (persons[i].parents[p] >= 0)
+	children[ nextChild[ persons[i].parents[p] ]++ ] = i;
+
+  vector<int> order; // parents before children
+  order.reserve(numPersons);
+  for(int i = 0; i < numPersons; i++)
+    if (numUnplaced[i] == 0) {
+      persons[i].gen = 0;
+      order.push_back(i);
+    }
+  int numGen = 1;
+  for(unsigned int o = 0; o < order.size(); o++) {
+    int cur = order[o];
+    for(int c = childStart[cur]; c < childStart[cur + 1]; c++) {
+      int child = children[c];
+      if (--numUnplaced[child] == 0) {
+	FamPerson &theChild = persons[child];
+	theChild.gen = 1 + max(persons[ theChild.parents[0] ].gen,
+			       persons[ theChild.parents[1] ].gen);
+	numGen = max(numGen, theChild.gen + 1);
+	order.push_back(child);
+      }
+    }
+  }
+  if ((int) order.size() < numPersons) {
+    for(int i = 0; i < numPersons; i++) {
+      if (numUnplaced[i] > 0) {
+	fprintf(stderr, "ERROR: line %d in fam: the ancestors of %s in family %s form a cycle\n",
+		persons[i].line, persons[i].id.c_str(), famId);
+	fatalExit(5);
+      }
+    }
+  }
+  // simulate() only makes founders in generations before the last, so a
+  // family of founders gets an empty second generation
+  numGen = max(numGen, 2);
+
+  vector<int> genSizes(numGen, 0);
+  for(int i = 0; i < numPersons; i++)
+    persons[i].branch = genSizes[ persons[i].gen ]++;
+
+  SimDetails &fam = addOnePerBranch(simDetails, famId, genSizes);
+  char ***sampleIds = new char**[numGen];
+  if (sampleIds == NULL) {
+    printf("ERROR: out of memory");
+    fatalExit(5);
+  }
+  for(int gen = 0; gen < numGen; gen++) {
+    sampleIds[gen] = new char*[ genSizes[gen] ];
+    if (sampleIds[gen] == NULL) {
+      printf("ERROR: out of memory");
+      fatalExit(5);
+    }
+  }
+  fam.sampleIds = sampleIds;
+
+  for(int i = 0; i < numPersons; i++) {
+    FamPerson &person = persons[i];
+    int gen = person.gen, branch = person.branch;
+
+    // the individuals given only as parents aren't printed
+    fam.numSampsToPrint[gen][branch] = (person.line >= 0) ? 1 : 0;
+    for(int p = 0; p < 2; p++) {
+      Parent &parent = fam.branchParents[gen][branch*2 + p];
+      if (person.parents[p] >= 0) {
+	parent.gen = persons[ person.parents[p] ].gen;
+	parent.branch = persons[ person.parents[p] ].branch;
+      }
+      else {
+	parent.gen = -1;
+	parent.branch = -1;
+      }
+    }
+    fam.sexConstraints[gen][branch].theSex = person.sex;
+    sampleIds[gen][branch] = new char[ person.id.size() + 1 ];
+    if (sampleIds[gen][branch] == NULL) {
+      printf("ERROR: out of memory");
+      fatalExit(5);
+    }
+    strcpy(sampleIds[gen][branch], person.id.c_str());
+  }
+}
+
+// Adds an entry named <name> with one replicate to <simDetails> in which each
+// individual is the only one in its branch, with <genSizes[gen]> individuals
+// (and so branches) in generation <gen>. Allocates the entry's arrays and
+// leaves the parents, the number to print, and the sex of each branch for the
+// caller to fill in; the sexes are otherwise unconstrained.
+SimDetails &addOnePerBranch(vector<SimDetails> &simDetails, const char *name,
+			    const vector<int> &genSizes) {
+  int numGen = genSizes.size();
+  int *numBranches = new int[numGen];
+  int **numSampsToPrint = new int*[numGen];
+  Parent **branchParents = new Parent*[numGen];
+  SexConstraint **sexConstraints = new SexConstraint*[numGen];
+  int **branchNumSpouses = new int*[numGen];
+  if (numBranches == NULL || numSampsToPrint == NULL ||
+      branchParents == NULL || sexConstraints == NULL ||
+      branchNumSpouses == NULL) {
+    printf("ERROR: out of memory");
+    fatalExit(5);
+  }
+
+  for(int gen = 0; gen < numGen; gen++) {
+    int num = numBranches[gen] = genSizes[gen];
+    numSampsToPrint[gen] = new int[num];
+    branchParents[gen] = new Parent[2 * num];
+    sexConstraints[gen] = new SexConstraint[num];
+    branchNumSpouses[gen] = new int[num];
+    if (numSampsToPrint[gen] == NULL || branchParents[gen] == NULL ||
+	sexConstraints[gen] == NULL || branchNumSpouses[gen] == NULL) {
+      printf("ERROR: out of memory");
+      fatalExit(5);
+    }
+    for(int branch = 0; branch < num; branch++) {
+      sexConstraints[gen][branch].set = -1;
+      sexConstraints[gen][branch].theSex = -1;
+      // each individual is the only one in its branch: no spouses
+      branchNumSpouses[gen][branch] = 0;
+    }
+  }
+
+  simDetails.emplace_back(/*numReps=*/ 1, numGen, numSampsToPrint,
+			  numBranches, branchParents, sexConstraints,
+			  /*i1Sex=*/ -1, branchNumSpouses, (char *) name);
+  return simDetails.back();
+}
@@ -0,0 +1,17 @@
+// ped-sim: pedigree simulation tool
+//
+// This program is distributed under the terms of the GNU General Public License
+
+#include <vector>
+#include "datastructs.h"
+
+#ifndef READFAM_H
+#define READFAM_H
+
+using namespace std;
+
+void readFam(vector<SimDetails> &simDetails, const char *famFile);
+SimDetails &addOnePerBranch(vector<SimDetails> &simDetails, const char *name,
+			    const vector<int> &genSizes);
+
+#endif // READFAM_H
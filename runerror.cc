@@ -0,0 +1,14 @@
+// ped-sim: pedigree simulation tool
+//
+// This program is distributed under the terms of the GNU General Public License
+
+#include <stdlib.h>
+#include "runerror.h"
+
+thread_local int ErrorScope::depth = 0;
+
+void fatalExit(int status) {
+  if (ErrorScope::active())
+    throw RunError{ status };
+  exit(status);
+}
@@ -0,0 +1,34 @@
+// ped-sim: pedigree simulation tool
+//
+// This program is distributed under the terms of the GNU General Public License
+
+#ifndef RUNERROR_H
+#define RUNERROR_H
+
+////////////////////////////////////////////////////////////////////////////////
+// Errors in the input files or settings print a message and then call
+// fatalExit(). In the program, that exits with <status>. On a thread inside an
+// ErrorScope -- a PedSim call (see pedsim.h) or a --server or --batch job --
+// it instead throws a RunError that ends only that call or job. Output files
+// (FileOrGZ objects) are closed as the error unwinds; other memory the failed
+// call allocated may not be freed.
+struct RunError {
+  int status; // what the program would have exited with
+};
+
+[[noreturn]] void fatalExit(int status);
+
+// While an ErrorScope exists, fatalExit() on the thread that created it
+// throws a RunError
+class ErrorScope {
+  public:
+    ErrorScope() { depth++; }
+    ~ErrorScope() { depth--; }
+
+    static bool active() { return depth > 0; }
+
+  private:
+    static thread_local int depth;
+};
+
+#endif // RUNERROR_H
@@ -0,0 +1,299 @@
+#!/usr/bin/env python3
+
+"""
+End-to-end scaling benchmarks for Ped-sim.
+
+Runs the ped-sim binary on a suite of scenarios that scale the number of
+replicates, generations, printed samples per replicate, input VCF samples and
+sites, and threads. For each scenario, records the wall time, peak memory (max
+RSS), and total size of the output files. The genetic map, def files, and input
+VCFs are generated here; the interference parameters come from the interfere/
+directory.
+
+Results are printed as a table and, with -o, saved as tab-separated values.
+With -b, results are compared to such a file from an earlier run (e.g., before
+a change), and the program exits with status 1 if any scenario's time or memory
+exceeds the baseline by more than the tolerances.
+"""
+
+import optparse
+import os
+import random
+import shutil
+import subprocess
+import sys
+import tempfile
+import time
+
+################################################################################
+# SCENARIOS
+################################################################################
+
+# the huge tier needs tens of GB of memory
+TIERS = ['small', 'medium', 'large', 'huge']
+
+def sibs_def(reps):
+    """Pairs of full siblings: two founders per replicate"""
+    return "def sibs %d 2\n2 2 1\n" % reps
+
+def make_scenarios():
+    """List of (name, tier, def text, extra options, input VCF (number of
+    samples, number of sites) or None)"""
+    scenarios = []
+
+    # replicates
+    for reps, tier in [(1000, 'small'), (10000, 'small'), (100000, 'medium'),
+                       (1000000, 'large'), (10000000, 'huge')]:
+        scenarios.append(('reps_%d' % reps, tier, sibs_def(reps), [], None))
+
+    # generations: a line of descent printing two siblings in the last
+    for gens, tier in [(3, 'small'), (10, 'small'), (20, 'medium'),
+                       (30, 'medium')]:
+        scenarios.append(('gens_%d' % gens, tier,
+                          "def line 100 %d\n%d 2 1\n" % (gens, gens), [],
+                          None))
+
+    # printed samples per replicate: siblings in one branch
+    for samps, tier in [(2, 'small'), (10, 'small'), (100, 'medium'),
+                        (1000, 'large'), (10000, 'huge')]:
+        scenarios.append(('printed_%d' % samps, tier,
+                          "def wide 10 2\n2 %d 1\n" % samps, [], None))
+
+    # input VCF width (samples, all used as founders) and number of sites
+    for width, sites, tier in [(200, 1000, 'small'), (200, 100000, 'medium'),
+                               (1000, 10000, 'medium'),
+                               (5000, 1000, 'medium'),
+                               (5000, 100000, 'large')]:
+        scenarios.append(('vcf_%dx%d' % (width, sites), tier,
+                          sibs_def(width // 2), [], (width, sites)))
+
+    # threads printing the output files
+    for threads, tier in [(1, 'small'), (4, 'small')]:
+        scenarios.append(('threads_%d_small' % threads, tier, sibs_def(100),
+                          ['--bp', '--mrca', '--fam', '--threads',
+                           str(threads)], (200, 1000)))
+    for threads in [1, 2, 4]:
+        scenarios.append(('threads_%d' % threads, 'medium', sibs_def(500),
+                          ['--bp', '--mrca', '--fam', '--threads',
+                           str(threads)], (1000, 10000)))
+
+    return scenarios
+
+################################################################################
+# FUNCTIONS
+################################################################################
+
+def parse_args():
+    """Parse command line arguments."""
+    script_dir = os.path.dirname(os.path.abspath(__file__))
+    parser = optparse.OptionParser(
+        usage='%prog [options]',
+        description='end-to-end scaling benchmarks for Ped-sim')
+
+    parser.add_option('--ped_sim', type='string', \
+        default=os.path.join(script_dir, 'ped-sim'),
+        help='ped-sim binary to run [default: %default]')
+    parser.add_option('--intf', type='string', \
+        default=os.path.join(script_dir, 'interfere', 'nu_p_campbell.tsv'),
+        help='interference parameters file [default: %default]')
+    parser.add_option('-t', '--tier', type='choice', choices=TIERS, \
+        default='small',
+        help='run scenarios up to this size: small, medium, large, or ' \
+             'huge ' \
+             '[default: %default]')
+    parser.add_option('-s', '--scenarios', type='string', \
+        help='comma-separated names of scenarios to run (any tier)')
+    parser.add_option('-r', '--repeat', type='int', default=1,
+        help='runs of each scenario; reports the median time ' \
+             '[default: %default]')
+    parser.add_option('-o', '--out', type='string',
+        help='file to save results to (usable as a baseline)')
+    parser.add_option('-b', '--baseline', type='string',
+        help='results file from an earlier run to compare to')
+    parser.add_option('--time_tol', type='float', default=0.2,
+        help='fraction a time may exceed the baseline by [default: %default]')
+    parser.add_option('--rss_tol', type='float', default=0.2,
+        help='fraction memory may exceed the baseline by [default: %default]')
+    parser.add_option('--min_time', type='float', default=0.1,
+        help='seconds a time must exceed the baseline by to count as a ' \
+             'regression [default: %default]')
+    parser.add_option('--work_dir', type='string',
+        help='directory for inputs and outputs (kept afterwards); ' \
+             'default: a temporary directory')
+    parser.add_option('--list', action='store_true', default=False,
+        help='list the scenarios and exit')
+
+    (opts, args) = parser.parse_args()
+    if len(args) > 0:
+        parser.print_help()
+        sys.exit(1)
+    return opts
+
+def write_map(filename):
+    """Write a sex-specific map for 22 chromosomes, with lengths decreasing
+    from chromosome 1 like the human map"""
+    with open(filename, 'w') as out_file:
+        for chrom in range(1, 23):
+            phys_len = (250 - (chrom - 1) * 9) * 1000000
+            male_len = phys_len / 1e6 * 0.9
+            female_len = phys_len / 1e6 * 1.5
+            num_pos = 500
+            for i in range(num_pos):
+                frac = i / (num_pos - 1)
+                out_file.write("%d %d %.6f %.6f\n" %
+                               (chrom, 1 + int(frac * (phys_len - 1)),
+                                frac * male_len, frac * female_len))
+
+def write_vcf(filename, num_samples, num_sites):
+    """Write a phased VCF with <num_samples> samples and <num_sites> sites
+    spread across the chromosomes of the map"""
+    rand = random.Random(1)
+    # rows of genotypes are drawn from a pool to make writing large files fast
+    pool = []
+    for i in range(64):
+        pool.append('\t'.join('%d|%d' % (rand.randint(0, 1),
+                                         rand.randint(0, 1))
+                              for s in range(num_samples)))
+    sites_per_chr = max(num_sites // 22, 1)
+    with open(filename, 'w') as out_file:
+        out_file.write("##fileformat=VCFv4.2\n")
+        out_file.write("#CHROM\tPOS\tID\tREF\tALT\tQUAL\tFILTER\tINFO\tFORMAT\t")
+        out_file.write('\t'.join('S%d' % s for s in range(num_samples)) + '\n')
+        printed = 0
+        for chrom in range(1, 23):
+            phys_len = (250 - (chrom - 1) * 9) * 1000000
+            if chrom == 22:
+                sites_per_chr = num_sites - printed
+            for i in range(sites_per_chr):
+                pos = 2 + (i * (phys_len - 3)) // sites_per_chr
+                out_file.write("%d\t%d\t.\tA\tG\t.\tPASS\t.\tGT\t%s\n" %
+                               (chrom, pos, rand.choice(pool)))
+            printed += sites_per_chr
+
+def run_scenario(opts, work_dir, name, def_text, extra, vcf, vcf_files):
+    """Run one scenario <opts.repeat> times, returning the median wall time,
+    the maximum peak RSS in kB, and the output size in bytes"""
+    def_file = os.path.join(work_dir, name + '.def')
+    with open(def_file, 'w') as out_file:
+        out_file.write(def_text)
+
+    cmd = [opts.ped_sim, '-d', def_file, '-m',
+           os.path.join(work_dir, 'map.txt'), '--intf', opts.intf,
+           '--seed', '1', '--nogz'] + extra
+    if vcf:
+        if vcf not in vcf_files:
+            vcf_files[vcf] = os.path.join(work_dir, 'in_%dx%d.vcf' % vcf)
+            write_vcf(vcf_files[vcf], vcf[0], vcf[1])
+        cmd += ['-i', vcf_files[vcf]]
+
+    out_dir = os.path.join(work_dir, name)
+    times = []
+    max_rss = 0
+    out_bytes = 0
+    for i in range(opts.repeat):
+        shutil.rmtree(out_dir, ignore_errors=True)
+        os.mkdir(out_dir)
+        start = time.monotonic()
+        proc = subprocess.Popen(cmd + ['-o', os.path.join(out_dir, 'out')],
+                                stdout=subprocess.DEVNULL)
+        # wait4() gives the resource use of this child alone
+        _, status, usage = os.wait4(proc.pid, 0)
+        times.append(time.monotonic() - start)
+        if status != 0:
+            sys.exit("ERROR: scenario %s failed: %s" % (name, ' '.join(cmd)))
+        max_rss = max(max_rss, usage.ru_maxrss)
+        out_bytes = sum(os.path.getsize(os.path.join(out_dir, f))
+                        for f in os.listdir(out_dir) if not f.endswith('.log'))
+    shutil.rmtree(out_dir)
+
+    times.sort()
+    return times[len(times) // 2], max_rss, out_bytes
+
+def read_results(filename):
+    """Read a results file, returning a dictionary from scenario names to
+    (time, rss, bytes)"""
+    results = {}
+    with open(filename, 'r') as in_file:
+        for line in in_file:
+            if line.startswith('#'):
+                continue
+            fields = line.rstrip('\n').split('\t')
+            results[fields[0]] = (float(fields[1]), int(fields[2]),
+                                  int(fields[3]))
+    return results
+
+def main():
+    opts = parse_args()
+
+    scenarios = make_scenarios()
+    if opts.list:
+        for name, tier, def_text, extra, vcf in scenarios:
+            print("%s\t%s" % (name, tier))
+        return
+
+    if opts.scenarios:
+        names = opts.scenarios.split(',')
+        unknown = set(names) - set(s[0] for s in scenarios)
+        if unknown:
+            sys.exit("ERROR: unknown scenario(s): " + ", ".join(unknown))
+        scenarios = [s for s in scenarios if s[0] in names]
+    else:
+        max_tier = TIERS.index(opts.tier)
+        scenarios = [s for s in scenarios if TIERS.index(s[1]) <= max_tier]
+
+    baseline = read_results(opts.baseline) if opts.baseline else {}
+
+    work_dir = opts.work_dir
+    if work_dir:
+        os.makedirs(work_dir, exist_ok=True)
+    else:
+        work_dir = tempfile.mkdtemp(prefix='ped-sim-scaling.')
+    write_map(os.path.join(work_dir, 'map.txt'))
+
+    results = {}
+    vcf_files = {}
+    regressions = []
+    print("%-20s %10s %12s %14s  %s" % ('scenario', 'time (s)', 'max RSS (MB)',
+                                        'output bytes', 'vs. baseline'))
+    for name, tier, def_text, extra, vcf in scenarios:
+        cur = run_scenario(opts, work_dir, name, def_text, extra, vcf,
+                           vcf_files)
+        results[name] = cur
+        compare = ''
+        if name in baseline:
+            base = baseline[name]
+            compare = "time %+.1f%%, RSS %+.1f%%" % \
+                (100 * (cur[0] / base[0] - 1) if base[0] > 0 else 0,
+                 100 * (cur[1] / base[1] - 1) if base[1] > 0 else 0)
+            if cur[2] != base[2]:
+                compare += ", output size changed"
+            if cur[0] > base[0] * (1 + opts.time_tol) and \
+                    cur[0] - base[0] > opts.min_time:
+                regressions.append("%s: time %.2fs vs. %.2fs" %
+                                   (name, cur[0], base[0]))
+                compare += "  REGRESSION"
+            elif cur[1] > base[1] * (1 + opts.rss_tol):
+                regressions.append("%s: max RSS %d kB vs. %d kB" %
+                                   (name, cur[1], base[1]))
+                compare += "  REGRESSION"
+        print("%-20s %10.2f %12.1f %14d  %s" %
+              (name, cur[0], cur[1] / 1024, cur[2], compare))
+        sys.stdout.flush()
+
+    if opts.out:
+        with open(opts.out, 'w') as out_file:
+            out_file.write("#scenario\twall_sec\tmax_rss_kb\toutput_bytes\n")
+            for name, tier, def_text, extra, vcf in scenarios:
+                out_file.write("%s\t%.3f\t%d\t%d\n" % ((name,) + results[name]))
+
+    if not opts.work_dir:
+        shutil.rmtree(work_dir)
+
+    if regressions:
+        print("\n%d regression(s):" % len(regressions))
+        for reg in regressions:
+            print("  " + reg)
+        sys.exit(1)
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,282 @@
+// ped-sim: pedigree simulation tool
+//
+// This program is distributed under the terms of the GNU General Public License
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <signal.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <string>
+#include <set>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include "server.h"
+#include "cmdlineopts.h"
+
+// Written to by the signal handler and by connections that request a shutdown
+// to wake the accept loop in runServer()
+static int wakePipe[2] = { -1, -1 };
+
+static void requestShutdown(int) {
+  char c = 0;
+  // nothing to do if this fails: the pipe already holds a request
+  if (write(wakePipe[1], &c, 1) < 0) { }
+}
+
+// Runs Ped-sim as a server (--server): reads the shared inputs once and then
+// runs the jobs it receives on a pool of threads. With a <path> of "-", jobs
+// are read from stdin and responses printed to stdout; otherwise, <path> names
+// a Unix domain socket to listen on, and each connection can submit jobs.
+// The socket server runs until it gets SIGINT or SIGTERM or a connection
+// sends "shutdown"; it then stops accepting connections, ends the open ones
+// once their jobs finish, and removes the socket.
+int runServer(const char *path) {
+  JobRunner runner(CmdLineOpts::numThreads, stderr);
+
+  if (strcmp(path, "-") == 0) {
+    serveConnection(runner, stdin, stdout);
+    return 0;
+  }
+
+  // a client that disconnects shouldn't end the server when we reply to it
+  signal(SIGPIPE, SIG_IGN);
+
+  int sock = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (sock < 0) {
+    perror("socket");
+    exit(1);
+  }
+  struct sockaddr_un addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sun_family = AF_UNIX;
+  if (strlen(path) >= sizeof(addr.sun_path)) {
+    fprintf(stderr, "ERROR: socket path %s is too long\n", path);
+    exit(2);
+  }
+  strcpy(addr.sun_path, path);
+
+  // remove a socket left by a server that didn't shut down cleanly, but not
+  // any other kind of file or the socket of a server that's running
+  struct stat pathStat;
+  if (lstat(path, &pathStat) == 0 && S_ISSOCK(pathStat.st_mode)) {
+    if (connect(sock, (struct sockaddr *) &addr, sizeof(addr)) == 0) {
+      fprintf(stderr, "ERROR: a server is already listening on %s\n", path);
+      exit(1);
+    }
+    unlink(path);
+  }
+
+  if (bind(sock, (struct sockaddr *) &addr, sizeof(addr)) < 0 ||
+      listen(sock, /*backlog=*/ 16) < 0) {
+    fprintf(stderr, "ERROR: could not listen on socket %s\n", path);
+    perror("bind");
+    exit(1);
+  }
+
+  if (pipe(wakePipe) < 0) {
+    perror("pipe");
+    unlink(path);
+    exit(1);
+  }
+  struct sigaction action;
+  memset(&action, 0, sizeof(action));
+  action.sa_handler = requestShutdown;
+  sigemptyset(&action.sa_mask);
+  sigaction(SIGINT, &action, NULL);
+  sigaction(SIGTERM, &action, NULL);
+  fprintf(stderr, "Listening on %s\n", path);
+
+  // the open connections, which must finish before <runner> goes away
+  mutex connLock;
+  condition_variable connDone;
+  set<int> connFds;
+
+  while (true) {
+    struct pollfd fds[2] = { { sock, POLLIN, 0 }, { wakePipe[0], POLLIN, 0 } };
+    if (poll(fds, 2, /*timeout=*/ -1) < 0) {
+      if (errno != EINTR)
+	perror("poll");
+      continue;
+    }
+    if (fds[1].revents != 0)
+      break; // shutdown requested
+    if (fds[0].revents == 0)
+      continue;
+
+    int fd = accept(sock, NULL, NULL);
+    if (fd < 0) {
+      perror("accept");
+      continue;
+    }
+    int outFd = dup(fd);
+    FILE *in = fdopen(fd, "r");
+    FILE *out = (outFd >= 0) ? fdopen(outFd, "w") : NULL;
+    if (in == NULL || out == NULL) {
+      // drop only this connection
+      perror("fdopen");
+      if (in)
+	fclose(in);
+      else
+	close(fd);
+      if (out)
+	fclose(out);
+      else if (outFd >= 0)
+	close(outFd);
+      continue;
+    }
+
+    {
+      unique_lock<mutex> lk(connLock);
+      connFds.insert(fd);
+    }
+    thread([&runner, &connLock, &connDone, &connFds, fd, in, out]() {
+      bool shutdown = serveConnection(runner, in, out);
+      if (shutdown)
+	requestShutdown(0);
+      unique_lock<mutex> lk(connLock);
+      connFds.erase(fd);
+      fclose(in);
+      fclose(out);
+      connDone.notify_all();
+    }).detach();
+  }
+
+  fprintf(stderr, "Shutting down: finishing the jobs of %lu connections\n",
+	  connFds.size());
+  close(sock);
+  unlink(path);
+
+  // end the open connections as if the clients had closed them: they reply
+  // to the jobs already submitted and then return
+  unique_lock<mutex> lk(connLock);
+  for(auto it = connFds.begin(); it != connFds.end(); it++)
+    ::shutdown(*it, SHUT_RD);
+  connDone.wait(lk, [&connFds]() { return connFds.empty(); });
+
+  return 0;
+}
+
+// Reads job requests from <in>, runs them using <runner>, and prints a line to
+// <out> when each finishes. A request is one line
+//   job <out_prefix> [settings]
+// with settings as listed in JobRunner::parseSettings(). If there is no def=
+// setting, the lines that follow (up to a line containing only "end") give the
+// pedigree definitions. On completion, prints
+//   done <out_prefix> <seed>
+// and for invalid requests and jobs that fail
+//   error <out_prefix> <message>
+// Jobs run concurrently and may finish in any order. Returns after <in>
+// reaches end of file (or a line "quit" or "shutdown") and all its jobs have
+// finished; returns true for "shutdown", which asks the server to stop.
+bool serveConnection(JobRunner &runner, FILE *in, FILE *out) {
+  mutex outLock;
+  condition_variable allDone;
+  int numPending = 0;
+  bool shutdown = false;
+
+  size_t bytesRead = 1024;
+  char *buffer = (char *) malloc(bytesRead + 1);
+  if (buffer == NULL) {
+    fprintf(stderr, "ERROR: out of memory");
+    exit(5);
+  }
+  const char *delim = " \t\n";
+
+  while (getline(&buffer, &bytesRead, in) >= 0) {
+    char *saveptr;
+    char *command = strtok_r(buffer, delim, &saveptr);
+    if (command == NULL || command[0] == '#')
+      continue; // blank line or comment
+    if (strcmp(command, "quit") == 0)
+      break;
+    if (strcmp(command, "shutdown") == 0) {
+      shutdown = true;
+      break;
+    }
+
+    if (strcmp(command, "job") != 0) {
+      unique_lock<mutex> lk(outLock);
+      fprintf(out, "error - unknown command %s\n", command);
+      fflush(out);
+      continue;
+    }
+
+    char *outPrefix = strtok_r(NULL, delim, &saveptr);
+    if (outPrefix == NULL) {
+      unique_lock<mutex> lk(outLock);
+      fprintf(out, "error - job requires an output prefix\n");
+      fflush(out);
+      continue;
+    }
+
+    JobSpec *job = new JobSpec;
+    if (job == NULL) {
+      fprintf(stderr, "ERROR: out of memory");
+      exit(5);
+    }
+    runner.initJob(*job, outPrefix);
+    string err;
+    bool success = runner.parseSettings(*job, saveptr, err);
+
+    if (job->defFile.empty()) {
+      // definitions follow (even if the settings had an error)
+      bool gotEnd = false;
+      while (getline(&buffer, &bytesRead, in) >= 0) {
+	// line containing only "end" (and whitespace)?
+	char *word = buffer + strspn(buffer, delim);
+	if (strncmp(word, "end", 3) == 0 &&
+	    word[3 + strspn(word + 3, delim)] == '\0') {
+	  gotEnd = true;
+	  break;
+	}
+	job->defText += buffer;
+      }
+      if (!gotEnd && success) {
+	err = "no \"end\" line after the pedigree definitions";
+	success = false;
+      }
+    }
+
+    if (success)
+      success = runner.check(*job, err);
+
+    if (!success) {
+      unique_lock<mutex> lk(outLock);
+      fprintf(out, "error %s %s\n", job->outPrefix.c_str(), err.c_str());
+      fflush(out);
+      delete job;
+      continue;
+    }
+
+    {
+      unique_lock<mutex> lk(outLock);
+      numPending++;
+    }
+    runner.submit(job, [&](JobSpec *done) {
+      unique_lock<mutex> lk(outLock);
+      if (done->status == 0)
+	fprintf(out, "done %s %u\n", done->outPrefix.c_str(), done->seed);
+      else
+	fprintf(out, "error %s %s\n", done->outPrefix.c_str(),
+		done->err.c_str());
+      fflush(out);
+      delete done;
+      numPending--;
+      if (numPending == 0)
+	allDone.notify_all();
+    });
+  }
+
+  unique_lock<mutex> lk(outLock);
+  allDone.wait(lk, [&numPending]() { return numPending == 0; });
+
+  free(buffer);
+  return shutdown;
+}
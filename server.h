@@ -0,0 +1,16 @@
+// ped-sim: pedigree simulation tool
+//
+// This program is distributed under the terms of the GNU General Public License
+
+#include <stdio.h>
+#include "jobs.h"
+
+#ifndef SERVER_H
+#define SERVER_H
+
+using namespace std;
+
+int runServer(const char *path);
+bool serveConnection(JobRunner &runner, FILE *in, FILE *out);
+
+#endif // SERVER_H
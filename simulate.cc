@@ -12,8 +12,19 @@
 #include "simulate.h"
 #include "cmdlineopts.h"
 #include "fixedcos.h"
-
-mt19937 randomGen;
+#include "phasetimer.h"
+#include "trace.h"
+#include "membudget.h"
+#include "progress.h"
+#include "pedcosts.h"
+#include "edgetable.h"
+#include "backward.h"
+#include "packedhaps.h"
+#include "runerror.h"
+
+// thread-local so that library users (see pedsim.h) can simulate on several
+// threads at once; the distributions below have no state
+thread_local mt19937 randomGen;
 uniform_int_distribution<int> coinFlip(0,1);
 exponential_distribution<double> crossoverDist(1.0);
 
@@ -36,6 +47,10 @@ int simulate(vector<SimDetails> &simDetails, Person *****&theSamples,
   // opposite sex.
   vector<int> sexAssignments;
 
+  // With --engine backward, the founders are simulated below, and
+  // traceAncestry() then simulates the non-founders of each replicate
+  bool backward = CmdLineOpts::engine == ENGINE_BACKWARD;
+
 #ifndef NOFIXEDCO
   // For randomly assigning a set of fixed (read in, probably from real data)
   // COs to each person. We'll shuffle a list of indexes of fixed crossovers and
@@ -55,10 +70,23 @@ int simulate(vector<SimDetails> &simDetails, Person *****&theSamples,
   }
 #endif // NOFIXEDCO
 
-  theSamples = new Person****[simDetails.size()];
+  // Each replicate seeds <randomGen> from the seed, the pedigree, and the
+  // replicate number, so it's the same in every run with that seed. With
+  // --shard, we simulate only this shard's replicates and, to get the same
+  // results as an unsharded run, number founder haplotypes and fixed COs from
+  // where such a run would be at the shard's first replicate in each pedigree
+  bool sharded = CmdLineOpts::numShards > 0;
+  vector<int> shardFirstHap, shardFirstNonFounder, repNonFounders;
+  if (sharded)
+    selectShard(simDetails, shardFirstHap, shardFirstNonFounder,
+		repNonFounders);
+
+  // zero-initialized (here and below) so that the Persons allocated before an
+  // error can be freed (see deleteTheSamples())
+  theSamples = new Person****[simDetails.size()]();
   if (theSamples == NULL) {
     printf("ERROR: out of memory");
-    exit(5);
+    fatalExit(5);
   }
   for(unsigned int ped = 0; ped < simDetails.size(); ped++) { // for each ped
     int numReps = simDetails[ped].numReps;
@@ -69,37 +97,54 @@ int simulate(vector<SimDetails> &simDetails, Person *****&theSamples,
     SexConstraint **sexConstraints = simDetails[ped].sexConstraints;
     int i1Sex = simDetails[ped].i1Sex;
     int **branchNumSpouses = simDetails[ped].branchNumSpouses;
+    uint64_t pedStart = PedCosts::active() ? PedCosts::now() : 0;
 
     simDetails[ped].founderOffset = totalFounderHaps;
+    if (sharded)
+      simDetails[ped].hapNumShift = shardFirstHap[ped] - totalFounderHaps;
 
     if (CmdLineOpts::dryRun)
       // for --dry_run, only want one replicate per pedigree
       numReps = 1;
 
+    if (CmdLineOpts::printMRCA && simDetails[ped].founderIdSuffix.empty())
+      makeFounderIdSuffixes(simDetails, ped);
+
     ////////////////////////////////////////////////////////////////////////////
     // Allocate space and make Person objects for all those we will simulate,
     // assigning sex if <sexSpecificMaps> is true
-    theSamples[ped] = new Person***[numReps];
+    theSamples[ped] = new Person***[numReps]();
     if (theSamples[ped] == NULL) {
       printf("ERROR: out of memory");
-      exit(5);
+      fatalExit(5);
     }
     for (int rep = 0; rep < numReps; rep++) {
+      TraceScope repEvent("simulate replicate", "ped", ped, "rep",
+			  simDetails[ped].firstRep + rep);
+
+      seed_seq repSeed = { CmdLineOpts::randSeed, ped,
+			   (unsigned int) (simDetails[ped].firstRep + rep) };
+      randomGen.seed(repSeed);
+#ifndef NOFIXEDCO
+      if (sharded && curFixedCOidx >= 0)
+	curFixedCOidx = shardFirstNonFounder[ped] + rep * repNonFounders[ped];
+#endif // NOFIXEDCO
 
       // ready to make sex assignments for this family
       sexAssignments.clear();
+      int repFirstHap = totalFounderHaps;
 
-      theSamples[ped][rep] = new Person**[numGen];
+      theSamples[ped][rep] = new Person**[numGen]();
       if (theSamples[ped][rep] == NULL) {
 	printf("ERROR: out of memory");
-	exit(5);
+	fatalExit(5);
       }
       for(int curGen = 0; curGen < numGen; curGen++) {
 
-	theSamples[ped][rep][curGen] = new Person*[ numBranches[curGen] ];
+	theSamples[ped][rep][curGen] = new Person*[ numBranches[curGen] ]();
 	if (theSamples[ped][rep][curGen] == NULL) {
 	  printf("ERROR: out of memory");
-	  exit(5);
+	  fatalExit(5);
 	}
 
 	// allocate Persons for each branch of <curGen>, assign their sex,
@@ -121,7 +166,7 @@ int simulate(vector<SimDetails> &simDetails, Person *****&theSamples,
 	  theSamples[ped][rep][curGen][branch] = new Person[numPersons];
 	  if (theSamples[ped][rep][curGen][branch] == NULL) {
 	    printf("ERROR: out of memory");
-	    exit(5);
+	    fatalExit(5);
 	  }
 
 	  if (sexSpecificMaps) {
@@ -137,14 +182,14 @@ int simulate(vector<SimDetails> &simDetails, Person *****&theSamples,
 	      branchAssign = coinFlip(randomGen);
 	    }
 	    else {
-	      while (sexConstraints[curGen][branch].set >=
-						  (int) sexAssignments.size()) {
+	      int set = sexConstraints[curGen][branch].set +
+						      simDetails[ped].setShift;
+	      while (set >= (int) sexAssignments.size()) {
 		int rand = coinFlip(randomGen);
 		sexAssignments.push_back(rand);
 		sexAssignments.push_back(rand ^ 1);
 	      }
-	      branchAssign =
-			  sexAssignments[ sexConstraints[curGen][branch].set ];
+	      branchAssign = sexAssignments[set];
 	    }
 	    // How many spouses for this branch?
 	    int thisBranchNumSpouses;
@@ -183,30 +228,6 @@ int simulate(vector<SimDetails> &simDetails, Person *****&theSamples,
 	    // Simulate the founders for this chromosome:
 	    if (curGen != numGen - 1) { // no founders in the last generation
 	      for(int ind = 0; ind < numFounders; ind++) {
-		if (rep == 0 && CmdLineOpts::printMRCA) {
-		  // number of digits for the numbers is 1 + (value+1) / 10
-		  // 6 for 'g-b-i\0'
-		  int branchNumSpouses =
-			  getBranchNumSpouses(simDetails[ped], curGen, branch);
-		  int idLength = 6 + 1 + (curGen + 1) / 10 +
-				     1 + (branch + 1) / 10 +
-				     1 + (ind + 1) / 10;
-		  char *idSuffix = new char[ idLength ];
-		  if (idSuffix == NULL) {
-		    printf("ERROR: out of memory\n");
-		    exit(5);
-		  }
-		  if (ind < branchNumSpouses)
-		    sprintf(idSuffix, "g%d-b%d-s%d", curGen + 1, branch + 1,
-			    ind + 1);
-		  else
-		    sprintf(idSuffix, "g%d-b%d-i%d", curGen + 1, branch + 1,
-			    ind - branchNumSpouses + 1);
-		  // same founder for two ids in a row for the two haplotypes:
-		  simDetails[ped].founderIdSuffix.push_back(idSuffix);
-		  simDetails[ped].founderIdSuffix.push_back(idSuffix);
-		}
-
 		for(int h = 0; h < 2; h++) { // 2 founder haplotypes per founder
 		  int foundHapNum;
 		  if (chrIdx == 0) {
@@ -238,9 +259,7 @@ int simulate(vector<SimDetails> &simDetails, Person *****&theSamples,
 		  trivialSeg.foundHapNum = foundHapNum;
 
 		  // the following copies <trivialSeg>, so we can reuse it
-		  theSamples[ped][rep][curGen][branch][ind].haps[h].
-								 emplace_back();
-		  theSamples[ped][rep][curGen][branch][ind].haps[h].back().
+		  addHap(theSamples[ped][rep][curGen][branch][ind], h).
 							  push_back(trivialSeg);
 
 		  // print this branch?
@@ -266,28 +285,7 @@ int simulate(vector<SimDetails> &simDetails, Person *****&theSamples,
 	    // First figure out who the parents are:
 	    Parent pars[2];
 	    int parIdx[2];  // index of the Person in the branch
-	    for(int p = 0; p < 2; p++) {
-	      pars[p] = branchParents[curGen][branch*2 + p];
-	      if (pars[p].branch < 0) {
-		assert(p == 1 && pars[p].gen == curGen - 1);
-		// founders have negative indexes that start from -1, so we
-		// add 1 to get it to be 0 based and negate to get the index
-		parIdx[p] = -(pars[p].branch + 1);
-		pars[1].branch = pars[0].branch;
-	      }
-	      else {
-		// use "primary" person: immediately after all the spouses
-		int thisBranchNumSpouses;
-		if (branchNumSpouses[curGen-1])
-		  thisBranchNumSpouses =
-		      -branchNumSpouses[ pars[p].gen ][ pars[p].branch ];
-		else if (curGen == numGen - 1) // no spouses in last generation
-		  thisBranchNumSpouses = 0;
-		else                           // one spouse by default
-		  thisBranchNumSpouses = 1;
-		parIdx[p] = thisBranchNumSpouses;
-	      }
-	    }
+	    getBranchParents(simDetails[ped], curGen, branch, pars, parIdx);
 
 	    Person ***curRepSamps = theSamples[ped][rep];
 	    // the non-founders are stored just after the founders
@@ -316,8 +314,6 @@ int simulate(vector<SimDetails> &simDetails, Person *****&theSamples,
 		  // skip dad
 		  continue;
 
-		// Make space for this haplotype in the current sample:
-		curRepSamps[curGen][branch][ind].haps[hapIdx].emplace_back();
 #ifndef NOFIXEDCO
 		if (p == 0 && chrIdx == 0 && curFixedCOidx >= 0) {
 		  // assign fixed COs for <thePerson>:
@@ -326,7 +322,15 @@ int simulate(vector<SimDetails> &simDetails, Person *****&theSamples,
 		  curFixedCOidx++; // next person's indexes
 		}
 #endif // NOFIXEDCO
-		Haplotype &toGen = thePerson.haps[hapIdx].back();
+		if (chrIdx == 0)
+		  PhaseTimer::count(MEIOSES);
+		if (backward)
+		  continue; // traceAncestry() simulates this below
+
+		// Make space for this haplotype in the current sample:
+		Haplotype &toGen = addHap(thePerson, hapIdx);
+		EdgeTable::beginHap(ped, rep, curGen, branch, ind, hapIdx,
+				    pars[p], parIdx[p], chrIdx);
 		generateHaplotype(toGen, theParent, map, coIntf, chrIdx,
 				  hapCarriers,
 				  (numSampsToPrint[curGen][branch] > 0) ? ped
@@ -339,16 +343,194 @@ int simulate(vector<SimDetails> &simDetails, Person *****&theSamples,
 	} // <branch>
       } // <curGen>
 
+      if (backward)
+	traceAncestry(simDetails[ped], ped, rep, theSamples[ped][rep], map,
+		      sexSpecificMaps, coIntf, hapCarriers);
+
+      // the replicate is complete: pack its haplotypes (see packedhaps.h)
+      for(int curGen = 0; curGen < numGen; curGen++) {
+	for(int branch = 0; branch < numBranches[curGen]; branch++) {
+	  int numFounders, numNonFounders;
+	  getPersonCounts(curGen, numGen, branch, numSampsToPrint,
+			  branchParents, branchNumSpouses, numFounders,
+			  numNonFounders);
+	  for(int ind = 0; ind < numFounders + numNonFounders; ind++)
+	    packHaps(theSamples[ped][rep][curGen][branch][ind], repFirstHap,
+		     map);
+	}
+      }
+      finishPacking();
+
       if (rep == 0)
 	simDetails[ped].numFounders = totalFounderHaps -
 						  simDetails[ped].founderOffset;
+
+      if (MemBudget::active()) {
+	// the replicate is complete, as are the carrier records of its
+	// founders' haplotypes
+	long repBytes = 0;
+	for(int curGen = 0; curGen < numGen; curGen++) {
+	  for(int branch = 0; branch < numBranches[curGen]; branch++) {
+	    int numFounders, numNonFounders;
+	    getPersonCounts(curGen, numGen, branch, numSampsToPrint,
+			    branchParents, branchNumSpouses, numFounders,
+			    numNonFounders);
+	    for(int ind = 0; ind < numFounders + numNonFounders; ind++)
+	      repBytes += MemBudget::personBytes(
+				      theSamples[ped][rep][curGen][branch][ind]);
+	  }
+	}
+	MemBudget::add(MEM_SAMPLES, repBytes);
+	long carrierBytes = 0;
+	for(int hap = repFirstHap; hap < totalFounderHaps; hap++)
+	  carrierBytes += MemBudget::carrierBytes(hapCarriers[hap]);
+	MemBudget::add(MEM_CARRIERS, carrierBytes);
+	// no output stages run during the simulation: stop here rather than
+	// simulating the remaining replicates
+	MemBudget::enforce();
+      }
+      Progress::add(PROG_SIMULATION);
     } // <rep>
 
+    if (PedCosts::active()) {
+      PedCosts::add(ped, PED_SIM_NS, PedCosts::now() - pedStart);
+      uint64_t numRecs = 0;
+      for(int hap = simDetails[ped].founderOffset; hap < totalFounderHaps;
+									hap++)
+	for(auto it = hapCarriers[hap].begin(); it != hapCarriers[hap].end();
+									  it++)
+	  numRecs += it->size();
+      PedCosts::add(ped, PED_CARRIER_RECS, numRecs);
+    }
   } // <ped>
 
+  releaseSpareHaps();
   return totalFounderHaps;
 }
 
+// For --shard: reduces the replicates in <simDetails> to those in this shard.
+// Numbering the (ped, rep) pairs in the order simulate() goes through them,
+// each shard gets a contiguous range of these. Sets <firstHap> and
+// <firstNonFounder> to the numbers of founder haplotypes and non-founders an
+// unsharded run simulates before the shard's first replicate of each pedigree,
+// and <repNonFounders> to the number of non-founders in each replicate.
+void selectShard(vector<SimDetails> &simDetails, vector<int> &firstHap,
+		 vector<int> &firstNonFounder, vector<int> &repNonFounders) {
+  long totalReps = 0;
+  for(auto it = simDetails.begin(); it != simDetails.end(); it++)
+    totalReps += it->numReps;
+  long shardStart = totalReps * (CmdLineOpts::shardIdx - 1) /
+							CmdLineOpts::numShards;
+  long shardEnd = totalReps * CmdLineOpts::shardIdx / CmdLineOpts::numShards;
+
+  long pedStart = 0; // index of the first replicate of <ped> among all
+  int numHaps = 0, numNonFounders = 0; // totals for the previous pedigrees
+  vector<int> repHaps;
+  for(unsigned int ped = 0; ped < simDetails.size(); ped++) {
+    int numGen = simDetails[ped].numGen;
+    int numReps = simDetails[ped].numReps;
+
+    int hapsPerRep = 0, nonFoundersPerRep = 0;
+    if (simDetails[ped].sharesWith >= 0) {
+      // same structure as an earlier pedigree
+      hapsPerRep = repHaps[ simDetails[ped].sharesWith ];
+      nonFoundersPerRep = repNonFounders[ simDetails[ped].sharesWith ];
+    }
+    else {
+      for(int gen = 0; gen < numGen; gen++) {
+	for(int branch = 0; branch < simDetails[ped].numBranches[gen];
+								    branch++) {
+	  int numFounders, numNonFound;
+	  getPersonCounts(gen, numGen, branch, simDetails[ped].numSampsToPrint,
+			  simDetails[ped].branchParents,
+			  simDetails[ped].branchNumSpouses, numFounders,
+			  numNonFound);
+	  if (gen != numGen - 1) // no founders in the last generation
+	    hapsPerRep += 2 * numFounders;
+	  nonFoundersPerRep += numNonFound;
+	}
+      }
+    }
+
+    long pedEnd = pedStart + numReps;
+    long first = min(max(shardStart, pedStart), pedEnd);
+    long last = min(max(shardEnd, pedStart), pedEnd); // exclusive
+    int firstRep = first - pedStart;
+    simDetails[ped].firstRep = firstRep;
+    simDetails[ped].numReps = last - first;
+
+    firstHap.push_back(numHaps + firstRep * hapsPerRep);
+    firstNonFounder.push_back(numNonFounders + firstRep * nonFoundersPerRep);
+    repNonFounders.push_back(nonFoundersPerRep);
+    repHaps.push_back(hapsPerRep);
+
+    pedStart += numReps;
+    numHaps += numReps * hapsPerRep;
+    numNonFounders += numReps * nonFoundersPerRep;
+  }
+}
+
+// For printing the mrca file: fills in the founder id suffixes of <ped>, two
+// (one for each haplotype) for each founder in the order simulate() numbers
+// their haplotypes. Entries that share a structure (see shareStructures() in
+// readdef.cc) share these, so they're made only once for each structure.
+void makeFounderIdSuffixes(vector<SimDetails> &simDetails, int ped) {
+  SimDetails &pedDetails = simDetails[ped];
+  if (pedDetails.sharesWith >= 0) {
+    SimDetails &owner = simDetails[ pedDetails.sharesWith ];
+    if (owner.founderIdSuffix.empty())
+      makeFounderIdSuffixes(simDetails, pedDetails.sharesWith);
+    pedDetails.founderIdSuffix = owner.founderIdSuffix;
+    return;
+  }
+
+  int numGen = pedDetails.numGen;
+  // no founders in the last generation
+  for(int gen = 0; gen < numGen - 1; gen++) {
+    for(int branch = 0; branch < pedDetails.numBranches[gen]; branch++) {
+      int numFounders, numNonFounders;
+      getPersonCounts(gen, numGen, branch, pedDetails.numSampsToPrint,
+		      pedDetails.branchParents, pedDetails.branchNumSpouses,
+		      numFounders, numNonFounders);
+      int branchNumSpouses = getBranchNumSpouses(pedDetails, gen, branch);
+
+      for(int ind = 0; ind < numFounders; ind++) {
+	char *idSuffix;
+	if (pedDetails.sampleIds) {
+	  // the id from the fam file
+	  const char *id = pedDetails.sampleIds[gen][branch];
+	  idSuffix = new char[ strlen(id) + 1 ];
+	  if (idSuffix == NULL) {
+	    printf("ERROR: out of memory\n");
+	    fatalExit(5);
+	  }
+	  strcpy(idSuffix, id);
+	}
+	else {
+	  // number of digits for the numbers is 1 + (value+1) / 10
+	  // 6 for 'g-b-i\0'
+	  int idLength = 6 + 1 + (gen + 1) / 10 +
+			     1 + (branch + 1) / 10 +
+			     1 + (ind + 1) / 10;
+	  idSuffix = new char[ idLength ];
+	  if (idSuffix == NULL) {
+	    printf("ERROR: out of memory\n");
+	    fatalExit(5);
+	  }
+	  if (ind < branchNumSpouses)
+	    sprintf(idSuffix, "g%d-b%d-s%d", gen + 1, branch + 1, ind + 1);
+	  else
+	    sprintf(idSuffix, "g%d-b%d-i%d", gen + 1, branch + 1,
+		    ind - branchNumSpouses + 1);
+	}
+	// same founder for two ids in a row for the two haplotypes:
+	pedDetails.founderIdSuffix.push_back(idSuffix);
+	pedDetails.founderIdSuffix.push_back(idSuffix);
+      }
+    }
+  }
+}
+
 // Returns (via parameters) the number of founders and non-founders in the given
 // generation and branch.
 void getPersonCounts(int curGen, int numGen, int branch, int **numSampsToPrint,
@@ -390,6 +572,34 @@ void getPersonCounts(int curGen, int numGen, int branch, int **numSampsToPrint,
   }
 }
 
+// Sets <pars> to the branches of the parents of the non-founders in <branch>
+// of <curGen> and <parIdx> to the index of each parent in its branch
+void getBranchParents(SimDetails &pedDetails, int curGen, int branch,
+		      Parent pars[2], int parIdx[2]) {
+  for(int p = 0; p < 2; p++) {
+    pars[p] = pedDetails.branchParents[curGen][branch*2 + p];
+    if (pars[p].branch < 0) {
+      assert(p == 1 && pars[p].gen == curGen - 1);
+      // founders have negative indexes that start from -1, so we
+      // add 1 to get it to be 0 based and negate to get the index
+      parIdx[p] = -(pars[p].branch + 1);
+      pars[1].branch = pars[0].branch;
+    }
+    else {
+      // use "primary" person: immediately after all the spouses
+      int thisBranchNumSpouses;
+      if (pedDetails.branchNumSpouses[curGen-1])
+	thisBranchNumSpouses =
+	    -pedDetails.branchNumSpouses[ pars[p].gen ][ pars[p].branch ];
+      else if (curGen == pedDetails.numGen - 1) // no spouses in last gen
+	thisBranchNumSpouses = 0;
+      else                                      // one spouse by default
+	thisBranchNumSpouses = 1;
+      parIdx[p] = thisBranchNumSpouses;
+    }
+  }
+}
+
 // Simulate one haplotype <toGenerate> by sampling crossovers and switching
 // between the two haplotypes stored in <parent>.
 void generateHaplotype(Haplotype &toGenerate, Person &parent,
@@ -427,7 +637,7 @@ void generateHaplotype(Haplotype &toGenerate, Person &parent,
   if (fixedCOidxs[0] == UINT_MAX) { // no fixed crossovers -- simulate:
 #endif // NOFIXEDCO
     if (chrLength > 0.0 && // any genetic length? (is 0 on chrX for males)
-	CmdLineOpts::interfereFile) {
+	coIntf.size() > 0) { // have interference parameters?
       coIntf[chrIdx].simStahl(coLocations, parent.sex, randomGen);
     }
     else if (chrLength > 0.0) { // any genetic length? (is 0 on chrX for males)
@@ -440,47 +650,15 @@ void generateHaplotype(Haplotype &toGenerate, Person &parent,
 	lastPos = curPos;
       }
     }
+    PhaseTimer::count(CROSSOVERS, coLocations.size());
 
-    // initially assume we'll recombine between first and second positions with
-    // map info
-    int switchIdx = 0;
-
-    int mapNumPos = map.chromNumPos(chrIdx);
     for(auto it = coLocations.begin(); it != coLocations.end(); it++) {
       // Multiply by 100 to get cM:
       double cMPosNextCO = firstcMPos + (*it * 100);
-
-      int left = 0, right = mapNumPos - 1;
-      while (true) {
-	if (right - left == 1) {
-	  switchIdx = left; // want <switchIdx> <= than <cMPosNextCO>
-	  break;
-	}
-	int mid = (left + right) / 2;
-	double midGenet = map.chromGenetPos(chrIdx, parent.sex, mid);
-	if (midGenet < cMPosNextCO)
-	  left = mid;
-	else if (midGenet > cMPosNextCO)
-	  right = mid;
-	else {
-	  // equal: exact map position
-	  switchIdx = mid;
-	  break;
-	}
-      }
-      if (switchIdx == mapNumPos - 1)
+      int switchPos = crossoverSwitchPos(map, chrIdx, parent.sex, cMPosNextCO);
+      if (switchPos < 0)
 	break; // let code below this while loop insert the final segments
 
-      // get physical position using linear interpolation:
-      double frac = (cMPosNextCO -
-		     map.chromGenetPos(chrIdx, parent.sex, switchIdx)) /
-	      (map.chromGenetPos(chrIdx, parent.sex, switchIdx+1) -
-			      map.chromGenetPos(chrIdx, parent.sex, switchIdx));
-      assert(frac >= 0.0 && frac <= 1.0);
-      int switchPos = map.chromPhysPos(chrIdx, switchIdx) +
-		      frac * (map.chromPhysPos(chrIdx, switchIdx+1) -
-					  map.chromPhysPos(chrIdx, switchIdx));
-
       // copy Segments from <curHap>
       copySegs(toGenerate, parent, nextSegStart, switchPos, curSegIdx, curHap,
 	       chrIdx, hapCarriers, ped, rep, curGen, branch, ind);
@@ -490,6 +668,7 @@ void generateHaplotype(Haplotype &toGenerate, Person &parent,
   else {
     vector<int> &theCOs = FixedCOs::getCOs(parent.sex, fixedCOidxs[parent.sex],
 					   chrIdx);
+    PhaseTimer::count(CROSSOVERS, theCOs.size());
 
     for(auto it = theCOs.begin(); it != theCOs.end(); it++) {
       // copy Segments from <curHap>
@@ -501,6 +680,9 @@ void generateHaplotype(Haplotype &toGenerate, Person &parent,
 
 
   // copy through to the end of the chromosome:
+  if (EdgeTable::active())
+    EdgeTable::add(nextSegStart, parent.haps[curHap][chrIdx].back().endPos,
+		   curHap);
   for( ; curSegIdx[curHap] < parent.haps[curHap][chrIdx].size();
 							  curSegIdx[curHap]++) {
     Segment &seg = parent.haps[curHap][chrIdx][ curSegIdx[curHap] ];
@@ -512,6 +694,7 @@ void generateHaplotype(Haplotype &toGenerate, Person &parent,
     }
     nextSegStart = seg.endPos + 1;
   }
+  PhaseTimer::count(SEGMENTS, toGenerate.size());
 
   int prevEndPos = -1;
   for(auto it = toGenerate.begin(); it != toGenerate.end(); it++) {
@@ -520,13 +703,55 @@ void generateHaplotype(Haplotype &toGenerate, Person &parent,
   }
 }
 
+// Returns the physical position of a crossover at <cMPos> (in centiMorgans) on
+// chromosome <chrIdx> in the map for <sex>: the last position copied from the
+// haplotype before the switch. Returns -1 if the crossover is at or beyond the
+// last map position.
+int crossoverSwitchPos(GeneticMap &map, unsigned int chrIdx, int sex,
+		       double cMPos) {
+  int mapNumPos = map.chromNumPos(chrIdx);
+  int switchIdx;
+  int left = 0, right = mapNumPos - 1;
+  while (true) {
+    if (right - left == 1) {
+      switchIdx = left; // want <switchIdx> <= than <cMPos>
+      break;
+    }
+    int mid = (left + right) / 2;
+    double midGenet = map.chromGenetPos(chrIdx, sex, mid);
+    if (midGenet < cMPos)
+      left = mid;
+    else if (midGenet > cMPos)
+      right = mid;
+    else {
+      // equal: exact map position
+      switchIdx = mid;
+      break;
+    }
+  }
+  if (switchIdx == mapNumPos - 1)
+    return -1;
+
+  // get physical position using linear interpolation:
+  double frac = (cMPos - map.chromGenetPos(chrIdx, sex, switchIdx)) /
+		(map.chromGenetPos(chrIdx, sex, switchIdx+1) -
+				      map.chromGenetPos(chrIdx, sex, switchIdx));
+  assert(frac >= 0.0 && frac <= 1.0);
+  return map.chromPhysPos(chrIdx, switchIdx) +
+	 frac * (map.chromPhysPos(chrIdx, switchIdx+1) -
+					  map.chromPhysPos(chrIdx, switchIdx));
+}
+
 // Copies the <Segment>s between <nextSegStart> and <switchPos> from <parent>'s
-// <curHap> haplotype to <toGenerate>.
+// <curHap> haplotype to <toGenerate> (recording the stretch as an edge for
+// --edges).
 void copySegs(Haplotype &toGenerate, Person &parent, int &nextSegStart,
 	      int switchPos, unsigned int curSegIdx[2], int &curHap,
 	      unsigned int chrIdx,
 	      vector< vector< vector<InheritRecord> > > &hapCarriers,
 	      int ped, int rep, int curGen, int branch, int ind) {
+  if (nextSegStart <= switchPos)
+    EdgeTable::add(nextSegStart, switchPos, curHap);
   for( ; curSegIdx[curHap] < parent.haps[curHap][chrIdx].size();
 							  curSegIdx[curHap]++) {
     if (nextSegStart > switchPos)
@@ -590,8 +815,18 @@ void deleteTheSamples(vector<SimDetails> &simDetails, Person *****theSamples) {
       // for --dry_run, only generated one replicate per pedigree
       numReps = 1;
 
+    // after an error in simulate(), the arrays not yet allocated are NULL
+    if (theSamples[ped] == NULL)
+      continue;
     for (int rep = 0; rep < numReps; rep++) {
+      if (theSamples[ped][rep] == NULL)
+	continue;
+      // the first Person owns the replicate's packed haplotypes (see Person)
+      if (theSamples[ped][rep][0] != NULL && theSamples[ped][rep][0][0] != NULL)
+	delete [] theSamples[ped][rep][0][0][0].packed;
       for(int curGen = 0; curGen < numGen; curGen++) {
+	if (theSamples[ped][rep][curGen] == NULL)
+	  continue;
 	for(int branch = 0; branch < numBranches[curGen]; branch++) {
 	  delete [] theSamples[ped][rep][curGen][branch];
 	}
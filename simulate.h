@@ -13,7 +13,7 @@
 using namespace std;
 
 // global random variables used in several other places
-extern mt19937 randomGen;
+extern thread_local mt19937 randomGen;
 extern uniform_int_distribution<int> coinFlip;
 extern exponential_distribution<double> crossoverDist;
 
@@ -21,15 +21,22 @@ int simulate(vector<SimDetails> &simDetails, Person *****&theSamples,
 	     GeneticMap &map, bool sexSpecificMaps, vector<COInterfere> &coIntf,
 	     vector< vector< vector<InheritRecord> > > &hapCarriers,
 	     vector<int> hapNumsBySex[2]);
+void selectShard(vector<SimDetails> &simDetails, vector<int> &firstHap,
+		 vector<int> &firstNonFounder, vector<int> &repNonFounders);
+void makeFounderIdSuffixes(vector<SimDetails> &simDetails, int ped);
 void getPersonCounts(int curGen, int numGen, int branch, int **numSampsToPrint,
 		     Parent **branchParents, int **branchNumSpouses,
 		     int &numFounders, int &numNonFounders);
+void getBranchParents(SimDetails &pedDetails, int curGen, int branch,
+		      Parent pars[2], int parIdx[2]);
 void generateHaplotype(Haplotype &toGenerate, Person &parent,
 		       GeneticMap &map, vector<COInterfere> &coIntf,
 		       unsigned int chrIdx,
 		       vector< vector< vector<InheritRecord> > > &hapCarriers,
 		       int ped, int rep, int curGen, int branch, int ind,
 		       unsigned int fixedCOidxs[2]);
+int crossoverSwitchPos(GeneticMap &map, unsigned int chrIdx, int sex,
+		       double cMPos);
 void copySegs(Haplotype &toGenerate, Person &parent, int &nextSegStart,
 	      int switchPos, unsigned int curSegIdx[2], int &curHap,
 	      unsigned int chrIdx,
@@ -0,0 +1,137 @@
+// ped-sim: pedigree simulation tool
+//
+// This program is distributed under the terms of the GNU General Public License
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <vector>
+#include <atomic>
+#include <mutex>
+#include <chrono>
+#include "trace.h"
+#include "runerror.h"
+
+struct TraceEvent {
+  const char *name;
+  uint64_t start, dur; // in ns
+  const char *argNames[2];
+  long args[2];
+};
+
+// Events of one thread. Only that thread writes to <events>; dump() reads
+// the first <count> entries (modulo RING_SIZE) after the thread is done.
+struct TraceRing {
+  int tid;
+  const char *threadName;
+  TraceEvent *events;
+  atomic<uint64_t> count;
+};
+
+bool Trace::on = false;
+static chrono::steady_clock::time_point origin;
+
+// all rings are kept (even after their threads exit) until dump()
+static mutex ringsLock;
+static vector<TraceRing *> rings;
+static thread_local TraceRing *myRing = NULL;
+
+// Returns the calling thread's ring, allocating it on first use
+static TraceRing *getRing() {
+  if (myRing)
+    return myRing;
+
+  myRing = new TraceRing;
+  if (myRing == NULL) {
+    printf("ERROR: out of memory");
+    fatalExit(5);
+  }
+  myRing->events = new TraceEvent[Trace::RING_SIZE];
+  if (myRing->events == NULL) {
+    printf("ERROR: out of memory");
+    fatalExit(5);
+  }
+  myRing->threadName = NULL;
+  myRing->count = 0;
+  lock_guard<mutex> lock(ringsLock);
+  myRing->tid = rings.size() + 1;
+  rings.push_back(myRing);
+  return myRing;
+}
+
+void Trace::enable() {
+  origin = chrono::steady_clock::now();
+  on = true;
+}
+
+uint64_t Trace::now() {
+  return chrono::duration_cast<chrono::nanoseconds>(
+			  chrono::steady_clock::now() - origin).count();
+}
+
+void Trace::record(const char *name, uint64_t start,
+		   const char *arg0Name, long arg0,
+		   const char *arg1Name, long arg1) {
+  if (!on)
+    return;
+
+  TraceRing *ring = getRing();
+  uint64_t idx = ring->count.load(memory_order_relaxed);
+  TraceEvent &event = ring->events[ idx % RING_SIZE ];
+  event.name = name;
+  event.start = start;
+  event.dur = now() - start;
+  event.argNames[0] = arg0Name;
+  event.argNames[1] = arg1Name;
+  event.args[0] = arg0;
+  event.args[1] = arg1;
+  ring->count.store(idx + 1, memory_order_release);
+}
+
+void Trace::nameThread(const char *name) {
+  if (on)
+    getRing()->threadName = name;
+}
+
+void Trace::dump(const char *fileName) {
+  FILE *out = fopen(fileName, "w");
+  if (!out) {
+    printf("ERROR: could not open trace file %s!\n", fileName);
+    perror("open");
+    fatalExit(1);
+  }
+
+  lock_guard<mutex> lock(ringsLock);
+  fprintf(out, "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [\n");
+  bool first = true;
+  for(auto it = rings.begin(); it != rings.end(); it++) {
+    TraceRing *ring = *it;
+    if (ring->threadName) {
+      fprintf(out, "%s{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, "
+		   "\"tid\": %d, \"args\": {\"name\": \"%s\"}}",
+	      first ? "" : ",\n", ring->tid, ring->threadName);
+      first = false;
+    }
+
+    uint64_t count = ring->count.load(memory_order_acquire);
+    uint64_t begin = (count > RING_SIZE) ? count - RING_SIZE : 0;
+    if (begin > 0)
+      fprintf(stderr, "WARNING: trace dropped the first %lu events of thread %d\n",
+	      begin, ring->tid);
+    for(uint64_t i = begin; i < count; i++) {
+      TraceEvent &event = ring->events[ i % RING_SIZE ];
+      // times are in microseconds
+      fprintf(out, "%s{\"name\": \"%s\", \"ph\": \"X\", \"pid\": 1, "
+		   "\"tid\": %d, \"ts\": %.3lf, \"dur\": %.3lf, \"args\": {",
+	      first ? "" : ",\n", event.name, ring->tid, event.start / 1e3,
+	      event.dur / 1e3);
+      first = false;
+      for(int a = 0; a < 2; a++)
+	if (event.argNames[a])
+	  fprintf(out, "%s\"%s\": %ld", (a == 0) ? "" : ", ",
+		  event.argNames[a], event.args[a]);
+      fprintf(out, "}}");
+    }
+  }
+  fprintf(out, "\n]}\n");
+  fclose(out);
+}
@@ -0,0 +1,69 @@
+// ped-sim: pedigree simulation tool
+//
+// This program is distributed under the terms of the GNU General Public License
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifndef TRACE_H
+#define TRACE_H
+
+using namespace std;
+
+////////////////////////////////////////////////////////////////////////////////
+// Timeline of events for --trace, printed in the Chrome trace event format
+// (viewable in chrome://tracing, Perfetto, etc.). Each thread records its
+// events in its own fixed-size ring buffer, so recording takes no locks; if a
+// thread records more than RING_SIZE events, its oldest ones are dropped.
+// Unless enable() has been called, recording is a test of one flag.
+class Trace {
+  public:
+    static const int RING_SIZE = 1 << 14;
+
+    // Call before starting any threads that record events
+    static void enable();
+    static bool enabled() { return on; }
+
+    // Nanoseconds since enable()
+    static uint64_t now();
+
+    // Records an event named <name> on the calling thread from <start> (as
+    // returned by now()) until the present. <argNames> (if non-NULL) label
+    // <arg0> and <arg1>, e.g., "ped" and "rep". The strings must be constants.
+    static void record(const char *name, uint64_t start,
+		       const char *arg0Name = NULL, long arg0 = 0,
+		       const char *arg1Name = NULL, long arg1 = 0);
+
+    // Names the calling thread in the timeline
+    static void nameThread(const char *name);
+
+    // Prints all recorded events to <fileName>; call after all threads that
+    // record events have finished
+    static void dump(const char *fileName);
+
+  private:
+    static bool on;
+};
+
+// Records an event spanning the lifetime of the object (see Trace::record())
+class TraceScope {
+  public:
+    TraceScope(const char *name, const char *arg0Name = NULL, long arg0 = 0,
+	       const char *arg1Name = NULL, long arg1 = 0) :
+	name(name), arg0Name(arg0Name), arg1Name(arg1Name), arg0(arg0),
+	arg1(arg1), start(0) {
+      if (Trace::enabled())
+	start = Trace::now();
+    }
+    ~TraceScope() {
+      if (Trace::enabled())
+	Trace::record(name, start, arg0Name, arg0, arg1Name, arg1);
+    }
+
+  private:
+    const char *name, *arg0Name, *arg1Name;
+    long arg0, arg1;
+    uint64_t start;
+};
+
+#endif // TRACE_H
@@ -0,0 +1,499 @@
+#!/usr/bin/env python3
+
+"""
+Distributional equivalence tests for Ped-sim.
+
+Runs a reference and a candidate configuration of Ped-sim (two binaries, two
+sets of options, or both) over many replicates and tests whether their outputs
+follow the same distributions. This is for validating changes that alter the
+exact output for a given seed but should leave the statistics unchanged (e.g.,
+a different random number generator or a faster way of sampling crossovers).
+
+Compares:
+  * crossover counts per chromosome and sex (chi-square test)
+  * crossover positions per chromosome and sex (two-sample KS test)
+  * IBD segment lengths and per-pair total IBD1 and IBD2 sharing for full
+    siblings, half-siblings, avuncular, grandparent-grandchild, and first
+    cousin pairs (two-sample KS tests)
+  * genotype error and missingness rates (chi-square tests)
+
+Crossovers come from the --bp output of full siblings whose parents are
+founders, so every switch between founder haplotypes is one crossover. The
+genotype rates come from a separate run with an input VCF that is
+homozygous for the reference allele at every site, so any other genotype is an
+error.
+
+Each test's p-value is printed. The program exits with status 1 if any p-value
+is below --alpha divided by the number of tests (a Bonferroni correction).
+Only the Python standard library is used, so it runs offline.
+"""
+
+import math
+import optparse
+import os
+import shlex
+import shutil
+import subprocess
+import sys
+import tempfile
+
+################################################################################
+# TESTS
+################################################################################
+
+# relationship classes: (pedigree name, def file lines, pairs printed per
+# replicate); names can't end in digits since replicate numbers follow them
+REL_CLASSES = [
+    ('FS', "2 2 1", 1),                 # full siblings
+    ('HS', "2 1 2 1:1 2:1", 1),         # half-siblings
+    ('AV', "2 1 2 1n\n3 1 1", 1),       # avuncular
+    ('GP', "1 1\n2 0 1\n3 1", 2),       # both grandparents with a grandchild
+    ('FC', "3 1 2", 1),                 # first cousins
+]
+
+# rates used for the genotype run; higher than the defaults to give the tests
+# more errors and missing genotypes to count
+ERR_RATE = 0.01
+ERR_HOM_RATE = 0.1
+MISS_RATE = 0.01
+
+NUM_CHROMS = 22
+
+def ks_test(a, b):
+    """Two-sample Kolmogorov-Smirnov test of <a> and <b>; returns the D
+    statistic and its asymptotic p-value"""
+    a = sorted(a)
+    b = sorted(b)
+    n, m = len(a), len(b)
+    if n == 0 or m == 0:
+        return 0.0, 1.0
+    i = j = 0
+    d = 0.0
+    while i < n and j < m:
+        # step past all copies of the smallest value so ties are handled
+        x = min(a[i], b[j])
+        while i < n and a[i] == x:
+            i += 1
+        while j < m and b[j] == x:
+            j += 1
+        d = max(d, abs(i / n - j / m))
+    en = math.sqrt(n * m / (n + m))
+    return d, ks_prob((en + 0.12 + 0.11 / en) * d)
+
+def ks_prob(lam):
+    """Kolmogorov distribution: probability of a statistic at least <lam>"""
+    if lam < 0.2:
+        return 1.0
+    total = 0.0
+    sign = 1.0
+    for j in range(1, 101):
+        term = sign * 2.0 * math.exp(-2.0 * j * j * lam * lam)
+        total += term
+        if abs(term) < 1e-12 * total:
+            break
+        sign = -sign
+    return min(max(total, 0.0), 1.0)
+
+def chi2_test(counts_a, counts_b):
+    """Chi-square test of homogeneity for two lists of counts over the same
+    (ordered) categories. Adjacent categories are pooled until every expected
+    count is at least 5. Returns the statistic, degrees of freedom, and
+    p-value."""
+    total_a = sum(counts_a)
+    total_b = sum(counts_b)
+    total = total_a + total_b
+    if total_a == 0 or total_b == 0:
+        return 0.0, 0, 1.0
+
+    # pool categories from the left, then fold a small remainder into the
+    # last pooled category
+    pooled = []
+    cur_a = cur_b = 0
+    for ca, cb in zip(counts_a, counts_b):
+        cur_a += ca
+        cur_b += cb
+        # expected counts are (cur_a + cur_b) * total_{a,b} / total
+        if (cur_a + cur_b) * min(total_a, total_b) >= 5 * total:
+            pooled.append((cur_a, cur_b))
+            cur_a = cur_b = 0
+    if cur_a + cur_b > 0:
+        if pooled:
+            last = pooled.pop()
+            pooled.append((last[0] + cur_a, last[1] + cur_b))
+        else:
+            pooled.append((cur_a, cur_b))
+
+    df = len(pooled) - 1
+    if df < 1:
+        return 0.0, 0, 1.0
+    stat = 0.0
+    for ca, cb in pooled:
+        col = ca + cb
+        exp_a = col * total_a / total
+        exp_b = col * total_b / total
+        stat += (ca - exp_a) ** 2 / exp_a + (cb - exp_b) ** 2 / exp_b
+    return stat, df, gamma_q(df / 2.0, stat / 2.0)
+
+def gamma_q(a, x):
+    """Regularized upper incomplete gamma function Q(a, x)"""
+    if x <= 0:
+        return 1.0
+    log_prefix = -x + a * math.log(x) - math.lgamma(a)
+    if x < a + 1:
+        # series for P(a, x)
+        term = total = 1.0 / a
+        ap = a
+        for n in range(1000):
+            ap += 1
+            term *= x / ap
+            total += term
+            if abs(term) < abs(total) * 1e-15:
+                break
+        return max(0.0, 1.0 - total * math.exp(log_prefix))
+    # continued fraction for Q(a, x) (modified Lentz's method)
+    tiny = 1e-300
+    b = x + 1 - a
+    c = 1 / tiny
+    d = 1 / b
+    h = d
+    for i in range(1, 1000):
+        an = -i * (i - a)
+        b += 2
+        d = an * d + b
+        if abs(d) < tiny:
+            d = tiny
+        c = b + an / c
+        if abs(c) < tiny:
+            c = tiny
+        d = 1 / d
+        delta = d * c
+        h *= delta
+        if abs(delta - 1) < 1e-15:
+            break
+    return min(1.0, math.exp(log_prefix) * h)
+
+################################################################################
+# FUNCTIONS
+################################################################################
+
+def parse_args():
+    """Parse command line arguments."""
+    script_dir = os.path.dirname(os.path.abspath(__file__))
+    default_bin = os.path.join(script_dir, 'ped-sim')
+    parser = optparse.OptionParser(
+        usage='%prog [options]',
+        description='distributional equivalence tests for two Ped-sim ' \
+                    'configurations')
+
+    parser.add_option('--ref', type='string', default=default_bin,
+        help='reference ped-sim binary [default: %default]')
+    parser.add_option('--cand', type='string', default=default_bin,
+        help='candidate ped-sim binary [default: %default]')
+    parser.add_option('--ref_args', type='string', default='',
+        help='extra options for the reference runs')
+    parser.add_option('--cand_args', type='string', default='',
+        help='extra options for the candidate runs')
+    parser.add_option('--intf', type='string', \
+        default=os.path.join(script_dir, 'interfere', 'nu_p_campbell.tsv'),
+        help='interference parameters file [default: %default]')
+    parser.add_option('-n', '--reps', type='int', default=5000,
+        help='replicates of each relationship class [default: %default]')
+    parser.add_option('--geno_reps', type='int', default=200,
+        help='replicates (pairs of siblings) in the genotype run ' \
+             '[default: %default]')
+    parser.add_option('--sites', type='int', default=2000,
+        help='sites in the input VCF for the genotype run ' \
+             '[default: %default]')
+    parser.add_option('--seed', type='int', default=1,
+        help='seed for the reference runs; the candidate runs use the ' \
+             'next value [default: %default]')
+    parser.add_option('--alpha', type='float', default=0.01,
+        help='family-wise significance level [default: %default]')
+    parser.add_option('-o', '--out', type='string',
+        help='file to save the test results to (tab-separated)')
+    parser.add_option('--work_dir', type='string',
+        help='directory for inputs and outputs (kept afterwards); ' \
+             'default: a temporary directory')
+
+    (opts, args) = parser.parse_args()
+    if len(args) > 0:
+        parser.print_help()
+        sys.exit(1)
+    return opts
+
+def chrom_len(chrom):
+    """Physical length of <chrom> in the generated map"""
+    return (250 - (chrom - 1) * 9) * 1000000
+
+def write_map(filename):
+    """Write a sex-specific map for 22 chromosomes with some variation in
+    recombination rate along each so that the position tests have structure
+    to compare"""
+    with open(filename, 'w') as out_file:
+        for chrom in range(1, NUM_CHROMS + 1):
+            phys_len = chrom_len(chrom)
+            num_pos = 200
+            male = female = 0.0
+            for i in range(num_pos):
+                frac = i / (num_pos - 1)
+                out_file.write("%d %d %.6f %.6f\n" %
+                               (chrom, 1 + int(frac * (phys_len - 1)), male,
+                                female))
+                # male recombination is concentrated near the telomeres
+                step = phys_len / 1e6 / (num_pos - 1)
+                tel = abs(2 * frac - 1)
+                male += step * (0.4 + 1.2 * tel * tel)
+                female += step * 1.5
+
+def write_def(filename, reps):
+    """Write a def file with <reps> replicates of each relationship class"""
+    with open(filename, 'w') as out_file:
+        for name, lines, pairs in REL_CLASSES:
+            num_gens = max(int(l.split()[0]) for l in lines.split('\n'))
+            out_file.write("def %s %d %d\n%s\n\n" % (name, reps, num_gens,
+                                                    lines))
+
+def write_vcf(filename, num_samples, num_sites):
+    """Write a VCF with <num_samples> samples that are all homozygous for the
+    reference allele at <num_sites> sites"""
+    row = '\t'.join(['0|0'] * num_samples)
+    sites_per_chr = max(num_sites // NUM_CHROMS, 1)
+    with open(filename, 'w') as out_file:
+        out_file.write("##fileformat=VCFv4.2\n")
+        out_file.write("#CHROM\tPOS\tID\tREF\tALT\tQUAL\tFILTER\tINFO\tFORMAT\t")
+        out_file.write('\t'.join('S%d' % s for s in range(num_samples)) + '\n')
+        printed = 0
+        for chrom in range(1, NUM_CHROMS + 1):
+            if chrom == NUM_CHROMS:
+                sites_per_chr = num_sites - printed
+            for i in range(sites_per_chr):
+                pos = 2 + (i * (chrom_len(chrom) - 3)) // sites_per_chr
+                out_file.write("%d\t%d\t.\tA\tG\t.\tPASS\t.\tGT\t%s\n" %
+                               (chrom, pos, row))
+            printed += sites_per_chr
+
+def run(binary, args, seed, out_prefix, intf, extra):
+    """Run <binary> with <extra> options followed by the user's <args>; uses
+    the interference model in <intf> unless <args> picks another crossover
+    model"""
+    args = shlex.split(args)
+    if intf and '--pois' not in args and '--fixed_co' not in args:
+        extra = extra + ['--intf', intf]
+    cmd = [binary, '-o', out_prefix, '--seed', str(seed), '--nogz'] + extra + \
+          args
+    proc = subprocess.run(cmd, stdout=subprocess.DEVNULL)
+    if proc.returncode != 0:
+        sys.exit("ERROR: run failed: %s" % ' '.join(cmd))
+
+def rel_class(sample_id):
+    """Relationship class of <sample_id>, e.g., FS for FS12_g2-b1-i1"""
+    ped = sample_id.split('_')[0]
+    return ped.rstrip('0123456789')
+
+def read_crossovers(bp_file):
+    """Crossover counts and positions from the full siblings in <bp_file>;
+    returns dictionaries from (chromosome, sex) to lists of counts and of
+    positions. h0 is transmitted by the father and h1 by the mother."""
+    counts = {}
+    positions = {}
+    with open(bp_file, 'r') as in_file:
+        for line in in_file:
+            fields = line.split()
+            if rel_class(fields[0]) != 'FS':
+                continue
+            sex = 'male' if fields[2] == 'h0' else 'female'
+            chrom = None
+            segs = []
+            for field in fields[3:] + ['|']:
+                if '|' in field:
+                    if chrom is not None:
+                        key = (chrom, sex)
+                        counts.setdefault(key, []).append(len(segs) - 1)
+                        positions.setdefault(key, []).extend(segs[:-1])
+                    chrom = field.split('|')[0]
+                    segs = []
+                else:
+                    segs.append(int(field.split(':')[1]))
+    return counts, positions
+
+def read_ibd(seg_file, reps):
+    """IBD segment lengths and per-pair IBD1 and IBD2 totals (in cM) for each
+    relationship class in <seg_file>; pairs with no IBD segments have totals
+    of 0"""
+    lengths = {}
+    totals = {}
+    with open(seg_file, 'r') as in_file:
+        for line in in_file:
+            fields = line.split()
+            cls = rel_class(fields[0])
+            ibd_type = fields[5]
+            if ibd_type == 'HBD':
+                continue
+            length = float(fields[8])
+            lengths.setdefault(cls, []).append(length)
+            pair = (fields[0], fields[1])
+            cur = totals.setdefault(cls, {}).setdefault(pair, [0.0, 0.0])
+            cur[0 if ibd_type == 'IBD1' else 1] += length
+
+    totals_ibd1 = {}
+    totals_ibd2 = {}
+    for name, lines, pairs in REL_CLASSES:
+        cls_totals = list(totals.get(name, {}).values())
+        cls_totals += [[0.0, 0.0]] * (reps * pairs - len(cls_totals))
+        totals_ibd1[name] = [t[0] for t in cls_totals]
+        totals_ibd2[name] = [t[1] for t in cls_totals]
+    return lengths, totals_ibd1, totals_ibd2
+
+def read_genotypes(vcf_file):
+    """Counts of correct (0/0), heterozygous error, opposite homozygous error,
+    and missing genotypes in <vcf_file>"""
+    correct = het = hom = missing = 0
+    with open(vcf_file, 'r') as in_file:
+        for line in in_file:
+            if line.startswith('#'):
+                continue
+            for gt in line.rstrip('\n').split('\t')[9:]:
+                alleles = gt.replace('|', '/').split('/')
+                if '.' in alleles:
+                    missing += 1
+                elif alleles[0] == alleles[1]:
+                    if alleles[0] == '0':
+                        correct += 1
+                    else:
+                        hom += 1
+                else:
+                    het += 1
+    return correct, het, hom, missing
+
+def simulate(opts, work_dir, label, binary, args, seed):
+    """Run one configuration and return its parsed results"""
+    out_dir = os.path.join(work_dir, label)
+    os.makedirs(out_dir, exist_ok=True)
+    prefix = os.path.join(out_dir, 'rel')
+    run(binary, args, seed, prefix, opts.intf,
+        ['-d', os.path.join(work_dir, 'rel.def'),
+         '-m', os.path.join(work_dir, 'map.txt'), '--bp'])
+    crossovers = read_crossovers(prefix + '.bp')
+    ibd = read_ibd(prefix + '.seg', opts.reps)
+
+    prefix = os.path.join(out_dir, 'geno')
+    run(binary, args, seed, prefix, opts.intf,
+        ['-d', os.path.join(work_dir, 'geno.def'),
+         '-m', os.path.join(work_dir, 'map.txt'),
+         '-i', os.path.join(work_dir, 'in.vcf'),
+         '--err_rate', str(ERR_RATE), '--err_hom_rate', str(ERR_HOM_RATE),
+         '--miss_rate', str(MISS_RATE)])
+    genotypes = read_genotypes(prefix + '.vcf')
+    return crossovers, ibd, genotypes
+
+def compare(ref, cand):
+    """List of (test name, reference n, candidate n, statistic, p-value)"""
+    tests = []
+    (ref_counts, ref_pos), ref_ibd, ref_geno = ref
+    (cand_counts, cand_pos), cand_ibd, cand_geno = cand
+
+    for chrom in range(1, NUM_CHROMS + 1):
+        for sex in ['male', 'female']:
+            key = (str(chrom), sex)
+            a = ref_counts.get(key, [])
+            b = cand_counts.get(key, [])
+            max_count = max(a + b + [0])
+            hist_a = [0] * (max_count + 1)
+            hist_b = [0] * (max_count + 1)
+            for c in a:
+                hist_a[c] += 1
+            for c in b:
+                hist_b[c] += 1
+            stat, df, p = chi2_test(hist_a, hist_b)
+            tests.append(('CO count chr%d %s' % (chrom, sex), len(a), len(b),
+                          'chi2=%.2f df=%d' % (stat, df), p))
+
+            a = ref_pos.get(key, [])
+            b = cand_pos.get(key, [])
+            d, p = ks_test(a, b)
+            tests.append(('CO position chr%d %s' % (chrom, sex), len(a),
+                          len(b), 'D=%.4f' % d, p))
+
+    for idx, what in [(0, 'IBD segment length'), (1, 'total IBD1'),
+                      (2, 'total IBD2')]:
+        for name, lines, pairs in REL_CLASSES:
+            a = ref_ibd[idx].get(name, [])
+            b = cand_ibd[idx].get(name, [])
+            if max(a + b + [0]) == 0:
+                continue # e.g., IBD2 in relatives with one parent in common
+            d, p = ks_test(a, b)
+            tests.append(('%s %s' % (what, name), len(a), len(b),
+                          'D=%.4f' % d, p))
+
+    # non-missing genotypes: correct, heterozygous error, homozygous error
+    stat, df, p = chi2_test(list(ref_geno[:3]), list(cand_geno[:3]))
+    tests.append(('genotype error', sum(ref_geno[:3]), sum(cand_geno[:3]),
+                  'chi2=%.2f df=%d' % (stat, df), p))
+    ref_called = sum(ref_geno[:3])
+    cand_called = sum(cand_geno[:3])
+    stat, df, p = chi2_test([ref_called, ref_geno[3]],
+                            [cand_called, cand_geno[3]])
+    tests.append(('genotype missingness', sum(ref_geno), sum(cand_geno),
+                  'chi2=%.2f df=%d' % (stat, df), p))
+    return tests
+
+def main():
+    opts = parse_args()
+
+    work_dir = opts.work_dir
+    if work_dir:
+        os.makedirs(work_dir, exist_ok=True)
+    else:
+        work_dir = tempfile.mkdtemp(prefix='ped-sim-validate.')
+    write_map(os.path.join(work_dir, 'map.txt'))
+    write_def(os.path.join(work_dir, 'rel.def'), opts.reps)
+    with open(os.path.join(work_dir, 'geno.def'), 'w') as out_file:
+        out_file.write("def geno %d 2\n2 2 1\n" % opts.geno_reps)
+    write_vcf(os.path.join(work_dir, 'in.vcf'), 2 * opts.geno_reps, opts.sites)
+
+    print("Running reference: %s %s" % (opts.ref, opts.ref_args))
+    sys.stdout.flush()
+    ref = simulate(opts, work_dir, 'ref', opts.ref, opts.ref_args, opts.seed)
+    print("Running candidate: %s %s" % (opts.cand, opts.cand_args))
+    sys.stdout.flush()
+    cand = simulate(opts, work_dir, 'cand', opts.cand, opts.cand_args,
+                    opts.seed + 1)
+
+    ref_geno, cand_geno = ref[2], cand[2]
+    print("\nGenotype error rate: reference %.5f, candidate %.5f" %
+          ((ref_geno[1] + ref_geno[2]) / max(sum(ref_geno[:3]), 1),
+           (cand_geno[1] + cand_geno[2]) / max(sum(cand_geno[:3]), 1)))
+    print("Missingness rate: reference %.5f, candidate %.5f\n" %
+          (ref_geno[3] / max(sum(ref_geno), 1),
+           cand_geno[3] / max(sum(cand_geno), 1)))
+
+    tests = compare(ref, cand)
+    threshold = opts.alpha / len(tests)
+    failures = []
+    print("%-32s %10s %10s %-18s %10s" % ('test', 'ref n', 'cand n',
+                                          'statistic', 'p-value'))
+    for name, n_ref, n_cand, stat, p in tests:
+        flag = ''
+        if p < threshold:
+            flag = '  FAIL'
+            failures.append(name)
+        print("%-32s %10d %10d %-18s %10.3g%s" % (name, n_ref, n_cand, stat,
+                                                  p, flag))
+
+    if opts.out:
+        with open(opts.out, 'w') as out_file:
+            out_file.write("#test\tref_n\tcand_n\tstatistic\tp_value\n")
+            for test in tests:
+                out_file.write("%s\t%d\t%d\t%s\t%.6g\n" % test)
+
+    if not opts.work_dir:
+        shutil.rmtree(work_dir)
+
+    print("\n%d tests; Bonferroni threshold %.3g" % (len(tests), threshold))
+    if failures:
+        print("%d test(s) failed (marked FAIL above)" % len(failures))
+        sys.exit(1)
+    print("All distributions match")
+
+if __name__ == "__main__":
+    main()